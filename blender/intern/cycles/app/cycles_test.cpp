@@ -21,6 +21,7 @@
 #include "buffers.h"
 #include "camera.h"
 #include "device.h"
+#include "film.h"
 #include "scene.h"
 #include "session.h"
 
@@ -30,6 +31,7 @@
 #include "util_path.h"
 #include "util_progress.h"
 #include "util_string.h"
+#include "util_system.h"
 #include "util_time.h"
 #include "util_view.h"
 
@@ -45,6 +47,9 @@ struct Options {
 	SceneParams scene_params;
 	SessionParams session_params;
 	bool quiet;
+	float adaptive_threshold;
+	int adaptive_min_samples;
+	vector<Pass> passes;
 } options;
 
 static void session_print(const string& str)
@@ -90,6 +95,7 @@ static BufferParams& session_buffer_params()
 	buffer_params.height = options.height;
 	buffer_params.full_width = options.width;
 	buffer_params.full_height = options.height;
+	buffer_params.passes = options.passes;
 
 	return buffer_params;
 }
@@ -114,6 +120,21 @@ static void scene_init(int width, int height)
 {
 	options.scene = new Scene(options.scene_params, options.session_params.device);
 	xml_read_file(options.scene, options.filepath.c_str());
+
+	/* adaptive sampling */
+	Pass::add(PASS_COMBINED, options.passes);
+
+	if(options.adaptive_threshold > 0.0f) {
+		Film *film = options.scene->film;
+
+		Pass::add(PASS_ADAPTIVE_VARIANCE, options.passes);
+		Pass::add(PASS_SAMPLE_COUNT, options.passes);
+
+		film->adaptive_threshold = options.adaptive_threshold;
+		film->adaptive_min_samples = options.adaptive_min_samples;
+		film->tag_passes_update(options.scene, options.passes);
+		film->tag_update(options.scene);
+	}
 	
 	if (width == 0 || height == 0) {
 		options.width = options.scene->camera->width;
@@ -121,8 +142,82 @@ static void scene_init(int width, int height)
 	}
 }
 
+static const char *session_cpu_kernel()
+{
+#ifdef WITH_OPTIMIZED_KERNEL
+	if(system_cpu_support_avx())
+		return "AVX";
+	else if(system_cpu_support_sse41())
+		return "SSE4.1";
+	else if(system_cpu_support_sse3())
+		return "SSE3";
+	else if(system_cpu_support_sse2())
+		return "SSE2";
+#endif
+
+	return "generic";
+}
+
+static void session_print_stats()
+{
+	int tile;
+	double total_time, sample_time;
+	uint64_t num_rays = options.session->stats.num_rays;
+
+	options.session->progress.get_tile(tile, total_time, sample_time);
+
+	/* rays are only counted on the CPU */
+	if(num_rays != 0 && total_time > 0.0) {
+		printf("Kernel: %s, BVH: %s, rays: %llu, time: %.2fs, rays per second: %.2fM\n",
+			session_cpu_kernel(), (options.scene_params.use_qbvh)? "QBVH": "binary",
+			(unsigned long long)num_rays, total_time,
+			(double)num_rays / total_time * 1e-6);
+	}
+
+	/* memory use of scene arrays */
+	map<string, size_t>& mem_arrays = options.session->stats.mem_arrays;
+
+	if(mem_arrays.size()) {
+		printf("Scene arrays:\n");
+
+		for(map<string, size_t>::iterator it = mem_arrays.begin(); it != mem_arrays.end(); it++)
+			printf("  %s: %.2fM\n", it->first.c_str(), (double)it->second / 1024.0 / 1024.0);
+
+		printf("  total: %.2fM\n", (double)options.session->stats.mem_arrays_total() / 1024.0 / 1024.0);
+	}
+
+	/* samples used by adaptive sampling */
+	RenderBuffers *buffers = options.session->buffers;
+
+	if(buffers && Pass::contains(buffers->params.passes, PASS_SAMPLE_COUNT) && buffers->copy_from_device()) {
+		int size = buffers->params.width*buffers->params.height;
+		vector<float> samples(size);
+		double total_samples = 0.0;
+		float min_samples = FLT_MAX, max_samples = 0.0f;
+
+		buffers->get_pass_rect(PASS_SAMPLE_COUNT, 1.0f, 1, 1, &samples[0]);
+
+		for(int i = 0; i < size; i++) {
+			total_samples += samples[i];
+			min_samples = min(min_samples, samples[i]);
+			max_samples = max(max_samples, samples[i]);
+		}
+
+		printf("Adaptive samples per pixel: average %.1f, min %.0f, max %.0f\n",
+			total_samples/max(size, 1), min_samples, max_samples);
+	}
+}
+
 static void session_exit()
 {
+	if(options.session_params.background && !options.quiet) {
+		session_print("Finished Rendering.");
+		printf("\n");
+
+		if(options.session)
+			session_print_stats();
+	}
+
 	if(options.session) {
 		delete options.session;
 		options.session = NULL;
@@ -131,11 +226,6 @@ static void session_exit()
 		delete options.scene;
 		options.scene = NULL;
 	}
-
-	if(options.session_params.background && !options.quiet) {
-		session_print("Finished Rendering.");
-		printf("\n");
-	}
 }
 
 static void display_info(Progress& progress)
@@ -204,11 +294,14 @@ static void options_parse(int argc, const char **argv)
 	options.filepath = "";
 	options.session = NULL;
 	options.quiet = false;
+	options.adaptive_threshold = 0.0f;
+	options.adaptive_min_samples = 16;
 
 	/* device names */
 	string device_names = "";
 	string devicename = "cpu";
 	bool list = false;
+	bool no_qbvh = false;
 
 	vector<DeviceType>& types = Device::available_types();
 
@@ -240,6 +333,11 @@ static void options_parse(int argc, const char **argv)
 		"--samples %d", &options.session_params.samples, "Number of samples to render",
 		"--output %s", &options.session_params.output_path, "File path to write output image",
 		"--threads %d", &options.session_params.threads, "CPU Rendering Threads",
+		"--no-qbvh", &no_qbvh, "Use the binary BVH even if the device supports QBVH",
+		"--compact-bvh", &options.scene_params.use_bvh_compact, "Store the BVH compactly, with quantized bounds and no precomputed triangle data",
+		"--texture-cache %d", &options.scene_params.texture_cache_size, "Load image tiles on demand with this memory budget in MB, disabled if 0",
+		"--adaptive-threshold %f", &options.adaptive_threshold, "Noise threshold for adaptive sampling, disabled if 0",
+		"--adaptive-min-samples %d", &options.adaptive_min_samples, "Samples per pixel before adaptive sampling checks the noise",
 		"--width  %d", &options.width, "Window width in pixel",
 		"--height %d", &options.height, "Window height in pixel",
 		"--list-devices", &list, "List information about all available devices",
@@ -290,6 +388,8 @@ static void options_parse(int argc, const char **argv)
 		}
 	}
 
+	options.scene_params.use_qbvh = options.session_params.device.has_qbvh && !no_qbvh;
+
 	/* handle invalid configurations */
 	if(options.session_params.device.type == DEVICE_NONE || !device_available) {
 		fprintf(stderr, "Unknown device: %s\n", devicename.c_str());
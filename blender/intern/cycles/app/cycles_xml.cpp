@@ -281,6 +281,14 @@ static void xml_read_integrator(const XMLReadState& state, pugi::xml_node node)
 	
 	xml_read_int(&integrator->seed, node, "seed");
 	xml_read_float(&integrator->sample_clamp, node, "sample_clamp");
+
+	if(xml_equal_string(node, "volume_sampling", "distance"))
+		integrator->volume_sampling = VOLUME_SAMPLING_DISTANCE;
+	else if(xml_equal_string(node, "volume_sampling", "equiangular"))
+		integrator->volume_sampling = VOLUME_SAMPLING_EQUIANGULAR;
+
+	xml_read_float(&integrator->volume_step_size, node, "volume_step_size");
+	xml_read_int(&integrator->volume_max_steps, node, "volume_max_steps");
 }
 
 /* Camera */
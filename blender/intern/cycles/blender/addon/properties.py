@@ -119,6 +119,11 @@ enum_sampling_pattern = (
     ('CORRELATED_MUTI_JITTER', "Correlated Multi-Jitter", "Use Correlated Multi-Jitter random sampling pattern"),
     )
 
+enum_volume_sampling = (
+    ('DISTANCE', "Distance", "Sample scattering distance proportional to the volume density"),
+    ('EQUIANGULAR', "Equiangular", "Sample scattering distance towards lights, less noise for lights inside or near thin volumes"),
+    )
+
 
 class CyclesRenderSettings(bpy.types.PropertyGroup):
     @classmethod
@@ -231,6 +236,27 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
                 default='SOBOL',
                 )
 
+        cls.use_adaptive_sampling = BoolProperty(
+                name="Adaptive Sampling",
+                description="Stop sampling pixels once their noise is below the threshold, "
+                            "spending render time where the image is noisy",
+                default=False,
+                )
+        cls.adaptive_threshold = FloatProperty(
+                name="Noise Threshold",
+                description="Noise level at which pixels stop being sampled, lower values "
+                            "give less noise and longer render times",
+                min=0.0001, max=1.0,
+                default=0.01,
+                )
+        cls.adaptive_min_samples = IntProperty(
+                name="Min Samples",
+                description="Number of samples to render for every pixel before "
+                            "checking its noise level",
+                min=1, max=4096,
+                default=16,
+                )
+
         cls.use_layer_samples = EnumProperty(
                 name="Layer Samples",
                 description="How to use per render layer sample settings",
@@ -251,6 +277,28 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
                 default=0.0,
                 )
 
+        cls.volume_sampling = EnumProperty(
+                name="Volume Sampling",
+                description="Method to sample scattering distances in volumes",
+                items=enum_volume_sampling,
+                default='DISTANCE',
+                )
+        cls.volume_step_size = FloatProperty(
+                name="Step Size",
+                description="Distance between volume shader samples when rendering "
+                            "volumes with varying density, lower values give more "
+                            "accurate results and longer render times",
+                min=0.0000001, max=100000.0,
+                default=0.1,
+                )
+        cls.volume_max_steps = IntProperty(
+                name="Max Steps",
+                description="Maximum number of steps through a volume, the step size "
+                            "is increased for longer distances",
+                min=2, max=65536,
+                default=1024,
+                )
+
         cls.min_bounces = IntProperty(
                 name="Min Bounces",
                 description="Minimum number of bounces, setting this lower "
@@ -392,11 +440,29 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
                 description="Use BVH spatial splits: longer builder time, faster render",
                 default=False,
                 )
+        cls.debug_use_compact_bvh = BoolProperty(
+                name="Use Compact BVH",
+                description="Use a compact BVH with quantized bounds and no precomputed triangle data: "
+                            "less memory, slower render",
+                default=False,
+                )
         cls.use_cache = BoolProperty(
                 name="Cache BVH",
                 description="Cache last built BVH to disk for faster re-render if no geometry changed",
                 default=False,
                 )
+        cls.use_texture_cache = BoolProperty(
+                name="Texture Cache",
+                description="Load image texture tiles on demand from tiled and mipmapped files, "
+                            "instead of loading all images fully before rendering (CPU only)",
+                default=False,
+                )
+        cls.texture_cache_size = IntProperty(
+                name="Cache Size",
+                description="Maximum memory used by the texture cache, in megabytes",
+                min=16, max=1048576,
+                default=1024,
+                )
         cls.tile_order = EnumProperty(
                 name="Tile Order",
                 description="Tile order for rendering",
@@ -88,6 +88,16 @@ class CyclesRender_PT_sampling(CyclesButtonsPanel, Panel):
         if cscene.feature_set == 'EXPERIMENTAL' and (device_type == 'NONE' or cscene.device == 'CPU'):
             layout.row().prop(cscene, "sampling_pattern", text="Pattern")
 
+        layout.separator()
+
+        split = layout.split()
+        col = split.column()
+        col.prop(cscene, "use_adaptive_sampling")
+        col = split.column(align=True)
+        col.active = cscene.use_adaptive_sampling
+        col.prop(cscene, "adaptive_threshold", text="Threshold")
+        col.prop(cscene, "adaptive_min_samples")
+
         for rl in scene.render.layers:
             if rl.samples > 0:
                 layout.separator()
@@ -125,6 +135,14 @@ class CyclesRender_PT_light_paths(CyclesButtonsPanel, Panel):
         col.prop(cscene, "no_caustics")
         col.prop(cscene, "blur_glossy")
 
+        col.separator()
+
+        sub = col.column(align=True)
+        sub.label("Volume:")
+        sub.prop(cscene, "volume_sampling", text="")
+        sub.prop(cscene, "volume_step_size")
+        sub.prop(cscene, "volume_max_steps")
+
         col = split.column()
 
         sub = col.column(align=True)
@@ -219,6 +237,7 @@ class CyclesRender_PT_performance(CyclesButtonsPanel, Panel):
         sub.label(text="Acceleration structure:")
         sub.prop(cscene, "debug_bvh_type", text="")
         sub.prop(cscene, "debug_use_spatial_splits")
+        sub.prop(cscene, "debug_use_compact_bvh")
         sub.prop(cscene, "use_cache")
 
         sub = col.column(align=True)
@@ -227,7 +246,14 @@ class CyclesRender_PT_performance(CyclesButtonsPanel, Panel):
 
         sub = col.column(align=True)
         sub.label(text="Final Render:")
-        sub.prop(rd, "use_persistent_data", text="Persistent Images")
+        sub.prop(rd, "use_persistent_data", text="Persistent Data")
+
+        sub = col.column(align=True)
+        sub.label(text="Textures:")
+        sub.prop(cscene, "use_texture_cache")
+        subsub = sub.row()
+        subsub.active = cscene.use_texture_cache
+        subsub.prop(cscene, "texture_cache_size")
 
 
 class CyclesRender_PT_opengl(CyclesButtonsPanel, Panel):
@@ -391,6 +391,59 @@ static void create_subd_mesh(Mesh *mesh, BL::Mesh b_mesh, PointerRNA *cmesh, con
 	sdmesh.tessellate(&dsplit, false, mesh, used_shaders[0], true);
 }
 
+/* Smoke Grids
+ *
+ * Voxel grids from a smoke domain are exported as mesh attributes, for volume
+ * shaders on the domain object to look up. This assumes the grid covers the
+ * full domain, as is the case without adaptive domain. */
+
+static void create_smoke_grid(Scene *scene, Mesh *mesh, PointerRNA& b_domain, AttributeStandard std, const char *identifier)
+{
+	if(!mesh->need_attribute(scene, std))
+		return;
+
+	int res[3];
+	RNA_int_get_array(&b_domain, "domain_resolution", res);
+
+	PropertyRNA *prop = RNA_struct_find_property(&b_domain, identifier);
+	int length = (prop)? RNA_property_array_length(&b_domain, prop): 0;
+
+	if(length == 0 || length != res[0]*res[1]*res[2])
+		return;
+
+	/* transform from object space to the unit cube of the grid */
+	float3 start = get_float3(b_domain, "start_point");
+	float3 cell_size = get_float3(b_domain, "cell_size");
+	float3 size = cell_size*make_float3((float)res[0], (float)res[1], (float)res[2]);
+
+	Transform tfm = transform_scale(make_float3(1.0f/size.x, 1.0f/size.y, 1.0f/size.z))*transform_translate(-start);
+
+	Attribute *attr = mesh->attributes.add(std);
+	attr->reserve_voxels(tfm, make_int3(res[0], res[1], res[2]));
+
+	RNA_property_float_get_array(&b_domain, prop, attr->data_voxels());
+}
+
+static void create_smoke_grids(Scene *scene, Mesh *mesh, BL::Object b_ob)
+{
+	BL::Object::modifiers_iterator b_mod;
+
+	for(b_ob.modifiers.begin(b_mod); b_mod != b_ob.modifiers.end(); ++b_mod) {
+		if(b_mod->type() == b_mod->type_SMOKE) {
+			BL::SmokeModifier b_smd((const PointerRNA)b_mod->ptr);
+
+			if(b_smd.smoke_type() == BL::SmokeModifier::smoke_type_DOMAIN) {
+				BL::SmokeDomainSettings b_domain = b_smd.domain_settings();
+
+				if(b_domain) {
+					create_smoke_grid(scene, mesh, b_domain.ptr, ATTR_STD_VOLUME_DENSITY, "density");
+					create_smoke_grid(scene, mesh, b_domain.ptr, ATTR_STD_VOLUME_HEAT, "heat");
+				}
+			}
+		}
+	}
+}
+
 /* Sync */
 
 Mesh *BlenderSync::sync_mesh(BL::Object b_ob, bool object_updated, bool hide_tris)
@@ -480,6 +533,10 @@ Mesh *BlenderSync::sync_mesh(BL::Object b_ob, bool object_updated, bool hide_tri
 		}
 	}
 
+	/* voxel grids for volume shaders */
+	if(render_layer.use_surfaces)
+		create_smoke_grids(scene, mesh, b_ob);
+
 	/* displacement method */
 	if(cmesh.data) {
 		const int method = RNA_enum_get(&cmesh, "displacement_method");
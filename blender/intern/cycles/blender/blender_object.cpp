@@ -251,6 +251,11 @@ Object *BlenderSync::sync_object(BL::Object b_parent, int persistent_id[OBJECT_P
 
 	if(object_map.sync(&object, b_ob, b_parent, key))
 		object_updated = true;
+
+	/* moved objects are not tagged for recalc on frame changes with persistent
+	 * data, meshes with the transform applied need to be synced again */
+	if(tfm != object->tfm)
+		object_updated = true;
 	
 	bool use_holdout = (layer_flag & render_layer.holdout_layer) != 0;
 	
@@ -81,8 +81,8 @@ BlenderSession::~BlenderSession()
 
 void BlenderSession::create_session()
 {
-	SceneParams scene_params = BlenderSync::get_scene_params(b_scene, background);
 	SessionParams session_params = BlenderSync::get_session_params(b_engine, b_userpref, b_scene, background);
+	SceneParams scene_params = BlenderSync::get_scene_params(b_scene, background, session_params.device);
 
 	/* reset status/progress */
 	last_status = "";
@@ -129,25 +129,28 @@ void BlenderSession::create_session()
 
 void BlenderSession::reset_session(BL::BlendData b_data_, BL::Scene b_scene_)
 {
+	bool scene_changed = (b_scene_.ptr.data != b_scene.ptr.data);
+
 	b_data = b_data_;
 	b_render = b_engine.render();
 	b_scene = b_scene_;
 
-	SceneParams scene_params = BlenderSync::get_scene_params(b_scene, background);
 	SessionParams session_params = BlenderSync::get_session_params(b_engine, b_userpref, b_scene, background);
+	SceneParams scene_params = BlenderSync::get_scene_params(b_scene, background, session_params.device);
 
 	width = render_resolution_x(b_render);
 	height = render_resolution_y(b_render);
 
 	if(scene->params.modified(scene_params) ||
 	   session->params.modified(session_params) ||
-	   !scene_params.persistent_data)
+	   !scene_params.persistent_data ||
+	   scene_changed || !sync)
 	{
 		/* if scene or session parameters changed, it's easier to simply re-create
 		 * them rather than trying to distinguish which settings need to be updated
 		 */
 
-		delete session;
+		free_session();
 
 		create_session();
 
@@ -164,8 +167,9 @@ void BlenderSession::reset_session(BL::BlendData b_data_, BL::Scene b_scene_)
 	 */
 	session->stats.mem_peak = session->stats.mem_used;
 
-	/* sync object should be re-created */
-	sync = new BlenderSync(b_engine, b_data, b_scene, scene, !background, session->progress, session_params.device.type == DEVICE_CPU);
+	/* sync object is kept along with the scene data, so that only data which
+	 * may have changed with the frame is synced again */
+	sync->sync_recalc_frame();
 
 	if(b_rv3d) {
 		sync->sync_data(b_v3d, b_engine.camera_override());
@@ -366,6 +370,14 @@ void BlenderSession::render()
 				if(pass_type != PASS_NONE)
 					Pass::add(pass_type, passes);
 			}
+
+			/* adaptive sampling, only for final renders */
+			PointerRNA cscene = RNA_pointer_get(&b_scene.ptr, "cycles");
+
+			if(get_boolean(cscene, "use_adaptive_sampling")) {
+				Pass::add(PASS_ADAPTIVE_VARIANCE, passes);
+				Pass::add(PASS_SAMPLE_COUNT, passes);
+			}
 		}
 
 		/* free result without merging */
@@ -402,13 +414,16 @@ void BlenderSession::render()
 	session->update_render_tile_cb = NULL;
 
 	/* free all memory used (host and device), so we wouldn't leave render
-	 * engine with extra memory allocated
+	 * engine with extra memory allocated. with persistent data the scene and
+	 * sync state are kept for the next frame
 	 */
 
-	session->device_free();
+	if(!scene->params.persistent_data) {
+		session->device_free();
 
-	delete sync;
-	sync = NULL;
+		delete sync;
+		sync = NULL;
+	}
 }
 
 void BlenderSession::do_write_update_render_result(BL::RenderResult b_rr, BL::RenderLayer b_rlay, RenderTile& rtile, bool do_update_only)
@@ -468,8 +483,8 @@ void BlenderSession::synchronize()
 		return;
 
 	/* on session/scene parameter changes, we recreate session entirely */
-	SceneParams scene_params = BlenderSync::get_scene_params(b_scene, background);
 	SessionParams session_params = BlenderSync::get_session_params(b_engine, b_userpref, b_scene, background);
+	SceneParams scene_params = BlenderSync::get_scene_params(b_scene, background, session_params.device);
 
 	if(session->params.modified(session_params) ||
 	   scene->params.modified(scene_params))
@@ -612,12 +627,16 @@ void BlenderSession::update_status_progress()
 	char time_str[128];
 	float mem_used = (float)session->stats.mem_used / 1024.0f / 1024.0f;
 	float mem_peak = (float)session->stats.mem_peak / 1024.0f / 1024.0f;
+	float mem_bvh = (float)session->stats.mem_arrays_total() / 1024.0f / 1024.0f;
 
 	get_status(status, substatus);
 	get_progress(progress, total_time);
 
 	timestatus = string_printf("Mem:%.2fM, Peak:%.2fM", mem_used, mem_peak);
 
+	if(mem_bvh > 0.0f)
+		timestatus += string_printf(", BVH:%.2fM", mem_bvh);
+
 	if(background) {
 		timestatus += " | " + b_scene.name();
 		if(b_rlay_name != "")
@@ -136,6 +136,47 @@ bool BlenderSync::sync_recalc()
 	return recalc;
 }
 
+void BlenderSync::sync_recalc_frame()
+{
+	/* tag data for sync after a frame change in a background render with
+	 * persistent data. blender recalc flags are cleared by the time we get
+	 * here, so shaders, lights and particles are all synced again as they are
+	 * cheap. object transforms are compared while syncing. meshes are exported
+	 * again for objects with modifiers or shape keys, or with updated data,
+	 * other meshes keep their packed data and BVH */
+	BL::BlendData::materials_iterator b_mat;
+
+	for(b_data.materials.begin(b_mat); b_mat != b_data.materials.end(); ++b_mat)
+		shader_map.set_recalc(*b_mat);
+
+	BL::BlendData::lamps_iterator b_lamp;
+
+	for(b_data.lamps.begin(b_lamp); b_lamp != b_data.lamps.end(); ++b_lamp)
+		shader_map.set_recalc(*b_lamp);
+
+	BL::BlendData::objects_iterator b_ob;
+
+	for(b_data.objects.begin(b_ob); b_ob != b_data.objects.end(); ++b_ob) {
+		if(object_is_mesh(*b_ob)) {
+			/* curves, text and metaballs are converted to a mesh that can
+			 * depend on other objects, they are always exported again */
+			if(!b_ob->data().is_a(&RNA_Mesh) || b_ob->is_updated_data() || b_ob->data().is_updated() ||
+			   ccl::BKE_object_is_modified(*b_ob, b_scene, preview))
+			{
+				BL::ID key = BKE_object_is_modified(*b_ob)? *b_ob: b_ob->data();
+				mesh_map.set_recalc(key);
+			}
+		}
+		else if(object_is_light(*b_ob))
+			light_map.set_recalc(*b_ob);
+
+		if(b_ob->particle_systems.length())
+			particle_system_map.set_recalc(*b_ob);
+	}
+
+	world_recalc = true;
+}
+
 void BlenderSync::sync_data(BL::SpaceView3D b_v3d, BL::Object b_override, const char *layer)
 {
 	sync_render_layers(b_v3d, layer);
@@ -175,6 +216,10 @@ void BlenderSync::sync_integrator()
 	integrator->no_caustics = get_boolean(cscene, "no_caustics");
 	integrator->filter_glossy = get_float(cscene, "blur_glossy");
 
+	integrator->volume_sampling = (VolumeSampling)RNA_enum_get(&cscene, "volume_sampling");
+	integrator->volume_step_size = get_float(cscene, "volume_step_size");
+	integrator->volume_max_steps = get_int(cscene, "volume_max_steps");
+
 	integrator->seed = get_int(cscene, "seed");
 
 	integrator->layer_flag = render_layer.layer;
@@ -219,6 +264,9 @@ void BlenderSync::sync_film()
 	film->filter_type = (FilterType)RNA_enum_get(&cscene, "filter_type");
 	film->filter_width = (film->filter_type == FILTER_BOX)? 1.0f: get_float(cscene, "filter_width");
 
+	film->adaptive_threshold = get_float(cscene, "adaptive_threshold");
+	film->adaptive_min_samples = get_int(cscene, "adaptive_min_samples");
+
 	if(b_scene.world()) {
 		BL::WorldMistSettings b_mist = b_scene.world().mist_settings();
 
@@ -310,7 +358,7 @@ void BlenderSync::sync_render_layers(BL::SpaceView3D b_v3d, const char *layer)
 
 /* Scene Parameters */
 
-SceneParams BlenderSync::get_scene_params(BL::Scene b_scene, bool background)
+SceneParams BlenderSync::get_scene_params(BL::Scene b_scene, bool background, const DeviceInfo& device_info)
 {
 	BL::RenderSettings r = b_scene.render();
 	SceneParams params;
@@ -328,13 +376,22 @@ SceneParams BlenderSync::get_scene_params(BL::Scene b_scene, bool background)
 		params.bvh_type = (SceneParams::BVHType)RNA_enum_get(&cscene, "debug_bvh_type");
 
 	params.use_bvh_spatial_split = RNA_boolean_get(&cscene, "debug_use_spatial_splits");
+	params.use_bvh_compact = RNA_boolean_get(&cscene, "debug_use_compact_bvh");
 	params.use_bvh_cache = (background)? RNA_boolean_get(&cscene, "use_cache"): false;
 
+	/* 4-wide BVH on devices that can traverse it */
+	params.use_qbvh = device_info.has_qbvh;
+
 	if(background && params.shadingsystem != SceneParams::OSL)
 		params.persistent_data = r.use_persistent_data();
 	else
 		params.persistent_data = false;
 
+	if(RNA_boolean_get(&cscene, "use_texture_cache"))
+		params.texture_cache_size = RNA_int_get(&cscene, "texture_cache_size");
+	else
+		params.texture_cache_size = 0;
+
 	return params;
 }
 
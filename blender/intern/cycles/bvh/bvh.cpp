@@ -69,6 +69,14 @@ BVH *BVH::create(const BVHParams& params, const vector<Object*>& objects)
 		return new RegularBVH(params, objects);
 }
 
+size_t BVH::node_size() const
+{
+	if(params.use_qbvh)
+		return (params.use_compact)? BVH_QNODE_COMPACT_SIZE: BVH_QNODE_SIZE;
+	else
+		return BVH_NODE_SIZE;
+}
+
 /* Cache */
 
 bool BVH::cache_read(CacheData& key)
@@ -225,10 +233,14 @@ void BVH::build(Progress& progress)
 
 void BVH::refit(Progress& progress)
 {
-	progress.set_substatus("Packing BVH primitives");
-	pack_primitives();
+	/* in the top level only object bounds are refit, primitives of meshes
+	 * with transform applied are packed already and did not move */
+	if(!params.top_level) {
+		progress.set_substatus("Packing BVH primitives");
+		pack_primitives();
 
-	if(progress.get_cancel()) return;
+		if(progress.get_cancel()) return;
+	}
 
 	progress.set_substatus("Refitting BVH nodes");
 	refit_nodes();
@@ -324,8 +336,14 @@ void BVH::pack_primitives()
 	size_t tidx_size = pack.prim_index.size();
 
 	pack.tri_woop.clear();
-	pack.tri_woop.resize(tidx_size * nsize);
 	pack.prim_visibility.clear();
+
+	/* in compact mode triangles are intersected from the mesh vertices, and
+	 * the visibility is looked up from the object */
+	if(params.use_compact)
+		return;
+
+	pack.tri_woop.resize(tidx_size * nsize);
 	pack.prim_visibility.resize(tidx_size);
 
 	for(unsigned int i = 0; i < tidx_size; i++) {
@@ -361,7 +379,8 @@ void BVH::pack_instances(size_t nodes_size)
 	 * BVH's are stored in global arrays. This function merges them into the
 	 * top level BVH, adjusting indexes and offsets where appropriate. */
 	bool use_qbvh = params.use_qbvh;
-	size_t nsize = (use_qbvh)? BVH_QNODE_SIZE: BVH_NODE_SIZE;
+	bool use_compact = params.use_compact;
+	size_t nsize = node_size();
 
 	/* adjust primitive index to point to the triangle in the global array, for
 	 * meshes with transform applied and already in the top level BVH */
@@ -399,7 +418,7 @@ void BVH::pack_instances(size_t nodes_size)
 			if(mesh_map.find(mesh) == mesh_map.end()) {
 				prim_index_size += bvh->pack.prim_index.size();
 				tri_woop_size += bvh->pack.tri_woop.size();
-				nodes_size += bvh->pack.nodes.size()*nsize;
+				nodes_size += bvh->pack.nodes.size();
 
 				mesh_map[mesh] = 1;
 			}
@@ -411,7 +430,8 @@ void BVH::pack_instances(size_t nodes_size)
 	pack.prim_index.resize(prim_index_size);
 	pack.prim_segment.resize(prim_index_size);
 	pack.prim_object.resize(prim_index_size);
-	pack.prim_visibility.resize(prim_index_size);
+	if(!use_compact)
+		pack.prim_visibility.resize(prim_index_size);
 	pack.tri_woop.resize(tri_woop_size);
 	pack.nodes.resize(nodes_size);
 	pack.object_node.resize(objects.size());
@@ -463,7 +483,7 @@ void BVH::pack_instances(size_t nodes_size)
 			size_t bvh_prim_index_size = bvh->pack.prim_index.size();
 			int *bvh_prim_index = &bvh->pack.prim_index[0];
 			int *bvh_prim_segment = &bvh->pack.prim_segment[0];
-			uint *bvh_prim_visibility = &bvh->pack.prim_visibility[0];
+			uint *bvh_prim_visibility = (bvh->pack.prim_visibility.size())? &bvh->pack.prim_visibility[0]: NULL;
 
 			for(size_t i = 0; i < bvh_prim_index_size; i++) {
 				if(bvh->pack.prim_segment[i] != ~0)
@@ -472,7 +492,8 @@ void BVH::pack_instances(size_t nodes_size)
 					pack_prim_index[pack_prim_index_offset] = bvh_prim_index[i] + mesh_tri_offset;
 
 				pack_prim_segment[pack_prim_index_offset] = bvh_prim_segment[i];
-				pack_prim_visibility[pack_prim_index_offset] = bvh_prim_visibility[i];
+				if(pack_prim_visibility)
+					pack_prim_visibility[pack_prim_index_offset] = bvh_prim_visibility[i];
 				pack_prim_object[pack_prim_index_offset] = 0;  // unused for instances
 				pack_prim_index_offset++;
 			}
@@ -502,14 +523,16 @@ void BVH::pack_instances(size_t nodes_size)
 					data.x += prim_offset;
 					data.y += prim_offset;
 				}
+				else if(use_qbvh) {
+					/* zero marks an empty child slot */
+					if(data.x) data.x += (data.x < 0)? -noffset: noffset;
+					if(data.y) data.y += (data.y < 0)? -noffset: noffset;
+					if(data.z) data.z += (data.z < 0)? -noffset: noffset;
+					if(data.w) data.w += (data.w < 0)? -noffset: noffset;
+				}
 				else {
 					data.x += (data.x < 0)? -noffset: noffset;
 					data.y += (data.y < 0)? -noffset: noffset;
-
-					if(use_qbvh) {
-						data.z += (data.z < 0)? -noffset: noffset;
-						data.w += (data.w < 0)? -noffset: noffset;
-					}
 				}
 
 				pack_nodes[pack_nodes_offset + nsize_bbox] = data;
@@ -526,6 +549,61 @@ void BVH::pack_instances(size_t nodes_size)
 	}
 }
 
+/* Refit */
+
+void BVH::refit_primitives(int start, int end, BoundBox& bbox, uint& visibility)
+{
+	for(int prim = start; prim < end; prim++) {
+		int pidx = pack.prim_index[prim];
+		int tob = pack.prim_object[prim];
+		Object *ob = objects[tob];
+
+		if(pidx == -1) {
+			/* object instance */
+			bbox.grow(ob->bounds);
+		}
+		else {
+			/* primitives */
+			const Mesh *mesh = ob->mesh;
+
+			if(pack.prim_segment[prim] != ~0) {
+				/* curves */
+				int str_offset = (params.top_level)? mesh->curve_offset: 0;
+				int k0 = mesh->curves[pidx - str_offset].first_key + pack.prim_segment[prim]; // XXX!
+				int k1 = k0 + 1;
+
+				float3 p[4];
+				p[0] = mesh->curve_keys[max(k0 - 1,mesh->curves[pidx - str_offset].first_key)].co;
+				p[1] = mesh->curve_keys[k0].co;
+				p[2] = mesh->curve_keys[k1].co;
+				p[3] = mesh->curve_keys[min(k1 + 1,mesh->curves[pidx - str_offset].first_key + mesh->curves[pidx - str_offset].num_keys - 1)].co;
+				float3 lower;
+				float3 upper;
+				curvebounds(&lower.x, &upper.x, p, 0);
+				curvebounds(&lower.y, &upper.y, p, 1);
+				curvebounds(&lower.z, &upper.z, p, 2);
+				float mr = max(mesh->curve_keys[k0].radius,mesh->curve_keys[k1].radius);
+				bbox.grow(lower, mr);
+				bbox.grow(upper, mr);
+
+				visibility |= PATH_RAY_CURVE;
+			}
+			else {
+				/* triangles */
+				int tri_offset = (params.top_level)? mesh->tri_offset: 0;
+				const int *vidx = mesh->triangles[pidx - tri_offset].v;
+				const float3 *vpos = &mesh->verts[0];
+
+				bbox.grow(vpos[vidx[0]]);
+				bbox.grow(vpos[vidx[1]]);
+				bbox.grow(vpos[vidx[2]]);
+			}
+		}
+
+		visibility |= ob->visibility;
+	}
+}
+
 /* Regular BVH */
 
 RegularBVH::RegularBVH(const BVHParams& params_, const vector<Object*>& objects_)
@@ -608,8 +686,6 @@ void RegularBVH::pack_nodes(const array<int>& prims, const BVHNode *root)
 
 void RegularBVH::refit_nodes()
 {
-	assert(!params.top_level);
-
 	BoundBox bbox = BoundBox::empty;
 	uint visibility = 0;
 	refit_node(0, (pack.is_leaf[0])? true: false, bbox, visibility);
@@ -623,56 +699,11 @@ void RegularBVH::refit_node(int idx, bool leaf, BoundBox& bbox, uint& visibility
 	int c1 = data[3].y;
 
 	if(leaf) {
-		/* refit leaf node */
-		for(int prim = c0; prim < c1; prim++) {
-			int pidx = pack.prim_index[prim];
-			int tob = pack.prim_object[prim];
-			Object *ob = objects[tob];
-
-			if(pidx == -1) {
-				/* object instance */
-				bbox.grow(ob->bounds);
-			}
-			else {
-				/* primitives */
-				const Mesh *mesh = ob->mesh;
-
-				if(pack.prim_segment[prim] != ~0) {
-					/* curves */
-					int str_offset = (params.top_level)? mesh->curve_offset: 0;
-					int k0 = mesh->curves[pidx - str_offset].first_key + pack.prim_segment[prim]; // XXX!
-					int k1 = k0 + 1;
-
-					float3 p[4];
-					p[0] = mesh->curve_keys[max(k0 - 1,mesh->curves[pidx - str_offset].first_key)].co;
-					p[1] = mesh->curve_keys[k0].co;
-					p[2] = mesh->curve_keys[k1].co;
-					p[3] = mesh->curve_keys[min(k1 + 1,mesh->curves[pidx - str_offset].first_key + mesh->curves[pidx - str_offset].num_keys - 1)].co;
-					float3 lower;
-					float3 upper;
-					curvebounds(&lower.x, &upper.x, p, 0);
-					curvebounds(&lower.y, &upper.y, p, 1);
-					curvebounds(&lower.z, &upper.z, p, 2);
-					float mr = max(mesh->curve_keys[k0].radius,mesh->curve_keys[k1].radius);
-					bbox.grow(lower, mr);
-					bbox.grow(upper, mr);
-
-					visibility |= PATH_RAY_CURVE;
-				}
-				else {
-					/* triangles */
-					int tri_offset = (params.top_level)? mesh->tri_offset: 0;
-					const int *vidx = mesh->triangles[pidx - tri_offset].v;
-					const float3 *vpos = &mesh->verts[0];
-
-					bbox.grow(vpos[vidx[0]]);
-					bbox.grow(vpos[vidx[1]]);
-					bbox.grow(vpos[vidx[2]]);
-				}
-			}
-
-			visibility |= ob->visibility;
-		}
+		/* refit leaf node, negative index is an object instance */
+		if(c0 < 0)
+			refit_primitives(~c0, ~c0+1, bbox, visibility);
+		else
+			refit_primitives(c0, c1, bbox, visibility);
 
 		pack_node(idx, bbox, bbox, c0, c1, visibility, visibility);
 	}
@@ -698,81 +729,185 @@ QBVH::QBVH(const BVHParams& params_, const vector<Object*>& objects_)
 : BVH(params_, objects_)
 {
 	params.use_qbvh = true;
-
-	/* todo: use visibility */
 }
 
 void QBVH::pack_leaf(const BVHStackEntry& e, const LeafNode *leaf)
 {
+	size_t nsize = node_size();
 	float4 data[BVH_QNODE_SIZE];
 
 	memset(data, 0, sizeof(data));
 
+	/* primitive range is stored in place of the child indices */
 	if(leaf->num_triangles() == 1 && pack.prim_index[leaf->m_lo] == -1) {
 		/* object */
-		data[6].x = __int_as_float(~(leaf->m_lo));
-		data[6].y = __int_as_float(0);
+		data[nsize-2].x = __int_as_float(~(leaf->m_lo));
+		data[nsize-2].y = __int_as_float(0);
 	}
 	else {
 		/* triangle */
-		data[6].x = __int_as_float(leaf->m_lo);
-		data[6].y = __int_as_float(leaf->m_hi);
+		data[nsize-2].x = __int_as_float(leaf->m_lo);
+		data[nsize-2].y = __int_as_float(leaf->m_hi);
 	}
 
-	memcpy(&pack.nodes[e.idx * BVH_QNODE_SIZE], data, sizeof(float4)*BVH_QNODE_SIZE);
+	memcpy(&pack.nodes[e.idx * nsize], data, sizeof(float4)*nsize);
 }
 
 void QBVH::pack_inner(const BVHStackEntry& e, const BVHStackEntry *en, int num)
 {
-	float4 data[BVH_QNODE_SIZE];
+	BoundBox bounds[4];
+	int child[4];
+	uint visibility[4];
 
 	for(int i = 0; i < num; i++) {
-		float3 bb_min = en[i].node->m_bounds.min;
-		float3 bb_max = en[i].node->m_bounds.max;
+		bounds[i] = en[i].node->m_bounds;
+		child[i] = en[i].encodeIdx();
+		visibility[i] = en[i].node->m_visibility;
+	}
+
+	pack_node(e.idx, bounds, child, visibility, num);
+}
+
+/* Quantize child bounds along one axis to 8 bits, rounding outwards. The
+ * result is checked against the same dequantization as in the kernel, so
+ * that float rounding never makes a decoded box smaller than the child. */
+static void qbvh_quantize(float origin, float scale, float bmin, float bmax, int *qmin, int *qmax)
+{
+	int lo = 0, hi = 0;
+
+	if(scale > 0.0f) {
+		lo = clamp((int)floorf((bmin - origin)/scale), 0, 255);
+		hi = clamp((int)ceilf((bmax - origin)/scale), 0, 255);
+
+		while(lo > 0 && origin + (float)lo*scale > bmin)
+			lo--;
+		while(hi < 255 && origin + (float)hi*scale < bmax)
+			hi++;
+	}
+
+	*qmin = lo;
+	*qmax = hi;
+}
 
-		data[0][i] = bb_min.x;
-		data[1][i] = bb_max.x;
-		data[2][i] = bb_min.y;
-		data[3][i] = bb_max.y;
-		data[4][i] = bb_min.z;
-		data[5][i] = bb_max.z;
+void QBVH::pack_node(int idx, const BoundBox *bounds, const int *child, const uint *visibility, int num)
+{
+	size_t nsize = node_size();
+	float4 data[BVH_QNODE_SIZE];
+
+	if(params.use_compact) {
+		/* origin and scale of the quantization grid, followed by one int per
+		 * plane with the 8 bit coordinates of the four children */
+		BoundBox node_bounds = BoundBox::empty;
+
+		for(int i = 0; i < num; i++)
+			node_bounds.grow(bounds[i]);
+
+		float origin[3] = {node_bounds.min.x, node_bounds.min.y, node_bounds.min.z};
+		float extent[3] = {node_bounds.max.x, node_bounds.max.y, node_bounds.max.z};
+		float scale[3];
+		uint planes[6] = {0, 0, 0, 0, 0, 0};
+
+		for(int axis = 0; axis < 3; axis++) {
+			scale[axis] = 0.0f;
+
+			if(extent[axis] > origin[axis] && isfinite(extent[axis] - origin[axis])) {
+				scale[axis] = (extent[axis] - origin[axis])/255.0f;
+
+				/* the top of the grid must reach the node bounds */
+				while(origin[axis] + 255.0f*scale[axis] < extent[axis])
+					scale[axis] = nextafterf(scale[axis], FLT_MAX);
+			}
+		}
+
+		for(int i = 0; i < 4; i++) {
+			/* inverted bounds, so rays never enter unused child slots */
+			int qmin[3] = {255, 255, 255};
+			int qmax[3] = {0, 0, 0};
+
+			if(i < num) {
+				qbvh_quantize(origin[0], scale[0], bounds[i].min.x, bounds[i].max.x, &qmin[0], &qmax[0]);
+				qbvh_quantize(origin[1], scale[1], bounds[i].min.y, bounds[i].max.y, &qmin[1], &qmax[1]);
+				qbvh_quantize(origin[2], scale[2], bounds[i].min.z, bounds[i].max.z, &qmin[2], &qmax[2]);
+			}
 
-		data[6][i] = __int_as_float(en[i].encodeIdx());
-		data[7][i] = 0.0f;
+			for(int axis = 0; axis < 3; axis++) {
+				planes[axis*2+0] |= (uint)qmin[axis] << (i*8);
+				planes[axis*2+1] |= (uint)qmax[axis] << (i*8);
+			}
+		}
+
+		data[0] = make_float4(origin[0], origin[1], origin[2], scale[0]);
+		data[1] = make_float4(scale[1], scale[2], __uint_as_float(planes[0]), __uint_as_float(planes[1]));
+		data[2] = make_float4(__uint_as_float(planes[2]), __uint_as_float(planes[3]), __uint_as_float(planes[4]), __uint_as_float(planes[5]));
 	}
+	else {
+		for(int i = 0; i < num; i++) {
+			data[0][i] = bounds[i].min.x;
+			data[1][i] = bounds[i].max.x;
+			data[2][i] = bounds[i].min.y;
+			data[3][i] = bounds[i].max.y;
+			data[4][i] = bounds[i].min.z;
+			data[5][i] = bounds[i].max.z;
+		}
+
+		/* empty bounds, so rays never enter unused child slots */
+		for(int i = num; i < 4; i++) {
+			data[0][i] = FLT_MAX;
+			data[1][i] = -FLT_MAX;
+			data[2][i] = FLT_MAX;
+			data[3][i] = -FLT_MAX;
+			data[4][i] = FLT_MAX;
+			data[5][i] = -FLT_MAX;
+		}
+	}
+
+	/* child indices and visibility, zero marks an empty child slot */
+	for(int i = 0; i < 4; i++) {
+		data[nsize-2][i] = __int_as_float((i < num)? child[i]: 0);
+		data[nsize-1][i] = __uint_as_float((i < num)? visibility[i]: 0);
+	}
+
+	memcpy(&pack.nodes[idx * nsize], data, sizeof(float4)*nsize);
+}
+
+/* Number of QBVH nodes for a binary tree, inner nodes take the place of their
+ * grandchildren and leaves are kept */
+static size_t qbvh_node_count(const BVHNode *node)
+{
+	size_t count = 1;
 
-	for(int i = num; i < 4; i++) {
-		data[0][i] = 0.0f;
-		data[1][i] = 0.0f;
-		data[2][i] = 0.0f;
+	if(node->is_leaf())
+		return count;
 
-		data[3][i] = 0.0f;
-		data[4][i] = 0.0f;
-		data[5][i] = 0.0f;
+	for(int i = 0; i < 2; i++) {
+		const BVHNode *child = node->get_child(i);
 
-		data[6][i] = __int_as_float(0);
-		data[7][i] = 0.0f;
+		if(child->is_leaf())
+			count++;
+		else
+			count += qbvh_node_count(child->get_child(0)) + qbvh_node_count(child->get_child(1));
 	}
 
-	memcpy(&pack.nodes[e.idx * BVH_QNODE_SIZE], data, sizeof(float4)*BVH_QNODE_SIZE);
+	return count;
 }
 
 /* Quad SIMD Nodes */
 
 void QBVH::pack_nodes(const array<int>& prims, const BVHNode *root)
 {
-	size_t node_size = root->getSubtreeSize(BVH_STAT_NODE_COUNT);
+	size_t num_nodes = qbvh_node_count(root);
+	size_t nsize = node_size();
 
 	/* resize arrays */
 	pack.nodes.clear();
 	pack.is_leaf.clear();
-	pack.is_leaf.resize(node_size);
+	pack.is_leaf.resize(num_nodes);
 
 	/* for top level BVH, first merge existing BVH's so we know the offsets */
 	if(params.top_level)
-		pack_instances(node_size*BVH_QNODE_SIZE);
+		pack_instances(num_nodes*nsize);
 	else
-		pack.nodes.resize(node_size*BVH_QNODE_SIZE);
+		pack.nodes.resize(num_nodes*nsize);
 
 	int nextNodeIdx = 0;
 
@@ -832,7 +967,54 @@ void QBVH::pack_nodes(const array<int>& prims, const BVHNode *root)
 
 void QBVH::refit_nodes()
 {
-	assert(0); /* todo */
+	BoundBox bbox = BoundBox::empty;
+	uint visibility = 0;
+	refit_node(0, (pack.is_leaf[0])? true: false, bbox, visibility);
+}
+
+void QBVH::refit_node(int idx, bool leaf, BoundBox& bbox, uint& visibility)
+{
+	size_t nsize = node_size();
+	float4 *data = (float4*)&pack.nodes[idx*nsize];
+
+	if(leaf) {
+		/* refit leaf node */
+		int c0 = __float_as_int(data[nsize-2].x);
+		int c1 = __float_as_int(data[nsize-2].y);
+
+		/* negative index is an object instance */
+		if(c0 < 0)
+			refit_primitives(~c0, ~c0+1, bbox, visibility);
+		else
+			refit_primitives(c0, c1, bbox, visibility);
+	}
+	else {
+		/* refit inner node, set bbox from children */
+		BoundBox cbox[4];
+		int child[4];
+		uint cvisibility[4];
+		int num = 0;
+
+		for(int i = 0; i < 4; i++) {
+			int c = __float_as_int(data[nsize-2][i]);
+
+			/* empty child slot */
+			if(c == 0)
+				continue;
+
+			cbox[num] = BoundBox::empty;
+			cvisibility[num] = 0;
+			child[num] = c;
+
+			refit_node((c < 0)? -c-1: c, (c < 0), cbox[num], cvisibility[num]);
+
+			bbox.grow(cbox[num]);
+			visibility |= cvisibility[num];
+			num++;
+		}
+
+		pack_node(idx, cbox, child, cvisibility, num);
+	}
 }
 
 CCL_NAMESPACE_END
@@ -37,6 +37,7 @@ class Progress;
 
 #define BVH_NODE_SIZE	4
 #define BVH_QNODE_SIZE	8
+#define BVH_QNODE_COMPACT_SIZE	5
 #define BVH_ALIGN		4096
 #define TRI_NODE_SIZE	3
 
@@ -46,15 +47,19 @@ class Progress;
 
 struct PackedBVH {
 	/* BVH nodes storage, one node is 4x int4, and contains two bounding boxes,
-	 * and child, triangle or object indexes dependening on the node type */
+	 * and child, triangle or object indexes dependening on the node type. QBVH
+	 * nodes are 8x int4 with four bounding boxes, or 5x int4 in compact mode
+	 * with the bounding boxes quantized to 8 bits relative to the node bounds */
 	array<int4> nodes; 
 	/* object index to BVH node index mapping for instances */
 	array<int> object_node; 
-	/* precomputed triangle intersection data, one triangle is 4x float4 */
+	/* precomputed triangle intersection data, one triangle is 3x float4, empty
+	 * in compact mode where triangles are intersected from the mesh vertices */
 	array<float4> tri_woop;
 	/* primitive type - triangle or strand (should be moved to flag?) */
 	array<int> prim_segment;
-	/* visibility visibilitys for primitives */
+	/* visibility flags for primitives, empty in compact mode where the
+	 * visibility of the object is used */
 	array<uint> prim_visibility;
 	/* mapping from BVH primitive index to true primitive index, as primitives
 	 * may be duplicated due to spatial splits. -1 for instances. */
@@ -96,6 +101,9 @@ public:
 
 	void clear_cache_except();
 
+	/* number of int4 per packed node */
+	size_t node_size() const;
+
 protected:
 	BVH(const BVHParams& params, const vector<Object*>& objects);
 
@@ -111,6 +119,9 @@ protected:
 	/* merge instance BVH's */
 	void pack_instances(size_t nodes_size);
 
+	/* refit leaf bounds and visibility from primitives */
+	void refit_primitives(int start, int end, BoundBox& bbox, uint& visibility);
+
 	/* for subclasses to implement */
 	virtual void pack_nodes(const array<int>& prims, const BVHNode *root) = 0;
 	virtual void refit_nodes() = 0;
@@ -151,9 +162,11 @@ protected:
 	void pack_nodes(const array<int>& prims, const BVHNode *root);
 	void pack_leaf(const BVHStackEntry& e, const LeafNode *leaf);
 	void pack_inner(const BVHStackEntry& e, const BVHStackEntry *en, int num);
+	void pack_node(int idx, const BoundBox *bounds, const int *child, const uint *visibility, int num);
 
 	/* refit */
 	void refit_nodes();
+	void refit_node(int idx, bool leaf, BoundBox& bbox, uint& visibility);
 };
 
 CCL_NAMESPACE_END
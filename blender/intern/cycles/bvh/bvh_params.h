@@ -48,7 +48,9 @@ public:
 	/* QBVH */
 	int use_qbvh;
 
-	int pad;
+	/* compact storage: quantized QBVH child bounds, no precomputed triangle
+	 * data and no per primitive visibility */
+	int use_compact;
 
 	/* fixed parameters */
 	enum {
@@ -71,7 +73,7 @@ public:
 		top_level = false;
 		use_cache = false;
 		use_qbvh = false;
-		pad = false;
+		use_compact = false;
 	}
 
 	/* SAH costs */
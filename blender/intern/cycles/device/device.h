@@ -56,6 +56,7 @@ public:
 	bool display_device;
 	bool advanced_shading;
 	bool pack_images;
+	bool has_qbvh;
 	vector<DeviceInfo> multi_devices;
 
 	DeviceInfo()
@@ -66,6 +67,7 @@ public:
 		display_device = false;
 		advanced_shading = true;
 		pack_images = false;
+		has_qbvh = false;
 	}
 };
 
@@ -113,6 +115,9 @@ public:
 	/* open shading language, only for CPU device */
 	virtual void *osl_memory() { return NULL; }
 
+	/* image texture cache, only for CPU device */
+	virtual void *texture_cache_memory() { return NULL; }
+
 	/* load/compile kernels, must be called before adding tasks */ 
 	virtual bool load_kernels(bool experimental) { return true; }
 
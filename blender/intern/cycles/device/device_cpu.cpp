@@ -26,6 +26,7 @@
 #include "kernel_compat_cpu.h"
 #include "kernel_types.h"
 #include "kernel_globals.h"
+#include "kernel_texture_cache.h"
 
 #include "osl_shader.h"
 #include "osl_globals.h"
@@ -50,16 +51,20 @@ public:
 #ifdef WITH_OSL
 	OSLGlobals osl_globals;
 #endif
+	TextureCacheGlobals texture_cache_globals;
 	
 	CPUDevice(Stats &stats) : Device(stats)
 	{
 #ifdef WITH_OSL
 		kernel_globals.osl = &osl_globals;
 #endif
+		kernel_globals.texture_cache = &texture_cache_globals;
 
 		/* do now to avoid thread issues */
 		system_cpu_support_sse2();
 		system_cpu_support_sse3();
+		system_cpu_support_sse41();
+		system_cpu_support_avx();
 	}
 
 	~CPUDevice()
@@ -125,6 +130,11 @@ public:
 #endif
 	}
 
+	void *texture_cache_memory()
+	{
+		return &texture_cache_globals;
+	}
+
 	void thread_run(DeviceTask *task)
 	{
 		if(task->type == DeviceTask::PATH_TRACE)
@@ -152,6 +162,24 @@ public:
 		}
 
 		KernelGlobals kg = kernel_globals;
+		kg.num_rays = 0;
+
+		/* pick the kernel for the instruction set of this CPU once, instead
+		 * of checking for every pixel */
+		void(*path_trace_kernel)(KernelGlobals *, float *, unsigned int *, int, int, int, int, int);
+
+#ifdef WITH_OPTIMIZED_KERNEL
+		if(system_cpu_support_avx())
+			path_trace_kernel = kernel_cpu_avx_path_trace;
+		else if(system_cpu_support_sse41())
+			path_trace_kernel = kernel_cpu_sse41_path_trace;
+		else if(system_cpu_support_sse3())
+			path_trace_kernel = kernel_cpu_sse3_path_trace;
+		else if(system_cpu_support_sse2())
+			path_trace_kernel = kernel_cpu_sse2_path_trace;
+		else
+#endif
+			path_trace_kernel = kernel_cpu_path_trace;
 
 #ifdef WITH_OSL
 		OSLShader::thread_init(&kg, &kernel_globals, &osl_globals);
@@ -165,65 +193,22 @@ public:
 			int start_sample = tile.start_sample;
 			int end_sample = tile.start_sample + tile.num_samples;
 
-#ifdef WITH_OPTIMIZED_KERNEL
-			if(system_cpu_support_sse3()) {
-				for(int sample = start_sample; sample < end_sample; sample++) {
-					if (task.get_cancel() || task_pool.cancelled()) {
-						if(task.need_finish_queue == false)
-							break;
-					}
-
-					for(int y = tile.y; y < tile.y + tile.h; y++) {
-						for(int x = tile.x; x < tile.x + tile.w; x++) {
-							kernel_cpu_sse3_path_trace(&kg, render_buffer, rng_state,
-								sample, x, y, tile.offset, tile.stride);
-						}
-					}
-
-					tile.sample = sample + 1;
-
-					task.update_progress(tile);
+			for(int sample = start_sample; sample < end_sample; sample++) {
+				if (task.get_cancel() || task_pool.cancelled()) {
+					if(task.need_finish_queue == false)
+						break;
 				}
-			}
-			else if(system_cpu_support_sse2()) {
-				for(int sample = start_sample; sample < end_sample; sample++) {
-					if (task.get_cancel() || task_pool.cancelled()) {
-						if(task.need_finish_queue == false)
-							break;
-					}
 
-					for(int y = tile.y; y < tile.y + tile.h; y++) {
-						for(int x = tile.x; x < tile.x + tile.w; x++) {
-							kernel_cpu_sse2_path_trace(&kg, render_buffer, rng_state,
-								sample, x, y, tile.offset, tile.stride);
-						}
+				for(int y = tile.y; y < tile.y + tile.h; y++) {
+					for(int x = tile.x; x < tile.x + tile.w; x++) {
+						path_trace_kernel(&kg, render_buffer, rng_state,
+							sample, x, y, tile.offset, tile.stride);
 					}
-
-					tile.sample = sample + 1;
-
-					task.update_progress(tile);
 				}
-			}
-			else
-#endif
-			{
-				for(int sample = start_sample; sample < end_sample; sample++) {
-					if (task.get_cancel() || task_pool.cancelled()) {
-						if(task.need_finish_queue == false)
-							break;
-					}
 
-					for(int y = tile.y; y < tile.y + tile.h; y++) {
-						for(int x = tile.x; x < tile.x + tile.w; x++) {
-							kernel_cpu_path_trace(&kg, render_buffer, rng_state,
-								sample, x, y, tile.offset, tile.stride);
-						}
-					}
-
-					tile.sample = sample + 1;
+				tile.sample = sample + 1;
 
-					task.update_progress(tile);
-				}
+				task.update_progress(tile);
 			}
 
 			task.release_tile(tile);
@@ -234,6 +219,8 @@ public:
 			}
 		}
 
+		stats.add_rays(kg.num_rays);
+
 #ifdef WITH_OSL
 		OSLShader::thread_free(&kg);
 #endif
@@ -242,7 +229,19 @@ public:
 	void thread_tonemap(DeviceTask& task)
 	{
 #ifdef WITH_OPTIMIZED_KERNEL
-		if(system_cpu_support_sse3()) {
+		if(system_cpu_support_avx()) {
+			for(int y = task.y; y < task.y + task.h; y++)
+				for(int x = task.x; x < task.x + task.w; x++)
+					kernel_cpu_avx_tonemap(&kernel_globals, (uchar4*)task.rgba, (float*)task.buffer,
+						task.sample, x, y, task.offset, task.stride);
+		}
+		else if(system_cpu_support_sse41()) {
+			for(int y = task.y; y < task.y + task.h; y++)
+				for(int x = task.x; x < task.x + task.w; x++)
+					kernel_cpu_sse41_tonemap(&kernel_globals, (uchar4*)task.rgba, (float*)task.buffer,
+						task.sample, x, y, task.offset, task.stride);
+		}
+		else if(system_cpu_support_sse3()) {
 			for(int y = task.y; y < task.y + task.h; y++)
 				for(int x = task.x; x < task.x + task.w; x++)
 					kernel_cpu_sse3_tonemap(&kernel_globals, (uchar4*)task.rgba, (float*)task.buffer,
@@ -273,7 +272,23 @@ public:
 #endif
 
 #ifdef WITH_OPTIMIZED_KERNEL
-		if(system_cpu_support_sse3()) {
+		if(system_cpu_support_avx()) {
+			for(int x = task.shader_x; x < task.shader_x + task.shader_w; x++) {
+				kernel_cpu_avx_shader(&kg, (uint4*)task.shader_input, (float4*)task.shader_output, task.shader_eval_type, x);
+
+				if(task_pool.cancelled())
+					break;
+			}
+		}
+		else if(system_cpu_support_sse41()) {
+			for(int x = task.shader_x; x < task.shader_x + task.shader_w; x++) {
+				kernel_cpu_sse41_shader(&kg, (uint4*)task.shader_input, (float4*)task.shader_output, task.shader_eval_type, x);
+
+				if(task_pool.cancelled())
+					break;
+			}
+		}
+		else if(system_cpu_support_sse3()) {
 			for(int x = task.shader_x; x < task.shader_x + task.shader_w; x++) {
 				kernel_cpu_sse3_shader(&kg, (uint4*)task.shader_input, (float4*)task.shader_output, task.shader_eval_type, x);
 
@@ -343,6 +358,14 @@ void device_cpu_info(vector<DeviceInfo>& devices)
 	info.advanced_shading = true;
 	info.pack_images = false;
 
+	/* 4-wide BVH traversal needs SSE2 in every kernel that can trace rays,
+	 * with OSL that includes the regular kernel used by the OSL services */
+#if defined(__QBVH__)
+	info.has_qbvh = true;
+#elif defined(WITH_OPTIMIZED_KERNEL) && !defined(WITH_OSL)
+	info.has_qbvh = system_cpu_support_sse2();
+#endif
+
 	devices.insert(devices.begin(), info);
 }
 
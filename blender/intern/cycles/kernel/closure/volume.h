@@ -18,8 +18,9 @@
 
 CCL_NAMESPACE_BEGIN
 
-/* note: the interfaces here are just as an example, need to figure
- * out the right functions and parameters to use */
+/* note: closure weights are used as absorption and scattering coefficients,
+ * scaled by the density. the phase functions themselves are normalized over
+ * the sphere and return the pdf as eval. */
 
 /* ISOTROPIC VOLUME CLOSURE */
 
@@ -31,9 +32,27 @@ __device int volume_isotropic_setup(ShaderClosure *sc, float density)
 	return SD_VOLUME;
 }
 
-__device float3 volume_isotropic_eval_phase(const ShaderClosure *sc, const float3 omega_in, const float3 omega_out)
+__device float3 volume_isotropic_eval_phase(const ShaderClosure *sc, const float3 omega_in, const float3 omega_out, float *pdf)
 {
-	return make_float3(1.0f, 1.0f, 1.0f);
+	*pdf = 1.0f/M_4PI_F;
+
+	return make_float3(*pdf, *pdf, *pdf);
+}
+
+__device int volume_isotropic_sample(const ShaderClosure *sc, float randu, float randv,
+	float3 *eval, float3 *omega_in, differential3 *domega_in, float *pdf)
+{
+	*omega_in = sample_uniform_sphere(randu, randv);
+	*pdf = 1.0f/M_4PI_F;
+	*eval = make_float3(*pdf, *pdf, *pdf);
+
+#ifdef __RAY_DIFFERENTIALS__
+	/* todo: find a better approximation for the scattered ray differentials */
+	domega_in->dx = make_float3(0.0f, 0.0f, 0.0f);
+	domega_in->dy = make_float3(0.0f, 0.0f, 0.0f);
+#endif
+
+	return LABEL_TRANSMIT|LABEL_DIFFUSE|LABEL_VOLUME;
 }
 
 /* TRANSPARENT VOLUME CLOSURE */
@@ -46,30 +65,36 @@ __device int volume_transparent_setup(ShaderClosure *sc, float density)
 	return SD_VOLUME;
 }
 
-__device float3 volume_transparent_eval_phase(const ShaderClosure *sc, const float3 omega_in, const float3 omega_out)
+__device float3 volume_transparent_eval_phase(const ShaderClosure *sc, const float3 omega_in, const float3 omega_out, float *pdf)
 {
-	return make_float3(1.0f, 1.0f, 1.0f);
+	/* absorption only, no scattering */
+	*pdf = 0.0f;
+
+	return make_float3(0.0f, 0.0f, 0.0f);
 }
 
 /* VOLUME CLOSURE */
 
-__device float3 volume_eval_phase(KernelGlobals *kg, const ShaderClosure *sc, const float3 omega_in, const float3 omega_out)
+__device float3 volume_eval_phase(KernelGlobals *kg, const ShaderClosure *sc, const float3 omega_in, const float3 omega_out, float *pdf)
 {
 #ifdef __OSL__
-	if(kg->osl && sc->prim)
+	if(kg->osl && sc->prim) {
+		*pdf = 1.0f/M_4PI_F;
 		return OSLShader::volume_eval_phase(sc, omega_in, omega_out);
+	}
 #endif
 
 	float3 eval;
 
 	switch(sc->type) {
 		case CLOSURE_VOLUME_ISOTROPIC_ID:
-			eval = volume_isotropic_eval_phase(sc, omega_in, omega_out);
+			eval = volume_isotropic_eval_phase(sc, omega_in, omega_out, pdf);
 			break;
 		case CLOSURE_VOLUME_TRANSPARENT_ID:
-			eval = volume_transparent_eval_phase(sc, omega_in, omega_out);
+			eval = volume_transparent_eval_phase(sc, omega_in, omega_out, pdf);
 			break;
 		default:
+			*pdf = 0.0f;
 			eval = make_float3(0.0f, 0.0f, 0.0f);
 			break;
 	}
@@ -77,5 +102,24 @@ __device float3 volume_eval_phase(KernelGlobals *kg, const ShaderClosure *sc, co
 	return eval;
 }
 
+__device int volume_sample_phase(KernelGlobals *kg, const ShaderClosure *sc, float randu, float randv,
+	float3 *eval, float3 *omega_in, differential3 *domega_in, float *pdf)
+{
+	int label;
+
+	switch(sc->type) {
+		case CLOSURE_VOLUME_ISOTROPIC_ID:
+			label = volume_isotropic_sample(sc, randu, randv, eval, omega_in, domega_in, pdf);
+			break;
+		default:
+			*pdf = 0.0f;
+			*eval = make_float3(0.0f, 0.0f, 0.0f);
+			label = LABEL_NONE;
+			break;
+	}
+
+	return label;
+}
+
 CCL_NAMESPACE_END
 
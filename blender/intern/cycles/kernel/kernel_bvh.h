@@ -30,7 +30,11 @@ CCL_NAMESPACE_BEGIN
 #define ENTRYPOINT_SENTINEL 0x76543210
 /* 64 object BVH + 64 mesh BVH + 64 object node splitting */
 #define BVH_STACK_SIZE 192
+/* QBVH pushes up to 3 children per node, for 32 levels of object and mesh BVH */
+#define BVH_QSTACK_SIZE 384
 #define BVH_NODE_SIZE 4
+#define BVH_QNODE_SIZE 8
+#define BVH_QNODE_COMPACT_SIZE 5
 #define TRI_NODE_SIZE 3
 
 /* silly workaround for float extended precision that happens when compiling
@@ -112,10 +116,84 @@ __device_inline void bvh_instance_motion_pop(KernelGlobals *kg, int object, cons
 }
 #endif
 
+/* Primitive visibility flags. In compact mode these are not stored per
+ * primitive, the object visibility is used instead. */
+__device_inline uint bvh_prim_visibility(KernelGlobals *kg, int object, int primAddr)
+{
+	if(kernel_data.bvh.use_compact) {
+		int prim_object = (object == ~0)? kernel_tex_fetch(__prim_object, primAddr): object;
+		return object_visibility(kg, prim_object);
+	}
+
+	return kernel_tex_fetch(__prim_visibility, primAddr);
+}
+
+/* Moller-Trumbore intersection from the mesh vertices, for compact mode where
+ * no precomputed triangle data is stored. Barycentrics match the Woop
+ * triangle, u for the first vertex and v for the second. */
+__device_inline bool bvh_triangle_intersect_verts(KernelGlobals *kg, float3 P, float3 idir,
+	int triAddr, float tmax, float *t, float *u, float *v)
+{
+	float3 verts[3];
+	triangle_vertices(kg, kernel_tex_fetch(__prim_index, triAddr), verts);
+
+	float3 dir = 1.0f/idir;
+	float3 e0 = verts[0] - verts[2];
+	float3 e1 = verts[1] - verts[2];
+	float3 pvec = cross(dir, e1);
+	float det = dot(e0, pvec);
+
+	if(det == 0.0f)
+		return false;
+
+	float inv_det = 1.0f/det;
+	float3 tvec = P - verts[2];
+	float tu = dot(tvec, pvec)*inv_det;
+
+	if(tu < 0.0f || tu > 1.0f)
+		return false;
+
+	float3 qvec = cross(tvec, e0);
+	float tv = dot(dir, qvec)*inv_det;
+
+	if(tv < 0.0f || tu + tv > 1.0f)
+		return false;
+
+	float tt = dot(e1, qvec)*inv_det;
+
+	if(!(tt > 0.0f && tt < tmax))
+		return false;
+
+	*t = tt;
+	*u = tu;
+	*v = tv;
+
+	return true;
+}
+
 /* Sven Woop's algorithm */
 __device_inline bool bvh_triangle_intersect(KernelGlobals *kg, Intersection *isect,
 	float3 P, float3 idir, uint visibility, int object, int triAddr)
 {
+	if(kernel_data.bvh.use_compact) {
+		float t, u, v;
+
+		if(!bvh_triangle_intersect_verts(kg, P, idir, triAddr, isect->t, &t, &u, &v))
+			return false;
+
+#ifdef __VISIBILITY_FLAG__
+		if(!(bvh_prim_visibility(kg, object, triAddr) & visibility))
+			return false;
+#endif
+
+		isect->prim = triAddr;
+		isect->object = object;
+		isect->u = u;
+		isect->v = v;
+		isect->t = t;
+		return true;
+	}
+
 	/* compute and check intersection t-value */
 	float4 v00 = kernel_tex_fetch(__tri_woop, triAddr*TRI_NODE_SIZE+0);
 	float4 v11 = kernel_tex_fetch(__tri_woop, triAddr*TRI_NODE_SIZE+1);
@@ -142,7 +220,7 @@ __device_inline bool bvh_triangle_intersect(KernelGlobals *kg, Intersection *ise
 #ifdef __VISIBILITY_FLAG__
 				/* visibility flag test. we do it here under the assumption
 				 * that most triangles are culled by node flags */
-				if(kernel_tex_fetch(__prim_visibility, triAddr) & visibility)
+				if(bvh_prim_visibility(kg, object, triAddr) & visibility)
 #endif
 				{
 					/* record intersection */
@@ -495,7 +573,7 @@ __device_inline bool bvh_cardinal_curve_intersect(KernelGlobals *kg, Intersectio
 #ifdef __VISIBILITY_FLAG__
 			/* visibility flag test. we do it here under the assumption
 			 * that most triangles are culled by node flags */
-			if(kernel_tex_fetch(__prim_visibility, curveAddr) & visibility)
+			if(bvh_prim_visibility(kg, object, curveAddr) & visibility)
 #endif
 			{
 				/* record intersection */
@@ -661,7 +739,7 @@ __device_inline bool bvh_curve_intersect(KernelGlobals *kg, Intersection *isect,
 #ifdef __VISIBILITY_FLAG__
 			/* visibility flag test. we do it here under the assumption
 			 * that most triangles are culled by node flags */
-			if(kernel_tex_fetch(__prim_visibility, curveAddr) & visibility)
+			if(bvh_prim_visibility(kg, object, curveAddr) & visibility)
 #endif
 			{
 				/* record intersection */
@@ -693,6 +771,27 @@ __device_inline bool bvh_curve_intersect(KernelGlobals *kg, Intersection *isect,
 __device_inline bool bvh_triangle_intersect_subsurface(KernelGlobals *kg, Intersection *isect,
 	float3 P, float3 idir, int object, int triAddr, float tmax, int *num_hits, float subsurface_random)
 {
+	if(kernel_data.bvh.use_compact) {
+		float t, u, v;
+
+		if(!bvh_triangle_intersect_verts(kg, P, idir, triAddr, tmax, &t, &u, &v))
+			return false;
+
+		(*num_hits)++;
+
+		if(subsurface_random * (*num_hits) <= 1.0f) {
+			/* record intersection */
+			isect->prim = triAddr;
+			isect->object = object;
+			isect->u = u;
+			isect->v = v;
+			isect->t = t;
+			return true;
+		}
+
+		return false;
+	}
+
 	/* compute and check intersection t-value */
 	float4 v00 = kernel_tex_fetch(__tri_woop, triAddr*TRI_NODE_SIZE+0);
 	float4 v11 = kernel_tex_fetch(__tri_woop, triAddr*TRI_NODE_SIZE+1);
@@ -735,6 +834,131 @@ __device_inline bool bvh_triangle_intersect_subsurface(KernelGlobals *kg, Inters
 }
 #endif
 
+#ifdef __QBVH__
+
+/* QBVH ray setup, splatted for intersecting four child bounding boxes at once */
+
+typedef struct QBVHRay {
+	__m128 P[3];
+	__m128 idir[3];
+	/* node data offsets of the near and far planes, depending on ray direction */
+	int near_x, near_y, near_z;
+	int far_x, far_y, far_z;
+} QBVHRay;
+
+__device_inline void qbvh_ray_init(QBVHRay *qray, float3 P, float3 idir)
+{
+	qray->P[0] = _mm_set_ps1(P.x);
+	qray->P[1] = _mm_set_ps1(P.y);
+	qray->P[2] = _mm_set_ps1(P.z);
+
+	qray->idir[0] = _mm_set_ps1(idir.x);
+	qray->idir[1] = _mm_set_ps1(idir.y);
+	qray->idir[2] = _mm_set_ps1(idir.z);
+
+	qray->near_x = (idir.x >= 0.0f)? 0: 1;
+	qray->near_y = (idir.y >= 0.0f)? 2: 3;
+	qray->near_z = (idir.z >= 0.0f)? 4: 5;
+	qray->far_x = qray->near_x ^ 1;
+	qray->far_y = qray->near_y ^ 1;
+	qray->far_z = qray->near_z ^ 1;
+}
+
+/* Intersect ray against the four child bounding boxes of a QBVH node, returns
+ * a bit mask of the children to traverse and their entry distances. For
+ * minimum width hair, boxes containing curves are enlarged like in the
+ * regular BVH traversal. */
+__device_inline int qbvh_node_size(KernelGlobals *kg)
+{
+	return (kernel_data.bvh.use_compact)? BVH_QNODE_COMPACT_SIZE: BVH_QNODE_SIZE;
+}
+
+/* Decode one plane of a compact node, four 8 bit child coordinates relative
+ * to the quantization grid of the node */
+__device_inline __m128 qbvh_dequantize(int plane, float origin, float scale)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i q = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(plane), zero), zero);
+
+	return _mm_add_ps(_mm_set_ps1(origin), _mm_mul_ps(_mm_cvtepi32_ps(q), _mm_set_ps1(scale)));
+}
+
+__device_inline int qbvh_node_intersect(KernelGlobals *kg, const QBVHRay *qray, int nodeAddr,
+	float tmax, uint visibility, float difl, float extmax, __m128 *dist)
+{
+	const int node_size = qbvh_node_size(kg);
+	const __m128 *bvh_nodes = (const __m128*)kg->__bvh_nodes.data + nodeAddr*node_size;
+	__m128 planes[6];
+
+	if(kernel_data.bvh.use_compact) {
+		/* origin and scale per axis, followed by the quantized planes */
+		const float *grid = (const float*)bvh_nodes;
+		const int *qplanes = (const int*)bvh_nodes + 6;
+
+		for(int i = 0; i < 6; i++)
+			planes[i] = qbvh_dequantize(qplanes[i], grid[i >> 1], grid[3 + (i >> 1)]);
+	}
+	else {
+		for(int i = 0; i < 6; i++)
+			planes[i] = bvh_nodes[i];
+	}
+
+	const __m128 tnear_x = _mm_mul_ps(_mm_sub_ps(planes[qray->near_x], qray->P[0]), qray->idir[0]);
+	const __m128 tnear_y = _mm_mul_ps(_mm_sub_ps(planes[qray->near_y], qray->P[1]), qray->idir[1]);
+	const __m128 tnear_z = _mm_mul_ps(_mm_sub_ps(planes[qray->near_z], qray->P[2]), qray->idir[2]);
+	const __m128 tfar_x = _mm_mul_ps(_mm_sub_ps(planes[qray->far_x], qray->P[0]), qray->idir[0]);
+	const __m128 tfar_y = _mm_mul_ps(_mm_sub_ps(planes[qray->far_y], qray->P[1]), qray->idir[1]);
+	const __m128 tfar_z = _mm_mul_ps(_mm_sub_ps(planes[qray->far_z], qray->P[2]), qray->idir[2]);
+
+#ifdef __KERNEL_SSE41__
+	/* integer min/max on the float bits, ordering is only wrong for two
+	 * negative values, which can't end up as the result when clamping tnear
+	 * to zero, and give tfar < tnear either way */
+	__m128 tnear = _mm_castsi128_ps(_mm_max_epi32(
+		_mm_max_epi32(_mm_castps_si128(tnear_x), _mm_castps_si128(tnear_y)),
+		_mm_max_epi32(_mm_castps_si128(tnear_z), _mm_setzero_si128())));
+	__m128 tfar = _mm_castsi128_ps(_mm_min_epi32(
+		_mm_min_epi32(_mm_castps_si128(tfar_x), _mm_castps_si128(tfar_y)),
+		_mm_min_epi32(_mm_castps_si128(tfar_z), _mm_castps_si128(_mm_set_ps1(tmax)))));
+#else
+	__m128 tnear = _mm_max_ps(_mm_max_ps(tnear_x, tnear_y), _mm_max_ps(tnear_z, _mm_setzero_ps()));
+	__m128 tfar = _mm_min_ps(_mm_min_ps(tfar_x, tfar_y), _mm_min_ps(tfar_z, _mm_set_ps1(tmax)));
+#endif
+
+	const __m128i vis = _mm_castps_si128(bvh_nodes[node_size-1]);
+
+#ifdef __HAIR__
+	if(difl != 0.0f) {
+		const __m128i curve_flag = _mm_set1_epi32(PATH_RAY_CURVE);
+		const __m128 curve = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(vis, curve_flag), curve_flag));
+
+		const __m128 dnear = _mm_max_ps(_mm_mul_ps(_mm_set_ps1(1.0f - difl), tnear), _mm_sub_ps(tnear, _mm_set_ps1(extmax)));
+		const __m128 dfar = _mm_min_ps(_mm_mul_ps(_mm_set_ps1(1.0f + difl), tfar), _mm_add_ps(tfar, _mm_set_ps1(extmax)));
+
+#ifdef __KERNEL_SSE41__
+		tnear = _mm_blendv_ps(tnear, dnear, curve);
+		tfar = _mm_blendv_ps(tfar, dfar, curve);
+#else
+		tnear = _mm_or_ps(_mm_and_ps(curve, dnear), _mm_andnot_ps(curve, tnear));
+		tfar = _mm_or_ps(_mm_and_ps(curve, dfar), _mm_andnot_ps(curve, tfar));
+#endif
+	}
+#endif
+
+	int mask = _mm_movemask_ps(_mm_cmple_ps(tnear, tfar));
+
+#ifdef __VISIBILITY_FLAG__
+	const __m128i invisible = _mm_cmpeq_epi32(_mm_and_si128(vis, _mm_set1_epi32((int)visibility)), _mm_setzero_si128());
+	mask &= ~_mm_movemask_ps(_mm_castsi128_ps(invisible));
+#endif
+
+	*dist = tnear;
+
+	return mask;
+}
+
+#endif /* __QBVH__ */
+
 /* BVH intersection function variations */
 
 #define BVH_INSTANCING			1
@@ -743,6 +967,12 @@ __device_inline bool bvh_triangle_intersect_subsurface(KernelGlobals *kg, Inters
 #define BVH_HAIR_MINIMUM_WIDTH	8
 #define BVH_SUBSURFACE			16
 
+/* each variation gets a binary and, on the CPU, a QBVH traversal function,
+ * BVH_FUNCTION_NAME dispatches to the one matching the packed nodes */
+#define BVH_NAME_JOIN(a, b) BVH_NAME_JOIN_(a, b)
+#define BVH_NAME_JOIN_(a, b) a##_##b
+#define BVH_FUNCTION_FULL_NAME(suffix) BVH_NAME_JOIN(BVH_FUNCTION_NAME, suffix)
+
 #define BVH_FUNCTION_NAME bvh_intersect
 #define BVH_FUNCTION_FEATURES 0
 #include "kernel_bvh_traversal.h"
@@ -808,6 +1038,10 @@ __device_inline bool scene_intersect(KernelGlobals *kg, const Ray *ray, const ui
 __device_inline bool scene_intersect(KernelGlobals *kg, const Ray *ray, const uint visibility, Intersection *isect)
 #endif
 {
+#ifdef __KERNEL_CPU__
+	kg->num_rays++;
+#endif
+
 #ifdef __OBJECT_MOTION__
 	if(kernel_data.bvh.have_motion) {
 #ifdef __HAIR__
@@ -846,6 +1080,10 @@ __device_inline bool scene_intersect(KernelGlobals *kg, const Ray *ray, const ui
 #ifdef __SUBSURFACE__
 __device_inline int scene_intersect_subsurface(KernelGlobals *kg, const Ray *ray, Intersection *isect, int subsurface_object, float subsurface_random)
 {
+#ifdef __KERNEL_CPU__
+	kg->num_rays++;
+#endif
+
 #ifdef __OBJECT_MOTION__
 	if(kernel_data.bvh.have_motion) {
 #ifdef __HAIR__
@@ -957,10 +1195,22 @@ __device_inline float3 bvh_triangle_refine(KernelGlobals *kg, ShaderData *sd, co
 
 	P = P + D*t;
 
-	float4 v00 = kernel_tex_fetch(__tri_woop, isect->prim*TRI_NODE_SIZE+0);
-	float Oz = v00.w - P.x*v00.x - P.y*v00.y - P.z*v00.z;
-	float invDz = 1.0f/(D.x*v00.x + D.y*v00.y + D.z*v00.z);
-	float rt = Oz * invDz;
+	float rt;
+
+	if(kernel_data.bvh.use_compact) {
+		/* distance to the triangle plane */
+		float3 verts[3];
+		triangle_vertices(kg, kernel_tex_fetch(__prim_index, isect->prim), verts);
+
+		float3 N = cross(verts[0] - verts[2], verts[1] - verts[2]);
+		rt = dot(verts[2] - P, N)/dot(D, N);
+	}
+	else {
+		float4 v00 = kernel_tex_fetch(__tri_woop, isect->prim*TRI_NODE_SIZE+0);
+		float Oz = v00.w - P.x*v00.x - P.y*v00.y - P.z*v00.z;
+		float invDz = 1.0f/(D.x*v00.x + D.y*v00.y + D.z*v00.z);
+		rt = Oz * invDz;
+	}
 
 	P = P + D*rt;
 
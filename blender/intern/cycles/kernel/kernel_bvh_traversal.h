@@ -31,7 +31,11 @@
 
 #define FEATURE(f) (((BVH_FUNCTION_FEATURES) & (f)) != 0)
 
-__device bool BVH_FUNCTION_NAME
+#ifdef __QBVH__
+#include "kernel_qbvh_traversal.h"
+#endif
+
+__device bool BVH_FUNCTION_FULL_NAME(binary)
 (KernelGlobals *kg, const Ray *ray, Intersection *isect
 #if FEATURE(BVH_SUBSURFACE)
 , int subsurface_object, float subsurface_random
@@ -393,6 +397,36 @@ __device bool BVH_FUNCTION_NAME
 #endif
 }
 
+__device_inline bool BVH_FUNCTION_NAME
+(KernelGlobals *kg, const Ray *ray, Intersection *isect
+#if FEATURE(BVH_SUBSURFACE)
+, int subsurface_object, float subsurface_random
+#else
+, const uint visibility
+#endif
+#if FEATURE(BVH_HAIR_MINIMUM_WIDTH) && !FEATURE(BVH_SUBSURFACE)
+, uint *lcg_state, float difl, float extmax
+#endif
+)
+{
+#if FEATURE(BVH_SUBSURFACE)
+#define BVH_FUNCTION_ARGS kg, ray, isect, subsurface_object, subsurface_random
+#elif FEATURE(BVH_HAIR_MINIMUM_WIDTH)
+#define BVH_FUNCTION_ARGS kg, ray, isect, visibility, lcg_state, difl, extmax
+#else
+#define BVH_FUNCTION_ARGS kg, ray, isect, visibility
+#endif
+
+#ifdef __QBVH__
+	if(kernel_data.bvh.use_qbvh)
+		return BVH_FUNCTION_FULL_NAME(qbvh)(BVH_FUNCTION_ARGS);
+#endif
+
+	return BVH_FUNCTION_FULL_NAME(binary)(BVH_FUNCTION_ARGS);
+
+#undef BVH_FUNCTION_ARGS
+}
+
 #undef FEATURE
 #undef BVH_FUNCTION_NAME
 #undef BVH_FUNCTION_FEATURES
@@ -34,10 +34,14 @@ CCL_NAMESPACE_BEGIN
 
 /* Texture types to be compatible with CUDA textures. These are really just
  * simple arrays and after inlining fetch hopefully revert to being a simple
- * pointer lookup. */
+ * pointer lookup.
+ *
+ * Member functions are force inlined, they are compiled into every kernel with
+ * its own instruction set. Out of line copies would be merged by the linker,
+ * and an AVX copy could end up being called from the SSE2 kernel. */
 
 template<typename T> struct texture  {
-	T fetch(int index)
+	__forceinline T fetch(int index)
 	{
 		kernel_assert(index >= 0 && index < width);
 		return data[index];
@@ -62,18 +66,18 @@ template<typename T> struct texture  {
 };
 
 template<typename T> struct texture_image  {
-	float4 read(float4 r)
+	__forceinline float4 read(float4 r)
 	{
 		return r;
 	}
 
-	float4 read(uchar4 r)
+	__forceinline float4 read(uchar4 r)
 	{
 		float f = 1.0f/255.0f;
 		return make_float4(r.x*f, r.y*f, r.z*f, r.w*f);
 	}
 
-	int wrap_periodic(int x, int width)
+	__forceinline int wrap_periodic(int x, int width)
 	{
 		x %= width;
 		if(x < 0)
@@ -81,19 +85,19 @@ template<typename T> struct texture_image  {
 		return x;
 	}
 
-	int wrap_clamp(int x, int width)
+	__forceinline int wrap_clamp(int x, int width)
 	{
 		return clamp(x, 0, width-1);
 	}
 
-	float frac(float x, int *ix)
+	__forceinline float frac(float x, int *ix)
 	{
 		int i = float_to_int(x) - ((x < 0.0f)? 1: 0);
 		*ix = i;
 		return x - (float)i;
 	}
 
-	float4 interp(float x, float y, bool periodic = true)
+	__forceinline float4 interp(float x, float y, bool periodic = true)
 	{
 		if(!data)
 			return make_float4(0.0f, 0.0f, 0.0f, 0.0f);
@@ -102,10 +102,15 @@ __device_noinline bool direct_emission(KernelGlobals *kg, ShaderData *sd, int li
 	if(is_zero(light_eval))
 		return false;
 
-	/* evaluate BSDF at shading point */
+	/* evaluate BSDF at shading point, or phase function inside a volume */
 	float bsdf_pdf;
 
-	shader_bsdf_eval(kg, sd, ls.D, eval, &bsdf_pdf);
+#ifdef __VOLUME__
+	if(sd->prim == ~0)
+		shader_volume_phase_eval(kg, sd, ls.D, eval, &bsdf_pdf);
+	else
+#endif
+		shader_bsdf_eval(kg, sd, ls.D, eval, &bsdf_pdf);
 
 	if(ls.shader & SHADER_USE_MIS) {
 		/* multiple importance sampling */
@@ -174,7 +179,9 @@ __device_noinline float3 indirect_primitive_emission(KernelGlobals *kg, ShaderDa
 #endif
 		/* multiple importance sampling, get triangle light pdf,
 		 * and compute weight with respect to BSDF pdf */
-		float pdf = triangle_light_pdf(kg, sd->Ng, sd->I, t);
+		float3 P = sd->P + t*sd->I;
+		float area_pdf = triangle_light_area_pdf(kg, P, sd->object, sd->prim);
+		float pdf = triangle_light_pdf(kg, area_pdf, sd->Ng, sd->I, t);
 		float mis_weight = power_heuristic(bsdf_pdf, pdf);
 
 		return L*mis_weight;
@@ -58,6 +58,10 @@ __device void kernel_film_tonemap(KernelGlobals *kg,
 	rgba += index;
 	buffer += index*kernel_data.film.pass_stride;
 
+	/* with adaptive sampling, pixels can have fewer samples than the tile */
+	if(kernel_data.film.pass_flag & PASS_SAMPLE_COUNT)
+		sample = max((int)buffer[kernel_data.film.pass_sample_count], 1) - 1;
+
 	/* map colors */
 	float4 irradiance = *((__global float4*)buffer);
 	float4 float_result = film_map(kg, irradiance, sample);
@@ -33,6 +33,8 @@ struct OSLThreadData;
 struct OSLShadingSystem;
 #endif
 
+struct TextureCacheGlobals;
+
 #define MAX_BYTE_IMAGES   512
 #define MAX_FLOAT_IMAGES  5
 
@@ -46,6 +48,12 @@ typedef struct KernelGlobals {
 
 	KernelData __data;
 
+	/* rays traced by this thread, for render statistics */
+	uint64_t num_rays;
+
+	/* image textures loaded on demand, see kernel_texture_cache.h */
+	TextureCacheGlobals *texture_cache;
+
 #ifdef __OSL__
 	/* On the CPU, we also have the OSL globals here. Most data structures are shared
 	 * with SVM, the difference is in the shaders and object/mesh attributes. */
@@ -56,6 +64,12 @@ typedef struct KernelGlobals {
 
 } KernelGlobals;
 
+/* lookups are implemented in kernel_texture_cache.cpp, to keep OpenImageIO
+ * out of the kernel */
+bool kernel_texture_cache_use(KernelGlobals *kg, int id);
+bool kernel_texture_cache_lookup(KernelGlobals *kg, int id, float x, float y,
+	float dsdx, float dtdx, float dsdy, float dtdy, float4 *result);
+
 #endif
 
 /* For CUDA, constant memory textures must be globals, so we can't put them
@@ -422,6 +422,183 @@ __device bool lamp_light_eval(KernelGlobals *kg, int lamp, float3 P, float3 D, f
 	return true;
 }
 
+/* Light Tree
+ *
+ * Emissive triangles are picked by descending a BVH, choosing children
+ * proportional to an estimate of their contribution at the shading point,
+ * from area, distance and the bounds of the emitter normals. In the leaf an
+ * emitter is picked by area, with the part of the CDF covered by the leaf. */
+
+#ifdef __LIGHT_TREE__
+
+__device float light_tree_node_importance(KernelGlobals *kg, int node, float3 P)
+{
+	float4 n0 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 0);
+	float4 n1 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 1);
+	float4 n3 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 3);
+
+	float3 bmin = float4_to_float3(n0);
+	float3 bmax = float4_to_float3(n1);
+	float3 D = 0.5f*(bmin + bmax) - P;
+	float dist2 = len_squared(D);
+	float radius2 = 0.25f*len_squared(bmax - bmin);
+
+	/* area over squared distance, clamped to the node size when inside */
+	float importance = n0.w/max(dist2, radius2);
+
+	/* cone of emitter normals, minus the angle subtended by the bounds */
+	float cos_theta_o = n3.w;
+
+	if(cos_theta_o > 0.0f && dist2 > radius2) {
+		float dist = sqrtf(dist2);
+		float theta = acosf(clamp(fabsf(dot(D, float4_to_float3(n3)))/dist, 0.0f, 1.0f));
+		float theta_o = acosf(cos_theta_o);
+		float theta_u = asinf(sqrtf(radius2/dist2));
+		float theta_p = max(theta - theta_o - theta_u, 0.0f);
+
+		if(theta_p >= M_PI_2_F)
+			return 0.0f;
+
+		importance *= cosf(theta_p);
+	}
+
+	return importance;
+}
+
+__device float light_tree_left_probability(KernelGlobals *kg, int left, int right, float3 P)
+{
+	float left_importance = light_tree_node_importance(kg, left, P);
+	float right_importance = light_tree_node_importance(kg, right, P);
+
+	if(left_importance + right_importance > 0.0f)
+		return left_importance/(left_importance + right_importance);
+
+	/* fall back to area when both are estimated to have no contribution */
+	float left_area = kernel_tex_fetch(__light_tree_nodes, left*LIGHT_TREE_NODE_SIZE).w;
+	float right_area = kernel_tex_fetch(__light_tree_nodes, right*LIGHT_TREE_NODE_SIZE).w;
+
+	if(left_area + right_area > 0.0f)
+		return left_area/(left_area + right_area);
+
+	return 0.5f;
+}
+
+__device int light_tree_sample(KernelGlobals *kg, float3 P, float randt, float *pdf)
+{
+	int node = 0;
+	float prob = 1.0f;
+
+	/* descend, reusing the random number for each decision */
+	while(true) {
+		int right = __float_as_int(kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 1).w);
+
+		if(right == 0)
+			break;
+
+		int left = node + 1;
+		float p_left = light_tree_left_probability(kg, left, right, P);
+
+		if(randt < p_left) {
+			node = left;
+			prob *= p_left;
+			randt = randt/p_left;
+		}
+		else {
+			node = right;
+			prob *= 1.0f - p_left;
+			randt = (randt - p_left)/(1.0f - p_left);
+		}
+
+		randt = min(randt, 1.0f - 1e-6f);
+	}
+
+	/* pick emitter in leaf proportional to area */
+	float4 n0 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 0);
+	float4 n2 = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 2);
+	int first = __float_as_int(n2.x);
+	int count = __float_as_int(n2.y);
+
+	float cdf_first = kernel_tex_fetch(__light_distribution, first).x;
+	float cdf_last = kernel_tex_fetch(__light_distribution, first + count).x;
+	float t = cdf_first + randt*(cdf_last - cdf_first);
+
+	int lower = first;
+	int len = count;
+
+	while(len > 0) {
+		int half_len = len >> 1;
+		int middle = lower + half_len;
+
+		if(t < kernel_tex_fetch(__light_distribution, middle).x) {
+			len = half_len;
+		}
+		else {
+			lower = middle + 1;
+			len = len - half_len - 1;
+		}
+	}
+
+	*pdf = (n0.w > 0.0f)? kernel_data.integrator.pdf_light_tree*prob/n0.w: 0.0f;
+
+	return clamp(lower-1, first, first+count-1);
+}
+
+__device float light_tree_pdf(KernelGlobals *kg, float3 P, int index)
+{
+	int node = 0;
+	float prob = 1.0f;
+
+	/* follow the path to the leaf containing the emitter */
+	while(true) {
+		int right = __float_as_int(kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE + 1).w);
+
+		if(right == 0)
+			break;
+
+		int left = node + 1;
+		float p_left = light_tree_left_probability(kg, left, right, P);
+		int right_first = __float_as_int(kernel_tex_fetch(__light_tree_nodes, right*LIGHT_TREE_NODE_SIZE + 2).x);
+
+		if(index < right_first) {
+			node = left;
+			prob *= p_left;
+		}
+		else {
+			node = right;
+			prob *= 1.0f - p_left;
+		}
+	}
+
+	float area = kernel_tex_fetch(__light_tree_nodes, node*LIGHT_TREE_NODE_SIZE).w;
+
+	return (area > 0.0f)? kernel_data.integrator.pdf_light_tree*prob/area: 0.0f;
+}
+
+__device int light_tree_lookup(KernelGlobals *kg, int object, int prim)
+{
+	/* binary search in emitters sorted by object and primitive */
+	int lower = 0;
+	int upper = kernel_data.integrator.num_light_tree_emitters - 1;
+
+	while(lower <= upper) {
+		int middle = (lower + upper) >> 1;
+		float4 l = kernel_tex_fetch(__light_tree_lookup, middle);
+		int l_object = __float_as_int(l.x);
+		int l_prim = __float_as_int(l.y);
+
+		if(l_object == object && l_prim == prim)
+			return __float_as_int(l.z);
+		else if(l_object < object || (l_object == object && l_prim < prim))
+			lower = middle + 1;
+		else
+			upper = middle - 1;
+	}
+
+	return -1;
+}
+
+#endif
+
 /* Triangle Light */
 
 __device void object_transform_light_sample(KernelGlobals *kg, LightSample *ls, int object, float time)
@@ -459,10 +636,21 @@ __device void triangle_light_sample(KernelGlobals *kg, int prim, int object,
 	object_transform_light_sample(kg, ls, object, time);
 }
 
-__device float triangle_light_pdf(KernelGlobals *kg,
+__device float triangle_light_area_pdf(KernelGlobals *kg, float3 P, int object, int prim)
+{
+#ifdef __LIGHT_TREE__
+	if(kernel_data.integrator.use_light_tree) {
+		int index = light_tree_lookup(kg, object, prim);
+		return (index == -1)? 0.0f: light_tree_pdf(kg, P, index);
+	}
+#endif
+
+	return kernel_data.integrator.pdf_triangles;
+}
+
+__device float triangle_light_pdf(KernelGlobals *kg, float pdf,
 	const float3 Ng, const float3 I, float t)
 {
-	float pdf = kernel_data.integrator.pdf_triangles;
 	float cos_pi = fabsf(dot(Ng, I));
 
 	if(cos_pi == 0.0f)
@@ -549,7 +737,15 @@ __device int light_distribution_sample(KernelGlobals *kg, float randt)
 __device void light_sample(KernelGlobals *kg, float randt, float randu, float randv, float time, float3 P, LightSample *ls)
 {
 	/* sample index */
-	int index = light_distribution_sample(kg, randt);
+	float pdf = kernel_data.integrator.pdf_triangles;
+	int index;
+
+#ifdef __LIGHT_TREE__
+	if(kernel_data.integrator.use_light_tree && randt < kernel_data.integrator.pdf_light_tree)
+		index = light_tree_sample(kg, P, randt/kernel_data.integrator.pdf_light_tree, &pdf);
+	else
+#endif
+		index = light_distribution_sample(kg, randt);
 
 	/* fetch light data */
 	float4 l = kernel_tex_fetch(__light_distribution, index);
@@ -570,7 +766,7 @@ __device void light_sample(KernelGlobals *kg, float randt, float randu, float ra
 
 		/* compute incoming direction, distance and pdf */
 		ls->D = normalize_len(ls->P - P, &ls->t);
-		ls->pdf = triangle_light_pdf(kg, ls->Ng, -ls->D, ls->t);
+		ls->pdf = triangle_light_pdf(kg, pdf, ls->Ng, -ls->D, ls->t);
 		ls->shader |= __float_as_int(l.z) & (~SHADER_MASK);
 	}
 	else {
@@ -224,6 +224,21 @@ __device_inline float3 object_dupli_uv(KernelGlobals *kg, int object)
 	return make_float3(f.x, f.y, 0.0f);
 }
 
+/* Attribute maps are stored per mesh, shared by the objects instancing it */
+__device_inline uint object_attribute_map_offset(KernelGlobals *kg, int object)
+{
+	int offset = object*OBJECT_SIZE + OBJECT_DUPLI;
+	float4 f = kernel_tex_fetch(__objects, offset + 1);
+	return __float_as_uint(f.z)*kernel_data.bvh.attributes_map_stride;
+}
+
+__device_inline uint object_visibility(KernelGlobals *kg, int object)
+{
+	int offset = object*OBJECT_SIZE + OBJECT_DUPLI;
+	float4 f = kernel_tex_fetch(__objects, offset);
+	return __float_as_uint(f.w);
+}
+
 
 __device int shader_pass_id(KernelGlobals *kg, ShaderData *sd)
 {
@@ -158,5 +158,54 @@ __device_inline void kernel_write_light_passes(KernelGlobals *kg, __global float
 #endif
 }
 
+/* Adaptive Sampling
+ *
+ * The sample count pass holds the number of samples taken for each pixel and
+ * the variance pass the sum of squared luminance, next to the sum in the
+ * combined pass. A pixel stops being sampled once the standard error of its
+ * mean is below the threshold, relative to the square root of the mean so
+ * that dark and bright areas are judged similar to how noise is perceived. */
+
+__device_inline bool kernel_adaptive_pixel_converged(KernelGlobals *kg, __global float *buffer, int sample)
+{
+#ifdef __PASSES__
+	if(!(kernel_data.film.pass_flag & PASS_SAMPLE_COUNT))
+		return false;
+	if(sample < kernel_data.film.adaptive_min_samples)
+		return false;
+
+	float num_samples = buffer[kernel_data.film.pass_sample_count];
+
+	if(num_samples < 2.0f)
+		return false;
+
+	__global float *combined = buffer + kernel_data.film.pass_combined;
+	float inv_num_samples = 1.0f/num_samples;
+	float mean = linear_rgb_to_gray(make_float3(combined[0], combined[1], combined[2]))*inv_num_samples;
+	float mean_sq = buffer[kernel_data.film.pass_adaptive_variance]*inv_num_samples;
+
+	/* variance of the mean, from the variance of the samples */
+	float variance = max(mean_sq - mean*mean, 0.0f)*inv_num_samples;
+	float error = sqrtf(variance);
+
+	return (error <= kernel_data.film.adaptive_threshold*(sqrtf(max(mean, 0.0f)) + 1e-4f));
+#else
+	return false;
+#endif
+}
+
+__device_inline void kernel_write_adaptive_passes(KernelGlobals *kg, __global float *buffer, int sample, float4 L)
+{
+#ifdef __PASSES__
+	if(!(kernel_data.film.pass_flag & PASS_SAMPLE_COUNT))
+		return;
+
+	float lum = linear_rgb_to_gray(make_float3(L.x, L.y, L.z));
+
+	kernel_write_pass_float(buffer + kernel_data.film.pass_adaptive_variance, sample, lum*lum);
+	kernel_write_pass_float(buffer + kernel_data.film.pass_sample_count, sample, 1.0f);
+#endif
+}
+
 CCL_NAMESPACE_END
 
@@ -41,6 +41,10 @@
 #include "kernel_subsurface.h"
 #endif
 
+#ifdef __VOLUME__
+#include "kernel_volume.h"
+#endif
+
 CCL_NAMESPACE_BEGIN
 
 typedef struct PathState {
@@ -51,9 +55,13 @@ typedef struct PathState {
 	int glossy_bounce;
 	int transmission_bounce;
 	int transparent_bounce;
+
+#ifdef __VOLUME__
+	VolumeStack volume_stack[VOLUME_STACK_SIZE];
+#endif
 } PathState;
 
-__device_inline void path_state_init(PathState *state)
+__device_inline void path_state_init(KernelGlobals *kg, PathState *state)
 {
 	state->flag = PATH_RAY_CAMERA|PATH_RAY_SINGULAR|PATH_RAY_MIS_SKIP;
 	state->bounce = 0;
@@ -61,6 +69,10 @@ __device_inline void path_state_init(PathState *state)
 	state->glossy_bounce = 0;
 	state->transmission_bounce = 0;
 	state->transparent_bounce = 0;
+
+#ifdef __VOLUME__
+	kernel_volume_stack_init(kg, state->volume_stack);
+#endif
 }
 
 __device_inline void path_state_next(KernelGlobals *kg, PathState *state, int label)
@@ -184,6 +196,12 @@ __device_inline bool shadow_blocked(KernelGlobals *kg, PathState *state, Ray *ra
 			float3 throughput = make_float3(1.0f, 1.0f, 1.0f);
 			float3 Pend = ray->P + ray->D*ray->t;
 			int bounce = state->transparent_bounce;
+#ifdef __VOLUME__
+			VolumeStack volume_stack[VOLUME_STACK_SIZE];
+
+			for(int i = 0; i < VOLUME_STACK_SIZE; i++)
+				volume_stack[i] = state->volume_stack[i];
+#endif
 
 			for(;;) {
 				if(bounce >= kernel_data.integrator.transparent_max_bounce) {
@@ -207,6 +225,12 @@ __device_inline bool shadow_blocked(KernelGlobals *kg, PathState *state, Ray *ra
 #else
 				if(!scene_intersect(kg, ray, PATH_RAY_SHADOW_TRANSPARENT, &isect)) {
 #endif
+#ifdef __VOLUME__
+					/* attenuation for the last segment towards the light */
+					if(volume_stack[0].shader != SHADER_NO_ID)
+						kernel_volume_shadow(kg, volume_stack, ray, &throughput);
+#endif
+
 					*shadow *= throughput;
 					return false;
 				}
@@ -214,11 +238,28 @@ __device_inline bool shadow_blocked(KernelGlobals *kg, PathState *state, Ray *ra
 				if(!shader_transparent_shadow(kg, &isect))
 					return true;
 
+#ifdef __VOLUME__
+				/* attenuation between the previous and this surface */
+				if(volume_stack[0].shader != SHADER_NO_ID) {
+					Ray segment_ray = *ray;
+					segment_ray.t = isect.t;
+					kernel_volume_shadow(kg, volume_stack, &segment_ray, &throughput);
+				}
+#endif
+
 				ShaderData sd;
 				shader_setup_from_ray(kg, &sd, &isect, ray);
 				shader_eval_surface(kg, &sd, 0.0f, PATH_RAY_SHADOW, SHADER_CONTEXT_SHADOW);
 
+#ifdef __VOLUME__
+				/* volume only surfaces are fully transparent */
+				if(!(sd.flag & SD_HAS_ONLY_VOLUME))
+					throughput *= shader_bsdf_transparency(kg, &sd);
+
+				kernel_volume_stack_enter_exit(kg, &sd, volume_stack);
+#else
 				throughput *= shader_bsdf_transparency(kg, &sd);
+#endif
 
 				ray->P = ray_offset(sd.P, -sd.Ng);
 				if(ray->t != FLT_MAX)
@@ -230,9 +271,109 @@ __device_inline bool shadow_blocked(KernelGlobals *kg, PathState *state, Ray *ra
 	}
 #endif
 
+#ifdef __VOLUME__
+	/* attenuation by the volumes the shadow ray starts in */
+	if(!result && state->volume_stack[0].shader != SHADER_NO_ID)
+		kernel_volume_shadow(kg, state->volume_stack, ray, shadow);
+#endif
+
 	return result;
 }
 
+#ifdef __VOLUME__
+
+/* Volume Bounce
+ *
+ * Direct lighting and phase function sampling at a scatter point inside a
+ * volume, sets up the ray for the next bounce. Returns false if the path
+ * terminates. */
+
+__device bool kernel_path_volume_bounce(KernelGlobals *kg, RNG *rng, int sample, int num_samples,
+	int num_total_samples, int rng_offset, ShaderData *sd, float3 *throughput, PathState *state, PathRadiance *L,
+	Ray *ray, float *ray_pdf, float *min_ray_pdf)
+{
+	/* path termination */
+	float probability = path_state_terminate_probability(kg, state, (*throughput)*num_samples);
+
+	if(probability == 0.0f) {
+		return false;
+	}
+	else if(probability != 1.0f) {
+		float terminate = path_rng_1D(kg, rng, sample, num_total_samples, rng_offset + PRNG_TERMINATE);
+
+		if(terminate >= probability)
+			return false;
+
+		*throughput /= probability;
+	}
+
+#ifdef __EMISSION__
+	if(kernel_data.integrator.use_direct_light) {
+		/* sample illumination from lights to find path contribution */
+		float light_t = path_rng_1D(kg, rng, sample, num_total_samples, rng_offset + PRNG_LIGHT);
+		float light_u, light_v;
+		path_rng_2D(kg, rng, sample, num_total_samples, rng_offset + PRNG_LIGHT_U, &light_u, &light_v);
+
+		Ray light_ray;
+		BsdfEval L_light;
+		bool is_lamp;
+
+#ifdef __OBJECT_MOTION__
+		light_ray.time = sd->time;
+#endif
+
+		if(direct_emission(kg, sd, -1, light_t, 0.0f, light_u, light_v, &light_ray, &L_light, &is_lamp)) {
+			/* trace shadow ray */
+			float3 shadow;
+
+			if(!shadow_blocked(kg, state, &light_ray, &shadow)) {
+				/* accumulate */
+				path_radiance_accum_light(L, *throughput, &L_light, shadow, 1.0f, state->bounce, is_lamp);
+			}
+		}
+	}
+#endif
+
+	/* sample phase function */
+	float phase_pdf;
+	BsdfEval phase_eval;
+	float3 phase_omega_in;
+	differential3 phase_domega_in;
+	float phase_u, phase_v;
+	path_rng_2D(kg, rng, sample, num_total_samples, rng_offset + PRNG_BSDF_U, &phase_u, &phase_v);
+	int label;
+
+	label = shader_volume_phase_sample(kg, sd, phase_u, phase_v, &phase_eval,
+		&phase_omega_in, &phase_domega_in, &phase_pdf);
+
+	if(phase_pdf == 0.0f || bsdf_eval_is_zero(&phase_eval))
+		return false;
+
+	/* modify throughput */
+	path_radiance_bsdf_bounce(L, throughput, &phase_eval, phase_pdf, state->bounce, label);
+
+	/* set labels */
+	*ray_pdf = phase_pdf;
+	*min_ray_pdf = fminf(phase_pdf, *min_ray_pdf);
+
+	/* update path state */
+	path_state_next(kg, state, label);
+
+	/* setup ray, no offset needed as there is no surface */
+	ray->P = sd->P;
+	ray->D = phase_omega_in;
+	ray->t = FLT_MAX;
+
+#ifdef __RAY_DIFFERENTIALS__
+	ray->dP = sd->dP;
+	ray->dD = phase_domega_in;
+#endif
+
+	return true;
+}
+
+#endif
+
 __device float4 kernel_path_progressive(KernelGlobals *kg, RNG *rng, int sample, Ray ray, __global float *buffer)
 {
 	/* initialize */
@@ -255,7 +396,7 @@ __device float4 kernel_path_progressive(KernelGlobals *kg, RNG *rng, int sample,
 	int num_samples = 0;
 #endif
 
-	path_state_init(&state);
+	path_state_init(kg, &state);
 
 	/* path iteration */
 	for(;; rng_offset += PRNG_BOUNCE_NUM) {
@@ -283,6 +424,32 @@ __device float4 kernel_path_progressive(KernelGlobals *kg, RNG *rng, int sample,
 		bool hit = scene_intersect(kg, &ray, visibility, &isect);
 #endif
 
+#ifdef __VOLUME__
+		/* volume attenuation, emission and scattering up to the next surface */
+		if(state.volume_stack[0].shader != SHADER_NO_ID) {
+			Ray volume_ray = ray;
+			volume_ray.t = (hit)? isect.t: ray.t;
+
+			ShaderData volume_sd;
+			VolumeIntegrateResult result = kernel_volume_integrate(kg, state.volume_stack,
+				state.flag, state.bounce, &volume_sd, &volume_ray, &L, &throughput,
+				rng, sample, num_samples, rng_offset);
+
+			if(result == VOLUME_PATH_SCATTERED) {
+				if(!kernel_path_volume_bounce(kg, rng, sample, 1, num_samples, rng_offset,
+					&volume_sd, &throughput, &state, &L, &ray, &ray_pdf, &min_ray_pdf))
+					break;
+
+#ifdef __LAMP_MIS__
+				ray_t = 0.0f;
+#endif
+				continue;
+			}
+			else if(result == VOLUME_PATH_MISSED)
+				break;
+		}
+#endif
+
 #ifdef __LAMP_MIS__
 		if(kernel_data.integrator.use_lamp_mis && !(state.flag & PATH_RAY_CAMERA)) {
 			/* ray starting from previous non-transparent bounce */
@@ -331,6 +498,21 @@ __device float4 kernel_path_progressive(KernelGlobals *kg, RNG *rng, int sample,
 		float rbsdf = path_rng_1D(kg, rng, sample, num_samples, rng_offset + PRNG_BSDF);
 		shader_eval_surface(kg, &sd, rbsdf, state.flag, SHADER_CONTEXT_MAIN);
 
+#ifdef __VOLUME__
+		/* surfaces with only a volume shader are passed through, entering or
+		 * leaving the volume */
+		if(sd.flag & SD_HAS_ONLY_VOLUME) {
+			kernel_volume_stack_enter_exit(kg, &sd, state.volume_stack);
+			path_state_next(kg, &state, LABEL_TRANSPARENT);
+
+			ray.P = ray_offset(sd.P, -sd.Ng);
+			if(ray.t != FLT_MAX)
+				ray.t -= sd.ray_length; /* clipping works through transparent */
+
+			continue;
+		}
+#endif
+
 		/* holdout */
 #ifdef __HOLDOUT__
 		if((sd.flag & (SD_HOLDOUT|SD_HOLDOUT_MASK)) && (state.flag & PATH_RAY_CAMERA)) {
@@ -511,6 +693,12 @@ __device float4 kernel_path_progressive(KernelGlobals *kg, RNG *rng, int sample,
 		/* update path state */
 		path_state_next(kg, &state, label);
 
+#ifdef __VOLUME__
+		/* enter/exit volume */
+		if(label & LABEL_TRANSMIT)
+			kernel_volume_stack_enter_exit(kg, &sd, state.volume_stack);
+#endif
+
 		/* setup ray */
 		ray.P = ray_offset(sd.P, (label & LABEL_TRANSMIT)? -sd.Ng: sd.Ng);
 		ray.D = bsdf_omega_in;
@@ -558,6 +746,32 @@ __device void kernel_path_indirect(KernelGlobals *kg, RNG *rng, int sample, Ray
 		bool hit = scene_intersect(kg, &ray, visibility, &isect);
 #endif
 
+#ifdef __VOLUME__
+		/* volume attenuation, emission and scattering up to the next surface */
+		if(state.volume_stack[0].shader != SHADER_NO_ID) {
+			Ray volume_ray = ray;
+			volume_ray.t = (hit)? isect.t: ray.t;
+
+			ShaderData volume_sd;
+			VolumeIntegrateResult result = kernel_volume_integrate(kg, state.volume_stack,
+				state.flag, state.bounce, &volume_sd, &volume_ray, L, &throughput,
+				rng, sample, num_total_samples, rng_offset);
+
+			if(result == VOLUME_PATH_SCATTERED) {
+				if(!kernel_path_volume_bounce(kg, rng, sample, num_samples, num_total_samples, rng_offset,
+					&volume_sd, &throughput, &state, L, &ray, &ray_pdf, &min_ray_pdf))
+					break;
+
+#ifdef __LAMP_MIS__
+				ray_t = 0.0f;
+#endif
+				continue;
+			}
+			else if(result == VOLUME_PATH_MISSED)
+				break;
+		}
+#endif
+
 #ifdef __LAMP_MIS__
 		if(kernel_data.integrator.use_lamp_mis && !(state.flag & PATH_RAY_CAMERA)) {
 			/* ray starting from previous non-transparent bounce */
@@ -597,6 +811,21 @@ __device void kernel_path_indirect(KernelGlobals *kg, RNG *rng, int sample, Ray
 		shader_eval_surface(kg, &sd, rbsdf, state.flag, SHADER_CONTEXT_INDIRECT);
 		shader_merge_closures(kg, &sd);
 
+#ifdef __VOLUME__
+		/* surfaces with only a volume shader are passed through, entering or
+		 * leaving the volume */
+		if(sd.flag & SD_HAS_ONLY_VOLUME) {
+			kernel_volume_stack_enter_exit(kg, &sd, state.volume_stack);
+			path_state_next(kg, &state, LABEL_TRANSPARENT);
+
+			ray.P = ray_offset(sd.P, -sd.Ng);
+			if(ray.t != FLT_MAX)
+				ray.t -= sd.ray_length; /* clipping works through transparent */
+
+			continue;
+		}
+#endif
+
 		/* blurring of bsdf after bounces, for rays that have a small likelihood
 		 * of following this particular path (diffuse, rough glossy) */
 		if(kernel_data.integrator.filter_glossy != FLT_MAX) {
@@ -753,6 +982,12 @@ __device void kernel_path_indirect(KernelGlobals *kg, RNG *rng, int sample, Ray
 		/* update path state */
 		path_state_next(kg, &state, label);
 
+#ifdef __VOLUME__
+		/* enter/exit volume */
+		if(label & LABEL_TRANSMIT)
+			kernel_volume_stack_enter_exit(kg, &sd, state.volume_stack);
+#endif
+
 		/* setup ray */
 		ray.P = ray_offset(sd.P, (label & LABEL_TRANSMIT)? -sd.Ng: sd.Ng);
 		ray.D = bsdf_omega_in;
@@ -934,6 +1169,12 @@ __device_noinline void kernel_path_non_progressive_lighting(KernelGlobals *kg, R
 			PathState ps = state;
 			path_state_next(kg, &ps, label);
 
+#ifdef __VOLUME__
+			/* enter/exit volume */
+			if(label & LABEL_TRANSMIT)
+				kernel_volume_stack_enter_exit(kg, sd, ps.volume_stack);
+#endif
+
 			/* setup ray */
 			Ray bsdf_ray;
 
@@ -978,7 +1219,7 @@ __device float4 kernel_path_non_progressive(KernelGlobals *kg, RNG *rng, int sam
 	int aa_samples = 0;
 #endif
 
-	path_state_init(&state);
+	path_state_init(kg, &state);
 
 	for(;; rng_offset += PRNG_BOUNCE_NUM) {
 		/* intersect scene */
@@ -1000,10 +1241,45 @@ __device float4 kernel_path_non_progressive(KernelGlobals *kg, RNG *rng, int sam
 			lcg_state = lcg_init(*rng + rng_offset + sample*0x51633e2d);
 		}
 
-		if(!scene_intersect(kg, &ray, visibility, &isect, &lcg_state, difl, extmax)) {
+		bool hit = scene_intersect(kg, &ray, visibility, &isect, &lcg_state, difl, extmax);
 #else
-		if(!scene_intersect(kg, &ray, visibility, &isect)) {
+		bool hit = scene_intersect(kg, &ray, visibility, &isect);
 #endif
+
+#ifdef __VOLUME__
+		/* volume attenuation, emission and scattering up to the next surface */
+		if(state.volume_stack[0].shader != SHADER_NO_ID) {
+			Ray volume_ray = ray;
+			volume_ray.t = (hit)? isect.t: ray.t;
+
+			ShaderData volume_sd;
+			VolumeIntegrateResult result = kernel_volume_integrate(kg, state.volume_stack,
+				state.flag, state.bounce, &volume_sd, &volume_ray, &L, &throughput,
+				rng, sample, aa_samples, rng_offset);
+
+			if(result == VOLUME_PATH_SCATTERED) {
+				/* continue the path from the scatter point with a single sample */
+				float min_ray_pdf = FLT_MAX;
+
+				if(kernel_path_volume_bounce(kg, rng, sample, 1, aa_samples, rng_offset,
+					&volume_sd, &throughput, &state, &L, &ray, &ray_pdf, &min_ray_pdf))
+				{
+					kernel_path_indirect(kg, rng, sample, ray, buffer, throughput, 1, aa_samples,
+						min_ray_pdf, ray_pdf, state, rng_offset+PRNG_BOUNCE_NUM, &L);
+
+					/* for render passes, sum and reset indirect light pass variables */
+					path_radiance_sum_indirect(&L);
+					path_radiance_reset_indirect(&L);
+				}
+
+				break;
+			}
+			else if(result == VOLUME_PATH_MISSED)
+				break;
+		}
+#endif
+
+		if(!hit) {
 			/* eval background shader if nothing hit */
 			if(kernel_data.background.transparent) {
 				L_transparent += average(throughput);
@@ -1029,6 +1305,20 @@ __device float4 kernel_path_non_progressive(KernelGlobals *kg, RNG *rng, int sam
 		shader_eval_surface(kg, &sd, 0.0f, state.flag, SHADER_CONTEXT_MAIN);
 		shader_merge_closures(kg, &sd);
 
+#ifdef __VOLUME__
+		/* surfaces with only a volume shader are passed through, entering or
+		 * leaving the volume */
+		if(sd.flag & SD_HAS_ONLY_VOLUME) {
+			kernel_volume_stack_enter_exit(kg, &sd, state.volume_stack);
+			path_state_next(kg, &state, LABEL_TRANSPARENT);
+
+			ray.P = ray_offset(sd.P, -sd.Ng);
+			ray.t -= sd.ray_length; /* clipping works through transparent */
+
+			continue;
+		}
+#endif
+
 		/* holdout */
 #ifdef __HOLDOUT__
 		if((sd.flag & (SD_HOLDOUT|SD_HOLDOUT_MASK))) {
@@ -1120,6 +1410,12 @@ __device float4 kernel_path_non_progressive(KernelGlobals *kg, RNG *rng, int sam
 			break;
 
 		path_state_next(kg, &state, LABEL_TRANSPARENT);
+
+#ifdef __VOLUME__
+		/* enter/exit volume */
+		kernel_volume_stack_enter_exit(kg, &sd, state.volume_stack);
+#endif
+
 		ray.P = ray_offset(sd.P, -sd.Ng);
 		ray.t -= sd.ray_length; /* clipping works through transparent */
 	}
@@ -1148,6 +1444,10 @@ __device void kernel_path_trace(KernelGlobals *kg,
 	rng_state += index;
 	buffer += index*pass_stride;
 
+	/* adaptive sampling, skip pixels that have converged */
+	if(kernel_adaptive_pixel_converged(kg, buffer, sample))
+		return;
+
 	/* initialize random numbers */
 	RNG rng;
 
@@ -1196,6 +1496,7 @@ __device void kernel_path_trace(KernelGlobals *kg,
 
 	/* accumulate result in output buffer */
 	kernel_write_pass_float4(buffer, sample, L);
+	kernel_write_adaptive_passes(kg, buffer, sample, L);
 
 	path_rng_end(kg, rng_state, rng);
 }
@@ -36,7 +36,7 @@ __device_inline int find_attribute(KernelGlobals *kg, ShaderData *sd, uint id, A
 #endif
 	{
 		/* for SVM, find attribute by unique id */
-		uint attr_offset = sd->object*kernel_data.bvh.attributes_map_stride;
+		uint attr_offset = object_attribute_map_offset(kg, sd->object);
 #ifdef __HAIR__
 		attr_offset = (sd->segment == ~0)? attr_offset: attr_offset + ATTR_PRIM_CURVE;
 #endif
@@ -54,8 +54,92 @@ __device_inline int find_attribute(KernelGlobals *kg, ShaderData *sd, uint id, A
 	}
 }
 
+#ifdef __VOLUME__
+
+/* voxel grids are stored as a header with the transform from object space to
+ * the unit cube and the resolution, followed by the voxels in x, y, z order.
+ * values are interpolated trilinearly between voxel centers */
+
+__device float voxel_attribute_float(KernelGlobals *kg, const ShaderData *sd, AttributeElement elem, int offset, float *dx, float *dy)
+{
+	if(dx) *dx = 0.0f;
+	if(dy) *dy = 0.0f;
+
+	if(elem != ATTR_ELEMENT_VOXEL)
+		return 0.0f;
+
+	Transform tfm;
+	tfm.x = make_float4(kernel_tex_fetch(__attributes_float, offset + 0), kernel_tex_fetch(__attributes_float, offset + 1),
+		kernel_tex_fetch(__attributes_float, offset + 2), kernel_tex_fetch(__attributes_float, offset + 3));
+	tfm.y = make_float4(kernel_tex_fetch(__attributes_float, offset + 4), kernel_tex_fetch(__attributes_float, offset + 5),
+		kernel_tex_fetch(__attributes_float, offset + 6), kernel_tex_fetch(__attributes_float, offset + 7));
+	tfm.z = make_float4(kernel_tex_fetch(__attributes_float, offset + 8), kernel_tex_fetch(__attributes_float, offset + 9),
+		kernel_tex_fetch(__attributes_float, offset + 10), kernel_tex_fetch(__attributes_float, offset + 11));
+	tfm.w = make_float4(0.0f, 0.0f, 0.0f, 1.0f);
+
+	int resx = __float_as_int(kernel_tex_fetch(__attributes_float, offset + 12));
+	int resy = __float_as_int(kernel_tex_fetch(__attributes_float, offset + 13));
+	int resz = __float_as_int(kernel_tex_fetch(__attributes_float, offset + 14));
+
+	/* position in voxel coordinates */
+	float3 P = sd->P;
+#ifdef __OBJECT_MOTION__
+	P = transform_point(&sd->ob_itfm, P);
+#else
+	Transform itfm = object_fetch_transform(kg, sd->object, OBJECT_INVERSE_TRANSFORM);
+	P = transform_point(&itfm, P);
+#endif
+	P = transform_point(&tfm, P);
+
+	if(P.x < 0.0f || P.y < 0.0f || P.z < 0.0f || P.x > 1.0f || P.y > 1.0f || P.z > 1.0f)
+		return 0.0f;
+
+	float x = P.x*resx - 0.5f;
+	float y = P.y*resy - 0.5f;
+	float z = P.z*resz - 0.5f;
+
+	int ix = (int)floorf(x);
+	int iy = (int)floorf(y);
+	int iz = (int)floorf(z);
+
+	float tx = x - ix;
+	float ty = y - iy;
+	float tz = z - iz;
+
+	int nix = clamp(ix + 1, 0, resx - 1);
+	int niy = clamp(iy + 1, 0, resy - 1);
+	int niz = clamp(iz + 1, 0, resz - 1);
+
+	ix = clamp(ix, 0, resx - 1);
+	iy = clamp(iy, 0, resy - 1);
+	iz = clamp(iz, 0, resz - 1);
+
+	int data = offset + VOXEL_HEADER_SIZE;
+	int sy = resx;
+	int sz = resx*resy;
+
+	float r;
+	r  = (1.0f - tz)*(1.0f - ty)*(1.0f - tx)*kernel_tex_fetch(__attributes_float, data + ix + iy*sy + iz*sz);
+	r += (1.0f - tz)*(1.0f - ty)*tx*kernel_tex_fetch(__attributes_float, data + nix + iy*sy + iz*sz);
+	r += (1.0f - tz)*ty*(1.0f - tx)*kernel_tex_fetch(__attributes_float, data + ix + niy*sy + iz*sz);
+	r += (1.0f - tz)*ty*tx*kernel_tex_fetch(__attributes_float, data + nix + niy*sy + iz*sz);
+	r += tz*(1.0f - ty)*(1.0f - tx)*kernel_tex_fetch(__attributes_float, data + ix + iy*sy + niz*sz);
+	r += tz*(1.0f - ty)*tx*kernel_tex_fetch(__attributes_float, data + nix + iy*sy + niz*sz);
+	r += tz*ty*(1.0f - tx)*kernel_tex_fetch(__attributes_float, data + ix + niy*sy + niz*sz);
+	r += tz*ty*tx*kernel_tex_fetch(__attributes_float, data + nix + niy*sy + niz*sz);
+
+	return r;
+}
+
+#endif
+
 __device float primitive_attribute_float(KernelGlobals *kg, const ShaderData *sd, AttributeElement elem, int offset, float *dx, float *dy)
 {
+#ifdef __VOLUME__
+	if(sd->prim == ~0)
+		return voxel_attribute_float(kg, sd, elem, offset, dx, dy);
+#endif
+
 #ifdef __HAIR__
 	if(sd->segment == ~0)
 #endif
@@ -68,6 +152,16 @@ __device float primitive_attribute_float(KernelGlobals *kg, const ShaderData *sd
 
 __device float3 primitive_attribute_float3(KernelGlobals *kg, const ShaderData *sd, AttributeElement elem, int offset, float3 *dx, float3 *dy)
 {
+#ifdef __VOLUME__
+	/* only float voxel grids are supported */
+	if(sd->prim == ~0) {
+		if(dx) *dx = make_float3(0.0f, 0.0f, 0.0f);
+		if(dy) *dy = make_float3(0.0f, 0.0f, 0.0f);
+
+		return make_float3(0.0f, 0.0f, 0.0f);
+	}
+#endif
+
 #ifdef __HAIR__
 	if(sd->segment == ~0)
 #endif
@@ -0,0 +1,251 @@
+/*
+ * Adapted from code Copyright 2009-2010 NVIDIA Corporation,
+ * and code copyright 2009-2012 Intel Corporation
+ *
+ * Modifications Copyright 2011-2013, Blender Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* This is a template QBVH traversal function for the CPU, included from
+ * kernel_bvh_traversal.h with the same features as the binary version.
+ * Nodes have four children, which are intersected at once with SSE. Hit
+ * children are visited front to back, the nearest one first, the others are
+ * pushed on the stack. */
+
+__device bool BVH_FUNCTION_FULL_NAME(qbvh)
+(KernelGlobals *kg, const Ray *ray, Intersection *isect
+#if FEATURE(BVH_SUBSURFACE)
+, int subsurface_object, float subsurface_random
+#else
+, const uint visibility
+#endif
+#if FEATURE(BVH_HAIR_MINIMUM_WIDTH) && !FEATURE(BVH_SUBSURFACE)
+, uint *lcg_state, float difl, float extmax
+#endif
+)
+{
+	/* traversal stack */
+	int traversalStack[BVH_QSTACK_SIZE];
+	traversalStack[0] = ENTRYPOINT_SENTINEL;
+
+	/* traversal variables */
+	int stackPtr = 0;
+	int nodeAddr = kernel_data.bvh.root;
+
+	/* ray parameters */
+	const float tmax = ray->t;
+	float3 P = ray->P;
+	float3 idir = bvh_inverse_direction(ray->D);
+	int object = ~0;
+
+#if FEATURE(BVH_SUBSURFACE)
+	const uint visibility = ~0;
+	int num_hits = 0;
+#endif
+
+#if !FEATURE(BVH_HAIR_MINIMUM_WIDTH) || FEATURE(BVH_SUBSURFACE)
+	const float difl = 0.0f, extmax = 0.0f;
+#endif
+
+#if FEATURE(BVH_MOTION)
+	Transform ob_tfm;
+#endif
+
+	isect->t = tmax;
+	isect->object = ~0;
+	isect->prim = ~0;
+	isect->u = 0.0f;
+	isect->v = 0.0f;
+
+	QBVHRay qray;
+	qbvh_ray_init(&qray, P, idir);
+
+	const int node_size = qbvh_node_size(kg);
+
+	/* traversal loop */
+	do {
+		do
+		{
+			/* traverse internal nodes */
+			while(nodeAddr >= 0 && nodeAddr != ENTRYPOINT_SENTINEL)
+			{
+				union { __m128 m128; float v[4]; } dist;
+				int traverseChild = qbvh_node_intersect(kg, &qray, nodeAddr, isect->t, visibility, difl, extmax, &dist.m128);
+
+				if(traverseChild == 0) {
+					/* no child was intersected */
+					nodeAddr = traversalStack[stackPtr];
+					--stackPtr;
+					continue;
+				}
+
+				float4 cnodes = kernel_tex_fetch(__bvh_nodes, nodeAddr*node_size+(node_size-2));
+
+				/* sort intersected children by distance */
+				int childAddr[4];
+				float childDist[4];
+				int numChild = 0;
+
+				for(int i = 0; i < 4; i++) {
+					if(traverseChild & (1 << i)) {
+						int j = numChild++;
+
+						while(j > 0 && childDist[j-1] > dist.v[i]) {
+							childAddr[j] = childAddr[j-1];
+							childDist[j] = childDist[j-1];
+							j--;
+						}
+
+						childAddr[j] = __float_as_int(cnodes[i]);
+						childDist[j] = dist.v[i];
+					}
+				}
+
+				/* push the farther ones, continue with the nearest */
+				for(int i = numChild - 1; i > 0; i--) {
+					++stackPtr;
+					traversalStack[stackPtr] = childAddr[i];
+				}
+
+				nodeAddr = childAddr[0];
+			}
+
+			/* if node is leaf, fetch triangle list */
+			if(nodeAddr < 0) {
+				float4 leaf = kernel_tex_fetch(__bvh_nodes, (-nodeAddr-1)*node_size+(node_size-2));
+				int primAddr = __float_as_int(leaf.x);
+
+#if FEATURE(BVH_INSTANCING)
+				if(primAddr >= 0) {
+#endif
+					int primAddr2 = __float_as_int(leaf.y);
+
+					/* pop */
+					nodeAddr = traversalStack[stackPtr];
+					--stackPtr;
+
+					/* primitive intersection */
+					while(primAddr < primAddr2) {
+						bool hit;
+
+#if FEATURE(BVH_SUBSURFACE)
+						/* only primitives from the same object */
+						uint tri_object = (object == ~0)? kernel_tex_fetch(__prim_object, primAddr): object;
+
+						if(tri_object == subsurface_object) {
+#endif
+
+							/* intersect ray against primitive */
+#if FEATURE(BVH_HAIR)
+							uint segment = kernel_tex_fetch(__prim_segment, primAddr);
+#if !FEATURE(BVH_SUBSURFACE)
+							if(segment != ~0) {
+
+								if(kernel_data.curve_kernel_data.curveflags & CURVE_KN_INTERPOLATE)
+#if FEATURE(BVH_HAIR_MINIMUM_WIDTH)
+									hit = bvh_cardinal_curve_intersect(kg, isect, P, idir, visibility, object, primAddr, segment, lcg_state, difl, extmax);
+								else
+									hit = bvh_curve_intersect(kg, isect, P, idir, visibility, object, primAddr, segment, lcg_state, difl, extmax);
+#else
+									hit = bvh_cardinal_curve_intersect(kg, isect, P, idir, visibility, object, primAddr, segment);
+								else
+									hit = bvh_curve_intersect(kg, isect, P, idir, visibility, object, primAddr, segment);
+#endif
+							}
+							else
+#endif
+#endif
+#if FEATURE(BVH_SUBSURFACE)
+#if FEATURE(BVH_HAIR)
+							if(segment == ~0)
+#endif
+							{
+								hit = bvh_triangle_intersect_subsurface(kg, isect, P, idir, object, primAddr, tmax, &num_hits, subsurface_random);
+								(void)hit;
+							}
+
+						}
+#else
+								hit = bvh_triangle_intersect(kg, isect, P, idir, visibility, object, primAddr);
+
+							/* shadow ray early termination */
+							if(hit && visibility == PATH_RAY_SHADOW_OPAQUE)
+								return true;
+#endif
+
+						primAddr++;
+					}
+				}
+#if FEATURE(BVH_INSTANCING)
+				else {
+					/* instance push */
+#if FEATURE(BVH_SUBSURFACE)
+					if(subsurface_object == kernel_tex_fetch(__prim_object, -primAddr-1)) {
+						object = subsurface_object;
+#else
+						object = kernel_tex_fetch(__prim_object, -primAddr-1);
+#endif
+
+#if FEATURE(BVH_MOTION)
+						bvh_instance_motion_push(kg, object, ray, &P, &idir, &isect->t, &ob_tfm, tmax);
+#else
+						bvh_instance_push(kg, object, ray, &P, &idir, &isect->t, tmax);
+#endif
+
+						qbvh_ray_init(&qray, P, idir);
+
+						++stackPtr;
+						traversalStack[stackPtr] = ENTRYPOINT_SENTINEL;
+
+						nodeAddr = kernel_tex_fetch(__object_node, object);
+#if FEATURE(BVH_SUBSURFACE)
+					}
+					else {
+						/* pop */
+						nodeAddr = traversalStack[stackPtr];
+						--stackPtr;
+					}
+#endif
+				}
+			}
+#endif
+		} while(nodeAddr != ENTRYPOINT_SENTINEL);
+
+#if FEATURE(BVH_INSTANCING)
+		if(stackPtr >= 0) {
+			kernel_assert(object != ~0);
+
+			/* instance pop */
+#if FEATURE(BVH_MOTION)
+			bvh_instance_motion_pop(kg, object, ray, &P, &idir, &isect->t, &ob_tfm, tmax);
+#else
+			bvh_instance_pop(kg, object, ray, &P, &idir, &isect->t, tmax);
+#endif
+
+			qbvh_ray_init(&qray, P, idir);
+
+			object = ~0;
+			nodeAddr = traversalStack[stackPtr];
+			--stackPtr;
+		}
+#endif
+	} while(nodeAddr != ENTRYPOINT_SENTINEL);
+
+#if FEATURE(BVH_SUBSURFACE)
+	return (num_hits != 0);
+#else
+	return (isect->prim != ~0);
+#endif
+}
+
@@ -458,6 +458,55 @@ __device_inline void shader_setup_from_background(KernelGlobals *kg, ShaderData
 	sd->ray_dP = ray->dP;
 }
 
+/* ShaderData setup from point inside volume */
+
+#ifdef __VOLUME__
+__device_inline void shader_setup_from_volume(KernelGlobals *kg, ShaderData *sd, const Ray *ray)
+{
+	/* vectors */
+	sd->P = ray->P;
+	sd->N = -ray->D;
+	sd->Ng = -ray->D;
+	sd->I = -ray->D;
+	sd->shader = SHADER_NO_ID;
+	sd->flag = 0;
+#ifdef __OBJECT_MOTION__
+	sd->time = ray->time;
+#endif
+	sd->ray_length = 0.0f;
+
+#ifdef __INSTANCING__
+	sd->object = ~0;
+#endif
+	sd->prim = ~0;
+#ifdef __HAIR__
+	sd->segment = ~0;
+#endif
+#ifdef __UV__
+	sd->u = 0.0f;
+	sd->v = 0.0f;
+#endif
+
+#ifdef __DPDU__
+	/* dPdu/dPdv */
+	sd->dPdu = make_float3(0.0f, 0.0f, 0.0f);
+	sd->dPdv = make_float3(0.0f, 0.0f, 0.0f);
+#endif
+
+#ifdef __RAY_DIFFERENTIALS__
+	/* differentials */
+	sd->dP = ray->dP;
+	differential_incoming(&sd->dI, ray->dD);
+	sd->du = differential_zero();
+	sd->dv = differential_zero();
+#endif
+
+	/* for NDC coordinates */
+	sd->ray_P = ray->P;
+	sd->ray_dP = ray->dP;
+}
+#endif
+
 /* BSDF */
 
 #ifdef __MULTI_CLOSURE__
@@ -835,25 +884,85 @@ __device float3 shader_eval_background(KernelGlobals *kg, ShaderData *sd, int pa
 
 /* Volume */
 
-__device float3 shader_volume_eval_phase(KernelGlobals *kg, ShaderData *sd,
-	float3 omega_in, float3 omega_out)
+#ifdef __VOLUME__
+
+__device void shader_volume_phase_eval(KernelGlobals *kg, const ShaderData *sd,
+	const float3 omega_in, BsdfEval *eval, float *pdf)
 {
-#ifdef __MULTI_CLOSURE__
-	float3 eval = make_float3(0.0f, 0.0f, 0.0f);
+	float sum_pdf = 0.0f;
+	float sum_sample_weight = 0.0f;
 
-	for(int i = 0; i< sd->num_closure; i++) {
+	bsdf_eval_init(eval, NBUILTIN_CLOSURES, make_float3(0.0f, 0.0f, 0.0f), kernel_data.film.use_light_pass);
+
+	for(int i = 0; i < sd->num_closure; i++) {
 		const ShaderClosure *sc = &sd->closure[i];
 
+		if(CLOSURE_IS_VOLUME(sc->type)) {
+			float phase_pdf = 0.0f;
+			float3 phase_eval = volume_eval_phase(kg, sc, omega_in, sd->I, &phase_pdf);
+
+			if(phase_pdf != 0.0f) {
+				bsdf_eval_accum(eval, sc->type, phase_eval*sc->weight);
+				sum_pdf += phase_pdf*sc->sample_weight;
+			}
+
+			sum_sample_weight += sc->sample_weight;
+		}
+	}
+
+	*pdf = (sum_sample_weight > 0.0f)? sum_pdf/sum_sample_weight: 0.0f;
+}
+
+__device int shader_volume_phase_sample(KernelGlobals *kg, const ShaderData *sd,
+	float randu, float randv, BsdfEval *phase_eval,
+	float3 *omega_in, differential3 *domega_in, float *pdf)
+{
+	/* pick a phase closure based on sample weights */
+	float sum = 0.0f;
+	int sampled;
+
+	for(sampled = 0; sampled < sd->num_closure; sampled++) {
+		const ShaderClosure *sc = &sd->closure[sampled];
+
 		if(CLOSURE_IS_VOLUME(sc->type))
-			eval += volume_eval_phase(kg, sc, omega_in, omega_out);
+			sum += sc->sample_weight;
 	}
 
-	return eval;
-#else
-	return volume_eval_phase(kg, &sd->closure, omega_in, omega_out);
-#endif
+	float r = sd->randb_closure*sum;
+	sum = 0.0f;
+
+	for(sampled = 0; sampled < sd->num_closure; sampled++) {
+		const ShaderClosure *sc = &sd->closure[sampled];
+
+		if(CLOSURE_IS_VOLUME(sc->type)) {
+			sum += sc->sample_weight;
+
+			if(r <= sum)
+				break;
+		}
+	}
+
+	if(sampled == sd->num_closure) {
+		*pdf = 0.0f;
+		return LABEL_NONE;
+	}
+
+	/* sample phase function, all phase functions are evaluated for the pdf
+	 * and weight, same as for BSDFs */
+	const ShaderClosure *sc = &sd->closure[sampled];
+	float3 eval;
+
+	*pdf = 0.0f;
+	int label = volume_sample_phase(kg, sc, randu, randv, &eval, omega_in, domega_in, pdf);
+
+	if(*pdf != 0.0f)
+		shader_volume_phase_eval(kg, sd, *omega_in, phase_eval, pdf);
+
+	return label;
 }
 
+#endif
+
 /* Volume Evaluation */
 
 __device void shader_eval_volume(KernelGlobals *kg, ShaderData *sd,
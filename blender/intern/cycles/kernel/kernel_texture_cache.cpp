@@ -0,0 +1,67 @@
+/*
+ * Copyright 2011, Blender Foundation.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* CPU texture cache lookups, compiled once and shared by all kernel variants */
+
+#include "kernel_compat_cpu.h"
+#include "kernel_math.h"
+#include "kernel_types.h"
+#include "kernel_globals.h"
+#include "kernel_texture_cache.h"
+
+CCL_NAMESPACE_BEGIN
+
+bool kernel_texture_cache_use(KernelGlobals *kg, int id)
+{
+	TextureCacheGlobals *tcg = kg->texture_cache;
+
+	return (tcg && tcg->ts && id >= 0 && id < (int)tcg->filenames.size() && !tcg->filenames[id].empty());
+}
+
+bool kernel_texture_cache_lookup(KernelGlobals *kg, int id, float x, float y,
+	float dsdx, float dtdx, float dsdy, float dtdy, float4 *result)
+{
+	if(!kernel_texture_cache_use(kg, id))
+		return false;
+
+	TextureCacheGlobals *tcg = kg->texture_cache;
+
+	TextureOpt options;
+	options.nchannels = 4;
+	options.fill = 1.0f;
+	options.swrap = TextureOpt::WrapPeriodic;
+	options.twrap = TextureOpt::WrapPeriodic;
+
+	/* image textures are stored bottom to top, files top to bottom */
+	float r[4];
+
+	if(!tcg->ts->texture(tcg->filenames[id], options, x, 1.0f - y, dsdx, -dtdx, dsdy, -dtdy, r)) {
+		/* missing texture color, same as for images that failed to load */
+		r[0] = 1.0f;
+		r[1] = 0.0f;
+		r[2] = 1.0f;
+		r[3] = 1.0f;
+	}
+
+	*result = make_float4(r[0], r[1], r[2], r[3]);
+
+	return true;
+}
+
+CCL_NAMESPACE_END
+
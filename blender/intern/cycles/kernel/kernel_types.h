@@ -32,6 +32,7 @@ CCL_NAMESPACE_BEGIN
 #define OBJECT_SIZE 		11
 #define OBJECT_VECTOR_SIZE	6
 #define LIGHT_SIZE			4
+#define LIGHT_TREE_NODE_SIZE	4
 #define FILTER_TABLE_SIZE	256
 #define RAMP_TABLE_SIZE		256
 #define PARTICLE_SIZE 		5
@@ -46,6 +47,9 @@ CCL_NAMESPACE_BEGIN
 
 #define TEX_NUM_FLOAT_IMAGES	5
 
+#define VOLUME_STACK_SIZE		16
+#define VOXEL_HEADER_SIZE		16
+
 /* device capabilities */
 #ifdef __KERNEL_CPU__
 #define __KERNEL_SHADING__
@@ -56,6 +60,11 @@ CCL_NAMESPACE_BEGIN
 #endif
 #define __SUBSURFACE__
 #define __CMJ__
+#define __LIGHT_TREE__
+#define __VOLUME__
+#ifdef __KERNEL_SSE2__
+#define __QBVH__
+#endif
 #endif
 
 #ifdef __KERNEL_CUDA__
@@ -181,7 +190,13 @@ enum PathTraceDimension {
 	PRNG_LIGHT_V = 5,
 	PRNG_LIGHT_F = 6,
 	PRNG_TERMINATE = 7,
+#ifdef __VOLUME__
+	PRNG_VOLUME_DISTANCE = 8,
+	PRNG_VOLUME_STEP = 9,
+	PRNG_BOUNCE_NUM = 10
+#else
 	PRNG_BOUNCE_NUM = 8
+#endif
 };
 
 enum SamplingPattern {
@@ -189,6 +204,11 @@ enum SamplingPattern {
 	SAMPLING_PATTERN_CMJ = 1
 };
 
+enum VolumeSampling {
+	VOLUME_SAMPLING_DISTANCE = 0,
+	VOLUME_SAMPLING_EQUIANGULAR = 1
+};
+
 /* these flags values correspond to raytypes in osl.cpp, so keep them in sync!
  *
  * for ray visibility tests in BVH traversal, the upper 20 bits are used for
@@ -262,7 +282,9 @@ typedef enum PassType {
 	PASS_SHADOW = 262144,
 	PASS_MOTION = 524288,
 	PASS_MOTION_WEIGHT = 1048576,
-	PASS_MIST = 2097152
+	PASS_MIST = 2097152,
+	PASS_ADAPTIVE_VARIANCE = 4194304,
+	PASS_SAMPLE_COUNT = 8388608
 } PassType;
 
 #define PASS_ALL (~0)
@@ -332,7 +354,9 @@ typedef enum ShaderFlag {
 	SHADER_EXCLUDE_CAMERA = (1 << 24),
 	SHADER_EXCLUDE_ANY = (SHADER_EXCLUDE_DIFFUSE|SHADER_EXCLUDE_GLOSSY|SHADER_EXCLUDE_TRANSMIT|SHADER_EXCLUDE_CAMERA),
 
-	SHADER_MASK = ~(SHADER_SMOOTH_NORMAL|SHADER_CAST_SHADOW|SHADER_AREA_LIGHT|SHADER_USE_MIS|SHADER_EXCLUDE_ANY)
+	SHADER_MASK = ~(SHADER_SMOOTH_NORMAL|SHADER_CAST_SHADOW|SHADER_AREA_LIGHT|SHADER_USE_MIS|SHADER_EXCLUDE_ANY),
+
+	SHADER_NO_ID = -1
 } ShaderFlag;
 
 /* Light Type */
@@ -390,6 +414,15 @@ typedef struct Ray {
 #endif
 } Ray;
 
+/* Volume Stack */
+
+#ifdef __VOLUME__
+typedef struct VolumeStack {
+	int object;
+	int shader;
+} VolumeStack;
+#endif
+
 /* Intersection */
 
 typedef struct Intersection {
@@ -411,7 +444,8 @@ typedef enum AttributeElement {
 	ATTR_ELEMENT_VERTEX,
 	ATTR_ELEMENT_CORNER,
 	ATTR_ELEMENT_CURVE,
-	ATTR_ELEMENT_CURVE_KEY
+	ATTR_ELEMENT_CURVE_KEY,
+	ATTR_ELEMENT_VOXEL
 } AttributeElement;
 
 typedef enum AttributeStandard {
@@ -429,6 +463,8 @@ typedef enum AttributeStandard {
 	ATTR_STD_PARTICLE,
 	ATTR_STD_CURVE_TANGENT,
 	ATTR_STD_CURVE_INTERCEPT,
+	ATTR_STD_VOLUME_DENSITY,
+	ATTR_STD_VOLUME_HEAT,
 	ATTR_STD_NUM,
 
 	ATTR_STD_NOT_FOUND = ~0
@@ -496,11 +532,12 @@ enum ShaderDataFlag {
 	SD_HAS_TRANSPARENT_SHADOW = 1024,	/* has transparent shadow */
 	SD_HAS_VOLUME = 2048,				/* has volume shader */
 	SD_HOMOGENEOUS_VOLUME = 4096,		/* has homogeneous volume */
+	SD_HAS_ONLY_VOLUME = 8192,			/* has volume shader but no surface shader */
 
 	/* object flags */
-	SD_HOLDOUT_MASK = 8192,				/* holdout for camera rays */
-	SD_OBJECT_MOTION = 16384,			/* has object motion blur */
-	SD_TRANSFORM_APPLIED = 32768 		/* vertices have transform applied */
+	SD_HOLDOUT_MASK = 16384,			/* holdout for camera rays */
+	SD_OBJECT_MOTION = 32768,			/* has object motion blur */
+	SD_TRANSFORM_APPLIED = 65536 		/* vertices have transform applied */
 };
 
 struct KernelGlobals;
@@ -684,6 +721,12 @@ typedef struct KernelFilm {
 	float mist_start;
 	float mist_inv_depth;
 	float mist_falloff;
+
+	/* adaptive sampling */
+	int pass_adaptive_variance;
+	int pass_sample_count;
+	float adaptive_threshold;
+	int adaptive_min_samples;
 } KernelFilm;
 
 typedef struct KernelBackground {
@@ -757,8 +800,18 @@ typedef struct KernelIntegrator {
 	/* sampler */
 	int sampling_pattern;
 
+	/* light tree */
+	int use_light_tree;
+	int num_light_tree_emitters;
+	float pdf_light_tree;
+
+	/* volume */
+	int volume_sampling;
+	int volume_max_steps;
+	float volume_step_size;
+
 	/* padding */
-	int pad;
+	int pad1, pad2, pad3;
 } KernelIntegrator;
 
 typedef struct KernelBVH {
@@ -768,8 +821,9 @@ typedef struct KernelBVH {
 	int have_motion;
 	int have_curves;
 	int have_instancing;
-
-	int pad1, pad2, pad3;
+	int use_qbvh;
+	int use_compact;
+	int pad1;
 } KernelBVH;
 
 typedef enum CurveFlag {
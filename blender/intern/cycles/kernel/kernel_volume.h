@@ -0,0 +1,469 @@
+/*
+ * Copyright 2013, Blender Foundation.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+CCL_NAMESPACE_BEGIN
+
+/* Volume Stack
+ *
+ * Volumes the ray is currently inside of, terminated by SHADER_NO_ID. The
+ * stack starts out with the world volume, objects are added when a ray enters
+ * them through a front facing surface and removed when it leaves through a
+ * back facing one. This assumes objects are closed and the camera is not
+ * inside a volume object. */
+
+__device void kernel_volume_stack_init(KernelGlobals *kg, VolumeStack *stack)
+{
+	int shader = kernel_data.background.shader;
+	int flag = kernel_tex_fetch(__shader_flag, (shader & SHADER_MASK)*2);
+
+	if(flag & SD_HAS_VOLUME) {
+		stack[0].object = ~0;
+		stack[0].shader = shader;
+		stack[1].shader = SHADER_NO_ID;
+	}
+	else
+		stack[0].shader = SHADER_NO_ID;
+}
+
+__device void kernel_volume_stack_enter_exit(KernelGlobals *kg, ShaderData *sd, VolumeStack *stack)
+{
+	if(!(sd->flag & SD_HAS_VOLUME))
+		return;
+
+	if(sd->flag & SD_BACKFACING) {
+		/* exit volume object: remove from stack */
+		for(int i = 0; stack[i].shader != SHADER_NO_ID; i++) {
+			if(stack[i].object == sd->object) {
+				/* shift back next stack entries */
+				do {
+					stack[i] = stack[i+1];
+					i++;
+				}
+				while(stack[i].shader != SHADER_NO_ID);
+
+				return;
+			}
+		}
+	}
+	else {
+		/* enter volume object: add to stack */
+		int i;
+
+		for(i = 0; stack[i].shader != SHADER_NO_ID; i++) {
+			/* already in the stack? then we have nothing to do */
+			if(stack[i].object == sd->object)
+				return;
+		}
+
+		/* if we exceed the stack limit, ignore */
+		if(i >= VOLUME_STACK_SIZE-1)
+			return;
+
+		/* add to the end of the stack */
+		stack[i].object = sd->object;
+		stack[i].shader = sd->shader;
+		stack[i+1].shader = SHADER_NO_ID;
+	}
+}
+
+__device bool kernel_volume_stack_is_homogeneous(KernelGlobals *kg, VolumeStack *stack)
+{
+	for(int i = 0; stack[i].shader != SHADER_NO_ID; i++) {
+		int flag = kernel_tex_fetch(__shader_flag, (stack[i].shader & SHADER_MASK)*2);
+
+		if(!(flag & SD_HOMOGENEOUS_VOLUME))
+			return false;
+	}
+
+	return true;
+}
+
+/* Volume Shader
+ *
+ * Evaluates the shaders of all volumes in the stack at a point, the closure
+ * weights scaled by density give the absorption and scattering coefficients,
+ * emission closures the emission per unit length. */
+
+typedef struct VolumeShaderCoefficients {
+	float3 sigma_a;
+	float3 sigma_s;
+	float3 emission;
+} VolumeShaderCoefficients;
+
+__device void volume_shader_sample(KernelGlobals *kg, ShaderData *sd, VolumeStack *stack,
+	int path_flag, ShaderContext ctx, float3 P, VolumeShaderCoefficients *coeff)
+{
+	coeff->sigma_a = make_float3(0.0f, 0.0f, 0.0f);
+	coeff->sigma_s = make_float3(0.0f, 0.0f, 0.0f);
+	coeff->emission = make_float3(0.0f, 0.0f, 0.0f);
+
+	sd->P = P;
+
+	for(int i = 0; stack[i].shader != SHADER_NO_ID; i++) {
+		sd->object = stack[i].object;
+		sd->shader = stack[i].shader;
+		sd->flag = kernel_tex_fetch(__shader_flag, (sd->shader & SHADER_MASK)*2);
+
+		if(sd->object != ~0) {
+			sd->flag |= kernel_tex_fetch(__object_flag, sd->object);
+
+#ifdef __OBJECT_MOTION__
+			shader_setup_object_transforms(kg, sd, sd->time);
+#endif
+		}
+
+		shader_eval_volume(kg, sd, 0.0f, path_flag, ctx);
+
+		for(int j = 0; j < sd->num_closure; j++) {
+			const ShaderClosure *sc = &sd->closure[j];
+
+			if(sc->type == CLOSURE_VOLUME_TRANSPARENT_ID)
+				coeff->sigma_a += sc->weight*sc->data0;
+			else if(sc->type == CLOSURE_VOLUME_ISOTROPIC_ID)
+				coeff->sigma_s += sc->weight*sc->data0;
+			else if(CLOSURE_IS_EMISSION(sc->type))
+				coeff->emission += sc->weight;
+		}
+	}
+}
+
+__device float3 volume_color_attenuation(float3 sigma, float t)
+{
+	return make_float3(expf(-sigma.x * t), expf(-sigma.y * t), expf(-sigma.z * t));
+}
+
+/* emission integrated over a segment with constant coefficients, taking
+ * into account the attenuation within the segment */
+__device float3 volume_emission_integrate(VolumeShaderCoefficients *coeff, float3 sigma_t, float t)
+{
+	float3 emission = coeff->emission;
+
+	emission.x *= (sigma_t.x > 0.0f)? (1.0f - expf(-sigma_t.x*t))/sigma_t.x: t;
+	emission.y *= (sigma_t.y > 0.0f)? (1.0f - expf(-sigma_t.y*t))/sigma_t.y: t;
+	emission.z *= (sigma_t.z > 0.0f)? (1.0f - expf(-sigma_t.z*t))/sigma_t.z: t;
+
+	return emission;
+}
+
+/* number of ray marching steps and step size for a segment. segments that
+ * would need more than the maximum number of steps use longer steps, and for
+ * infinite rays we only march up to the maximum number of steps */
+__device int volume_march_steps(KernelGlobals *kg, float t, float *step_size)
+{
+	float step = kernel_data.integrator.volume_step_size;
+	int max_steps = kernel_data.integrator.volume_max_steps;
+
+	if(t == FLT_MAX) {
+		*step_size = step;
+		return max_steps;
+	}
+
+	float steps = ceilf(t/step);
+
+	if(steps >= (float)max_steps) {
+		*step_size = t/max_steps;
+		return max_steps;
+	}
+
+	int num_steps = max((int)steps, 1);
+	*step_size = t/num_steps;
+
+	return num_steps;
+}
+
+/* Volume Shadows
+ *
+ * Transmittance along a shadow ray segment, in closed form for homogeneous
+ * volumes and by ray marching otherwise. */
+
+__device void kernel_volume_shadow(KernelGlobals *kg, VolumeStack *stack, Ray *ray, float3 *throughput)
+{
+	ShaderData sd;
+	VolumeShaderCoefficients coeff;
+
+	shader_setup_from_volume(kg, &sd, ray);
+
+	if(kernel_volume_stack_is_homogeneous(kg, stack)) {
+		volume_shader_sample(kg, &sd, stack, PATH_RAY_SHADOW, SHADER_CONTEXT_SHADOW, ray->P, &coeff);
+		*throughput *= volume_color_attenuation(coeff.sigma_a + coeff.sigma_s, ray->t);
+		return;
+	}
+
+	float step_size;
+	int steps = volume_march_steps(kg, ray->t, &step_size);
+	float3 tau = make_float3(0.0f, 0.0f, 0.0f);
+
+	for(int i = 0; i < steps; i++) {
+		float t = (i + 0.5f)*step_size;
+
+		volume_shader_sample(kg, &sd, stack, PATH_RAY_SHADOW, SHADER_CONTEXT_SHADOW, ray->P + ray->D*t, &coeff);
+		tau += (coeff.sigma_a + coeff.sigma_s)*step_size;
+
+		/* stop if nearly all light is blocked */
+		if(min(tau.x, min(tau.y, tau.z)) > 10.0f)
+			break;
+	}
+
+	*throughput *= volume_color_attenuation(tau, 1.0f);
+}
+
+/* Equiangular Sampling
+ *
+ * Sample a distance along the ray proportional to the inverse squared
+ * distance to a point on a light, which gives much less noise than distance
+ * sampling for lights inside or near thin volumes. */
+
+__device bool volume_equiangular_setup(Ray *ray, float3 light_P, float *delta, float *D)
+{
+	if(ray->t == FLT_MAX)
+		return false;
+
+	*delta = dot(light_P - ray->P, ray->D);
+	*D = sqrtf(max(len_squared(light_P - ray->P) - (*delta)*(*delta), 0.0f));
+
+	return (*D > 0.0f);
+}
+
+__device float volume_equiangular_sample(Ray *ray, float delta, float D, float xi, float *pdf)
+{
+	float theta_a = -atan2f(delta, D);
+	float theta_b = atan2f(ray->t - delta, D);
+	float t = D*tanf(theta_a*(1.0f - xi) + theta_b*xi);
+
+	*pdf = D/((theta_b - theta_a)*(D*D + t*t));
+
+	return clamp(delta + t, 0.0f, ray->t);
+}
+
+/* Volume Integration
+ *
+ * Integrates emission along the ray segment up to the next surface, and
+ * decides if the path scatters inside the volume or continues to the surface,
+ * adjusting the throughput for attenuation and sampling pdf. When scattering,
+ * the shader data is set up at the scatter point with an isotropic phase
+ * function, the scattering coefficient is included in the throughput. */
+
+typedef enum VolumeIntegrateResult {
+	VOLUME_PATH_SCATTERED = 0,
+	VOLUME_PATH_ATTENUATED = 1,
+	VOLUME_PATH_MISSED = 2
+} VolumeIntegrateResult;
+
+__device void kernel_volume_scatter_setup(KernelGlobals *kg, ShaderData *sd, Ray *ray, float t)
+{
+	shader_setup_from_volume(kg, sd, ray);
+	sd->P = ray->P + ray->D*t;
+
+	/* all phase functions are isotropic currently, so a single closure gives
+	 * the same result as the closures of all volumes at this point */
+	ShaderClosure *sc = &sd->closure[0];
+
+	sc->type = CLOSURE_VOLUME_ISOTROPIC_ID;
+	sc->weight = make_float3(1.0f, 1.0f, 1.0f);
+	sc->sample_weight = 1.0f;
+	sc->data0 = 1.0f;
+	sc->data1 = 0.0f;
+	sc->N = sd->N;
+#ifdef __OSL__
+	sc->prim = NULL;
+#endif
+
+	sd->num_closure = 1;
+	sd->randb_closure = 0.0f;
+	sd->flag = SD_VOLUME;
+}
+
+__device VolumeIntegrateResult kernel_volume_integrate_homogeneous(KernelGlobals *kg,
+	VolumeStack *stack, int path_flag, int bounce, ShaderData *sd, Ray *ray,
+	PathRadiance *L, float3 *throughput, RNG *rng, int sample, int num_samples, int rng_offset)
+{
+	VolumeShaderCoefficients coeff;
+
+	volume_shader_sample(kg, sd, stack, path_flag, SHADER_CONTEXT_MAIN, ray->P, &coeff);
+
+	float3 sigma_t = coeff.sigma_a + coeff.sigma_s;
+	float3 transmittance = volume_color_attenuation(sigma_t, ray->t);
+
+	/* emission */
+	if(!is_zero(coeff.emission))
+		path_radiance_accum_emission(L, *throughput, volume_emission_integrate(&coeff, sigma_t, ray->t), bounce);
+
+	/* absorption only */
+	float sample_sigma_t = average(sigma_t);
+
+	if(is_zero(coeff.sigma_s) || sample_sigma_t <= 0.0f) {
+		*throughput *= transmittance;
+		return (is_zero(*throughput))? VOLUME_PATH_MISSED: VOLUME_PATH_ATTENUATED;
+	}
+
+	float xi = path_rng_1D(kg, rng, sample, num_samples, rng_offset + PRNG_VOLUME_DISTANCE);
+
+	/* find a light position for equiangular sampling */
+	float delta, D;
+	bool equiangular = false;
+
+	if(kernel_data.integrator.volume_sampling == VOLUME_SAMPLING_EQUIANGULAR) {
+		float light_t = path_rng_1D(kg, rng, sample, num_samples, rng_offset + PRNG_LIGHT);
+		float light_u, light_v;
+		path_rng_2D(kg, rng, sample, num_samples, rng_offset + PRNG_LIGHT_U, &light_u, &light_v);
+
+		LightSample ls;
+		light_sample(kg, light_t, light_u, light_v, ray->time, ray->P, &ls);
+
+		if(ls.pdf != 0.0f && ls.t != FLT_MAX)
+			equiangular = volume_equiangular_setup(ray, ls.P, &delta, &D);
+	}
+
+	if(equiangular) {
+		/* scatter with the probability of interacting with the volume */
+		float scatter_probability = 1.0f - average(transmittance);
+
+		if(xi < scatter_probability) {
+			float pdf;
+			float t = volume_equiangular_sample(ray, delta, D, xi/scatter_probability, &pdf);
+
+			*throughput *= volume_color_attenuation(sigma_t, t)*coeff.sigma_s/(scatter_probability*pdf);
+			kernel_volume_scatter_setup(kg, sd, ray, t);
+
+			return VOLUME_PATH_SCATTERED;
+		}
+
+		*throughput *= transmittance/(1.0f - scatter_probability);
+	}
+	else {
+		/* distance sampling, passing through to the surface if we sample a
+		 * distance beyond it */
+		float t = -logf(1.0f - xi)/sample_sigma_t;
+
+		if(t < ray->t) {
+			float pdf = sample_sigma_t*expf(-sample_sigma_t*t);
+
+			*throughput *= volume_color_attenuation(sigma_t, t)*coeff.sigma_s/pdf;
+			kernel_volume_scatter_setup(kg, sd, ray, t);
+
+			return VOLUME_PATH_SCATTERED;
+		}
+
+		float pdf = expf(-sample_sigma_t*ray->t);
+
+		if(pdf == 0.0f)
+			return VOLUME_PATH_MISSED;
+
+		*throughput *= transmittance/pdf;
+	}
+
+	return (is_zero(*throughput))? VOLUME_PATH_MISSED: VOLUME_PATH_ATTENUATED;
+}
+
+__device VolumeIntegrateResult kernel_volume_integrate_heterogeneous(KernelGlobals *kg,
+	VolumeStack *stack, int path_flag, int bounce, ShaderData *sd, Ray *ray,
+	PathRadiance *L, float3 *throughput, RNG *rng, int sample, int num_samples, int rng_offset)
+{
+	VolumeShaderCoefficients coeff;
+
+	float step_size;
+	int steps = volume_march_steps(kg, ray->t, &step_size);
+
+	/* jittered step offset, and optical depth at which we scatter */
+	float step_offset = path_rng_1D(kg, rng, sample, num_samples, rng_offset + PRNG_VOLUME_STEP);
+	float xi = path_rng_1D(kg, rng, sample, num_samples, rng_offset + PRNG_VOLUME_DISTANCE);
+	float scatter_tau = -logf(1.0f - xi);
+
+	float3 tau = make_float3(0.0f, 0.0f, 0.0f);
+	float3 emission = make_float3(0.0f, 0.0f, 0.0f);
+	float3 scatter_weight = make_float3(0.0f, 0.0f, 0.0f);
+	float scatter_t = 0.0f;
+	bool scattered = false;
+
+	for(int i = 0; i < steps; i++) {
+		float t = i*step_size;
+
+		volume_shader_sample(kg, sd, stack, path_flag, SHADER_CONTEXT_MAIN, ray->P + ray->D*(t + step_offset*step_size), &coeff);
+
+		float3 sigma_t = coeff.sigma_a + coeff.sigma_s;
+		float3 transmittance = volume_color_attenuation(tau, 1.0f);
+
+		/* emission, accumulated along the entire segment regardless of
+		 * scattering, as it does not depend on the path continuation */
+		if(!is_zero(coeff.emission))
+			emission += transmittance*volume_emission_integrate(&coeff, sigma_t, step_size);
+
+		/* scatter if we reach the sampled optical depth within this step */
+		float sample_sigma_t = average(sigma_t);
+
+		if(!scattered && sample_sigma_t > 0.0f) {
+			float sample_tau = average(tau);
+
+			if(sample_tau + sample_sigma_t*step_size > scatter_tau) {
+				float dt = (scatter_tau - sample_tau)/sample_sigma_t;
+				float pdf = sample_sigma_t*expf(-scatter_tau);
+
+				scatter_weight = transmittance*volume_color_attenuation(sigma_t, dt)*coeff.sigma_s/pdf;
+				scatter_t = t + dt;
+				scattered = true;
+			}
+		}
+
+		tau += sigma_t*step_size;
+
+		/* stop if nearly all light is blocked */
+		if(scattered && min(tau.x, min(tau.y, tau.z)) > 10.0f)
+			break;
+	}
+
+	if(!is_zero(emission))
+		path_radiance_accum_emission(L, *throughput, emission, bounce);
+
+	if(scattered) {
+		*throughput *= scatter_weight;
+
+		if(is_zero(*throughput))
+			return VOLUME_PATH_MISSED;
+
+		kernel_volume_scatter_setup(kg, sd, ray, scatter_t);
+
+		return VOLUME_PATH_SCATTERED;
+	}
+
+	/* pass through to the surface */
+	float pdf = expf(-average(tau));
+
+	if(pdf == 0.0f)
+		return VOLUME_PATH_MISSED;
+
+	*throughput *= volume_color_attenuation(tau, 1.0f)/pdf;
+
+	return (is_zero(*throughput))? VOLUME_PATH_MISSED: VOLUME_PATH_ATTENUATED;
+}
+
+__device VolumeIntegrateResult kernel_volume_integrate(KernelGlobals *kg,
+	VolumeStack *stack, int path_flag, int bounce, ShaderData *sd, Ray *ray,
+	PathRadiance *L, float3 *throughput, RNG *rng, int sample, int num_samples, int rng_offset)
+{
+	shader_setup_from_volume(kg, sd, ray);
+
+	if(kernel_volume_stack_is_homogeneous(kg, stack))
+		return kernel_volume_integrate_homogeneous(kg, stack, path_flag, bounce, sd, ray,
+			L, throughput, rng, sample, num_samples, rng_offset);
+	else
+		return kernel_volume_integrate_heterogeneous(kg, stack, path_flag, bounce, sd, ray,
+			L, throughput, rng, sample, num_samples, rng_offset);
+}
+
+CCL_NAMESPACE_END
+
@@ -50,7 +50,7 @@ __device_inline float svm_image_texture_frac(float x, int *ix)
 	return x - (float)i;
 }
 
-__device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y, uint srgb, uint use_alpha)
+__device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y, differential ds, differential dt, uint srgb, uint use_alpha)
 {
 	/* first slots are used by float textures, which are not supported here */
 	if(id < TEX_NUM_FLOAT_IMAGES)
@@ -112,12 +112,13 @@ __device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y, u
 
 #else
 
-__device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y, uint srgb, uint use_alpha)
+__device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y, differential ds, differential dt, uint srgb, uint use_alpha)
 {
 	float4 r;
 
 #ifdef __KERNEL_CPU__
-	r = kernel_tex_image_interp(id, x, y);
+	if(!kernel_texture_cache_lookup(kg, id, x, y, ds.dx, dt.dx, ds.dy, dt.dy, &r))
+		r = kernel_tex_image_interp(id, x, y);
 #else
 	/* not particularly proud of this massive switch, what are the
 	 * alternatives?
@@ -259,6 +260,39 @@ __device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y, u
 
 #endif
 
+#ifdef __KERNEL_CPU__
+
+/* Derivatives of the texture coordinate for mipmap selection in the texture
+ * cache. The stack holds no derivatives, so they are only known when the
+ * coordinate is the UV map without texture mapping, for which the compiler
+ * passes the attribute. Other coordinates use the full resolution. */
+
+__device void svm_image_texture_uv_derivatives(KernelGlobals *kg, ShaderData *sd, uint uv_id, differential *ds, differential *dt)
+{
+	*ds = differential_zero();
+	*dt = differential_zero();
+
+#ifdef __RAY_DIFFERENTIALS__
+	if(uv_id == ATTR_STD_NOT_FOUND)
+		return;
+
+	AttributeElement elem_uv;
+	int offset_uv = find_attribute(kg, sd, uv_id, &elem_uv);
+
+	if(offset_uv != ATTR_STD_NOT_FOUND) {
+		float3 dx, dy;
+		primitive_attribute_float3(kg, sd, elem_uv, offset_uv, &dx, &dy);
+
+		ds->dx = dx.x;
+		ds->dy = dy.x;
+		dt->dx = dx.y;
+		dt->dy = dy.y;
+	}
+#endif
+}
+
+#endif
+
 __device void svm_node_tex_image(KernelGlobals *kg, ShaderData *sd, float *stack, uint4 node)
 {
 	uint id = node.y;
@@ -268,7 +302,15 @@ __device void svm_node_tex_image(KernelGlobals *kg, ShaderData *sd, float *stack
 
 	float3 co = stack_load_float3(stack, co_offset);
 	uint use_alpha = stack_valid(alpha_offset);
-	float4 f = svm_image_texture(kg, id, co.x, co.y, srgb, use_alpha);
+	differential ds = differential_zero();
+	differential dt = differential_zero();
+
+#ifdef __KERNEL_CPU__
+	if(kernel_texture_cache_use(kg, id))
+		svm_image_texture_uv_derivatives(kg, sd, node.w, &ds, &dt);
+#endif
+
+	float4 f = svm_image_texture(kg, id, co.x, co.y, ds, dt, srgb, use_alpha);
 
 	if(stack_valid(out_offset))
 		stack_store_float3(stack, out_offset, make_float3(f.x, f.y, f.z));
@@ -350,13 +392,14 @@ __device void svm_node_tex_image_box(KernelGlobals *kg, ShaderData *sd, float *s
 
 	float4 f = make_float4(0.0f, 0.0f, 0.0f, 0.0f);
 	uint use_alpha = stack_valid(alpha_offset);
+	differential dzero = differential_zero();
 
 	if(weight.x > 0.0f)
-		f += weight.x*svm_image_texture(kg, id, co.y, co.z, srgb, use_alpha);
+		f += weight.x*svm_image_texture(kg, id, co.y, co.z, dzero, dzero, srgb, use_alpha);
 	if(weight.y > 0.0f)
-		f += weight.y*svm_image_texture(kg, id, co.x, co.z, srgb, use_alpha);
+		f += weight.y*svm_image_texture(kg, id, co.x, co.z, dzero, dzero, srgb, use_alpha);
 	if(weight.z > 0.0f)
-		f += weight.z*svm_image_texture(kg, id, co.y, co.x, srgb, use_alpha);
+		f += weight.z*svm_image_texture(kg, id, co.y, co.x, dzero, dzero, srgb, use_alpha);
 
 	if(stack_valid(out_offset))
 		stack_store_float3(stack, out_offset, make_float3(f.x, f.y, f.z));
@@ -384,7 +427,8 @@ __device void svm_node_tex_environment(KernelGlobals *kg, ShaderData *sd, float
 		uv = direction_to_mirrorball(co);
 
 	uint use_alpha = stack_valid(alpha_offset);
-	float4 f = svm_image_texture(kg, id, uv.x, uv.y, srgb, use_alpha);
+	differential dzero = differential_zero();
+	float4 f = svm_image_texture(kg, id, uv.x, uv.y, dzero, dzero, srgb, use_alpha);
 
 	if(stack_valid(out_offset))
 		stack_store_float3(stack, out_offset, make_float3(f.x, f.y, f.z));
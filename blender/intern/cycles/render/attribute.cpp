@@ -44,6 +44,23 @@ void Attribute::reserve(int numverts, int numtris, int numcurves, int numkeys)
 	buffer.resize(buffer_size(numverts, numtris, numcurves, numkeys), 0);
 }
 
+void Attribute::reserve_voxels(const Transform& tfm, int3 resolution)
+{
+	/* header with transform to the unit cube and resolution, see the kernel
+	 * voxel attribute lookup */
+	size_t num_voxels = (size_t)resolution.x*resolution.y*resolution.z;
+
+	buffer.resize((VOXEL_HEADER_SIZE + num_voxels)*data_sizeof(), 0);
+
+	float *header = data_float();
+
+	memcpy(header, &tfm, sizeof(float)*12);
+	header[12] = __int_as_float(resolution.x);
+	header[13] = __int_as_float(resolution.y);
+	header[14] = __int_as_float(resolution.z);
+	header[15] = 0.0f;
+}
+
 void Attribute::add(const float& f)
 {
 	char *data = (char*)&f;
@@ -93,6 +110,10 @@ size_t Attribute::element_size(int numverts, int numtris, int numcurves, int num
 		case ATTR_ELEMENT_CURVE_KEY:
 			size = numkeys;
 			break;
+		case ATTR_ELEMENT_VOXEL:
+			/* voxel grids have their own size */
+			size = buffer.size()/data_sizeof();
+			break;
 		default:
 			size = 0;
 			break;
@@ -151,6 +172,10 @@ const char *Attribute::standard_name(AttributeStandard std)
 		return "curve_tangent";
 	else if(std == ATTR_STD_CURVE_INTERCEPT)
 		return "curve_intercept";
+	else if(std == ATTR_STD_VOLUME_DENSITY)
+		return "density";
+	else if(std == ATTR_STD_VOLUME_HEAT)
+		return "heat";
 	
 	return "";
 }
@@ -258,6 +283,12 @@ Attribute *AttributeSet::add(AttributeStandard std, ustring name)
 			case ATTR_STD_MOTION_POST:
 				attr = add(name, TypeDesc::TypePoint, ATTR_ELEMENT_VERTEX);
 				break;
+			case ATTR_STD_VOLUME_DENSITY:
+				attr = add(name, TypeDesc::TypeFloat, ATTR_ELEMENT_VOXEL);
+				break;
+			case ATTR_STD_VOLUME_HEAT:
+				attr = add(name, TypeDesc::TypeFloat, ATTR_ELEMENT_VOXEL);
+				break;
 			default:
 				assert(0);
 				break;
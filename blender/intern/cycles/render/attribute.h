@@ -23,6 +23,7 @@
 
 #include "util_list.h"
 #include "util_param.h"
+#include "util_transform.h"
 #include "util_types.h"
 #include "util_vector.h"
 
@@ -51,6 +52,7 @@ public:
 	Attribute() {}
 	void set(ustring name, TypeDesc type, AttributeElement element);
 	void reserve(int numverts, int numfaces, int numcurves, int numkeys);
+	void reserve_voxels(const Transform& tfm, int3 resolution);
 
 	size_t data_sizeof() const;
 	size_t element_size(int numverts, int numfaces, int numcurves, int numkeys) const;
@@ -64,6 +66,8 @@ public:
 	const float3 *data_float3() const { return (const float3*)data(); }
 	const float *data_float() const { return (const float*)data(); }
 
+	float *data_voxels() { return data_float() + VOXEL_HEADER_SIZE; }
+
 	void add(const float& f);
 	void add(const float3& f);
 
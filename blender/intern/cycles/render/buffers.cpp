@@ -159,9 +159,30 @@ bool RenderBuffers::copy_from_device()
 	return true;
 }
 
+/* with adaptive sampling the number of samples differs per pixel, it is read
+ * from the sample count pass at the given offset relative to the pass data */
+static inline float pass_pixel_scale(const float *in, int count_offset, float scale)
+{
+	if(count_offset == 0)
+		return scale;
+
+	float num_samples = in[count_offset];
+	return (num_samples > 0.0f)? 1.0f/num_samples: 0.0f;
+}
+
 bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int components, float *pixels)
 {
 	int pass_offset = 0;
+	int count_pass_offset = -1;
+
+	if(Pass::contains(params.passes, PASS_SAMPLE_COUNT)) {
+		count_pass_offset = 0;
+		foreach(Pass& count_pass, params.passes) {
+			if(count_pass.type == PASS_SAMPLE_COUNT)
+				break;
+			count_pass_offset += count_pass.components;
+		}
+	}
 
 	foreach(Pass& pass, params.passes) {
 		if(pass.type != type) {
@@ -173,7 +194,11 @@ bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int
 		int pass_stride = params.get_passes_size();
 
 		float scale = (pass.filter)? 1.0f/(float)sample: 1.0f;
-		float scale_exposure = (pass.exposure)? scale*exposure: scale;
+		float pass_exposure = (pass.exposure)? exposure: 1.0f;
+		float scale_exposure = scale*pass_exposure;
+
+		/* offset of the sample count relative to this pass, 0 if unused */
+		int count_offset = (pass.filter && count_pass_offset != -1)? count_pass_offset - pass_offset: 0;
 
 		int size = params.width*params.height;
 
@@ -190,7 +215,7 @@ bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int
 			else {
 				for(int i = 0; i < size; i++, in += pass_stride, pixels++) {
 					float f = *in;
-					pixels[0] = f*scale_exposure;
+					pixels[0] = f*pass_pixel_scale(in, count_offset, scale)*pass_exposure;
 				}
 			}
 		}
@@ -234,10 +259,11 @@ bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int
 				/* RGB/vector */
 				for(int i = 0; i < size; i++, in += pass_stride, pixels += 3) {
 					float3 f = make_float3(in[0], in[1], in[2]);
+					float pixel_scale_exposure = pass_pixel_scale(in, count_offset, scale)*pass_exposure;
 
-					pixels[0] = f.x*scale_exposure;
-					pixels[1] = f.y*scale_exposure;
-					pixels[2] = f.z*scale_exposure;
+					pixels[0] = f.x*pixel_scale_exposure;
+					pixels[1] = f.y*pixel_scale_exposure;
+					pixels[2] = f.z*pixel_scale_exposure;
 				}
 			}
 		}
@@ -281,13 +307,15 @@ bool RenderBuffers::get_pass_rect(PassType type, float exposure, int sample, int
 			else {
 				for(int i = 0; i < size; i++, in += pass_stride, pixels += 4) {
 					float4 f = make_float4(in[0], in[1], in[2], in[3]);
+					float pixel_scale = pass_pixel_scale(in, count_offset, scale);
+					float pixel_scale_exposure = pixel_scale*pass_exposure;
 
-					pixels[0] = f.x*scale_exposure;
-					pixels[1] = f.y*scale_exposure;
-					pixels[2] = f.z*scale_exposure;
+					pixels[0] = f.x*pixel_scale_exposure;
+					pixels[1] = f.y*pixel_scale_exposure;
+					pixels[2] = f.z*pixel_scale_exposure;
 
 					/* clamp since alpha might be > 1.0 due to russian roulette */
-					pixels[3] = clamp(f.w*scale, 0.0f, 1.0f);
+					pixels[3] = clamp(f.w*pixel_scale, 0.0f, 1.0f);
 				}
 			}
 		}
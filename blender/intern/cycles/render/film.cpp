@@ -144,6 +144,13 @@ void Pass::add(PassType type, vector<Pass>& passes)
 			pass.components = 4;
 			pass.exposure = false;
 			break;
+		case PASS_ADAPTIVE_VARIANCE:
+			pass.components = 1;
+			break;
+		case PASS_SAMPLE_COUNT:
+			pass.components = 1;
+			pass.filter = false;
+			break;
 	}
 
 	passes.push_back(pass);
@@ -261,6 +268,9 @@ Film::Film()
 
 	use_light_visibility = false;
 
+	adaptive_threshold = 0.01f;
+	adaptive_min_samples = 16;
+
 	need_update = true;
 }
 
@@ -365,6 +375,13 @@ void Film::device_update(Device *device, DeviceScene *dscene, Scene *scene)
 			case PASS_SHADOW:
 				kfilm->pass_shadow = kfilm->pass_stride;
 				kfilm->use_light_pass = 1;
+				break;
+			case PASS_ADAPTIVE_VARIANCE:
+				kfilm->pass_adaptive_variance = kfilm->pass_stride;
+				break;
+			case PASS_SAMPLE_COUNT:
+				kfilm->pass_sample_count = kfilm->pass_stride;
+				break;
 			case PASS_NONE:
 				break;
 		}
@@ -384,6 +401,10 @@ void Film::device_update(Device *device, DeviceScene *dscene, Scene *scene)
 	kfilm->mist_inv_depth = (mist_depth > 0.0f)? 1.0f/mist_depth: 0.0f;
 	kfilm->mist_falloff = mist_falloff;
 
+	/* adaptive sampling parameters, enabled by the passes */
+	kfilm->adaptive_threshold = adaptive_threshold;
+	kfilm->adaptive_min_samples = max(adaptive_min_samples, 1);
+
 	need_update = false;
 }
 
@@ -400,7 +421,9 @@ bool Film::modified(const Film& film)
 	return !(exposure == film.exposure
 		&& Pass::equals(passes, film.passes)
 		&& filter_type == film.filter_type
-		&& filter_width == film.filter_width);
+		&& filter_width == film.filter_width
+		&& adaptive_threshold == film.adaptive_threshold
+		&& adaptive_min_samples == film.adaptive_min_samples);
 }
 
 void Film::tag_passes_update(Scene *scene, const vector<Pass>& passes_)
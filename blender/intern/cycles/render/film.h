@@ -63,6 +63,10 @@ public:
 
 	bool use_light_visibility;
 
+	/* adaptive sampling, used when the passes include the sample count */
+	float adaptive_threshold;
+	int adaptive_min_samples;
+
 	bool need_update;
 
 	Film();
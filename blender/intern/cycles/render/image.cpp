@@ -20,6 +20,8 @@
 #include "image.h"
 #include "scene.h"
 
+#include "kernel_texture_cache.h"
+
 #include "util_foreach.h"
 #include "util_image.h"
 #include "util_path.h"
@@ -36,6 +38,8 @@ ImageManager::ImageManager()
 	need_update = true;
 	pack_images = false;
 	osl_texture_system = NULL;
+	texture_cache_size = 0;
+	texture_cache_system = NULL;
 	animation_frame = 0;
 
 	tex_num_images = TEX_NUM_IMAGES;
@@ -49,6 +53,9 @@ ImageManager::~ImageManager()
 		assert(!images[slot]);
 	for(size_t slot = 0; slot < float_images.size(); slot++)
 		assert(!float_images[slot]);
+
+	if(texture_cache_system)
+		TextureSystem::destroy((TextureSystem*)texture_cache_system);
 }
 
 void ImageManager::set_pack_images(bool pack_images_)
@@ -61,6 +68,11 @@ void ImageManager::set_osl_texture_system(void *texture_system)
 	osl_texture_system = texture_system;
 }
 
+void ImageManager::set_texture_cache(int max_memory_MB)
+{
+	texture_cache_size = max_memory_MB;
+}
+
 void ImageManager::set_extended_image_limits(void)
 {
 	tex_num_images = TEX_EXTENDED_NUM_IMAGES;
@@ -151,6 +163,11 @@ int ImageManager::add_image(const string& filename, void *builtin_data, bool ani
 	/* load image info and find out if we need a float texture */
 	is_float = (pack_images)? false: is_float_image(filename, builtin_data, is_linear);
 
+	/* the texture cache returns float values for any file, so we use byte
+	 * slots and are not limited by the number of float images */
+	if(texture_cache_size && !builtin_data)
+		is_float = false;
+
 	if(is_float) {
 		/* find existing image */
 		for(slot = 0; slot < float_images.size(); slot++) {
@@ -534,6 +551,11 @@ void ImageManager::device_free_image(Device *device, DeviceScene *dscene, int sl
 	}
 
 	if(img) {
+		TextureCacheGlobals *tcg = (TextureCacheGlobals*)device->texture_cache_memory();
+
+		if(tcg && slot < tcg->filenames.size())
+			tcg->filenames[slot] = ustring();
+
 		if(osl_texture_system) {
 #ifdef WITH_OSL
 			ustring filename(images[slot]->filename);
@@ -574,6 +596,8 @@ void ImageManager::device_update(Device *device, DeviceScene *dscene, Progress&
 	if(!need_update)
 		return;
 
+	texture_cache_update(device);
+
 	TaskPool pool;
 
 	for(size_t slot = 0; slot < images.size(); slot++) {
@@ -584,7 +608,9 @@ void ImageManager::device_update(Device *device, DeviceScene *dscene, Progress&
 			device_free_image(device, dscene, slot + tex_image_byte_start);
 		}
 		else if(images[slot]->need_load) {
-			if(!osl_texture_system) 
+			if(texture_cache_use(images[slot]))
+				texture_cache_load_image(device, slot + tex_image_byte_start);
+			else if(!osl_texture_system) 
 				pool.push(function_bind(&ImageManager::device_load_image, this, device, dscene, slot + tex_image_byte_start, &progress));
 		}
 	}
@@ -597,7 +623,9 @@ void ImageManager::device_update(Device *device, DeviceScene *dscene, Progress&
 			device_free_image(device, dscene, slot);
 		}
 		else if(float_images[slot]->need_load) {
-			if(!osl_texture_system) 
+			if(texture_cache_use(float_images[slot]))
+				texture_cache_load_image(device, slot);
+			else if(!osl_texture_system) 
 				pool.push(function_bind(&ImageManager::device_load_image, this, device, dscene, slot, &progress));
 		}
 	}
@@ -647,6 +675,69 @@ void ImageManager::device_pack_images(Device *device, DeviceScene *dscene, Progr
 		device->tex_alloc("__tex_image_packed_info", dscene->tex_image_packed_info);
 }
 
+/* Texture Cache */
+
+bool ImageManager::texture_cache_use(Image *img)
+{
+	/* builtin images are not read from files, so are always loaded in full */
+	return (texture_cache_system && !img->builtin_data);
+}
+
+void ImageManager::texture_cache_update(Device *device)
+{
+	TextureCacheGlobals *tcg = (TextureCacheGlobals*)device->texture_cache_memory();
+
+	if(!texture_cache_size || !tcg)
+		return;
+
+	/* OSL already reads all images through its texture system. it is shared
+	 * with other sessions, so its settings are left alone */
+	if(osl_texture_system)
+		return;
+
+	if(!texture_cache_system) {
+		TextureSystem *ts = TextureSystem::create(false);
+
+		/* tile and mipmap untiled files on demand */
+		ts->attribute("automip", 1);
+		ts->attribute("autotile", 64);
+		ts->attribute("gray_to_rgb", 1);
+
+		texture_cache_system = ts;
+	}
+
+	((TextureSystem*)texture_cache_system)->attribute("max_memory_MB", (float)texture_cache_size);
+
+	tcg->ts = (TextureSystem*)texture_cache_system;
+	tcg->filenames.resize(tex_image_byte_start + images.size());
+}
+
+void ImageManager::texture_cache_load_image(Device *device, int slot)
+{
+	TextureCacheGlobals *tcg = (TextureCacheGlobals*)device->texture_cache_memory();
+	Image *img = (slot >= tex_image_byte_start)? images[slot - tex_image_byte_start]: float_images[slot];
+	ustring filename(img->filename);
+
+	/* drop tiles of a previous version of the file */
+	tcg->ts->invalidate(filename);
+	tcg->filenames[slot] = filename;
+
+	img->need_load = false;
+}
+
+void ImageManager::texture_cache_free(Device *device)
+{
+	TextureCacheGlobals *tcg = (TextureCacheGlobals*)device->texture_cache_memory();
+
+	if(tcg) {
+		tcg->ts = NULL;
+		tcg->filenames.clear();
+	}
+
+	if(texture_cache_system)
+		((TextureSystem*)texture_cache_system)->invalidate_all(true);
+}
+
 void ImageManager::device_free(Device *device, DeviceScene *dscene)
 {
 	for(size_t slot = 0; slot < images.size(); slot++)
@@ -654,6 +745,8 @@ void ImageManager::device_free(Device *device, DeviceScene *dscene)
 	for(size_t slot = 0; slot < float_images.size(); slot++)
 		device_free_image(device, dscene, slot);
 
+	texture_cache_free(device);
+
 	device->tex_free(dscene->tex_image_packed);
 	device->tex_free(dscene->tex_image_packed_info);
 
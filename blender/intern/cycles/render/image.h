@@ -59,6 +59,7 @@ public:
 	void device_free(Device *device, DeviceScene *dscene);
 
 	void set_osl_texture_system(void *texture_system);
+	void set_texture_cache(int max_memory_MB);
 	void set_pack_images(bool pack_images_);
 	void set_extended_image_limits(void);
 	bool set_animation_frame_update(int frame);
@@ -89,6 +90,10 @@ private:
 	void *osl_texture_system;
 	bool pack_images;
 
+	/* texture cache, in megabytes, 0 if disabled */
+	int texture_cache_size;
+	void *texture_cache_system;
+
 	bool file_load_image(Image *img, device_vector<uchar4>& tex_img);
 	bool file_load_float_image(Image *img, device_vector<float4>& tex_img);
 
@@ -96,6 +101,11 @@ private:
 	void device_free_image(Device *device, DeviceScene *dscene, int slot);
 
 	void device_pack_images(Device *device, DeviceScene *dscene, Progress& progess);
+
+	bool texture_cache_use(Image *img);
+	void texture_cache_update(Device *device);
+	void texture_cache_load_image(Device *device, int slot);
+	void texture_cache_free(Device *device);
 };
 
 CCL_NAMESPACE_END
@@ -60,6 +60,10 @@ Integrator::Integrator()
 
 	sampling_pattern = SAMPLING_PATTERN_SOBOL;
 
+	volume_sampling = VOLUME_SAMPLING_DISTANCE;
+	volume_step_size = 0.1f;
+	volume_max_steps = 1024;
+
 	need_update = true;
 }
 
@@ -117,6 +121,10 @@ void Integrator::device_update(Device *device, DeviceScene *dscene, Scene *scene
 
 	kintegrator->sampling_pattern = sampling_pattern;
 
+	kintegrator->volume_sampling = volume_sampling;
+	kintegrator->volume_step_size = max(volume_step_size, 1e-5f);
+	kintegrator->volume_max_steps = max(volume_max_steps, 1);
+
 	/* sobol directions table */
 	int max_samples = 1;
 
@@ -174,7 +182,10 @@ bool Integrator::modified(const Integrator& integrator)
 		mesh_light_samples == integrator.mesh_light_samples &&
 		subsurface_samples == integrator.subsurface_samples &&
 		motion_blur == integrator.motion_blur &&
-		sampling_pattern == integrator.sampling_pattern);
+		sampling_pattern == integrator.sampling_pattern &&
+		volume_sampling == integrator.volume_sampling &&
+		volume_step_size == integrator.volume_step_size &&
+		volume_max_steps == integrator.volume_max_steps);
 }
 
 void Integrator::tag_update(Scene *scene)
@@ -63,6 +63,10 @@ public:
 
 	SamplingPattern sampling_pattern;
 
+	VolumeSampling volume_sampling;
+	float volume_step_size;
+	int volume_max_steps;
+
 	bool need_update;
 
 	Integrator();
@@ -20,11 +20,13 @@
 #include "integrator.h"
 #include "film.h"
 #include "light.h"
+#include "light_tree.h"
 #include "mesh.h"
 #include "object.h"
 #include "scene.h"
 #include "shader.h"
 
+#include "util_algorithm.h"
 #include "util_foreach.h"
 #include "util_progress.h"
 
@@ -142,6 +144,19 @@ LightManager::~LightManager()
 {
 }
 
+/* Light Tree Lookup */
+
+struct LightTreeLookup {
+	int object;
+	int prim;
+	int index;
+
+	bool operator<(const LightTreeLookup& other) const
+	{
+		return (object < other.object) || (object == other.object && prim < other.prim);
+	}
+};
+
 void LightManager::device_update_distribution(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress)
 {
 	progress.set_status("Updating Lights", "Computing distribution");
@@ -201,6 +216,11 @@ void LightManager::device_update_distribution(Device *device, DeviceScene *dscen
 	size_t offset = 0;
 	int j = 0;
 
+	vector<LightTreeEmitter> emitters;
+	bool use_motion = false;
+
+	emitters.reserve(num_triangles);
+
 	foreach(Object *object, scene->objects) {
 		Mesh *mesh = object->mesh;
 		bool have_emission = false;
@@ -244,6 +264,9 @@ void LightManager::device_update_distribution(Device *device, DeviceScene *dscen
 				use_light_visibility = true;
 			}
 
+			if(object->use_motion)
+				use_motion = true;
+
 			for(size_t i = 0; i < mesh->triangles.size(); i++) {
 				Shader *shader = scene->shaders[mesh->shader[i]];
 
@@ -252,7 +275,6 @@ void LightManager::device_update_distribution(Device *device, DeviceScene *dscen
 					distribution[offset].y = __int_as_float(i + mesh->tri_offset);
 					distribution[offset].z = __int_as_float(shader_id);
 					distribution[offset].w = __int_as_float(object_id);
-					offset++;
 
 					Mesh::Triangle t = mesh->triangles[i];
 					float3 p1 = mesh->verts[t.v[0]];
@@ -265,7 +287,24 @@ void LightManager::device_update_distribution(Device *device, DeviceScene *dscen
 						p3 = transform_point(&tfm, p3);
 					}
 
-					totarea += triangle_area(p1, p2, p3);
+					float area = triangle_area(p1, p2, p3);
+					totarea += area;
+
+					/* light tree emitter */
+					LightTreeEmitter emitter;
+
+					emitter.bounds = BoundBox::empty;
+					emitter.bounds.grow(p1);
+					emitter.bounds.grow(p2);
+					emitter.bounds.grow(p3);
+					emitter.centroid = (p1 + p2 + p3)*(1.0f/3.0f);
+					emitter.N = cross(p2 - p1, p3 - p1);
+					emitter.N = (area > 0.0f)? normalize(emitter.N): make_float3(0.0f, 0.0f, 1.0f);
+					emitter.area = area;
+					emitter.entry = distribution[offset];
+
+					emitters.push_back(emitter);
+					offset++;
 				}
 			}
 
@@ -311,6 +350,49 @@ void LightManager::device_update_distribution(Device *device, DeviceScene *dscen
 
 	float trianglearea = totarea;
 
+	/* light tree over emissive triangles, the distribution entries are
+	 * reordered to match its leaves, which keeps the CDF valid */
+	size_t num_light_tree_emitters = 0;
+
+	dscene->light_tree_nodes.clear();
+	dscene->light_tree_lookup.clear();
+
+	if(emitters.size() && trianglearea > 0.0f) {
+		/* emitter normals are not known for moving objects */
+		LightTree tree(emitters, !use_motion);
+		float area = 0.0f;
+
+		for(size_t i = 0; i < emitters.size(); i++) {
+			distribution[i] = emitters[i].entry;
+			distribution[i].x = area;
+			area += emitters[i].area;
+		}
+
+		/* lookup table to find an emitter from object and primitive, sorted
+		 * so the kernel can do a binary search */
+		vector<LightTreeLookup> lookup(emitters.size());
+
+		for(size_t i = 0; i < emitters.size(); i++) {
+			int object_id = __float_as_int(emitters[i].entry.w);
+
+			lookup[i].object = (object_id < 0)? ~object_id: object_id;
+			lookup[i].prim = __float_as_int(emitters[i].entry.y);
+			lookup[i].index = i;
+		}
+
+		sort(lookup.begin(), lookup.end());
+
+		float4 *lookup_data = dscene->light_tree_lookup.resize(lookup.size());
+
+		for(size_t i = 0; i < lookup.size(); i++) {
+			lookup_data[i] = make_float4(__int_as_float(lookup[i].object),
+				__int_as_float(lookup[i].prim), __int_as_float(lookup[i].index), 0.0f);
+		}
+
+		dscene->light_tree_nodes.copy(&tree.nodes[0], tree.nodes.size());
+		num_light_tree_emitters = emitters.size();
+	}
+
 	/* point lights */
 	float lightarea = (totarea > 0.0f)? totarea/scene->lights.size(): 1.0f;
 	bool use_lamp_mis = false;
@@ -377,6 +459,11 @@ void LightManager::device_update_distribution(Device *device, DeviceScene *dscen
 
 		kintegrator->use_lamp_mis = use_lamp_mis;
 
+		/* light tree, picks triangles with the same probability as the CDF */
+		kintegrator->use_light_tree = (num_light_tree_emitters != 0);
+		kintegrator->num_light_tree_emitters = num_light_tree_emitters;
+		kintegrator->pdf_light_tree = (num_lights)? 0.5f: 1.0f;
+
 		/* bit of an ugly hack to compensate for emitting triangles influencing
 		 * amount of samples we get for this pass */
 		kfilm->pass_shadow_scale = 1.0f;
@@ -389,9 +476,16 @@ void LightManager::device_update_distribution(Device *device, DeviceScene *dscen
 
 		/* CDF */
 		device->tex_alloc("__light_distribution", dscene->light_distribution);
+
+		if(kintegrator->use_light_tree) {
+			device->tex_alloc("__light_tree_nodes", dscene->light_tree_nodes);
+			device->tex_alloc("__light_tree_lookup", dscene->light_tree_lookup);
+		}
 	}
 	else {
 		dscene->light_distribution.clear();
+		dscene->light_tree_nodes.clear();
+		dscene->light_tree_lookup.clear();
 
 		kintegrator->num_distribution = 0;
 		kintegrator->num_all_lights = 0;
@@ -399,6 +493,9 @@ void LightManager::device_update_distribution(Device *device, DeviceScene *dscen
 		kintegrator->pdf_lights = 0.0f;
 		kintegrator->inv_pdf_lights = 0.0f;
 		kintegrator->use_lamp_mis = false;
+		kintegrator->use_light_tree = false;
+		kintegrator->num_light_tree_emitters = 0;
+		kintegrator->pdf_light_tree = 0.0f;
 		kfilm->pass_shadow_scale = 1.0f;
 	}
 }
@@ -643,11 +740,15 @@ void LightManager::device_free(Device *device, DeviceScene *dscene)
 	device->tex_free(dscene->light_data);
 	device->tex_free(dscene->light_background_marginal_cdf);
 	device->tex_free(dscene->light_background_conditional_cdf);
+	device->tex_free(dscene->light_tree_nodes);
+	device->tex_free(dscene->light_tree_lookup);
 
 	dscene->light_distribution.clear();
 	dscene->light_data.clear();
 	dscene->light_background_marginal_cdf.clear();
 	dscene->light_background_conditional_cdf.clear();
+	dscene->light_tree_nodes.clear();
+	dscene->light_tree_lookup.clear();
 }
 
 void LightManager::tag_update(Scene *scene)
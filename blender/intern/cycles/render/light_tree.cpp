@@ -0,0 +1,166 @@
+/*
+ * Copyright 2011, Blender Foundation.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "light_tree.h"
+
+#include "kernel_types.h"
+
+#include "util_algorithm.h"
+#include "util_math.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* maximum number of emitters in a leaf, these are picked by area */
+#define LIGHT_TREE_LEAF_SIZE 4
+
+class LightTreeCentroidCompare {
+public:
+	int axis;
+
+	LightTreeCentroidCompare(int axis_) : axis(axis_) {}
+
+	bool operator()(const LightTreeEmitter& a, const LightTreeEmitter& b) const
+	{
+		const float *ca = &a.centroid.x;
+		const float *cb = &b.centroid.x;
+
+		return ca[axis] < cb[axis];
+	}
+};
+
+LightTree::LightTree(vector<LightTreeEmitter>& emitters_, bool use_orientation_)
+: emitters(emitters_), use_orientation(use_orientation_)
+{
+	if(emitters.size() == 0)
+		return;
+
+	BoundBox bounds;
+	Cone cone;
+	float area;
+
+	nodes.reserve(2*(emitters.size()/LIGHT_TREE_LEAF_SIZE + 1)*LIGHT_TREE_NODE_SIZE);
+	build(0, emitters.size(), bounds, cone, area);
+}
+
+void LightTree::merge_cone(Cone& cone, const Cone& other)
+{
+	/* normals are lines for two sided emission, flip into the same hemisphere */
+	float3 axis = other.axis;
+
+	if(dot(cone.axis, axis) < 0.0f)
+		axis = -axis;
+
+	float theta_d = acosf(clamp(dot(cone.axis, axis), -1.0f, 1.0f));
+
+	/* one cone contains the other */
+	if(theta_d + other.theta <= cone.theta)
+		return;
+	if(theta_d + cone.theta <= other.theta) {
+		cone.axis = axis;
+		cone.theta = other.theta;
+		return;
+	}
+
+	float theta_o = 0.5f*(cone.theta + theta_d + other.theta);
+
+	if(theta_o >= M_PI_2_F) {
+		cone.theta = M_PI_2_F;
+		return;
+	}
+
+	/* rotate axis towards the other one */
+	float theta_r = theta_o - cone.theta;
+	float3 ortho = axis - cone.axis*dot(cone.axis, axis);
+	float ortho_len = len(ortho);
+
+	if(ortho_len > 0.0f)
+		cone.axis = normalize(cone.axis*cosf(theta_r) + ortho*(sinf(theta_r)/ortho_len));
+
+	cone.theta = theta_o;
+}
+
+int LightTree::build(int start, int end, BoundBox& bounds, Cone& cone, float& area)
+{
+	int node = nodes.size()/LIGHT_TREE_NODE_SIZE;
+	int right = 0;
+
+	nodes.resize(nodes.size() + LIGHT_TREE_NODE_SIZE);
+
+	/* bounds */
+	BoundBox centroid_bounds = BoundBox::empty;
+	bounds = BoundBox::empty;
+
+	for(int i = start; i < end; i++) {
+		bounds.grow(emitters[i].bounds);
+		centroid_bounds.grow(emitters[i].centroid);
+	}
+
+	/* split in the middle along the largest axis, unless all centroids are
+	 * in the same spot and the emitters can't be separated */
+	if(end - start > LIGHT_TREE_LEAF_SIZE) {
+		float3 size = centroid_bounds.size();
+		int axis = (size.x > size.y)? ((size.x > size.z)? 0: 2): ((size.y > size.z)? 1: 2);
+		float axis_size = (&size.x)[axis];
+
+		if(axis_size > 0.0f) {
+			int mid = (start + end)/2;
+
+			nth_element(emitters.begin() + start, emitters.begin() + mid,
+				emitters.begin() + end, LightTreeCentroidCompare(axis));
+
+			BoundBox left_bounds, right_bounds;
+			Cone right_cone;
+			float left_area, right_area;
+
+			build(start, mid, left_bounds, cone, left_area);
+			right = build(mid, end, right_bounds, right_cone, right_area);
+
+			merge_cone(cone, right_cone);
+			area = left_area + right_area;
+		}
+	}
+
+	if(right == 0) {
+		/* leaf */
+		cone.axis = emitters[start].N;
+		cone.theta = 0.0f;
+		area = 0.0f;
+
+		for(int i = start; i < end; i++) {
+			Cone emitter_cone;
+			emitter_cone.axis = emitters[i].N;
+			emitter_cone.theta = 0.0f;
+
+			merge_cone(cone, emitter_cone);
+			area += emitters[i].area;
+		}
+	}
+
+	/* cos(theta) of the normal bounds, 0 disables the orientation test */
+	float cos_theta = (use_orientation)? cosf(cone.theta): 0.0f;
+
+	nodes[node*LIGHT_TREE_NODE_SIZE + 0] = make_float4(bounds.min.x, bounds.min.y, bounds.min.z, area);
+	nodes[node*LIGHT_TREE_NODE_SIZE + 1] = make_float4(bounds.max.x, bounds.max.y, bounds.max.z, __int_as_float(right));
+	nodes[node*LIGHT_TREE_NODE_SIZE + 2] = make_float4(__int_as_float(start), __int_as_float(end - start), 0.0f, 0.0f);
+	nodes[node*LIGHT_TREE_NODE_SIZE + 3] = make_float4(cone.axis.x, cone.axis.y, cone.axis.z, cos_theta);
+
+	return node;
+}
+
+CCL_NAMESPACE_END
+
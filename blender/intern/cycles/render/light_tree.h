@@ -0,0 +1,79 @@
+/*
+ * Copyright 2011, Blender Foundation.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __LIGHT_TREE_H__
+#define __LIGHT_TREE_H__
+
+#include "util_boundbox.h"
+#include "util_types.h"
+#include "util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Light Tree Emitter
+ *
+ * Emissive triangle in world space, with the light distribution entry it was
+ * created from. */
+
+class LightTreeEmitter {
+public:
+	BoundBox bounds;
+	float3 centroid;
+	float3 N;
+	float area;
+
+	/* light distribution entry */
+	float4 entry;
+};
+
+/* Light Tree
+ *
+ * Bounding volume hierarchy over emissive triangles, so the kernel can pick
+ * them proportional to an estimate of their contribution at the shading
+ * point, rather than by area alone. Each node stores its bounds, the total
+ * emitter area and a cone bounding the emitter normals. Emission is two sided,
+ * so normals are treated as lines and the cone never exceeds a hemisphere.
+ *
+ * Nodes are packed depth first, the left child directly follows its parent.
+ * Leaves reference a range of emitters, which are reordered to match the
+ * leaf order. */
+
+class LightTree {
+public:
+	LightTree(vector<LightTreeEmitter>& emitters, bool use_orientation);
+
+	/* packed nodes, LIGHT_TREE_NODE_SIZE float4 per node */
+	vector<float4> nodes;
+
+protected:
+	struct Cone {
+		float3 axis;
+		float theta;
+	};
+
+	int build(int start, int end, BoundBox& bounds, Cone& cone, float& area);
+	void merge_cone(Cone& cone, const Cone& other);
+
+	vector<LightTreeEmitter>& emitters;
+	bool use_orientation;
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __LIGHT_TREE_H__ */
+
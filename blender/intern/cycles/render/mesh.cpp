@@ -390,6 +390,7 @@ void Mesh::compute_bvh(SceneParams *params, Progress *progress, int n, int total
 			bparams.use_cache = params->use_bvh_cache;
 			bparams.use_spatial_split = params->use_bvh_spatial_split;
 			bparams.use_qbvh = params->use_qbvh;
+			bparams.use_compact = params->use_bvh_compact;
 
 			delete bvh;
 			bvh = BVH::create(bparams, objects);
@@ -444,6 +445,13 @@ void MeshManager::update_osl_attributes(Device *device, Scene *scene, vector<Att
 
 	og->attribute_map.resize(scene->objects.size()*ATTR_PRIM_TYPES);
 
+	/* mesh index lookup, instead of searching the mesh array for each of
+	 * possibly many instances */
+	map<Mesh*, size_t> mesh_index;
+
+	for(size_t j = 0; j < scene->meshes.size(); j++)
+		mesh_index[scene->meshes[j]] = j;
+
 	for(size_t i = 0; i < scene->objects.size(); i++) {
 		/* set object name to object index map */
 		Object *object = scene->objects[i];
@@ -463,13 +471,7 @@ void MeshManager::update_osl_attributes(Device *device, Scene *scene, vector<Att
 		}
 
 		/* find mesh attributes */
-		size_t j;
-
-		for(j = 0; j < scene->meshes.size(); j++)
-			if(scene->meshes[j] == object->mesh)
-				break;
-
-		AttributeRequestSet& attributes = mesh_attributes[j];
+		AttributeRequestSet& attributes = mesh_attributes[mesh_index[object->mesh]];
 
 		/* set object attributes */
 		foreach(AttributeRequest& req, attributes.requests) {
@@ -533,24 +535,16 @@ void MeshManager::update_svm_attributes(Device *device, DeviceScene *dscene, Sce
 	if(attr_map_stride == 0)
 		return;
 	
-	/* create attribute map */
-	uint4 *attr_map = dscene->attributes_map.resize(attr_map_stride*scene->objects.size());
+	/* create attribute map, one per mesh and shared by all objects that
+	 * instance it, the object data stores the mesh index */
+	uint4 *attr_map = dscene->attributes_map.resize(attr_map_stride*scene->meshes.size());
 	memset(attr_map, 0, dscene->attributes_map.size()*sizeof(uint));
 
-	for(size_t i = 0; i < scene->objects.size(); i++) {
-		Object *object = scene->objects[i];
-		Mesh *mesh = object->mesh;
-
-		/* find mesh attributes */
-		size_t j;
-
-		for(j = 0; j < scene->meshes.size(); j++)
-			if(scene->meshes[j] == mesh)
-				break;
-
-		AttributeRequestSet& attributes = mesh_attributes[j];
+	for(size_t i = 0; i < scene->meshes.size(); i++) {
+		Mesh *mesh = scene->meshes[i];
+		AttributeRequestSet& attributes = mesh_attributes[i];
 
-		/* set object attributes */
+		/* set mesh attributes */
 		int index = i*attr_map_stride;
 
 		foreach(AttributeRequest& req, attributes.requests) {
@@ -663,14 +657,13 @@ static void update_attribute_element_offset(Mesh *mesh, vector<float>& attr_floa
 	}
 }
 
-void MeshManager::device_update_attributes(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress)
+static void mesh_request_attributes(Scene *scene, vector<AttributeRequestSet>& mesh_attributes)
 {
-	progress.set_status("Updating Mesh", "Computing attributes");
-
 	/* gather per mesh requested attributes. as meshes may have multiple
 	 * shaders assigned, this merges the requested attributes that have
 	 * been set per shader by the shader manager */
-	vector<AttributeRequestSet> mesh_attributes(scene->meshes.size());
+	mesh_attributes.clear();
+	mesh_attributes.resize(scene->meshes.size());
 
 	for(size_t i = 0; i < scene->meshes.size(); i++) {
 		Mesh *mesh = scene->meshes[i];
@@ -682,6 +675,14 @@ void MeshManager::device_update_attributes(Device *device, DeviceScene *dscene,
 			mesh_attributes[i].add(shader->attributes);
 		}
 	}
+}
+
+void MeshManager::device_update_attributes(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress)
+{
+	progress.set_status("Updating Mesh", "Computing attributes");
+
+	vector<AttributeRequestSet> mesh_attributes;
+	mesh_request_attributes(scene, mesh_attributes);
 
 	/* mesh attribute are stored in a single array per data type. here we fill
 	 * those arrays, and set the offset and element type to create attribute
@@ -748,6 +749,9 @@ void MeshManager::device_update_mesh(Device *device, DeviceScene *dscene, Scene
 	size_t curve_key_size = 0;
 	size_t curve_size = 0;
 
+	vector<size_t> mesh_sizes;
+	mesh_sizes.reserve(scene->meshes.size()*4);
+
 	foreach(Mesh *mesh, scene->meshes) {
 		mesh->vert_offset = vert_size;
 		mesh->tri_offset = tri_size;
@@ -760,6 +764,32 @@ void MeshManager::device_update_mesh(Device *device, DeviceScene *dscene, Scene
 
 		curve_key_size += mesh->curve_keys.size();
 		curve_size += mesh->curves.size();
+
+		mesh_sizes.push_back(mesh->verts.size());
+		mesh_sizes.push_back(mesh->triangles.size());
+		mesh_sizes.push_back(mesh->curve_keys.size());
+		mesh_sizes.push_back(mesh->curves.size());
+	}
+
+	/* if no meshes were added, removed or resized, all offsets are the same
+	 * as before and only modified meshes need to be packed again */
+	bool pack_all = (packed_meshes != scene->meshes || packed_sizes != mesh_sizes);
+
+	/* forget the layout until packing is done, a cancelled update leaves the
+	 * arrays partially packed */
+	packed_meshes.clear();
+	packed_sizes.clear();
+
+	if(pack_all) {
+		device_free_mesh(device, dscene);
+	}
+	else {
+		device->tex_free(dscene->tri_normal);
+		device->tex_free(dscene->tri_vnormal);
+		device->tex_free(dscene->tri_vindex);
+		device->tex_free(dscene->tri_verts);
+		device->tex_free(dscene->curves);
+		device->tex_free(dscene->curve_keys);
 	}
 
 	if(tri_size != 0) {
@@ -771,13 +801,21 @@ void MeshManager::device_update_mesh(Device *device, DeviceScene *dscene, Scene
 		float4 *tri_verts = dscene->tri_verts.resize(vert_size);
 		float4 *tri_vindex = dscene->tri_vindex.resize(tri_size);
 
-		foreach(Mesh *mesh, scene->meshes) {
-			mesh->pack_normals(scene, &normal[mesh->tri_offset], &vnormal[mesh->vert_offset]);
-			mesh->pack_verts(&tri_verts[mesh->vert_offset], &tri_vindex[mesh->tri_offset], mesh->vert_offset);
+		TaskPool pool;
 
-			if(progress.get_cancel()) return;
+		foreach(Mesh *mesh, scene->meshes) {
+			if(pack_all || mesh->need_update) {
+				pool.push(function_bind(&Mesh::pack_normals, mesh, scene,
+					&normal[mesh->tri_offset], &vnormal[mesh->vert_offset]));
+				pool.push(function_bind(&Mesh::pack_verts, mesh,
+					&tri_verts[mesh->vert_offset], &tri_vindex[mesh->tri_offset], mesh->vert_offset));
+			}
 		}
 
+		pool.wait_work();
+
+		if(progress.get_cancel()) return;
+
 		/* vertex coordinates */
 		progress.set_status("Updating Mesh", "Copying Mesh to device");
 
@@ -793,30 +831,50 @@ void MeshManager::device_update_mesh(Device *device, DeviceScene *dscene, Scene
 		float4 *curve_keys = dscene->curve_keys.resize(curve_key_size);
 		float4 *curves = dscene->curves.resize(curve_size);
 
+		TaskPool pool;
+
 		foreach(Mesh *mesh, scene->meshes) {
-			mesh->pack_curves(scene, &curve_keys[mesh->curvekey_offset], &curves[mesh->curve_offset], mesh->curvekey_offset);
-			if(progress.get_cancel()) return;
+			if(pack_all || mesh->need_update) {
+				pool.push(function_bind(&Mesh::pack_curves, mesh, scene,
+					&curve_keys[mesh->curvekey_offset], &curves[mesh->curve_offset], mesh->curvekey_offset));
+			}
 		}
 
+		pool.wait_work();
+
+		if(progress.get_cancel()) return;
+
 		device->tex_alloc("__curve_keys", dscene->curve_keys);
 		device->tex_alloc("__curves", dscene->curves);
 	}
+
+	packed_meshes = scene->meshes;
+	packed_sizes = mesh_sizes;
 }
 
-void MeshManager::device_update_bvh(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress)
+void MeshManager::device_update_bvh(Device *device, DeviceScene *dscene, Scene *scene, bool refit, Progress& progress)
 {
-	/* bvh build */
-	progress.set_status("Updating Scene BVH", "Building");
+	if(refit) {
+		/* bvh refit, only object bounds changed */
+		progress.set_status("Updating Scene BVH", "Refitting");
 
-	BVHParams bparams;
-	bparams.top_level = true;
-	bparams.use_qbvh = scene->params.use_qbvh;
-	bparams.use_spatial_split = scene->params.use_bvh_spatial_split;
-	bparams.use_cache = scene->params.use_bvh_cache;
-
-	delete bvh;
-	bvh = BVH::create(bparams, scene->objects);
-	bvh->build(progress);
+		bvh->refit(progress);
+	}
+	else {
+		/* bvh build */
+		progress.set_status("Updating Scene BVH", "Building");
+
+		BVHParams bparams;
+		bparams.top_level = true;
+		bparams.use_qbvh = scene->params.use_qbvh;
+		bparams.use_compact = scene->params.use_bvh_compact;
+		bparams.use_spatial_split = scene->params.use_bvh_spatial_split;
+		bparams.use_cache = scene->params.use_bvh_cache;
+
+		delete bvh;
+		bvh = BVH::create(bparams, scene->objects);
+		bvh->build(progress);
+	}
 
 	if(progress.get_cancel()) return;
 
@@ -855,6 +913,23 @@ void MeshManager::device_update_bvh(Device *device, DeviceScene *dscene, Scene *
 	}
 
 	dscene->data.bvh.root = pack.root_index;
+	dscene->data.bvh.use_qbvh = scene->params.use_qbvh;
+	dscene->data.bvh.use_compact = scene->params.use_bvh_compact;
+
+	/* memory use of the BVH arrays, for the render stats */
+	device->stats.mem_array("__bvh_nodes", dscene->bvh_nodes.memory_size());
+	device->stats.mem_array("__object_node", dscene->object_node.memory_size());
+	device->stats.mem_array("__tri_woop", dscene->tri_woop.memory_size());
+	device->stats.mem_array("__prim_segment", dscene->prim_segment.memory_size());
+	device->stats.mem_array("__prim_visibility", dscene->prim_visibility.memory_size());
+	device->stats.mem_array("__prim_index", dscene->prim_index.memory_size());
+	device->stats.mem_array("__prim_object", dscene->prim_object.memory_size());
+}
+
+static void mesh_compute_normals(Mesh *mesh)
+{
+	mesh->add_face_normals();
+	mesh->add_vertex_normals();
 }
 
 void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress)
@@ -863,69 +938,97 @@ void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scen
 		return;
 
 	/* update normals */
+	bool meshes_modified = false;
+	TaskPool pool;
+
 	foreach(Mesh *mesh, scene->meshes) {
 		foreach(uint shader, mesh->used_shaders)
 			if(scene->shaders[shader]->need_update_attributes)
 				mesh->need_update = true;
 
 		if(mesh->need_update) {
-			mesh->add_face_normals();
-			mesh->add_vertex_normals();
-
-			if(progress.get_cancel()) return;
+			pool.push(function_bind(&mesh_compute_normals, mesh));
+			meshes_modified = true;
 		}
 	}
 
-	/* device update */
-	device_free(device, dscene);
+	pool.wait_work();
 
-	device_update_mesh(device, dscene, scene, progress);
 	if(progress.get_cancel()) return;
 
-	device_update_attributes(device, dscene, scene, progress);
-	if(progress.get_cancel()) return;
+	/* when only object transforms changed, mesh and attribute data on the
+	 * device are still valid, and the scene BVH only needs new bounds */
+	vector<AttributeRequestSet> mesh_attributes;
+	mesh_request_attributes(scene, mesh_attributes);
 
-	/* update displacement */
-	bool displacement_done = false;
+	vector<Mesh*> object_meshes;
+	foreach(Object *object, scene->objects)
+		object_meshes.push_back(object->mesh);
 
-	foreach(Mesh *mesh, scene->meshes)
-		if(mesh->need_update && displace(device, dscene, scene, mesh, progress))
-			displacement_done = true;
+	bool transform_only = !meshes_modified && bvh &&
+		packed_meshes == scene->meshes &&
+		bvh->objects == scene->objects &&
+		packed_object_meshes == object_meshes &&
+		packed_attributes.size() == mesh_attributes.size();
 
-	/* todo: properly handle cancel halfway displacement */
-	if(progress.get_cancel()) return;
+	for(size_t i = 0; transform_only && i < mesh_attributes.size(); i++)
+		if(packed_attributes[i].modified(mesh_attributes[i]))
+			transform_only = false;
+
+	device_free_bvh(device, dscene);
 
-	/* device re-update after displacement */
-	if(displacement_done) {
-		device_free(device, dscene);
+	if(!transform_only) {
+		/* device update */
+		device_free_attributes(device, dscene);
+		packed_object_meshes.clear();
+		packed_attributes.clear();
 
 		device_update_mesh(device, dscene, scene, progress);
 		if(progress.get_cancel()) return;
 
 		device_update_attributes(device, dscene, scene, progress);
 		if(progress.get_cancel()) return;
-	}
 
-	/* update bvh */
-	size_t i = 0, num_bvh = 0;
+		/* update displacement */
+		bool displacement_done = false;
 
-	foreach(Mesh *mesh, scene->meshes)
-		if(mesh->need_update && !mesh->transform_applied)
-			num_bvh++;
+		foreach(Mesh *mesh, scene->meshes)
+			if(mesh->need_update && displace(device, dscene, scene, mesh, progress))
+				displacement_done = true;
 
-	TaskPool pool;
+		/* todo: properly handle cancel halfway displacement */
+		if(progress.get_cancel()) return;
 
-	foreach(Mesh *mesh, scene->meshes) {
-		if(mesh->need_update) {
-			pool.push(function_bind(&Mesh::compute_bvh, mesh, &scene->params, &progress, i, num_bvh));
-			i++;
+		/* device re-update after displacement */
+		if(displacement_done) {
+			device_free_attributes(device, dscene);
+
+			device_update_mesh(device, dscene, scene, progress);
+			if(progress.get_cancel()) return;
+
+			device_update_attributes(device, dscene, scene, progress);
+			if(progress.get_cancel()) return;
 		}
-	}
 
-	pool.wait_work();
-	
-	foreach(Shader *shader, scene->shaders)
-		shader->need_update_attributes = false;
+		/* update bvh */
+		size_t i = 0, num_bvh = 0;
+
+		foreach(Mesh *mesh, scene->meshes)
+			if(mesh->need_update && !mesh->transform_applied)
+				num_bvh++;
+
+		foreach(Mesh *mesh, scene->meshes) {
+			if(mesh->need_update) {
+				pool.push(function_bind(&Mesh::compute_bvh, mesh, &scene->params, &progress, i, num_bvh));
+				i++;
+			}
+		}
+
+		pool.wait_work();
+		
+		foreach(Shader *shader, scene->shaders)
+			shader->need_update_attributes = false;
+	}
 
 	float shuttertime = scene->camera->shuttertime;
 #ifdef __OBJECT_MOTION__
@@ -940,43 +1043,45 @@ void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scen
 
 	if(progress.get_cancel()) return;
 
-	device_update_bvh(device, dscene, scene, progress);
+	/* refit only for dynamic BVH, static BVH builds favor quality */
+	bool refit = transform_only && scene->params.bvh_type == SceneParams::BVH_DYNAMIC;
+
+	device_update_bvh(device, dscene, scene, refit, progress);
+
+	if(progress.get_cancel()) return;
+
+	packed_object_meshes = object_meshes;
+	packed_attributes = mesh_attributes;
 
 	need_update = false;
 }
 
-void MeshManager::device_free(Device *device, DeviceScene *dscene)
+void MeshManager::device_free_mesh(Device *device, DeviceScene *dscene)
 {
-	device->tex_free(dscene->bvh_nodes);
-	device->tex_free(dscene->object_node);
-	device->tex_free(dscene->tri_woop);
-	device->tex_free(dscene->prim_segment);
-	device->tex_free(dscene->prim_visibility);
-	device->tex_free(dscene->prim_index);
-	device->tex_free(dscene->prim_object);
 	device->tex_free(dscene->tri_normal);
 	device->tex_free(dscene->tri_vnormal);
 	device->tex_free(dscene->tri_vindex);
 	device->tex_free(dscene->tri_verts);
 	device->tex_free(dscene->curves);
 	device->tex_free(dscene->curve_keys);
-	device->tex_free(dscene->attributes_map);
-	device->tex_free(dscene->attributes_float);
-	device->tex_free(dscene->attributes_float3);
 
-	dscene->bvh_nodes.clear();
-	dscene->object_node.clear();
-	dscene->tri_woop.clear();
-	dscene->prim_segment.clear();
-	dscene->prim_visibility.clear();
-	dscene->prim_index.clear();
-	dscene->prim_object.clear();
 	dscene->tri_normal.clear();
 	dscene->tri_vnormal.clear();
 	dscene->tri_vindex.clear();
 	dscene->tri_verts.clear();
 	dscene->curves.clear();
 	dscene->curve_keys.clear();
+
+	packed_meshes.clear();
+	packed_sizes.clear();
+}
+
+void MeshManager::device_free_attributes(Device *device, DeviceScene *dscene)
+{
+	device->tex_free(dscene->attributes_map);
+	device->tex_free(dscene->attributes_float);
+	device->tex_free(dscene->attributes_float3);
+
 	dscene->attributes_map.clear();
 	dscene->attributes_float.clear();
 	dscene->attributes_float3.clear();
@@ -992,6 +1097,35 @@ void MeshManager::device_free(Device *device, DeviceScene *dscene)
 #endif
 }
 
+void MeshManager::device_free_bvh(Device *device, DeviceScene *dscene)
+{
+	device->tex_free(dscene->bvh_nodes);
+	device->tex_free(dscene->object_node);
+	device->tex_free(dscene->tri_woop);
+	device->tex_free(dscene->prim_segment);
+	device->tex_free(dscene->prim_visibility);
+	device->tex_free(dscene->prim_index);
+	device->tex_free(dscene->prim_object);
+
+	dscene->bvh_nodes.clear();
+	dscene->object_node.clear();
+	dscene->tri_woop.clear();
+	dscene->prim_segment.clear();
+	dscene->prim_visibility.clear();
+	dscene->prim_index.clear();
+	dscene->prim_object.clear();
+}
+
+void MeshManager::device_free(Device *device, DeviceScene *dscene)
+{
+	device_free_bvh(device, dscene);
+	device_free_mesh(device, dscene);
+	device_free_attributes(device, dscene);
+
+	packed_object_meshes.clear();
+	packed_attributes.clear();
+}
+
 void MeshManager::tag_update(Scene *scene)
 {
 	need_update = true;
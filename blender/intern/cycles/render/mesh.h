@@ -150,10 +150,23 @@ public:
 	void device_update_object(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress);
 	void device_update_mesh(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress);
 	void device_update_attributes(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress);
-	void device_update_bvh(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress);
+	void device_update_bvh(Device *device, DeviceScene *dscene, Scene *scene, bool refit, Progress& progress);
 	void device_free(Device *device, DeviceScene *dscene);
 
 	void tag_update(Scene *scene);
+
+protected:
+	void device_free_mesh(Device *device, DeviceScene *dscene);
+	void device_free_attributes(Device *device, DeviceScene *dscene);
+	void device_free_bvh(Device *device, DeviceScene *dscene);
+
+	/* layout of the packed mesh arrays and scene BVH at the last update. if
+	 * it did not change, only modified meshes are packed again, and when only
+	 * object transforms changed the scene BVH can be refit */
+	vector<Mesh*> packed_meshes;
+	vector<size_t> packed_sizes;
+	vector<Mesh*> packed_object_meshes;
+	vector<AttributeRequestSet> packed_attributes;
 };
 
 CCL_NAMESPACE_END
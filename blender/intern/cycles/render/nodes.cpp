@@ -200,13 +200,23 @@ void ImageTextureNode::compile(SVMCompiler& compiler)
 		}
 
 		if(projection == "Flat") {
+			/* UV map for texture cache mipmap selection, derivatives of other
+			 * coordinates are not known and use the full resolution */
+			ShaderOutput *vector_link = vector_in->link;
+			uint uv_id = ATTR_STD_NOT_FOUND;
+
+			if(tex_mapping.skip() && vector_link && vector_link->parent->name == ustring("texture_coordinate") &&
+			   vector_link == vector_link->parent->output("UV") && !((TextureCoordinateNode*)vector_link->parent)->from_dupli)
+				uv_id = compiler.attribute(ATTR_STD_UV);
+
 			compiler.add_node(NODE_TEX_IMAGE,
 				slot,
 				compiler.encode_uchar4(
 					vector_offset,
 					color_out->stack_offset,
 					alpha_out->stack_offset,
-					srgb));
+					srgb),
+				uv_id);
 		}
 		else {
 			compiler.add_node(NODE_TEX_IMAGE_BOX,
@@ -1631,6 +1641,7 @@ EmissionNode::EmissionNode()
 	add_input("Color", SHADER_SOCKET_COLOR, make_float3(0.8f, 0.8f, 0.8f));
 	add_input("Strength", SHADER_SOCKET_FLOAT, 10.0f);
 	add_input("SurfaceMixWeight", SHADER_SOCKET_FLOAT, 0.0f, ShaderInput::USE_SVM);
+	add_input("VolumeMixWeight", SHADER_SOCKET_FLOAT, 0.0f, ShaderInput::USE_SVM);
 
 	add_output("Emission", SHADER_SOCKET_CLOSURE);
 }
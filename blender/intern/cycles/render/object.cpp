@@ -154,6 +154,7 @@ void ObjectManager::device_update_transforms(Device *device, DeviceScene *dscene
 	float4 *objects_vector = NULL;
 	int i = 0;
 	map<Mesh*, float> surface_area_map;
+	map<Mesh*, uint> mesh_index;
 	Scene::MotionType need_motion = scene->need_motion(device->info.advanced_shading);
 	bool have_motion = false;
 	bool have_curves = false;
@@ -162,6 +163,10 @@ void ObjectManager::device_update_transforms(Device *device, DeviceScene *dscene
 	if(need_motion == Scene::MOTION_PASS)
 		objects_vector = dscene->objects_vector.resize(OBJECT_VECTOR_SIZE*scene->objects.size());
 
+	/* objects instancing the same mesh share its attribute map */
+	for(size_t j = 0; j < scene->meshes.size(); j++)
+		mesh_index[scene->meshes[j]] = j;
+
 	foreach(Object *ob, scene->objects) {
 		Mesh *mesh = ob->mesh;
 		uint flag = 0;
@@ -178,14 +183,58 @@ void ObjectManager::device_update_transforms(Device *device, DeviceScene *dscene
 		float pass_id = ob->pass_id;
 		float random_number = (float)ob->random_id * (1.0f/(float)0xFFFFFFFF);
 
-		if(transform_uniform_scale(tfm, uniform_scale)) {
-			map<Mesh*, float>::iterator it = surface_area_map.find(mesh);
+		/* surface area is only used to normalize emission, OSL shaders can
+		 * read it though. skip it for instances of meshes without emission,
+		 * which otherwise need a loop over all triangles for every instance
+		 * with non-uniform scale */
+		bool need_surface_area = (scene->params.shadingsystem == SceneParams::OSL);
+
+		foreach(uint sindex, mesh->used_shaders) {
+			Shader *shader = scene->shaders[sindex];
+
+			if(shader->has_surface_emission || shader->has_volume)
+				need_surface_area = true;
+		}
+
+		if(need_surface_area) {
+			if(transform_uniform_scale(tfm, uniform_scale)) {
+				map<Mesh*, float>::iterator it = surface_area_map.find(mesh);
+
+				if(it == surface_area_map.end()) {
+					foreach(Mesh::Triangle& t, mesh->triangles) {
+						float3 p1 = mesh->verts[t.v[0]];
+						float3 p2 = mesh->verts[t.v[1]];
+						float3 p3 = mesh->verts[t.v[2]];
+
+						surface_area += triangle_area(p1, p2, p3);
+					}
+
+					foreach(Mesh::Curve& curve, mesh->curves) {
+						int first_key = curve.first_key;
+
+						for(int i = 0; i < curve.num_segments(); i++) {
+							float3 p1 = mesh->curve_keys[first_key + i].co;
+							float r1 = mesh->curve_keys[first_key + i].radius;
+							float3 p2 = mesh->curve_keys[first_key + i + 1].co;
+							float r2 = mesh->curve_keys[first_key + i + 1].radius;
+
+							/* currently ignores segment overlaps*/
+							surface_area += M_PI_F *(r1 + r2) * len(p1 - p2);
+						}
+					}
+
+					surface_area_map[mesh] = surface_area;
+				}
+				else
+					surface_area = it->second;
 
-			if(it == surface_area_map.end()) {
+				surface_area *= uniform_scale;
+			}
+			else {
 				foreach(Mesh::Triangle& t, mesh->triangles) {
-					float3 p1 = mesh->verts[t.v[0]];
-					float3 p2 = mesh->verts[t.v[1]];
-					float3 p3 = mesh->verts[t.v[2]];
+					float3 p1 = transform_point(&tfm, mesh->verts[t.v[0]]);
+					float3 p2 = transform_point(&tfm, mesh->verts[t.v[1]]);
+					float3 p3 = transform_point(&tfm, mesh->verts[t.v[2]]);
 
 					surface_area += triangle_area(p1, p2, p3);
 				}
@@ -199,42 +248,13 @@ void ObjectManager::device_update_transforms(Device *device, DeviceScene *dscene
 						float3 p2 = mesh->curve_keys[first_key + i + 1].co;
 						float r2 = mesh->curve_keys[first_key + i + 1].radius;
 
+						p1 = transform_point(&tfm, p1);
+						p2 = transform_point(&tfm, p2);
+
 						/* currently ignores segment overlaps*/
 						surface_area += M_PI_F *(r1 + r2) * len(p1 - p2);
 					}
 				}
-
-				surface_area_map[mesh] = surface_area;
-			}
-			else
-				surface_area = it->second;
-
-			surface_area *= uniform_scale;
-		}
-		else {
-			foreach(Mesh::Triangle& t, mesh->triangles) {
-				float3 p1 = transform_point(&tfm, mesh->verts[t.v[0]]);
-				float3 p2 = transform_point(&tfm, mesh->verts[t.v[1]]);
-				float3 p3 = transform_point(&tfm, mesh->verts[t.v[2]]);
-
-				surface_area += triangle_area(p1, p2, p3);
-			}
-
-			foreach(Mesh::Curve& curve, mesh->curves) {
-				int first_key = curve.first_key;
-
-				for(int i = 0; i < curve.num_segments(); i++) {
-					float3 p1 = mesh->curve_keys[first_key + i].co;
-					float r1 = mesh->curve_keys[first_key + i].radius;
-					float3 p2 = mesh->curve_keys[first_key + i + 1].co;
-					float r2 = mesh->curve_keys[first_key + i + 1].radius;
-
-					p1 = transform_point(&tfm, p1);
-					p2 = transform_point(&tfm, p2);
-
-					/* currently ignores segment overlaps*/
-					surface_area += M_PI_F *(r1 + r2) * len(p1 - p2);
-				}
 			}
 		}
 
@@ -275,8 +295,8 @@ void ObjectManager::device_update_transforms(Device *device, DeviceScene *dscene
 #endif
 
 		/* dupli object coords */
-		objects[offset+9] = make_float4(ob->dupli_generated[0], ob->dupli_generated[1], ob->dupli_generated[2], 0.0f);
-		objects[offset+10] = make_float4(ob->dupli_uv[0], ob->dupli_uv[1], 0.0f, 0.0f);
+		objects[offset+9] = make_float4(ob->dupli_generated[0], ob->dupli_generated[1], ob->dupli_generated[2], __uint_as_float(ob->visibility));
+		objects[offset+10] = make_float4(ob->dupli_uv[0], ob->dupli_uv[1], __uint_as_float(mesh_index[mesh]), 0.0f);
 
 		/* object flag */
 		if(ob->use_holdout)
@@ -63,8 +63,13 @@ Scene::Scene(const SceneParams& params_, const DeviceInfo& device_info_)
 	else
 		shader_manager = ShaderManager::create(this, SceneParams::SVM);
 
-	if (device_info_.type == DEVICE_CPU)
+	if (device_info_.type == DEVICE_CPU) {
 		image_manager->set_extended_image_limits();
+
+		/* load image tiles on demand, only supported on the CPU */
+		if(params.texture_cache_size)
+			image_manager->set_texture_cache(params.texture_cache_size);
+	}
 }
 
 Scene::~Scene()
@@ -258,7 +263,10 @@ bool Scene::need_reset()
 void Scene::reset()
 {
 	shader_manager->reset(this);
-	shader_manager->add_default(this);
+
+	/* default shaders are kept along with persistent scene data */
+	if(shaders.size() == 0)
+		shader_manager->add_default(this);
 
 	/* ensure all objects are updated */
 	camera->tag_update();
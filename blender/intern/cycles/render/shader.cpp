@@ -223,10 +223,13 @@ void ShaderManager::device_update_common(Device *device, DeviceScene *dscene, Sc
 
 		if(shader->use_mis)
 			flag |= SD_USE_MIS;
-		if(shader->has_surface_transparent && shader->use_transparent_shadow)
-			flag |= SD_HAS_TRANSPARENT_SHADOW;
 		if(shader->has_volume)
 			flag |= SD_HAS_VOLUME;
+		if(shader->has_volume && !shader->has_surface)
+			flag |= SD_HAS_ONLY_VOLUME;
+		/* volume only surfaces are passed through by shadow rays */
+		if((shader->has_surface_transparent || (flag & SD_HAS_ONLY_VOLUME)) && shader->use_transparent_shadow)
+			flag |= SD_HAS_TRANSPARENT_SHADOW;
 		if(shader->homogeneous_volume)
 			flag |= SD_HOMOGENEOUS_VOLUME;
 		if(shader->has_surface_bssrdf)
@@ -20,6 +20,7 @@
 #include "graph.h"
 #include "light.h"
 #include "mesh.h"
+#include "object.h"
 #include "scene.h"
 #include "shader.h"
 #include "svm.h"
@@ -77,6 +78,8 @@ void SVMShaderManager::device_update(Device *device, DeviceScene *dscene, Scene
 		if(shader->use_mis && shader->has_surface_emission)
 			scene->light_manager->need_update = true;
 
+		bool had_emission = shader->has_surface_emission || shader->has_volume;
+
 		SVMCompiler compiler(scene->shader_manager, scene->image_manager,
 			use_multi_closure);
 		compiler.sunsky = (sunsky_done)? NULL: &dscene->data.sunsky;
@@ -84,6 +87,10 @@ void SVMShaderManager::device_update(Device *device, DeviceScene *dscene, Scene
 		compiler.compile(shader, svm_nodes, i);
 		if(!compiler.sunsky)
 			sunsky_done = true;
+
+		/* object surface areas are only computed for emissive meshes */
+		if(had_emission != (shader->has_surface_emission || shader->has_volume))
+			scene->object_manager->need_update = true;
 	}
 
 	dscene->svm_nodes.copy((uint4*)&svm_nodes[0], svm_nodes.size());
@@ -487,12 +494,14 @@ void SVMCompiler::generate_closure(ShaderNode *node, set<ShaderNode*>& done)
 		stack_clear_users(node, done);
 		stack_clear_temporary(node);
 
-		if(node->has_surface_emission())
-			current_shader->has_surface_emission = true;
-		if(node->has_surface_transparent())
-			current_shader->has_surface_transparent = true;
-		if(node->has_surface_bssrdf())
-			current_shader->has_surface_bssrdf = true;
+		if(current_type == SHADER_TYPE_SURFACE) {
+			if(node->has_surface_emission())
+				current_shader->has_surface_emission = true;
+			if(node->has_surface_transparent())
+				current_shader->has_surface_transparent = true;
+			if(node->has_surface_bssrdf())
+				current_shader->has_surface_bssrdf = true;
+		}
 
 		/* end node is added outside of this */
 	}
@@ -549,12 +558,14 @@ void SVMCompiler::generate_multi_closure(ShaderNode *node, set<ShaderNode*>& don
 
 		mix_weight_offset = SVM_STACK_INVALID;
 
-		if(node->has_surface_emission())
-			current_shader->has_surface_emission = true;
-		if(node->has_surface_transparent())
-			current_shader->has_surface_transparent = true;
-		if(node->has_surface_bssrdf())
-			current_shader->has_surface_bssrdf = true;
+		if(current_type == SHADER_TYPE_SURFACE) {
+			if(node->has_surface_emission())
+				current_shader->has_surface_emission = true;
+			if(node->has_surface_transparent())
+				current_shader->has_surface_transparent = true;
+			if(node->has_surface_bssrdf())
+				current_shader->has_surface_bssrdf = true;
+		}
 	}
 
 	done.insert(node);
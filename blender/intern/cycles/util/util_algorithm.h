@@ -28,6 +28,7 @@ using std::swap;
 using std::max;
 using std::min;
 using std::remove;
+using std::nth_element;
 
 CCL_NAMESPACE_END
 
@@ -174,12 +174,23 @@ __device_inline int float_to_int(float f)
 
 __device_inline int floor_to_int(float f)
 {
+#if defined(__KERNEL_SSE41__) && !defined(_MSC_VER)
+	/* SSE4.1 rounding instruction, avoids the libm call */
+	__m128 v = _mm_load_ss(&f);
+	return _mm_cvtt_ss2si(_mm_floor_ss(v, v));
+#else
 	return float_to_int(floorf(f));
+#endif
 }
 
 __device_inline int ceil_to_int(float f)
 {
+#if defined(__KERNEL_SSE41__) && !defined(_MSC_VER)
+	__m128 v = _mm_load_ss(&f);
+	return _mm_cvtt_ss2si(_mm_ceil_ss(v, v));
+#else
 	return float_to_int(ceilf(f));
+#endif
 }
 
 __device_inline float signf(float f)
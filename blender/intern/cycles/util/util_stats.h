@@ -19,11 +19,16 @@
 #ifndef __UTIL_STATS_H__
 #define __UTIL_STATS_H__
 
+#include "util_map.h"
+#include "util_string.h"
+#include "util_thread.h"
+#include "util_types.h"
+
 CCL_NAMESPACE_BEGIN
 
 class Stats {
 public:
-	Stats() : mem_used(0), mem_peak(0) {}
+	Stats() : mem_used(0), mem_peak(0), num_rays(0) {}
 
 	void mem_alloc(size_t size) {
 		mem_used += size;
@@ -35,8 +40,36 @@ public:
 		mem_used -= size;
 	}
 
+	/* rays are counted by CPU render threads */
+	void add_rays(uint64_t num) {
+		thread_scoped_lock lock(rays_mutex);
+		num_rays += num;
+	}
+
+	/* memory used by individual scene arrays, to report how it is spent */
+	void mem_array(const string& name, size_t size) {
+		if(size)
+			mem_arrays[name] = size;
+		else
+			mem_arrays.erase(name);
+	}
+
+	size_t mem_arrays_total() {
+		size_t total = 0;
+
+		for(map<string, size_t>::iterator it = mem_arrays.begin(); it != mem_arrays.end(); it++)
+			total += it->second;
+
+		return total;
+	}
+
 	size_t mem_used;
 	size_t mem_peak;
+	uint64_t num_rays;
+	map<string, size_t> mem_arrays;
+
+protected:
+	thread_mutex rays_mutex;
 };
 
 CCL_NAMESPACE_END
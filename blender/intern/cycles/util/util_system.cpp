@@ -134,8 +134,26 @@ struct CPUCapabilities {
 	bool xop;
 	bool fma3;
 	bool fma4;
+	bool osxsave;
 };
 
+/* AVX registers also need to be saved by the OS on context switches, which
+ * is reported in the XCR0 register */
+static bool system_cpu_os_support_avx()
+{
+#if defined(_MSC_VER) && (_MSC_FULL_VER >= 160040219)
+	unsigned long long xcr0 = _xgetbv(0);
+	return (xcr0 & 0x6) == 0x6;
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	unsigned int lo, hi;
+	/* xgetbv, as opcode for older assemblers */
+	asm(".byte 0x0f, 0x01, 0xd0" : "=a" (lo), "=d" (hi) : "c" (0));
+	return (lo & 0x6) == 0x6;
+#else
+	return false;
+#endif
+}
+
 static CPUCapabilities& system_cpu_capabilities()
 {
 	static CPUCapabilities caps;
@@ -165,8 +183,12 @@ static CPUCapabilities& system_cpu_capabilities()
 			caps.sse41 = (result[2] & ((int)1 << 19)) != 0;
 			caps.sse42 = (result[2] & ((int)1 << 20)) != 0;
 
+			caps.osxsave = (result[2] & ((int)1 << 27)) != 0;
 			caps.avx = (result[2] & ((int)1 << 28)) != 0;
 			caps.fma3 = (result[2] & ((int)1 << 12)) != 0;
+
+			if(caps.avx && !(caps.osxsave && system_cpu_os_support_avx()))
+				caps.avx = false;
 		}
 
 #if 0
@@ -197,6 +219,18 @@ bool system_cpu_support_sse3()
 	return caps.sse && caps.sse2 && caps.sse3 && caps.ssse3;
 }
 
+bool system_cpu_support_sse41()
+{
+	CPUCapabilities& caps = system_cpu_capabilities();
+	return caps.sse && caps.sse2 && caps.sse3 && caps.ssse3 && caps.sse41;
+}
+
+bool system_cpu_support_avx()
+{
+	CPUCapabilities& caps = system_cpu_capabilities();
+	return caps.sse && caps.sse2 && caps.sse3 && caps.ssse3 && caps.sse41 && caps.avx;
+}
+
 #else
 
 bool system_cpu_support_sse2()
@@ -209,6 +243,16 @@ bool system_cpu_support_sse3()
 	return false;
 }
 
+bool system_cpu_support_sse41()
+{
+	return false;
+}
+
+bool system_cpu_support_avx()
+{
+	return false;
+}
+
 #endif
 
 CCL_NAMESPACE_END
@@ -73,8 +73,8 @@
 #ifndef __KERNEL_SSSE3__
 #define __KERNEL_SSSE3__
 #endif
-#ifndef __KERNEL_SSE4__
-#define __KERNEL_SSE4__
+#ifndef __KERNEL_SSE41__
+#define __KERNEL_SSE41__
 #endif
 #endif
 
@@ -99,6 +99,14 @@
 #include <tmmintrin.h> /* SSSE 3 */
 #endif
 
+#ifdef __KERNEL_SSE41__
+#include <smmintrin.h> /* SSE 4.1 */
+#endif
+
+#ifdef __KERNEL_AVX__
+#include <immintrin.h> /* AVX */
+#endif
+
 #else
 
 /* MinGW64 has conflicting declarations for these SSE headers in <windows.h>.
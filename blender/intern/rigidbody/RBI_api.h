@@ -88,6 +88,9 @@ extern void RB_dworld_set_gravity(rbDynamicsWorld *world, const float g_in[3]);
 extern void RB_dworld_set_solver_iterations(rbDynamicsWorld *world, int num_solver_iterations);
 /* Split Impulse */
 extern void RB_dworld_set_split_impulse(rbDynamicsWorld *world, int split_impulse);
+/* Broadphase */
+/* Defer dynamic/static pair updates to a single collide pass per step */
+extern void RB_dworld_set_broadphase_deferred(rbDynamicsWorld *world, int deferred);
 
 /* Simulation ----------------------- */
 
@@ -207,6 +210,15 @@ void RB_body_get_orientation(rbRigidBody *body, float v_out[4]);
 
 /* ............ */
 
+/* Batch access to world transforms of many bodies at once
+ * - locations are packed as 3 floats and rotations (quaternions) as 4 floats per body
+ * - NULL entries in the body array are skipped, leaving their array slots untouched
+ */
+void RB_bodies_get_loc_rot(rbRigidBody **bodies, int totbody, float *r_loc, float *r_rot);
+void RB_bodies_set_loc_rot(rbRigidBody **bodies, int totbody, const float *loc, const float *rot);
+
+/* ............ */
+
 extern void RB_body_apply_central_force(rbRigidBody *body, const float v_in[3]);
 
 /* ********************************** */
@@ -195,6 +195,16 @@ void RB_dworld_set_split_impulse(rbDynamicsWorld *world, int split_impulse)
 	info.m_splitImpulse = split_impulse;
 }
 
+/* Broadphase */
+void RB_dworld_set_broadphase_deferred(rbDynamicsWorld *world, int deferred)
+{
+	btDbvtBroadphase *broadphase = (btDbvtBroadphase *)world->pairCache;
+	
+	/* collide dynamic against static tree once per step in the collide call,
+	 * instead of once per moved proxy, which is cheaper for many moving bodies */
+	broadphase->m_deferedcollide = (deferred != 0);
+}
+
 /* Simulation ----------------------- */
 
 void RB_dworld_step_simulation(rbDynamicsWorld *world, float timeStep, int maxSubSteps, float timeSubStep)
@@ -609,6 +619,33 @@ void RB_body_get_orientation(rbRigidBody *object, float v_out[4])
 	copy_quat_btquat(v_out, body->getWorldTransform().getRotation());
 }
 
+/* ............ */
+
+void RB_bodies_get_loc_rot(rbRigidBody **bodies, int totbody, float *r_loc, float *r_rot)
+{
+	int i;
+	
+	for (i = 0; i < totbody; i++) {
+		if (bodies[i]) {
+			const btTransform &trans = bodies[i]->body->getWorldTransform();
+			
+			copy_v3_btvec3(r_loc + 3 * i, trans.getOrigin());
+			copy_quat_btquat(r_rot + 4 * i, trans.getRotation());
+		}
+	}
+}
+
+void RB_bodies_set_loc_rot(rbRigidBody **bodies, int totbody, const float *loc, const float *rot)
+{
+	int i;
+	
+	for (i = 0; i < totbody; i++) {
+		if (bodies[i]) {
+			RB_body_set_loc_rot(bodies[i], loc + 3 * i, rot + 4 * i);
+		}
+	}
+}
+
 /* ............ */
 /* Overrides for simulation */
 
@@ -278,6 +278,7 @@ class RENDER_PT_performance(RenderButtonsPanel, Panel):
         sub.active = rd.use_compositing
         sub.prop(rd, "use_free_image_textures")
         sub.prop(rd, "use_free_unused_nodes")
+        col.prop(rd, "use_persistent_data", text="Persistent Objects")
         sub = col.column()
         sub.active = rd.use_raytrace
         sub.label(text="Acceleration structure:")
@@ -287,6 +287,7 @@ class SCENE_PT_rigid_body_world(SceneButtonsPanel, Panel):
             col = split.column()
             col.prop(rbw, "time_scale", text="Speed")
             col.prop(rbw, "use_split_impulse")
+            col.prop(rbw, "use_deferred_broadphase")
 
             col = split.column()
             col.prop(rbw, "steps_per_second", text="Steps Per Second")
@@ -105,6 +105,10 @@ typedef struct EffectorCache {
 	float guide_loc[4], guide_dir[3], guide_radius;
 	float velocity[3];
 
+	/* per-effector invariants, so points don't recompute them */
+	float nor[3];                   /* normalized object z-axis */
+	struct ListBase *colliders;     /* visibility colliders when caller passes none */
+
 	float frame;
 	int flag;
 } EffectorCache;
@@ -113,6 +117,8 @@ void            free_partdeflect(struct PartDeflect *pd);
 struct ListBase *pdInitEffectors(struct Scene *scene, struct Object *ob_src, struct ParticleSystem *psys_src, struct EffectorWeights *weights);
 void            pdEndEffectors(struct ListBase **effectors);
 void            pdDoEffectors(struct ListBase *effectors, struct ListBase *colliders, struct EffectorWeights *weights, struct EffectedPoint *point, float *force, float *impulse);
+int             pdEffectorsThreadsafe(struct ListBase *effectors);
+void            pdDoEffectorsBlock(struct ListBase *effectors, struct ListBase *colliders, struct EffectorWeights *weights, struct EffectedPoint *points, int totpoint, float (*force)[3], float (*impulse)[3]);
 
 void pd_point_from_particle(struct ParticleSimulationData *sim, struct ParticleData *pa, struct ParticleKey *state, struct EffectedPoint *point);
 void pd_point_from_loc(struct Scene *scene, float *loc, float *vel, int index, struct EffectedPoint *point);
@@ -99,6 +99,9 @@
 #include <string.h>
 #endif // WITH_MOD_FLUID
 
+/* number of points for which effector evaluation is threaded */
+#define EFF_OMP_LIMIT 256
+
 EffectorWeights *BKE_add_effector_weights(Group *group)
 {
 	EffectorWeights *weights = MEM_callocN(sizeof(EffectorWeights), "EffectorWeights");
@@ -202,7 +205,14 @@ static void precalculate_effector(EffectorCache *eff)
 		copy_v3_v3(old_vel, eff->ob->obmat[3]);
 		BKE_object_where_is_calc_time(eff->scene, eff->ob, cfra);
 		sub_v3_v3v3(eff->velocity, eff->ob->obmat[3], old_vel);
+
+		/* use z-axis as normal */
+		normalize_v3_v3(eff->nor, eff->ob->obmat[2]);
 	}
+
+	/* collect visibility colliders once instead of for every point */
+	if (eff->pd->flag & PFIELD_VISIBILITY)
+		eff->colliders = get_collider_cache(eff->scene, eff->ob, NULL);
 }
 static EffectorCache *new_effector_cache(Scene *scene, Object *ob, ParticleSystem *psys, PartDeflect *pd)
 {
@@ -312,6 +322,8 @@ void pdEndEffectors(ListBase **effectors)
 		for (; eff; eff=eff->next) {
 			if (eff->guide_data)
 				MEM_freeN(eff->guide_data);
+			if (eff->colliders)
+				free_collider_cache(&eff->colliders);
 		}
 
 		BLI_freelistN(*effectors);
@@ -406,7 +418,7 @@ static float eff_calc_visibility(ListBase *colliders, EffectorCache *eff, Effect
 		return visibility;
 
 	if (!colls)
-		colls = get_collider_cache(eff->scene, eff->ob, NULL);
+		colls = eff->colliders;
 
 	if (!colls)
 		return visibility;
@@ -440,9 +452,6 @@ static float eff_calc_visibility(ListBase *colliders, EffectorCache *eff, Effect
 		}
 	}
 
-	if (!colliders)
-		free_collider_cache(&colls);
-	
 	return visibility;
 }
 
@@ -640,10 +649,9 @@ int get_effector_data(EffectorCache *eff, EffectorData *efd, EffectedPoint *poin
 	else {
 		/* use center of object for distance calculus */
 		Object *ob = eff->ob;
-		Object obcopy = *ob;
 
-		/* use z-axis as normal*/
-		normalize_v3_v3(efd->nor, ob->obmat[2]);
+		/* use z-axis as normal, precalculated per effector */
+		copy_v3_v3(efd->nor, eff->nor);
 
 		if (eff->pd && eff->pd->shape == PFIELD_SHAPE_PLANE) {
 			float temp[3], translate[3];
@@ -663,8 +671,6 @@ int get_effector_data(EffectorCache *eff, EffectorData *efd, EffectedPoint *poin
 		if (real_velocity)
 			copy_v3_v3(efd->vel, eff->velocity);
 
-		*eff->ob = obcopy;
-
 		efd->size = 0.0f;
 
 		ret = 1;
@@ -685,7 +691,7 @@ int get_effector_data(EffectorCache *eff, EffectorData *efd, EffectedPoint *poin
 		else {
 			/* for some effectors we need the object center every time */
 			sub_v3_v3v3(efd->vec_to_point2, point->loc, eff->ob->obmat[3]);
-			normalize_v3_v3(efd->nor2, eff->ob->obmat[2]);
+			copy_v3_v3(efd->nor2, eff->nor);
 		}
 	}
 
@@ -960,6 +966,49 @@ static void do_physical_effector(EffectorCache *eff, EffectorData *efd, Effected
 	}
 }
 
+/* evaluate a single effector for a point, adding to force and impulse */
+static void do_effector_point(EffectorCache *eff, ListBase *colliders, EffectorWeights *weights, EffectedPoint *point, float *force, float *impulse)
+{
+	EffectorData efd;
+	int p=0, tot = 1, step = 1;
+
+	/* object effectors were fully checked to be OK to evaluate! */
+
+	get_effector_tot(eff, &efd, point, &tot, &p, &step);
+
+	for (; p<tot; p+=step) {
+		if (get_effector_data(eff, &efd, point, 0)) {
+			efd.falloff= effector_falloff(eff, &efd, point, weights);
+			
+			if (efd.falloff > 0.0f)
+				efd.falloff *= eff_calc_visibility(colliders, eff, &efd, point);
+
+			if (efd.falloff <= 0.0f) {
+				/* don't do anything */
+			}
+			else if (eff->pd->forcefield == PFIELD_TEXTURE) {
+				do_texture_effector(eff, &efd, point, force);
+			}
+			else {
+				float temp1[3] = {0, 0, 0}, temp2[3];
+				copy_v3_v3(temp1, force);
+
+				do_physical_effector(eff, &efd, point, force);
+				
+				/* for softbody backward compatibility */
+				if (point->flag & PE_WIND_AS_SPEED && impulse) {
+					sub_v3_v3v3(temp2, force, temp1);
+					sub_v3_v3v3(impulse, impulse, temp2);
+				}
+			}
+		}
+		else if (eff->flag & PE_VELOCITY_TO_IMPULSE && impulse) {
+			/* special case for harmonic effector */
+			add_v3_v3v3(impulse, impulse, efd.vel);
+		}
+	}
+}
+
 /*  -------- pdDoEffectors() --------
  * generic force/speed system, now used for particles and softbodies
  * scene       = scene where it runs in, for time and stuff
@@ -989,47 +1038,57 @@ void pdDoEffectors(ListBase *effectors, ListBase *colliders, EffectorWeights *we
  *     (is independent of other effectors)
  */
 	EffectorCache *eff;
-	EffectorData efd;
-	int p=0, tot = 1, step = 1;
 
 	/* Cycle through collected objects, get total of (1/(gravity_strength * dist^gravity_power)) */
 	/* Check for min distance here? (yes would be cool to add that, ton) */
 	
 	if (effectors) for (eff = effectors->first; eff; eff=eff->next) {
-		/* object effectors were fully checked to be OK to evaluate! */
+		do_effector_point(eff, colliders, weights, point, force, impulse);
+	}
+}
 
-		get_effector_tot(eff, &efd, point, &tot, &p, &step);
+/* node textures evaluate through multitex_ext() as thread 0, which shares node tree exec data */
+static int effector_is_threadsafe(EffectorCache *eff)
+{
+	Tex *tex = eff->pd->tex;
 
-		for (; p<tot; p+=step) {
-			if (get_effector_data(eff, &efd, point, 0)) {
-				efd.falloff= effector_falloff(eff, &efd, point, weights);
-				
-				if (efd.falloff > 0.0f)
-					efd.falloff *= eff_calc_visibility(colliders, eff, &efd, point);
+	if (eff->pd->forcefield == PFIELD_TEXTURE && tex && tex->use_nodes && tex->nodetree)
+		return 0;
 
-				if (efd.falloff <= 0.0f) {
-					/* don't do anything */
-				}
-				else if (eff->pd->forcefield == PFIELD_TEXTURE) {
-					do_texture_effector(eff, &efd, point, force);
-				}
-				else {
-					float temp1[3] = {0, 0, 0}, temp2[3];
-					copy_v3_v3(temp1, force);
-
-					do_physical_effector(eff, &efd, point, force);
-					
-					/* for softbody backward compatibility */
-					if (point->flag & PE_WIND_AS_SPEED && impulse) {
-						sub_v3_v3v3(temp2, force, temp1);
-						sub_v3_v3v3(impulse, impulse, temp2);
-					}
-				}
-			}
-			else if (eff->flag & PE_VELOCITY_TO_IMPULSE && impulse) {
-				/* special case for harmonic effector */
-				add_v3_v3v3(impulse, impulse, efd.vel);
-			}
-		}
+	return 1;
+}
+
+/* all effectors can be evaluated for different points from multiple threads */
+int pdEffectorsThreadsafe(ListBase *effectors)
+{
+	EffectorCache *eff;
+
+	if (effectors) for (eff = effectors->first; eff; eff=eff->next) {
+		if (!effector_is_threadsafe(eff))
+			return 0;
+	}
+
+	return 1;
+}
+
+/*  -------- pdDoEffectorsBlock() --------
+ * same as pdDoEffectors() for a block of points, but with the effector loop outside
+ * so each effector's data stays in cache while it is evaluated for all points,
+ * points are evaluated in parallel when the effector allows it
+ * force		= array of totpoint force accumulators
+ * impulse		= array of totpoint impulse accumulators, or NULL
+ */
+void pdDoEffectorsBlock(ListBase *effectors, ListBase *colliders, EffectorWeights *weights, EffectedPoint *points, int totpoint, float (*force)[3], float (*impulse)[3])
+{
+	EffectorCache *eff;
+	int i;
+
+	if (effectors) for (eff = effectors->first; eff; eff=eff->next) {
+		/* wind noise draws from the effector's shared RNG, keep it serial so results are repeatable */
+		int threaded = (totpoint >= EFF_OMP_LIMIT) && effector_is_threadsafe(eff) && (eff->pd->f_noise <= 0.0f);
+
+#pragma omp parallel for schedule(static) if (threaded)
+		for (i = 0; i < totpoint; i++)
+			do_effector_point(eff, colliders, weights, points + i, force[i], impulse ? impulse[i] : NULL);
 	}
 }
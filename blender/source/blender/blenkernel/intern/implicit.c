@@ -1542,7 +1542,7 @@ static void cloth_calc_force(ClothModifierData *clmd, float UNUSED(frame), lfVec
 	unsigned int numverts = cloth->numverts;
 	LinkNode *search;
 	lfVector *winvec;
-	EffectedPoint epoint;
+	EffectedPoint *epoints;
 
 	tm2[0][0] = tm2[1][1] = tm2[2][2] = -spring_air;
 	
@@ -1581,11 +1581,13 @@ static void cloth_calc_force(ClothModifierData *clmd, float UNUSED(frame), lfVec
 		if (!winvec)
 			printf("winvec: out of memory in implicit.c\n");
 		
-		// precalculate wind forces
-		for (i = 0; i < cloth->numverts; i++) {
-			pd_point_from_loc(clmd->scene, (float*)lX[i], (float*)lV[i], i, &epoint);
-			pdDoEffectors(effectors, NULL, clmd->sim_parms->effector_weights, &epoint, winvec[i], NULL);
-		}
+		// precalculate wind forces, all vertices per effector
+		epoints = MEM_mallocN(sizeof(EffectedPoint) * cloth->numverts, "cloth effected points");
+		for (i = 0; i < cloth->numverts; i++)
+			pd_point_from_loc(clmd->scene, (float*)lX[i], (float*)lV[i], i, &epoints[i]);
+
+		pdDoEffectorsBlock(effectors, NULL, clmd->sim_parms->effector_weights, epoints, cloth->numverts, winvec, NULL);
+		MEM_freeN(epoints);
 		
 		for (i = 0; i < cloth->numfaces; i++) {
 			float trinormal[3] = {0, 0, 0}; // normalized triangle normal
@@ -52,6 +52,7 @@
 #include "BLI_math.h"
 #include "BLI_utildefines.h"
 #include "BLI_kdtree.h"
+#include "BLI_pointgrid.h"
 #include "BLI_rand.h"
 #include "BLI_threads.h"
 #include "BLI_linklist.h"
@@ -571,7 +572,7 @@ void psys_free(Object *ob, ParticleSystem *psys)
 		
 		BLI_freelistN(&psys->targets);
 
-		BLI_bvhtree_free(psys->bvhtree);
+		BLI_pointgrid_free(psys->pointgrid);
 		BLI_kdtree_free(psys->tree);
  
 		if (psys->fluid_springs)
@@ -70,6 +70,7 @@
 #include "BLI_blenlib.h"
 #include "BLI_kdtree.h"
 #include "BLI_kdopbvh.h"
+#include "BLI_pointgrid.h"
 #include "BLI_threads.h"
 #include "BLI_linklist.h"
 
@@ -2106,31 +2107,32 @@ void psys_get_pointcache_start_end(Scene *scene, ParticleSystem *psys, int *sfra
 /************************************************/
 /*			Effectors							*/
 /************************************************/
-static void psys_update_particle_bvhtree(ParticleSystem *psys, float cfra)
+/* cellsize should be close to the SPH interaction radius */
+static void psys_update_particle_pointgrid(ParticleSystem *psys, float cfra, float cellsize)
 {
 	if (psys) {
 		PARTICLE_P;
 		int totpart = 0;
 
-		if (!psys->bvhtree || psys->bvhtree_frame != cfra) {
+		if (!psys->pointgrid || psys->pointgrid_frame != cfra) {
 			LOOP_SHOWN_PARTICLES {
 				totpart++;
 			}
 			
-			BLI_bvhtree_free(psys->bvhtree);
-			psys->bvhtree = BLI_bvhtree_new(totpart, 0.0, 4, 6);
+			BLI_pointgrid_free(psys->pointgrid);
+			psys->pointgrid = BLI_pointgrid_new(totpart);
 
 			LOOP_SHOWN_PARTICLES {
 				if (pa->alive == PARS_ALIVE) {
 					if (pa->state.time == cfra)
-						BLI_bvhtree_insert(psys->bvhtree, p, pa->prev_state.co, 1);
+						BLI_pointgrid_insert(psys->pointgrid, p, pa->prev_state.co);
 					else
-						BLI_bvhtree_insert(psys->bvhtree, p, pa->state.co, 1);
+						BLI_pointgrid_insert(psys->pointgrid, p, pa->state.co);
 				}
 			}
-			BLI_bvhtree_balance(psys->bvhtree);
+			BLI_pointgrid_balance(psys->pointgrid, cellsize);
 
-			psys->bvhtree_frame = cfra;
+			psys->pointgrid_frame = cfra;
 		}
 	}
 }
@@ -2447,7 +2449,7 @@ static void sph_evaluate_func(BVHTree *tree, ParticleSystem **psys, float co[3],
 			break;
 		}
 		else {
-			BLI_bvhtree_range_query(psys[i]->bvhtree, co, interaction_radius, callback, pfr);
+			BLI_pointgrid_range_query(psys[i]->pointgrid, co, interaction_radius, callback, pfr);
 		}
 	}
 }
@@ -3008,6 +3010,255 @@ static void basic_integrate(ParticleSimulationData *sim, int p, float dfra, floa
 		}
 	}
 }
+/* Struct of arrays version of basic_integrate() for all dynamic particles at once.
+ * The hot state is gathered from psys->particles into separate arrays, effectors
+ * are evaluated a block of points at a time and the explicit euler step runs as
+ * plain loops over the arrays, before scattering the result back.
+ * blocks are several times the effector threading limit, so each threaded
+ * effector loop has enough points to pay for starting the threads */
+#define PSYS_SOA_BLOCK 4096
+
+typedef struct ParticleStateSoA {
+	int totpoint;
+	int *index;              /* index into psys->particles */
+	float (*co)[3];
+	float (*vel)[3];
+	float (*ave)[3];
+	float (*force)[3];
+	float (*impulse)[3];
+	float *dtime;
+	float *inv_mass;
+	float *size;
+	float *field, *gravity, *damp;  /* texture influence */
+} ParticleStateSoA;
+
+static int basic_integrate_soa_check(ParticleSimulationData *sim)
+{
+	ParticleSettings *part = sim->psys->part;
+
+	/* other integrators evaluate forces at intermediate states per particle */
+	if (part->integrator != PART_INT_EULER)
+		return 0;
+
+	/* brownian force and collisions both draw from BLI_frand(), keep
+	 * them interleaved per particle so results don't change */
+	if (part->brownfac != 0.0f && sim->colliders)
+		return 0;
+
+	return 1;
+}
+
+static void basic_integrate_soa_gather(ParticleSimulationData *sim, ParticleStateSoA *soa, float cfra)
+{
+	ParticleSystem *psys = sim->psys;
+	ParticleSettings *part = psys->part;
+	ParticleTexture ptex;
+	float timestep = psys_get_timestep(sim);
+	int i, tot = 0;
+	PARTICLE_P;
+
+	LOOP_DYNAMIC_PARTICLES {
+		tot++;
+	}
+
+	soa->totpoint = tot;
+	if (tot == 0)
+		return;
+
+	soa->index = MEM_mallocN(sizeof(int) * tot, "psys soa index");
+	soa->co = MEM_mallocN(sizeof(float) * 3 * tot, "psys soa co");
+	soa->vel = MEM_mallocN(sizeof(float) * 3 * tot, "psys soa vel");
+	soa->ave = MEM_mallocN(sizeof(float) * 3 * tot, "psys soa ave");
+	soa->force = MEM_callocN(sizeof(float) * 3 * tot, "psys soa force");
+	soa->impulse = MEM_callocN(sizeof(float) * 3 * tot, "psys soa impulse");
+	soa->dtime = MEM_mallocN(sizeof(float) * tot, "psys soa dtime");
+	soa->inv_mass = MEM_mallocN(sizeof(float) * tot, "psys soa inv_mass");
+	soa->size = MEM_mallocN(sizeof(float) * tot, "psys soa size");
+	soa->field = MEM_mallocN(sizeof(float) * tot, "psys soa field");
+	soa->gravity = MEM_mallocN(sizeof(float) * tot, "psys soa gravity");
+	soa->damp = MEM_mallocN(sizeof(float) * tot, "psys soa damp");
+
+	i = 0;
+	LOOP_DYNAMIC_PARTICLES {
+		psys_get_texture(sim, pa, &ptex, PAMAP_PHYSICS, cfra);
+
+		soa->index[i] = p;
+		copy_v3_v3(soa->co[i], pa->state.co);
+		copy_v3_v3(soa->vel[i], pa->state.vel);
+		/* maintain angular velocity */
+		copy_v3_v3(soa->ave[i], pa->prev_state.ave);
+		soa->dtime[i] = pa->state.time * timestep;
+		soa->inv_mass[i] = 1.0f / (part->flag & PART_SIZEMASS ? part->mass * pa->size : part->mass);
+		soa->size[i] = pa->size;
+		soa->field[i] = ptex.field;
+		soa->gravity[i] = ptex.gravity;
+		soa->damp[i] = ptex.damp;
+		i++;
+	}
+}
+
+static void basic_integrate_soa_free(ParticleStateSoA *soa)
+{
+	if (soa->totpoint == 0)
+		return;
+
+	MEM_freeN(soa->index);
+	MEM_freeN(soa->co);
+	MEM_freeN(soa->vel);
+	MEM_freeN(soa->ave);
+	MEM_freeN(soa->force);
+	MEM_freeN(soa->impulse);
+	MEM_freeN(soa->dtime);
+	MEM_freeN(soa->inv_mass);
+	MEM_freeN(soa->size);
+	MEM_freeN(soa->field);
+	MEM_freeN(soa->gravity);
+	MEM_freeN(soa->damp);
+}
+
+static void basic_integrate_soa_forces(ParticleSimulationData *sim, ParticleStateSoA *soa)
+{
+	ParticleSystem *psys = sim->psys;
+	ParticleSettings *part = psys->part;
+	EffectedPoint *points;
+	int i, b, tot = soa->totpoint;
+
+	/* add effectors, each block of points is passed to every effector in turn */
+	if (tot && psys->effectors && (part->type != PART_HAIR || part->effector_weights->flag & EFF_WEIGHT_DO_HAIR)) {
+		points = MEM_mallocN(sizeof(EffectedPoint) * min_ii(tot, PSYS_SOA_BLOCK), "particle effected points");
+
+		for (b = 0; b < tot; b += PSYS_SOA_BLOCK) {
+			int totblock = min_ii(PSYS_SOA_BLOCK, tot - b);
+
+			for (i = 0; i < totblock; i++) {
+				ParticleData *pa = psys->particles + soa->index[b + i];
+				EffectedPoint *point = points + i;
+
+				pd_point_from_particle(sim, pa, &pa->state, point);
+				point->loc = soa->co[b + i];
+				point->vel = soa->vel[b + i];
+				if (point->ave)
+					point->ave = soa->ave[b + i];
+			}
+
+			pdDoEffectorsBlock(psys->effectors, sim->colliders, part->effector_weights, points, totblock,
+			                   soa->force + b, soa->impulse + b);
+		}
+
+		MEM_freeN(points);
+	}
+
+	for (i = 0; i < tot; i++) {
+		mul_v3_fl(soa->force[i], soa->field[i]);
+		mul_v3_fl(soa->impulse[i], soa->field[i]);
+	}
+
+	/* calculate air-particle interaction */
+	if (part->dragfac != 0.0f) {
+		for (i = 0; i < tot; i++) {
+			madd_v3_v3fl(soa->force[i], soa->vel[i], -part->dragfac * soa->size[i] * soa->size[i] * len_v3(soa->vel[i]));
+		}
+	}
+
+	/* brownian force */
+	if (part->brownfac != 0.0f) {
+		for (i = 0; i < tot; i++) {
+			soa->force[i][0] += (BLI_frand()-0.5f) * part->brownfac;
+			soa->force[i][1] += (BLI_frand()-0.5f) * part->brownfac;
+			soa->force[i][2] += (BLI_frand()-0.5f) * part->brownfac;
+		}
+	}
+}
+
+/* explicit euler step, same as integrate_particle() with PART_INT_EULER */
+static void basic_integrate_soa_step(ParticleSimulationData *sim, ParticleStateSoA *soa)
+{
+	ParticleSettings *part = sim->psys->part;
+	float gravity[3];
+	int i, tot = soa->totpoint;
+
+	/* add global acceleration (gravitation) */
+	if (psys_uses_gravity(sim) &&
+		/* normal gravity is too strong for hair so it's disabled by default */
+		(part->type != PART_HAIR || part->effector_weights->flag & EFF_WEIGHT_DO_HAIR))
+	{
+		mul_v3_v3fl(gravity, sim->scene->physics_settings.gravity, part->effector_weights->global_gravity);
+	}
+	else {
+		zero_v3(gravity);
+	}
+
+	for (i = 0; i < tot; i++) {
+		float acceleration[3];
+
+		/* force to acceleration */
+		mul_v3_v3fl(acceleration, soa->force[i], soa->inv_mass[i]);
+		madd_v3_v3fl(acceleration, gravity, soa->gravity[i]);
+
+		add_v3_v3(soa->vel[i], soa->impulse[i]);
+		madd_v3_v3fl(soa->co[i], soa->vel[i], soa->dtime[i]);
+		madd_v3_v3fl(soa->vel[i], acceleration, soa->dtime[i]);
+	}
+
+	/* damp affects final velocity */
+	if (part->dampfac != 0.f) {
+		for (i = 0; i < tot; i++) {
+			mul_v3_fl(soa->vel[i], 1.f - part->dampfac * soa->damp[i] * 25.f * soa->dtime[i]);
+		}
+	}
+}
+
+static void basic_integrate_soa_scatter(ParticleSimulationData *sim, ParticleStateSoA *soa, float cfra)
+{
+	ParticleSystem *psys = sim->psys;
+	ParticleSettings *part = psys->part;
+	ParticleKey tkey;
+	float time;
+	int i;
+
+	for (i = 0; i < soa->totpoint; i++) {
+		int p = soa->index[i];
+		ParticleData *pa = psys->particles + p;
+
+		copy_v3_v3(pa->state.co, soa->co[i]);
+		copy_v3_v3(pa->state.vel, soa->vel[i]);
+		copy_v3_v3(pa->state.ave, soa->ave[i]);
+
+		/* finally we do guides */
+		if (part->type != PART_HAIR) {
+			time = (cfra - pa->time) / pa->lifetime;
+			CLAMP(time, 0.0f, 1.0f);
+
+			copy_v3_v3(tkey.co, pa->state.co);
+			copy_v3_v3(tkey.vel, pa->state.vel);
+			tkey.time = pa->state.time;
+
+			if (do_guides(psys->effectors, &tkey, p, time)) {
+				copy_v3_v3(pa->state.co, tkey.co);
+				/* guides don't produce valid velocity */
+				sub_v3_v3v3(pa->state.vel, tkey.co, pa->prev_state.co);
+				mul_v3_fl(pa->state.vel, 1.0f / soa->dtime[i]);
+				pa->state.time = tkey.time;
+			}
+		}
+	}
+}
+
+/* gathers all forces that effect particles and calculates new states for all dynamic particles */
+static void basic_integrate_all(ParticleSimulationData *sim, float cfra)
+{
+	ParticleStateSoA soa = {0};
+
+	basic_integrate_soa_gather(sim, &soa, cfra);
+
+	if (soa.totpoint) {
+		basic_integrate_soa_forces(sim, &soa);
+		basic_integrate_soa_step(sim, &soa);
+		basic_integrate_soa_scatter(sim, &soa, cfra);
+	}
+
+	basic_integrate_soa_free(&soa);
+}
 static void basic_rotate(ParticleSettings *part, ParticleData *pa, float dfra, float timestep)
 {
 	float rotfac, rot1[4], rot2[4] = {1.0,0.0,0.0,0.0}, dtime=dfra*timestep, extrotfac;
@@ -4191,11 +4442,15 @@ static void dynamics_step(ParticleSimulationData *sim, float cfra)
 		case PART_PHYS_FLUID:
 		{
 			ParticleTarget *pt = psys->targets.first;
-			psys_update_particle_bvhtree(psys, cfra);
+			SPHFluidSettings *fluid = part->fluid;
+			/* neighbors are searched within the interaction radius, use it as grid cell size */
+			float cellsize = fluid->radius * (fluid->flag & SPH_FAC_RADIUS ? 4.0f * part->size : 1.0f);
+
+			psys_update_particle_pointgrid(psys, cfra, cellsize);
 			
-			for (; pt; pt=pt->next) {  /* Updating others systems particle tree for fluid-fluid interaction */
+			for (; pt; pt=pt->next) {  /* Updating others systems particle grid for fluid-fluid interaction */
 				if (pt->ob)
-					psys_update_particle_bvhtree(BLI_findlink(&pt->ob->particlesystem, pt->psys-1), cfra);
+					psys_update_particle_pointgrid(BLI_findlink(&pt->ob->particlesystem, pt->psys-1), cfra, cellsize);
 			}
 			break;
 		}
@@ -4246,6 +4501,21 @@ static void dynamics_step(ParticleSimulationData *sim, float cfra)
 	switch (part->phystype) {
 		case PART_PHYS_NEWTON:
 		{
+			if (basic_integrate_soa_check(sim)) {
+				/* do global forces & effectors for all particles at once */
+				basic_integrate_all(sim, cfra);
+
+				LOOP_DYNAMIC_PARTICLES {
+					/* deflection */
+					if (sim->colliders)
+						collision_check(sim, p, pa->state.time, cfra);
+
+					/* rotations */
+					basic_rotate(part, pa, pa->state.time, timestep);
+				}
+				break;
+			}
+
 			LOOP_DYNAMIC_PARTICLES {
 				/* do global forces & effectors */
 				basic_integrate(sim, p, pa->state.time, cfra);
@@ -69,16 +69,13 @@
 #include "BKE_object.h"
 #include "BKE_particle.h"
 #include "BKE_pointcache.h"
+#include "BKE_rigidbody.h"
 #include "BKE_scene.h"
 #include "BKE_smoke.h"
 #include "BKE_softbody.h"
 
 #include "BIK_api.h"
 
-#ifdef WITH_BULLET
-#  include "RBI_api.h"
-#endif
-
 /* both in intern */
 #ifdef WITH_SMOKE
 #include "smoke_API.h"
@@ -975,10 +972,7 @@ static int  ptcache_rigidbody_write(int index, void *rb_v, void **data, int UNUS
 		RigidBodyOb *rbo = ob->rigidbody_object;
 		
 		if (rbo->type == RBO_TYPE_ACTIVE) {
-#ifdef WITH_BULLET
-			RB_body_get_position(rbo->physics_object, rbo->pos);
-			RB_body_get_orientation(rbo->physics_object, rbo->orn);
-#endif
+			/* pos/orn are synced from the simulation in BKE_ptcache_write */
 			PTCACHE_DATA_FROM(data, BPHYS_DATA_LOCATION, rbo->pos);
 			PTCACHE_DATA_FROM(data, BPHYS_DATA_ROTATION, rbo->orn);
 		}
@@ -2439,6 +2433,10 @@ int BKE_ptcache_write(PTCacheID *pid, unsigned int cfra)
 	if (ptcache_write_needed(pid, cfra, &overwrite)==0)
 		return 0;
 
+	/* rigid body transforms are read back from the simulation in one batch */
+	if (pid->type == PTCACHE_TYPE_RIGIDBODY && cfra)
+		BKE_rigidbody_update_sim_transforms(pid->calldata);
+
 	if (pid->write_stream) {
 		ptcache_write_stream(pid, cfra, totpoint);
 	}
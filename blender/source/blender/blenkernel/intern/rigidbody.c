@@ -687,6 +687,7 @@ void BKE_rigidbody_validate_sim_world(Scene *scene, RigidBodyWorld *rbw, short r
 
 	RB_dworld_set_solver_iterations(rbw->physics_world, rbw->num_solver_iterations);
 	RB_dworld_set_split_impulse(rbw->physics_world, rbw->flag & RBW_FLAG_USE_SPLIT_IMPULSE);
+	RB_dworld_set_broadphase_deferred(rbw->physics_world, rbw->flag & RBW_FLAG_USE_DEFERRED_BROADPHASE);
 }
 
 /* ************************************** */
@@ -993,10 +994,11 @@ static void rigidbody_update_sim_world(Scene *scene, RigidBodyWorld *rbw)
 	rigidbody_update_ob_array(rbw);
 }
 
-static void rigidbody_update_sim_ob(Scene *scene, RigidBodyWorld *rbw, Object *ob, RigidBodyOb *rbo)
+/* kinematic transforms are returned in loc/rot with the body in r_body,
+ * so they can be pushed into the simulation in one batch */
+static void rigidbody_update_sim_ob(Scene *scene, RigidBodyWorld *rbw, Object *ob, RigidBodyOb *rbo,
+                                    rbRigidBody **r_body, float loc[3], float rot[4])
 {
-	float loc[3];
-	float rot[4];
 	float scale[3];
 
 	/* only update if rigid body exists */
@@ -1020,7 +1022,7 @@ static void rigidbody_update_sim_ob(Scene *scene, RigidBodyWorld *rbw, Object *o
 	/* update rigid body location and rotation for kinematic bodies */
 	if (rbo->flag & RBO_FLAG_KINEMATIC || (ob->flag & SELECT && G.moving & G_TRANSFORM_OBJ)) {
 		RB_body_activate(rbo->physics_object);
-		RB_body_set_loc_rot(rbo->physics_object, loc, rot);
+		*r_body = rbo->physics_object;
 	}
 	/* update influence of effectors - but don't do it on an effector */
 	/* only dynamic bodies need effector update */
@@ -1072,14 +1074,23 @@ static void rigidbody_update_sim_ob(Scene *scene, RigidBodyWorld *rbw, Object *o
 static void rigidbody_update_simulation(Scene *scene, RigidBodyWorld *rbw, int rebuild)
 {
 	GroupObject *go;
+	rbRigidBody **bodies = NULL;
+	float *loc = NULL, *rot = NULL;
+	int i;
 
 	/* update world */
 	if (rebuild)
 		BKE_rigidbody_validate_sim_world(scene, rbw, true);
 	rigidbody_update_sim_world(scene, rbw);
 
+	if (rbw->numbodies) {
+		bodies = MEM_callocN(sizeof(rbRigidBody *) * rbw->numbodies, "rigidbody kinematic bodies");
+		loc = MEM_mallocN(sizeof(float) * 3 * rbw->numbodies, "rigidbody kinematic loc");
+		rot = MEM_mallocN(sizeof(float) * 4 * rbw->numbodies, "rigidbody kinematic rot");
+	}
+
 	/* update objects */
-	for (go = rbw->group->gobject.first; go; go = go->next) {
+	for (go = rbw->group->gobject.first, i = 0; go; go = go->next, i++) {
 		Object *ob = go->ob;
 
 		if (ob && ob->type == OB_MESH) {
@@ -1120,9 +1131,19 @@ static void rigidbody_update_simulation(Scene *scene, RigidBodyWorld *rbw, int r
 			}
 
 			/* update simulation object... */
-			rigidbody_update_sim_ob(scene, rbw, ob, rbo);
+			rigidbody_update_sim_ob(scene, rbw, ob, rbo, &bodies[i], loc + 3 * i, rot + 4 * i);
 		}
 	}
+
+	/* move kinematic bodies */
+	if (bodies) {
+		RB_bodies_set_loc_rot(bodies, rbw->numbodies, loc, rot);
+
+		MEM_freeN(bodies);
+		MEM_freeN(loc);
+		MEM_freeN(rot);
+	}
+
 	/* update constraints */
 	if (rbw->constraints == NULL) /* no constraints, move on */
 		return;
@@ -1180,6 +1201,45 @@ static void rigidbody_update_simulation_post_step(RigidBodyWorld *rbw)
 	}
 }
 
+/* Copy world transforms of all active bodies from the simulation into their settings
+ * in one batch, called by the point cache before writing them */
+void BKE_rigidbody_update_sim_transforms(RigidBodyWorld *rbw)
+{
+	rbRigidBody **bodies;
+	float *loc, *rot;
+	int i, totbody = rbw->numbodies;
+
+	if (rbw->objects == NULL || totbody == 0)
+		return;
+
+	bodies = MEM_mallocN(sizeof(rbRigidBody *) * totbody, "rigidbody sync bodies");
+	loc = MEM_mallocN(sizeof(float) * 3 * totbody, "rigidbody sync loc");
+	rot = MEM_mallocN(sizeof(float) * 4 * totbody, "rigidbody sync rot");
+
+	for (i = 0; i < totbody; i++) {
+		Object *ob = rbw->objects[i];
+		RigidBodyOb *rbo = ob ? ob->rigidbody_object : NULL;
+
+		/* only active bodies are written to the cache */
+		bodies[i] = (rbo && rbo->type == RBO_TYPE_ACTIVE) ? rbo->physics_object : NULL;
+	}
+
+	RB_bodies_get_loc_rot(bodies, totbody, loc, rot);
+
+	for (i = 0; i < totbody; i++) {
+		if (bodies[i]) {
+			RigidBodyOb *rbo = rbw->objects[i]->rigidbody_object;
+
+			copy_v3_v3(rbo->pos, loc + 3 * i);
+			copy_qt_qt(rbo->orn, rot + 4 * i);
+		}
+	}
+
+	MEM_freeN(bodies);
+	MEM_freeN(loc);
+	MEM_freeN(rot);
+}
+
 bool BKE_rigidbody_check_sim_running(RigidBodyWorld *rbw, float ctime)
 {
 	return (rbw && (rbw->flag & RBW_FLAG_MUTED) == 0 && ctime > rbw->pointcache->startframe);
@@ -1371,6 +1431,7 @@ struct RigidBodyWorld *BKE_rigidbody_get_world(Scene *scene) { return NULL; }
 void BKE_rigidbody_remove_object(Scene *scene, Object *ob) {}
 void BKE_rigidbody_remove_constraint(Scene *scene, Object *ob) {}
 void BKE_rigidbody_sync_transforms(RigidBodyWorld *rbw, Object *ob, float ctime) {}
+void BKE_rigidbody_update_sim_transforms(RigidBodyWorld *rbw) {}
 void BKE_rigidbody_aftertrans_update(Object *ob, float loc[3], float rot[3], float quat[4], float rotAxis[3], float rotAngle) {}
 bool BKE_rigidbody_check_sim_running(RigidBodyWorld *rbw, float ctime) { return false; }
 void BKE_rigidbody_cache_reset(RigidBodyWorld *rbw) {}
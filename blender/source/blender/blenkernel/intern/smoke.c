@@ -2386,10 +2386,11 @@ static void update_effectors(Scene *scene, Object *ob, SmokeDomainSettings *sds,
 		float *velocity_y = smoke_get_velocity_y(sds->fluid);
 		float *velocity_z = smoke_get_velocity_z(sds->fluid);
 		unsigned char *obstacle = smoke_get_obstacle(sds->fluid);
+		int threaded = pdEffectorsThreadsafe(effectors);
 		int x;
 
 		// precalculate wind forces
-		#pragma omp parallel for schedule(static)
+		#pragma omp parallel for schedule(static) if (threaded)
 		for (x = 0; x < sds->res[0]; x++)
 		{
 			int y, z;
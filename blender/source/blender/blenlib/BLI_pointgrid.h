@@ -0,0 +1,55 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2013 Blender Foundation.
+ * All rights reserved.
+ *
+ * The Original Code is: all of this file.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+#ifndef __BLI_POINTGRID_H__
+#define __BLI_POINTGRID_H__
+
+/** \file BLI_pointgrid.h
+ *  \ingroup bli
+ *  \brief A cell sorted uniform grid for fixed radius neighbor search.
+ */
+
+struct PointGrid;
+typedef struct PointGrid PointGrid;
+
+/* same signature as BVHTree_RangeQuery, so callbacks can be shared */
+typedef void (*PointGridRangeQuery)(void *userdata, int index, float squared_dist);
+
+/* Creates or free a grid */
+PointGrid *BLI_pointgrid_new(int maxsize);
+void BLI_pointgrid_free(PointGrid *grid);
+
+/* Construction: first insert points, then call balance with the cell size,
+ * which is best chosen close to the radius used for range queries.
+ * The cell size may be increased to keep the number of cells bounded. */
+void BLI_pointgrid_insert(PointGrid *grid, int index, const float co[3]);
+void BLI_pointgrid_balance(PointGrid *grid, float cellsize);
+
+/* Calls callback for every point closer than radius to co, returns number of points found.
+ * Points are visited in cell order, so consecutive queries nearby touch the same memory. */
+int BLI_pointgrid_range_query(const PointGrid *grid, const float co[3], float radius,
+                              PointGridRangeQuery callback, void *userdata);
+
+#endif  /* __BLI_POINTGRID_H__ */
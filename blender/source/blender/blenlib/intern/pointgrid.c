@@ -0,0 +1,239 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2013 Blender Foundation.
+ * All rights reserved.
+ *
+ * The Original Code is: all of this file.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenlib/intern/pointgrid.c
+ *  \ingroup bli
+ *
+ * Points are sorted by cell with a counting sort, cells are stored x-major so
+ * a run of cells along x maps to one contiguous range of the sorted arrays.
+ */
+
+#include <float.h>
+#include <string.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_math.h"
+#include "BLI_pointgrid.h"
+#include "BLI_utildefines.h"
+
+/* upper bound of cells per point, the cell size is increased to stay below it */
+#define POINTGRID_MAX_CELLS_PER_POINT 4
+/* number of points above which the cell assignment is threaded */
+#define POINTGRID_OMP_LIMIT 10000
+
+struct PointGrid {
+	float (*co)[3];
+	int *index;
+	int totnode, maxsize;
+
+	float min[3];
+	float cellsize, inv_cellsize;
+	int res[3];
+	int *cell_start;  /* res[0] * res[1] * res[2] + 1 offsets into co/index */
+};
+
+PointGrid *BLI_pointgrid_new(int maxsize)
+{
+	PointGrid *grid;
+
+	grid = MEM_callocN(sizeof(PointGrid), "PointGrid");
+	grid->co = MEM_mallocN(sizeof(float) * 3 * max_ii(maxsize, 1), "PointGrid co");
+	grid->index = MEM_mallocN(sizeof(int) * max_ii(maxsize, 1), "PointGrid index");
+	grid->maxsize = maxsize;
+
+	return grid;
+}
+
+void BLI_pointgrid_free(PointGrid *grid)
+{
+	if (grid) {
+		MEM_freeN(grid->co);
+		MEM_freeN(grid->index);
+		if (grid->cell_start)
+			MEM_freeN(grid->cell_start);
+		MEM_freeN(grid);
+	}
+}
+
+void BLI_pointgrid_insert(PointGrid *grid, int index, const float co[3])
+{
+	BLI_assert(grid->totnode < grid->maxsize);
+
+	grid->index[grid->totnode] = index;
+	copy_v3_v3(grid->co[grid->totnode], co);
+	grid->totnode++;
+}
+
+BLI_INLINE int pointgrid_cell_axis(const PointGrid *grid, const float co[3], int axis)
+{
+	float f = (co[axis] - grid->min[axis]) * grid->inv_cellsize;
+
+	/* clamp in float before converting, far away points would overflow int */
+	if (f <= 0.0f)
+		return 0;
+	else if (f >= (float)(grid->res[axis] - 1))
+		return grid->res[axis] - 1;
+	else
+		return (int)f;
+}
+
+BLI_INLINE int pointgrid_cell_index(const PointGrid *grid, const float co[3])
+{
+	return pointgrid_cell_axis(grid, co, 0) +
+	       grid->res[0] * (pointgrid_cell_axis(grid, co, 1) +
+	                       grid->res[1] * pointgrid_cell_axis(grid, co, 2));
+}
+
+void BLI_pointgrid_balance(PointGrid *grid, float cellsize)
+{
+	float max[3], size[3];
+	float (*sorted_co)[3];
+	int *sorted_index, *cell, *offset;
+	int i, totcell, maxcell;
+
+	if (grid->cell_start) {
+		MEM_freeN(grid->cell_start);
+		grid->cell_start = NULL;
+	}
+
+	if (grid->totnode == 0) {
+		grid->res[0] = grid->res[1] = grid->res[2] = 0;
+		return;
+	}
+
+	INIT_MINMAX(grid->min, max);
+	for (i = 0; i < grid->totnode; i++)
+		minmax_v3v3_v3(grid->min, max, grid->co[i]);
+	sub_v3_v3v3(size, max, grid->min);
+
+	/* grow cells until their number is bounded by the number of points,
+	 * sparse far apart points would otherwise allocate huge empty grids */
+	maxcell = max_ii(grid->totnode * POINTGRID_MAX_CELLS_PER_POINT, 64);
+	cellsize = max_ff(cellsize, FLT_EPSILON * max_ff(max_fff(size[0], size[1], size[2]), 1.0f));
+	while (1) {
+		double tot = 1.0;
+
+		for (i = 0; i < 3; i++)
+			tot *= floor((double)size[i] / (double)cellsize) + 1.0;
+
+		if (tot <= (double)maxcell)
+			break;
+
+		cellsize *= 2.0f;
+	}
+
+	for (i = 0; i < 3; i++)
+		grid->res[i] = (int)(size[i] / cellsize) + 1;
+
+	grid->cellsize = cellsize;
+	grid->inv_cellsize = 1.0f / cellsize;
+	totcell = grid->res[0] * grid->res[1] * grid->res[2];
+
+	/* counting sort by cell */
+	cell = MEM_mallocN(sizeof(int) * grid->totnode, "PointGrid cell");
+	grid->cell_start = MEM_callocN(sizeof(int) * (totcell + 1), "PointGrid cell_start");
+
+	#pragma omp parallel for schedule(static) if (grid->totnode > POINTGRID_OMP_LIMIT)
+	for (i = 0; i < grid->totnode; i++) {
+		int c = pointgrid_cell_index(grid, grid->co[i]);
+
+		cell[i] = c;
+
+		#pragma omp atomic
+		grid->cell_start[c + 1]++;
+	}
+
+	for (i = 0; i < totcell; i++)
+		grid->cell_start[i + 1] += grid->cell_start[i];
+
+	/* scatter in insertion order, so points within a cell keep a stable order */
+	offset = MEM_mallocN(sizeof(int) * totcell, "PointGrid offset");
+	memcpy(offset, grid->cell_start, sizeof(int) * totcell);
+
+	sorted_co = MEM_mallocN(sizeof(float) * 3 * max_ii(grid->maxsize, 1), "PointGrid co");
+	sorted_index = MEM_mallocN(sizeof(int) * max_ii(grid->maxsize, 1), "PointGrid index");
+
+	for (i = 0; i < grid->totnode; i++) {
+		int j = offset[cell[i]]++;
+
+		copy_v3_v3(sorted_co[j], grid->co[i]);
+		sorted_index[j] = grid->index[i];
+	}
+
+	MEM_freeN(grid->co);
+	MEM_freeN(grid->index);
+	grid->co = sorted_co;
+	grid->index = sorted_index;
+
+	MEM_freeN(offset);
+	MEM_freeN(cell);
+}
+
+int BLI_pointgrid_range_query(const PointGrid *grid, const float co[3], float radius,
+                              PointGridRangeQuery callback, void *userdata)
+{
+	float lo_co[3], hi_co[3];
+	float radius_sq = radius * radius;
+	int lo[3], hi[3];
+	int y, z, i, hits = 0;
+
+	if (grid->cell_start == NULL)
+		return 0;
+
+	for (i = 0; i < 3; i++) {
+		lo_co[i] = co[i] - radius;
+		hi_co[i] = co[i] + radius;
+
+		/* query box entirely outside of the grid */
+		if (hi_co[i] < grid->min[i] ||
+		    lo_co[i] > grid->min[i] + grid->cellsize * (float)grid->res[i])
+		{
+			return 0;
+		}
+
+		lo[i] = pointgrid_cell_axis(grid, lo_co, i);
+		hi[i] = pointgrid_cell_axis(grid, hi_co, i);
+	}
+
+	for (z = lo[2]; z <= hi[2]; z++) {
+		for (y = lo[1]; y <= hi[1]; y++) {
+			int row = grid->res[0] * (y + grid->res[1] * z);
+			int start = grid->cell_start[row + lo[0]];
+			int end = grid->cell_start[row + hi[0] + 1];
+
+			for (i = start; i < end; i++) {
+				float dist_sq = len_squared_v3v3(co, grid->co[i]);
+
+				if (dist_sq < radius_sq) {
+					callback(userdata, grid->index[i], dist_sq);
+					hits++;
+				}
+			}
+		}
+	}
+
+	return hits;
+}
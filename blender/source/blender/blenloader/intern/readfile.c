@@ -3882,7 +3882,7 @@ static void direct_link_particlesystems(FileData *fd, ListBase *particles)
 		}
 		
 		psys->tree = NULL;
-		psys->bvhtree = NULL;
+		psys->pointgrid = NULL;
 	}
 	return;
 }
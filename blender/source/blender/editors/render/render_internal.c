@@ -30,6 +30,7 @@
 #include <math.h>
 #include <string.h>
 #include <stddef.h>
+#include <stdarg.h>
 
 #include "MEM_guardedalloc.h"
 
@@ -282,6 +283,26 @@ static void render_freejob(void *rjv)
 	MEM_freeN(rj);
 }
 
+/* append a field to str, which is IMA_MAX_RENDER_TEXT in size, at spos,
+ * fields that don't fit are dropped. returns the new end of the string */
+static char *renderinfo_append(char *str, char *spos, const char *format, ...)
+{
+	size_t len = (size_t)(str + IMA_MAX_RENDER_TEXT - spos);
+	size_t n;
+	va_list args;
+
+	va_start(args, format);
+	n = BLI_vsnprintf(spos, len, format, args);
+	va_end(args);
+
+	if (n >= len) {
+		spos[0] = '\0';
+		return spos;
+	}
+
+	return spos + n;
+}
+
 /* str is IMA_MAX_RENDER_TEXT in size */
 static void make_renderinfo_string(RenderStats *rs, Scene *scene, char *str)
 {
@@ -300,68 +321,74 @@ static void make_renderinfo_string(RenderStats *rs, Scene *scene, char *str)
 
 	/* local view */
 	if (rs->localview)
-		spos += sprintf(spos, "%s | ", IFACE_("Local View"));
+		spos = renderinfo_append(str, spos, "%s | ", IFACE_("Local View"));
 
 	/* frame number */
-	spos += sprintf(spos, IFACE_("Frame:%d "), (scene->r.cfra));
+	spos = renderinfo_append(str, spos, IFACE_("Frame:%d "), (scene->r.cfra));
 
 	/* previous and elapsed time */
 	BLI_timestr(rs->lastframetime, info_time_str, sizeof(info_time_str));
 
 	if (rs->infostr && rs->infostr[0]) {
 		if (rs->lastframetime != 0.0)
-			spos += sprintf(spos, IFACE_("| Last:%s "), info_time_str);
+			spos = renderinfo_append(str, spos, IFACE_("| Last:%s "), info_time_str);
 		else
-			spos += sprintf(spos, "| ");
+			spos = renderinfo_append(str, spos, "| ");
 
 		BLI_timestr(PIL_check_seconds_timer() - rs->starttime, info_time_str, sizeof(info_time_str));
 	}
 	else
-		spos += sprintf(spos, "| ");
+		spos = renderinfo_append(str, spos, "| ");
 
-	spos += sprintf(spos, IFACE_("Time:%s "), info_time_str);
+	spos = renderinfo_append(str, spos, IFACE_("Time:%s "), info_time_str);
 
 	/* statistics */
 	if (rs->statstr) {
 		if (rs->statstr[0]) {
-			spos += sprintf(spos, "| %s ", rs->statstr);
+			spos = renderinfo_append(str, spos, "| %s ", rs->statstr);
 		}
 	}
 	else {
 		if (rs->totvert || rs->totface || rs->tothalo || rs->totstrand || rs->totlamp)
-			spos += sprintf(spos, "| ");
-
-		if (rs->totvert) spos += sprintf(spos, IFACE_("Ve:%d "), rs->totvert);
-		if (rs->totface) spos += sprintf(spos, IFACE_("Fa:%d "), rs->totface);
-		if (rs->tothalo) spos += sprintf(spos, IFACE_("Ha:%d "), rs->tothalo);
-		if (rs->totstrand) spos += sprintf(spos, IFACE_("St:%d "), rs->totstrand);
-		if (rs->totlamp) spos += sprintf(spos, IFACE_("La:%d "), rs->totlamp);
+			spos = renderinfo_append(str, spos, "| ");
+
+		if (rs->totvert) spos = renderinfo_append(str, spos, IFACE_("Ve:%d "), rs->totvert);
+		if (rs->totface) spos = renderinfo_append(str, spos, IFACE_("Fa:%d "), rs->totface);
+		if (rs->tothalo) spos = renderinfo_append(str, spos, IFACE_("Ha:%d "), rs->tothalo);
+		if (rs->totstrand) spos = renderinfo_append(str, spos, IFACE_("St:%d "), rs->totstrand);
+		if (rs->totlamp) spos = renderinfo_append(str, spos, IFACE_("La:%d "), rs->totlamp);
+
+		if (rs->convert_time != 0.0f) {
+			spos = renderinfo_append(str, spos, IFACE_("| Conv:%.2fs "), rs->convert_time);
+			if (rs->convert_slowest[0])
+				spos = renderinfo_append(str, spos, IFACE_("(%s %.2fs) "), rs->convert_slowest, rs->convert_slowest_time);
+		}
+		if (rs->raytree_nodes)
+			spos = renderinfo_append(str, spos, IFACE_("| Tree:%d nodes %.2fs "), rs->raytree_nodes, rs->raytree_time);
+		if (rs->totray_reflect || rs->totray_shadow || rs->totray_ao)
+			spos = renderinfo_append(str, spos, IFACE_("Rays:%.2fM (Re:%.2fM Sh:%.2fM AO:%.2fM) "),
+			                         (rs->totray_reflect + rs->totray_shadow + rs->totray_ao) * 1e-6,
+			                         rs->totray_reflect * 1e-6, rs->totray_shadow * 1e-6, rs->totray_ao * 1e-6);
 
 		if (rs->mem_peak == 0.0f)
-			spos += sprintf(spos, IFACE_("| Mem:%.2fM (%.2fM, Peak %.2fM) "),
-			                megs_used_memory, mmap_used_memory, megs_peak_memory);
+			spos = renderinfo_append(str, spos, IFACE_("| Mem:%.2fM (%.2fM, Peak %.2fM) "),
+			                         megs_used_memory, mmap_used_memory, megs_peak_memory);
 		else
-			spos += sprintf(spos, IFACE_("| Mem:%.2fM, Peak: %.2fM "), rs->mem_used, rs->mem_peak);
+			spos = renderinfo_append(str, spos, IFACE_("| Mem:%.2fM, Peak: %.2fM "), rs->mem_used, rs->mem_peak);
 
 		if (rs->curfield)
-			spos += sprintf(spos, IFACE_("Field %d "), rs->curfield);
+			spos = renderinfo_append(str, spos, IFACE_("Field %d "), rs->curfield);
 		if (rs->curblur)
-			spos += sprintf(spos, IFACE_("Blur %d "), rs->curblur);
+			spos = renderinfo_append(str, spos, IFACE_("Blur %d "), rs->curblur);
 	}
 
 	/* full sample */
 	if (rs->curfsa)
-		spos += sprintf(spos, IFACE_("| Full Sample %d "), rs->curfsa);
+		spos = renderinfo_append(str, spos, IFACE_("| Full Sample %d "), rs->curfsa);
 	
 	/* extra info */
 	if (rs->infostr && rs->infostr[0])
-		spos += sprintf(spos, "| %s ", rs->infostr);
-
-	/* very weak... but 512 characters is quite safe */
-	if (spos >= str + IMA_MAX_RENDER_TEXT)
-		if (G.debug & G_DEBUG)
-			printf("WARNING! renderwin text beyond limit\n");
-
+		spos = renderinfo_append(str, spos, "| %s ", rs->infostr);
 }
 
 static void image_renderinfo_cb(void *rjv, RenderStats *rs)
@@ -743,6 +743,15 @@ void IMB_exrtile_write_channels(void *handle, int partx, int party, int level)
 }
 
 void IMB_exr_write_channels(void *handle)
+{
+	ExrHandle *data = (ExrHandle *)handle;
+
+	IMB_exr_write_channels_rows(handle, data->height);
+}
+
+/* write the next totrow scanlines, top to bottom. channel rects point to where
+ * the full image would start, so they can be set per band of rows */
+void IMB_exr_write_channels_rows(void *handle, int totrow)
 {
 	ExrHandle *data = (ExrHandle *)handle;
 	FrameBuffer frameBuffer;
@@ -759,7 +768,7 @@ void IMB_exr_write_channels(void *handle)
 
 		data->ofile->setFrameBuffer(frameBuffer);
 		try {
-			data->ofile->writePixels(data->height);
+			data->ofile->writePixels(totrow);
 		}
 		catch (const std::exception &exc) {
 			std::cerr << "OpenEXR-writePixels: ERROR: " << exc.what() << std::endl;
@@ -771,6 +780,15 @@ void IMB_exr_write_channels(void *handle)
 }
 
 void IMB_exr_read_channels(void *handle)
+{
+	ExrHandle *data = (ExrHandle *)handle;
+
+	IMB_exr_read_channels_rows(handle, 0, data->height - 1);
+}
+
+/* read rows ymin to ymax, counted from the bottom like blender images. channel
+ * rects point to where the full image would start */
+void IMB_exr_read_channels_rows(void *handle, int ymin, int ymax)
 {
 	ExrHandle *data = (ExrHandle *)handle;
 	FrameBuffer frameBuffer;
@@ -797,7 +815,10 @@ void IMB_exr_read_channels(void *handle)
 	data->ifile->setFrameBuffer(frameBuffer);
 
 	try {
-		data->ifile->readPixels(0, data->height - 1);
+		if (flip)
+			data->ifile->readPixels(ymin, ymax);
+		else
+			data->ifile->readPixels(data->height - 1 - ymax, data->height - 1 - ymin);
 	}
 	catch (const std::exception &exc) {
 		std::cerr << "OpenEXR-readPixels: ERROR: " << exc.what() << std::endl;
@@ -43,7 +43,9 @@ void    IMB_exrtile_begin_write     (void *handle, const char *filename, int mip
 void    IMB_exr_set_channel         (void *handle, const char *layname, const char *channame, int xstride, int ystride, float *rect) { (void)handle; (void)layname; (void)channame; (void)xstride; (void)ystride; (void)rect; }
 
 void    IMB_exr_read_channels       (void *handle) { (void)handle; }
+void    IMB_exr_read_channels_rows  (void *handle, int ymin, int ymax) { (void)handle; (void)ymin; (void)ymax; }
 void    IMB_exr_write_channels      (void *handle) { (void)handle; }
+void    IMB_exr_write_channels_rows (void *handle, int totrow) { (void)handle; (void)totrow; }
 void    IMB_exrtile_write_channels  (void *handle, int partx, int party, int level) { (void)handle; (void)partx; (void)party; (void)level; }
 void    IMB_exrtile_clear_channels  (void *handle) { (void)handle; }
 
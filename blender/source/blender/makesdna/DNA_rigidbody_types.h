@@ -80,7 +80,9 @@ typedef enum eRigidBodyWorld_Flag {
 	/* sim data needs to be rebuilt */
 	RBW_FLAG_NEEDS_REBUILD		= (1 << 1),
 	/* usse split impulse when stepping the simulation */
-	RBW_FLAG_USE_SPLIT_IMPULSE	= (1 << 2)
+	RBW_FLAG_USE_SPLIT_IMPULSE	= (1 << 2),
+	/* collide the broadphase trees once per step instead of once per moved body */
+	RBW_FLAG_USE_DEFERRED_BROADPHASE	= (1 << 3)
 } eRigidBodyWorld_Flag;
 
 /* ******************************** */
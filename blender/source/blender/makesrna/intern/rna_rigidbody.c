@@ -133,6 +133,19 @@ static void rna_RigidBodyWorld_split_impulse_set(PointerRNA *ptr, int value)
 #endif
 }
 
+static void rna_RigidBodyWorld_deferred_broadphase_set(PointerRNA *ptr, int value)
+{
+	RigidBodyWorld *rbw = (RigidBodyWorld *)ptr->data;
+	
+	RB_FLAG_SET(rbw->flag, value, RBW_FLAG_USE_DEFERRED_BROADPHASE);
+
+#ifdef WITH_BULLET
+	if (rbw->physics_world) {
+		RB_dworld_set_broadphase_deferred(rbw->physics_world, value);
+	}
+#endif
+}
+
 /* ******************************** */
 
 static void rna_RigidBodyOb_reset(Main *bmain, Scene *scene, PointerRNA *ptr)
@@ -687,6 +700,15 @@ static void rna_def_rigidbody_world(BlenderRNA *brna)
 	                         "stability a little so use only when necessary)");
 	RNA_def_property_update(prop, NC_SCENE, "rna_RigidBodyWorld_reset");
 
+	/* deferred broadphase */
+	prop = RNA_def_property(srna, "use_deferred_broadphase", PROP_BOOLEAN, PROP_NONE);
+	RNA_def_property_boolean_sdna(prop, NULL, "flag", RBW_FLAG_USE_DEFERRED_BROADPHASE);
+	RNA_def_property_boolean_funcs(prop, NULL, "rna_RigidBodyWorld_deferred_broadphase_set");
+	RNA_def_property_ui_text(prop, "Deferred Broadphase",
+	                         "Find colliding pairs once per simulation step instead of once per moved object "
+	                         "(faster with many moving objects, but may change the simulation result)");
+	RNA_def_property_update(prop, NC_SCENE, "rna_RigidBodyWorld_reset");
+
 	/* cache */
 	prop = RNA_def_property(srna, "point_cache", PROP_POINTER, PROP_NONE);
 	RNA_def_property_flag(prop, PROP_NEVER_NULL);
@@ -154,6 +154,36 @@ static void rna_SmokeModifier_density_get(PointerRNA *ptr, float *values)
 	memcpy(values, density, size * sizeof(float));
 }
 
+static int rna_SmokeModifier_heat_get_length(PointerRNA *ptr, int length[RNA_MAX_ARRAY_DIMENSION])
+{
+	SmokeDomainSettings *settings = (SmokeDomainSettings *)ptr->data;
+
+	if (settings->fluid) {
+		float *heat = smoke_get_heat(settings->fluid);
+		unsigned int size = settings->res[0] * settings->res[1] * settings->res[2];
+
+		if (heat)
+			length[0] = size;
+		else
+			length[0] = 0;
+	}
+	else {
+		length[0] = 0; /* No smoke domain created yet */
+	}
+
+	return length[0];
+}
+
+static void rna_SmokeModifier_heat_get(PointerRNA *ptr, float *values)
+{
+	SmokeDomainSettings *settings = (SmokeDomainSettings *)ptr->data;
+	float *heat = smoke_get_heat(settings->fluid);
+	unsigned int size = settings->res[0] * settings->res[1] * settings->res[2];
+
+	if (heat)
+		memcpy(values, heat, size * sizeof(float));
+}
+
 static void rna_SmokeFlow_density_vgroup_get(PointerRNA *ptr, char *value)
 {
 	SmokeFlowSettings *flow = (SmokeFlowSettings *)ptr->data;
@@ -364,6 +394,14 @@ static void rna_def_smoke_domain_settings(BlenderRNA *brna)
 	RNA_def_property_float_funcs(prop, "rna_SmokeModifier_density_get", NULL, NULL);
 	RNA_def_property_ui_text(prop, "Density", "Smoke density");
 
+	prop = RNA_def_property(srna, "heat", PROP_FLOAT, PROP_NONE);
+	RNA_def_property_array(prop, 32);
+	RNA_def_property_flag(prop, PROP_DYNAMIC);
+	RNA_def_property_clear_flag(prop, PROP_EDITABLE);
+	RNA_def_property_dynamic_array_funcs(prop, "rna_SmokeModifier_heat_get_length");
+	RNA_def_property_float_funcs(prop, "rna_SmokeModifier_heat_get", NULL, NULL);
+	RNA_def_property_ui_text(prop, "Heat", "Smoke heat");
+
 	prop = RNA_def_property(srna, "cell_size", PROP_FLOAT, PROP_XYZ); /* can change each frame when using adaptive domain */
 	RNA_def_property_clear_flag(prop, PROP_EDITABLE);
 	RNA_def_property_ui_text(prop, "cell_size", "Cell Size");
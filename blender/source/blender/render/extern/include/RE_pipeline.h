@@ -128,6 +128,10 @@ typedef struct RenderResult {
 	
 	/* optional saved endresult on disk */
 	int do_exr_tile;
+	/* buffers were not read back from the exr tile files, see render_result_exr_file_stream.
+	 * layers and passes have NULL rects, RE_GetRenderLayer and RE_AcquireResultImage
+	 * don't give access to them */
+	int exr_stream;
 	
 	/* for render results in Image, verify validity for sequences */
 	int framenr;
@@ -150,6 +154,13 @@ typedef struct RenderStats {
 	const char *infostr, *statstr;
 	char scene_name[MAX_ID_NAME - 2];
 	float mem_used, mem_peak;
+	/* database conversion post-processing time, and the slowest object */
+	float convert_time, convert_slowest_time;
+	char convert_slowest[MAX_ID_NAME - 2];
+	/* raytree build time and node count, and rays cast so far per type */
+	float raytree_time;
+	int raytree_nodes;
+	unsigned long long totray_reflect, totray_shadow, totray_ao;
 } RenderStats;
 
 /* *********************** API ******************** */
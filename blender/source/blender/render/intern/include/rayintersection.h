@@ -45,6 +45,10 @@ struct RayObject;
 #define RE_RAY_LCTS_MAX_SIZE	256
 #define RT_USE_LAST_HIT			/* last shadow hit is reused before raycasting on whole tree */
 //#define RT_USE_HINT			/* last hit object is reused before raycasting on whole tree */
+/* AO and area light samples are traced in packets of coherent rays, unless the
+ * debug value is set to this, which traces the same packets one ray at a time
+ * so both can be compared in the Mrays/s reported with --debug */
+#define RT_DEBUG_VALUE_NO_PACKETS	737
 
 typedef struct LCTSHint {
 	int size;
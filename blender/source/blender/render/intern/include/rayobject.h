@@ -53,6 +53,14 @@ typedef struct RayObject RayObject;
 
 int RE_rayobject_raycast(RayObject *r, struct Isect *i);
 
+/* Packet of rays traversing the structure together, for coherent rays like
+ * AO or area light samples from one shading point. All rays must have the same
+ * mode, returns a bit mask of the rays that hit */
+
+#define RE_RAY_PACKET_SIZE	8
+
+int RE_rayobject_raycast_packet(RayObject *r, struct Isect *isec, int tot);
+
 /* Acceleration Structures */
 
 RayObject *RE_rayobject_octree_create(int ocres, int size);
@@ -111,6 +119,16 @@ void RE_rayobject_hint_bb(RayObject *r, struct RayHint *hint, float min[3], floa
 /* initializes an hint for optimizing raycast where it is know that a ray will be contained inside the given cone*/
 /* void RE_rayobject_hint_cone(RayObject *r, struct RayHint *hint, float *); */
 
+/* Statistics */
+
+typedef struct RayObjectStats {
+	int totnode, totleaf;
+	float sah_cost;		/* surface area heuristic cost, relative to the root bounding box */
+} RayObjectStats;
+
+/* node counts and cost of an acceleration structure, zero for structures that don't support it */
+void RE_rayobject_stats(RayObject *r, RayObjectStats *stats);
+
 /* Internals */
 
 #include "../raytrace/rayobject_internal.h"
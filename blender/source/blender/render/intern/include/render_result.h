@@ -45,6 +45,7 @@ struct Render;
 struct RenderData;
 struct RenderLayer;
 struct RenderResult;
+struct ReportList;
 struct Scene;
 struct rcti;
 struct ColorManagedDisplaySettings;
@@ -77,6 +78,8 @@ void render_result_single_layer_end(struct Render *re);
 
 void render_result_exr_file_begin(struct Render *re);
 void render_result_exr_file_end(struct Render *re);
+int render_result_exr_file_stream(struct Render *re);
+int render_result_exr_file_write(struct Render *re, struct ReportList *reports, const char *filename, int compress);
 
 void render_result_exr_file_merge(struct RenderResult *rr, struct RenderResult *rrpart);
 
@@ -61,6 +61,7 @@ struct RenderBuckets;
 struct ObjectInstanceRen;
 struct RayObject;
 struct RayFace;
+struct RayTypeStats;
 struct RenderEngine;
 struct ReportList;
 struct Main;
@@ -202,9 +203,12 @@ struct Render
 	struct RayFace *rayfaces;
 	struct VlakPrimitive *rayprimitives;
 	float maxdist; /* needed for keeping an incorrect behavior of SUN and HEMI lights (avoid breaking old scenes) */
+	struct RayTypeStats *raystats;	/* rays cast per thread and type, while the raytree exists */
+	double raystats_start;
 
 	/* occlusion tree */
 	void *occlusiontree;
+	void *occlusionpersist;	/* per face occlusion kept between animation frames */
 	ListBase strandsurface;
 	
 	/* use this instead of R.r.cfra */
@@ -218,6 +222,7 @@ struct Render
 	ListBase lampren;	/* storage, for free */
 	
 	ListBase objecttable;
+	ListBase persistenttable;	/* ObjectRen kept between animation frames */
 
 	struct ObjectInstanceRen *objectinstance;
 	ListBase instancetable;
@@ -226,10 +231,12 @@ struct Render
 	struct Image *bakebuf;
 	
 	struct GHash *orco_hash;
+	struct GHash *instance_hash;	/* first instanceable ObjectRen per Object */
 
 	struct GHash *sss_hash;
 	ListBase *sss_points;
 	struct Material *sss_mat;
+	ListBase ssspersist;	/* sss irradiance points kept between animation frames */
 
 	ListBase customdata_names;
 
@@ -301,6 +308,9 @@ typedef struct ShadBuf {
 	int co[3];
 	int size, bias;
 	ListBase buffers;
+
+	/* threads building this buffer in bands, see threaded_makeshadowbufs() */
+	int totthread;
 	
 	/* irregular shadowbufer, result stored per thread */
 	struct ISBData *isb_result[BLENDER_MAX_THREADS];
@@ -330,11 +340,24 @@ typedef struct ObjectRen {
 
 	float obmat[4][4];	/* only used in convertblender.c, for instancing */
 
+	/* conversion post-processing, deferred so objects can be done in threads */
+	int postflag;
+	short postsmoothresh;
+	float postmat[4][4], postimat[3][3];
+	double convtime;	/* conversion time in seconds, for stats */
+
+	/* static objects kept across animation frames, see convertblender.c */
+	float persistmat[4][4];	/* inverse of view space object matrix at conversion */
+	unsigned int checksum;
+	float smoothresh;
+	float *orco;
+
 	/* used on makeraytree */
 	struct RayObject *raytree;
 	struct RayFace *rayfaces;
 	struct VlakPrimitive *rayprimitives;
 	struct ObjectInstanceRen *rayobi;
+	int totrayface;	/* raytraceable faces, counted once for all instances */
 	
 } ObjectRen;
 
@@ -621,6 +644,7 @@ typedef struct LampRen {
 #define R_BAKE_TRACE	32
 #define R_BAKING		64
 #define R_ANIMATION		128
+#define R_MBLUR_PASS	256	/* rendering one of the motion blur samples */
 
 /* vlakren->flag (vlak = face in dutch) char!!! */
 #define R_SMOOTH		1
@@ -650,6 +674,16 @@ typedef struct LampRen {
 
 /* objectren->flag */
 #define R_INSTANCEABLE		1
+#define R_NEED_FINALIZE		2
+#define R_PERSISTENT		4
+
+/* objectren->postflag */
+#define R_POST_DISPLACE			1
+#define R_POST_DISPLACE_NORMALS	2
+#define R_POST_AUTOSMOOTH		4
+#define R_POST_NORMALS			8
+#define R_POST_TANGENT			16
+#define R_POST_NMAP_TANGENT		32
 
 /* objectinstance->flag */
 #define R_DUPLI_TRANSFORMED	1
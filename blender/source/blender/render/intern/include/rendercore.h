@@ -87,6 +87,7 @@ struct RayObject *RE_rayobject_create(int type, int size, int octree_resolution)
 
 extern void freeraytree(Render *re);
 extern void makeraytree(Render *re);
+extern void update_ray_stats(Render *re);
 struct RayObject* makeraytree_object(Render *re, ObjectInstanceRen *obi);
 
 extern void ray_shadow(ShadeInput *shi, LampRen *lar, float shadfac[4]);
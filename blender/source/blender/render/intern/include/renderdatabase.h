@@ -88,6 +88,7 @@ typedef struct StrandTableNode {
 
 /* renderdatabase.c */
 void free_renderdata_tables(struct Render *re);
+void free_renderdata_object(struct ObjectRen *obr);
 void free_renderdata_vertnodes(struct VertTableNode *vertnodes);
 void free_renderdata_vlaknodes(struct VlakTableNode *vlaknodes);
 
@@ -152,6 +153,7 @@ void area_lamp_vectors(struct LampRen *lar);
 /* convertblender.c */
 void init_render_world(Render *re);
 void RE_Database_FromScene_Vectors(Render *re, struct Main *bmain, struct Scene *sce, unsigned int lay);
+void RE_Database_FreePersistent(Render *re);
 
 
 #endif /* __RENDERDATABASE_H__ */
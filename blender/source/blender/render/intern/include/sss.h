@@ -47,7 +47,7 @@ void scatter_settings_free(ScatterSettings *ss);
 
 ScatterTree *scatter_tree_new(ScatterSettings *ss[3], float scale, float error,
                               float (*co)[3], float (*color)[3], float *area, int totpoint);
-void scatter_tree_build(ScatterTree *tree);
+void scatter_tree_build(ScatterTree *tree, int totthread);
 void scatter_tree_sample(ScatterTree *tree, const float co[3], float color[3]);
 void scatter_tree_free(ScatterTree *tree);
 
@@ -60,6 +60,7 @@ struct VlakRen;
 void make_sss_tree(struct Render *re);
 void sss_add_points(Render *re, float (*co)[3], float (*color)[3], float *area, int totpoint);
 void free_sss(struct Render *re);
+void free_sss_persistent(struct Render *re);
 
 int sample_sss(struct Render *re, struct Material *mat, const float co[3], float color[3]);
 int sss_pass_done(struct Render *re, struct Material *mat);
@@ -31,6 +31,7 @@
 
 
 #include <assert.h>
+#include <string.h>
 
 #include "MEM_guardedalloc.h"
 
@@ -366,13 +367,13 @@ MALWAYS_INLINE int intersect_rayface(RayObject *hit_obj, RayFace *face, Isect *i
 
 /* Intersection */
 
-int RE_rayobject_raycast(RayObject *r, Isect *isec)
+/* setup vars used on raycast, returns true if the ray already hit its last hit */
+static int rayobject_raycast_init(Isect *isec)
 {
 	int i;
 
 	RE_RC_COUNT(isec->raycounter->raycast.test);
 
-	/* setup vars used on raycast */
 	for (i = 0; i < 3; i++) {
 		isec->idot_axis[i]          = 1.0f / isec->dir[i];
 		
@@ -400,6 +401,14 @@ int RE_rayobject_raycast(RayObject *r, Isect *isec)
 	isec->hit_hint = 0;
 #endif
 
+	return 0;
+}
+
+int RE_rayobject_raycast(RayObject *r, Isect *isec)
+{
+	if (rayobject_raycast_init(isec))
+		return 1;
+
 	if (RE_rayobject_intersect(r, isec)) {
 		RE_RC_COUNT(isec->raycounter->raycast.hit);
 
@@ -412,6 +421,47 @@ int RE_rayobject_raycast(RayObject *r, Isect *isec)
 	return 0;
 }
 
+int RE_rayobject_raycast_packet(RayObject *r, Isect *isec, int tot)
+{
+	int i, hit = 0, todo = 0;
+
+	assert(tot <= RE_RAY_PACKET_SIZE);
+
+	for (i = 0; i < tot; i++) {
+		if (rayobject_raycast_init(&isec[i]))
+			hit |= (1 << i);
+		else
+			todo |= (1 << i);
+	}
+
+	if (todo) {
+		if (RE_rayobject_isRayAPI(r) && RE_rayobject_align(r)->api->raycast_packet) {
+			RayObject *ar = RE_rayobject_align(r);
+			todo = ar->api->raycast_packet(ar, isec, tot, todo);
+		}
+		else {
+			int mask = todo;
+
+			for (i = 0, todo = 0; i < tot; i++)
+				if ((mask & (1 << i)) && RE_rayobject_intersect(r, &isec[i]))
+					todo |= (1 << i);
+		}
+
+		for (i = 0; i < tot; i++) {
+			if (todo & (1 << i)) {
+				RE_RC_COUNT(isec[i].raycounter->raycast.hit);
+#ifdef RT_USE_HINT
+				isec[i].hint = isec[i].hit_hint;
+#endif
+			}
+		}
+
+		hit |= todo;
+	}
+
+	return hit;
+}
+
 int RE_rayobject_intersect(RayObject *r, Isect *i)
 {
 	if (RE_rayobject_isRayFace(r)) {
@@ -470,6 +520,19 @@ float RE_rayobject_cost(RayObject *r)
 	}
 }
 
+/* Statistics */
+
+void RE_rayobject_stats(RayObject *r, RayObjectStats *stats)
+{
+	memset(stats, 0, sizeof(RayObjectStats));
+
+	if (RE_rayobject_isRayAPI(r)) {
+		r = RE_rayobject_align(r);
+		if (r->api->stats)
+			r->api->stats(r, stats);
+	}
+}
+
 /* Bounding Boxes */
 
 void RE_rayobject_merge_bb(RayObject *r, float min[3], float max[3])
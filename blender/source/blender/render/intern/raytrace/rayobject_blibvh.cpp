@@ -66,7 +66,9 @@ static RayObjectAPI bvh_api =
 	RE_rayobject_blibvh_free,
 	RE_rayobject_blibvh_bb,
 	RE_rayobject_blibvh_cost,
-	RE_rayobject_blibvh_hint_bb
+	RE_rayobject_blibvh_hint_bb,
+	NULL,
+	NULL
 };
 
 typedef struct BVHObject {
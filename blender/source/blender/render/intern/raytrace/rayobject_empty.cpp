@@ -69,7 +69,9 @@ static RayObjectAPI empty_api =
 	RE_rayobject_empty_free,
 	RE_rayobject_empty_bb,
 	RE_rayobject_empty_cost,
-	RE_rayobject_empty_hint_bb
+	RE_rayobject_empty_hint_bb,
+	NULL,
+	NULL
 };
 
 static RayObject empty_raytree = { &empty_api, {NULL, NULL} };
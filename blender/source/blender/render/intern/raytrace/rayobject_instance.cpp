@@ -59,7 +59,9 @@ static RayObjectAPI instance_api =
 	RE_rayobject_instance_free,
 	RE_rayobject_instance_bb,
 	RE_rayobject_instance_cost,
-	RE_rayobject_instance_hint_bb
+	RE_rayobject_instance_hint_bb,
+	NULL,
+	NULL
 };
 
 typedef struct InstanceRayObject {
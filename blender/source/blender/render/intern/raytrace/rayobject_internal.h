@@ -127,6 +127,8 @@ typedef void (*RE_rayobject_free_callback)(RayObject *);
 typedef void (*RE_rayobject_merge_bb_callback)(RayObject *, float min[3], float max[3]);
 typedef float (*RE_rayobject_cost_callback)(RayObject *);
 typedef void (*RE_rayobject_hint_bb_callback)(RayObject *, struct RayHint *, float min[3], float max[3]);
+typedef void (*RE_rayobject_stats_callback)(RayObject *, struct RayObjectStats *);
+typedef int  (*RE_rayobject_raycast_packet_callback)(RayObject *, struct Isect *, int tot, int mask);
 
 typedef struct RayObjectAPI {
 	RE_rayobject_raycast_callback	raycast;
@@ -136,6 +138,8 @@ typedef struct RayObjectAPI {
 	RE_rayobject_merge_bb_callback	bb;
 	RE_rayobject_cost_callback		cost;
 	RE_rayobject_hint_bb_callback	hint_bb;
+	RE_rayobject_stats_callback		stats;
+	RE_rayobject_raycast_packet_callback	raycast_packet;
 } RayObjectAPI;
 
 /*
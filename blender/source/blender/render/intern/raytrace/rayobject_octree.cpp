@@ -112,7 +112,9 @@ static RayObjectAPI octree_api =
 	RE_rayobject_octree_free,
 	RE_rayobject_octree_bb,
 	RE_rayobject_octree_cost,
-	RE_rayobject_octree_hint_bb
+	RE_rayobject_octree_hint_bb,
+	NULL,
+	NULL
 };
 
 /* **************** ocval method ******************* */
@@ -107,6 +107,26 @@ static int intersect(QBVHTree *obj, Isect *isec)
 		return RE_rayobject_intersect((RayObject *)obj->root, isec);
 }
 
+template<int StackSize>
+static int intersect_packet(QBVHTree *obj, Isect *isec, int tot, int mask)
+{
+	if (RE_rayobject_isAligned(obj->root)) {
+		if (isec->mode == RE_RAY_SHADOW)
+			return svbvh_node_stack_raycast_packet<StackSize, true>(obj->root, isec, tot, mask);
+		else
+			return svbvh_node_stack_raycast_packet<StackSize, false>(obj->root, isec, tot, mask);
+	}
+	else {
+		int i, hit = 0;
+
+		for (i = 0; i < tot; i++)
+			if ((mask & (1 << i)) && RE_rayobject_intersect((RayObject *)obj->root, &isec[i]))
+				hit |= (1 << i);
+
+		return hit;
+	}
+}
+
 template<class Tree>
 static void bvh_hint_bb(Tree *tree, LCTSHint *hint, float *UNUSED(min), float *UNUSED(max))
 {
@@ -128,7 +148,9 @@ static RayObjectAPI make_api()
 		(RE_rayobject_free_callback)    ((void  (*)(Tree *))       & bvh_free<Tree>),
 		(RE_rayobject_merge_bb_callback)((void  (*)(Tree *, float *, float *)) & bvh_bb<Tree>),
 		(RE_rayobject_cost_callback)    ((float (*)(Tree *))      & bvh_cost<Tree>),
-		(RE_rayobject_hint_bb_callback) ((void  (*)(Tree *, LCTSHint *, float *, float *)) & bvh_hint_bb<Tree>)
+		(RE_rayobject_hint_bb_callback) ((void  (*)(Tree *, LCTSHint *, float *, float *)) & bvh_hint_bb<Tree>),
+		(RE_rayobject_stats_callback)   ((void  (*)(Tree *, RayObjectStats *)) & svbvh_stats<Tree>),
+		(RE_rayobject_raycast_packet_callback) ((int (*)(Tree *, Isect *, int, int)) & intersect_packet<STACK_SIZE>)
 	};
 	
 	return api;
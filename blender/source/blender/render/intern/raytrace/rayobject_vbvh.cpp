@@ -152,6 +152,52 @@ static void bvh_hint_bb(Tree *tree, LCTSHint *hint, float *UNUSED(min), float *U
 	}
 }
 
+/*
+ * Sums node counts and surface area cost of a subtree, with the cost of
+ * a node weighted by the area of its bounding box
+ */
+static void vbvh_node_stats(VBVHNode *node, RayObjectStats *stats)
+{
+	if (is_leaf(node)) {
+		float min[3], max[3];
+
+		INIT_MINMAX(min, max);
+		RE_rayobject_merge_bb((RayObject *)node, min, max);
+
+		stats->totleaf++;
+		stats->sah_cost += bb_area(min, max) * RE_rayobject_cost((RayObject *)node);
+	}
+	else {
+		stats->totnode++;
+		stats->sah_cost += bb_area(node->bb, node->bb + 3);
+
+		for (VBVHNode *child = node->child; child; child = child->sibling) {
+			vbvh_node_stats(child, stats);
+
+			/* a leaf is always the only child */
+			if (is_leaf(child))
+				break;
+		}
+	}
+}
+
+template<class Tree>
+static void bvh_stats(Tree *obj, RayObjectStats *stats)
+{
+	float min[3], max[3], area;
+
+	if (obj->root == NULL)
+		return;
+
+	INIT_MINMAX(min, max);
+	bvh_node_merge_bb(obj->root, min, max);
+	area = bb_area(min, max);
+
+	vbvh_node_stats(obj->root, stats);
+	if (area > 0.0f)
+		stats->sah_cost /= area;
+}
+
 #if 0  /* UNUSED */
 static void bfree(VBVHTree *tree)
 {
@@ -184,7 +230,9 @@ static RayObjectAPI make_api()
 		(RE_rayobject_free_callback)    ((void  (*)(Tree *))       & bvh_free<Tree>),
 		(RE_rayobject_merge_bb_callback)((void  (*)(Tree *, float *, float *)) & bvh_bb<Tree>),
 		(RE_rayobject_cost_callback)    ((float (*)(Tree *))      & bvh_cost<Tree>),
-		(RE_rayobject_hint_bb_callback) ((void  (*)(Tree *, LCTSHint *, float *, float *)) & bvh_hint_bb<Tree>)
+		(RE_rayobject_hint_bb_callback) ((void  (*)(Tree *, LCTSHint *, float *, float *)) & bvh_hint_bb<Tree>),
+		(RE_rayobject_stats_callback)   ((void  (*)(Tree *, RayObjectStats *)) & bvh_stats<Tree>),
+		NULL
 	};
 	
 	return api;
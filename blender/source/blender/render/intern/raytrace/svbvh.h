@@ -154,6 +154,74 @@ static int svbvh_node_stack_raycast(SVBVHNode *root, Isect *isec)
 }
 
 
+/*
+ * Packet traversal, the rays share the stack and each node is only visited
+ * once, tested against the rays in the mask it was pushed with
+ */
+template<int MAX_STACK_SIZE, bool SHADOW>
+static int svbvh_node_stack_raycast_packet(SVBVHNode *root, Isect *isec, int tot, int mask)
+{
+	SVBVHNode *stack[MAX_STACK_SIZE], *node;
+	int stack_mask[MAX_STACK_SIZE];
+	int hit = 0, stack_pos = 0;
+
+	stack[stack_pos] = root;
+	stack_mask[stack_pos++] = mask;
+
+	while (stack_pos) {
+		stack_pos--;
+		node = stack[stack_pos];
+		mask = stack_mask[stack_pos];
+
+		/* shadow rays are done at the first hit */
+		if (SHADOW)
+			mask &= ~hit;
+		if (mask == 0)
+			continue;
+
+		if (!svbvh_node_is_leaf(node)) {
+			int nchilds = node->nchilds;
+			int child_mask[4] = {0, 0, 0, 0};
+			SVBVHNode **child = node->child;
+
+			for (int i = 0; i < tot; i++) {
+				if (!(mask & (1 << i)))
+					continue;
+
+				if (nchilds == 4) {
+					int res = svbvh_bb_intersect_test_simd4(&isec[i], ((__m128 *) (node->child_bb)));
+
+					RE_RC_COUNT(isec[i].raycounter->simd_bb.test);
+
+					if (res & 1) child_mask[0] |= (1 << i);
+					if (res & 2) child_mask[1] |= (1 << i);
+					if (res & 4) child_mask[2] |= (1 << i);
+					if (res & 8) child_mask[3] |= (1 << i);
+				}
+				else {
+					for (int c = 0; c < nchilds; c++)
+						if (svbvh_bb_intersect_test(&isec[i], node->child_bb + 6 * c))
+							child_mask[c] |= (1 << i);
+				}
+			}
+
+			for (int c = 0; c < nchilds; c++) {
+				if (child_mask[c]) {
+					stack[stack_pos] = child[c];
+					stack_mask[stack_pos++] = child_mask[c];
+				}
+			}
+		}
+		else {
+			for (int i = 0; i < tot; i++)
+				if ((mask & (1 << i)) && RE_rayobject_intersect((RayObject *)node, &isec[i]))
+					hit |= (1 << i);
+		}
+	}
+
+	return hit;
+}
+
 template<>
 inline void bvh_node_merge_bb<SVBVHNode>(SVBVHNode *node, float min[3], float max[3])
 {
@@ -187,6 +255,64 @@ inline void bvh_node_merge_bb<SVBVHNode>(SVBVHNode *node, float min[3], float ma
 
 
 
+/*
+ * Sums node counts and surface area cost of a subtree, with the cost of
+ * a node weighted by the area of its bounding box
+ */
+static void svbvh_node_stats(SVBVHNode *node, float area, RayObjectStats *stats)
+{
+	if (is_leaf(node)) {
+		stats->totleaf++;
+		stats->sah_cost += area * RE_rayobject_cost((RayObject *)node);
+	}
+	else {
+		const int nsimd = node->nchilds & ~3;
+
+		stats->totnode++;
+		stats->sah_cost += area;
+
+		for (int i = 0; i < node->nchilds; i++) {
+			float min[3], max[3];
+
+			/* padding */
+			if (node->child[i] == NULL)
+				continue;
+
+			if (i < nsimd) {
+				/* groups of 4 are stored for SIMD, see prepare_for_simd() */
+				const float *res = node->child_bb + 6 * (i & ~3);
+				for (int j = 0; j < 3; j++) {
+					min[j] = res[4 * j + (i & 3)];
+					max[j] = res[4 * (j + 3) + (i & 3)];
+				}
+			}
+			else {
+				copy_v3_v3(min, node->child_bb + 6 * i);
+				copy_v3_v3(max, node->child_bb + 6 * i + 3);
+			}
+
+			svbvh_node_stats(node->child[i], bb_area(min, max), stats);
+		}
+	}
+}
+
+template<class Tree>
+static void svbvh_stats(Tree *obj, RayObjectStats *stats)
+{
+	float min[3], max[3], area;
+
+	if (obj->root == NULL)
+		return;
+
+	INIT_MINMAX(min, max);
+	bvh_node_merge_bb(obj->root, min, max);
+	area = bb_area(min, max);
+
+	svbvh_node_stats(obj->root, area, stats);
+	if (area > 0.0f)
+		stats->sah_cost /= area;
+}
+
 /*
  * Builds a SVBVH tree form a VBVHTree
  */
@@ -42,12 +42,14 @@
 #include "BLI_memarena.h"
 #include "BLI_ghash.h"
 #include "BLI_linklist.h"
+#include "BLI_threads.h"
 #ifdef WITH_FREESTYLE
 #  include "BLI_edgehash.h"
 #endif
 
 #include "BLF_translation.h"
 
+#include "DNA_anim_types.h"
 #include "DNA_armature_types.h"
 #include "DNA_camera_types.h"
 #include "DNA_material_types.h"
@@ -56,6 +58,7 @@
 #include "DNA_group_types.h"
 #include "DNA_lamp_types.h"
 #include "DNA_image_types.h"
+#include "DNA_key_types.h"
 #include "DNA_lattice_types.h"
 #include "DNA_mesh_types.h"
 #include "DNA_meshdata_types.h"
@@ -2300,7 +2303,7 @@ static void displace_render_vert(Render *re, ObjectRen *obr, ShadeInput *shi, Ve
 	return;
 }
 
-static void displace_render_face(Render *re, ObjectRen *obr, VlakRen *vlr, float *scale, float mat[4][4], float imat[3][3])
+static void displace_render_face(Render *re, ObjectRen *obr, VlakRen *vlr, float *scale, float mat[4][4], float imat[3][3], int thread)
 {
 	ShadeInput shi;
 
@@ -2317,7 +2320,7 @@ static void displace_render_face(Render *re, ObjectRen *obr, VlakRen *vlr, float
 	shi.obr= obr;
 	shi.vlr= vlr;		/* current render face */
 	shi.mat= vlr->mat;		/* current input material */
-	shi.thread= 0;
+	shi.thread= thread;
 	
 	/* TODO, assign these, displacement with new bumpmap is skipped without - campbell */
 #if 0
@@ -2355,7 +2358,7 @@ static void displace_render_face(Render *re, ObjectRen *obr, VlakRen *vlr, float
 	}
 }
 
-static void do_displacement(Render *re, ObjectRen *obr, float mat[4][4], float imat[3][3])
+static void do_displacement(Render *re, ObjectRen *obr, float mat[4][4], float imat[3][3], int thread)
 {
 	VertRen *vr;
 	VlakRen *vlr;
@@ -2380,7 +2383,7 @@ static void do_displacement(Render *re, ObjectRen *obr, float mat[4][4], float i
 
 	for (i=0; i<obr->totvlak; i++) {
 		vlr=RE_findOrAddVlak(obr, i);
-		displace_render_face(re, obr, vlr, scale, mat, imat);
+		displace_render_face(re, obr, vlr, scale, mat, imat, thread);
 	}
 	
 	/* Recalc vertex normals */
@@ -3395,7 +3398,11 @@ static void init_render_mesh(Render *re, ObjectRen *obr, int timeoffset)
 		orco= dm->getVertDataArray(dm, CD_ORCO);
 		if (orco) {
 			orco= MEM_dupallocN(orco);
-			set_object_orco(re, ob, orco);
+			/* persistent objects outlive the orco hash */
+			if (obr->flag & R_PERSISTENT)
+				obr->orco= orco;
+			else
+				set_object_orco(re, ob, orco);
 		}
 	}
 
@@ -3690,22 +3697,28 @@ static void init_render_mesh(Render *re, ObjectRen *obr, int timeoffset)
 		if (need_stress)
 			calc_edge_stress(re, obr, me);
 
+		/* displacement, autosmooth and normals only work on the render
+		 * data itself, they're done for all objects at once in threads,
+		 * see convert_render_objects_post() */
 		if (test_for_displace(re, ob ) ) {
 			recalc_normals= 1;
-			calc_vertexnormals(re, obr, 0, 0);
-			if (do_autosmooth)
-				do_displacement(re, obr, mat, imat);
-			else
-				do_displacement(re, obr, NULL, NULL);
+			obr->postflag |= R_POST_DISPLACE|R_POST_DISPLACE_NORMALS;
 		}
 
 		if (do_autosmooth) {
 			recalc_normals= 1;
-			autosmooth(re, obr, mat, me->smoothresh);
+			obr->postflag |= R_POST_AUTOSMOOTH;
+			obr->postsmoothresh= me->smoothresh;
+		}
+
+		if (recalc_normals!=0 || need_tangent!=0) {
+			obr->postflag |= R_POST_NORMALS;
+			if (need_tangent) obr->postflag |= R_POST_TANGENT;
+			if (need_nmap_tangent) obr->postflag |= R_POST_NMAP_TANGENT;
 		}
 
-		if (recalc_normals!=0 || need_tangent!=0)
-			calc_vertexnormals(re, obr, need_tangent, need_nmap_tangent);
+		copy_m4_m4(obr->postmat, mat);
+		copy_m3_m3(obr->postimat, imat);
 	}
 
 	dm->release(dm);
@@ -4485,12 +4498,7 @@ static void finalize_render_object(Render *re, ObjectRen *obr, int timeoffset)
 	int a, b;
 
 	if (obr->totvert || obr->totvlak || obr->tothalo || obr->totstrand) {
-		/* the exception below is because displace code now is in init_render_mesh call, 
-		 * I will look at means to have autosmooth enabled for all object types
-		 * and have it as general postprocess, like displace */
-		if (ob->type!=OB_MESH && test_for_displace(re, ob))
-			do_displacement(re, obr, NULL, NULL);
-	
+		/* displacement was done before in convert_render_objects_post() */
 		if (!timeoffset) {
 			/* phong normal interpolation can cause error in tracing
 			 * (terminator problem) */
@@ -4634,14 +4642,30 @@ static ObjectRen *find_dupligroup_dupli(Render *re, Object *ob, int psysindex)
 		return NULL;
 
 	/* try to find an object that was already created so we can reuse it
-	 * and save memory */
-	for (obr=re->objecttable.first; obr; obr=obr->next)
-		if (obr->ob == ob && obr->psysindex == psysindex && (obr->flag & R_INSTANCEABLE))
+	 * and save memory. render objects for the emitter and particle systems
+	 * of an object are added in a row, so only the first one is hashed */
+	if (re->instance_hash == NULL)
+		return NULL;
+
+	for (obr=BLI_ghash_lookup(re->instance_hash, ob); obr && obr->ob == ob; obr=obr->next)
+		if (obr->psysindex == psysindex && (obr->flag & R_INSTANCEABLE))
 			return obr;
 	
 	return NULL;
 }
 
+static void add_instanceable_render_object(Render *re, ObjectRen *obr)
+{
+	obr->flag |= R_INSTANCEABLE;
+	copy_m4_m4(obr->obmat, obr->ob->obmat);
+
+	if (!re->instance_hash)
+		re->instance_hash = BLI_ghash_ptr_new("add_instanceable_render_object gh");
+
+	if (!BLI_ghash_haskey(re->instance_hash, obr->ob))
+		BLI_ghash_insert(re->instance_hash, obr->ob, obr);
+}
+
 static void set_dupli_tex_mat(Render *re, ObjectInstanceRen *obi, DupliObject *dob)
 {
 	/* For duplis we need to have a matrix that transform the coordinate back
@@ -4688,6 +4712,7 @@ static void init_render_object_data(Render *re, ObjectRen *obr, int timeoffset)
 {
 	Object *ob= obr->ob;
 	ParticleSystem *psys;
+	double start= PIL_check_seconds_timer();
 	int i;
 
 	if (obr->psysindex) {
@@ -4718,7 +4743,16 @@ static void init_render_object_data(Render *re, ObjectRen *obr, int timeoffset)
 			init_render_mball(re, obr);
 	}
 
-	finalize_render_object(re, obr, timeoffset);
+	/* the exception below is because displace code now is in init_render_mesh call, 
+	 * I will look at means to have autosmooth enabled for all object types
+	 * and have it as general postprocess, like displace */
+	if (obr->totvert || obr->totvlak || obr->tothalo || obr->totstrand)
+		if (ob->type!=OB_MESH && test_for_displace(re, ob))
+			obr->postflag |= R_POST_DISPLACE;
+
+	/* post-processing and finalizing is done for all objects together */
+	obr->flag |= R_NEED_FINALIZE;
+	obr->convtime= PIL_check_seconds_timer() - start;
 
 	re->totvert += obr->totvert;
 	re->totvlak += obr->totvlak;
@@ -4726,6 +4760,468 @@ static void init_render_object_data(Render *re, ObjectRen *obr, int timeoffset)
 	re->totstrand += obr->totstrand;
 }
 
+/* displacement, autosmooth, normals and tangents of an object, these only
+ * touch the object's own render data so objects can be done in parallel */
+static void postprocess_render_object(Render *re, ObjectRen *obr, int thread)
+{
+	int flag= obr->postflag;
+
+	if (flag & R_POST_DISPLACE) {
+		if (flag & R_POST_DISPLACE_NORMALS)
+			calc_vertexnormals(re, obr, 0, 0);
+
+		if (flag & R_POST_AUTOSMOOTH)
+			do_displacement(re, obr, obr->postmat, obr->postimat, thread);
+		else
+			do_displacement(re, obr, NULL, NULL, thread);
+	}
+
+	if (flag & R_POST_AUTOSMOOTH)
+		autosmooth(re, obr, obr->postmat, obr->postsmoothresh);
+
+	if (flag & R_POST_NORMALS)
+		calc_vertexnormals(re, obr, (flag & R_POST_TANGENT) != 0, (flag & R_POST_NMAP_TANGENT) != 0);
+
+	obr->postflag= 0;
+}
+
+/* number of slowest objects printed in the conversion stats */
+#define CONVERT_STATS_MAX	10
+
+typedef struct ConvertPostThread {
+	Render *re;
+	ThreadQueue *workqueue;
+	int thread;
+} ConvertPostThread;
+
+static void *do_convert_post_thread(void *data_v)
+{
+	ConvertPostThread *data= data_v;
+	ObjectRen *obr;
+
+	while ((obr= BLI_thread_queue_pop(data->workqueue))) {
+		double start= PIL_check_seconds_timer();
+
+		if (!data->re->test_break(data->re->tbh))
+			postprocess_render_object(data->re, obr, data->thread);
+
+		obr->convtime += PIL_check_seconds_timer() - start;
+	}
+
+	return NULL;
+}
+
+static int postprocess_size_cmp(const void *a1, const void *a2)
+{
+	const ObjectRen *obr1= *(const ObjectRen **)a1, *obr2= *(const ObjectRen **)a2;
+
+	if (obr1->totvlak < obr2->totvlak) return 1;
+	else if (obr1->totvlak > obr2->totvlak) return -1;
+	return 0;
+}
+
+static int convtime_cmp(const void *a1, const void *a2)
+{
+	const ObjectRen *obr1= *(const ObjectRen **)a1, *obr2= *(const ObjectRen **)a2;
+
+	if (obr1->convtime < obr2->convtime) return 1;
+	else if (obr1->convtime > obr2->convtime) return -1;
+	return 0;
+}
+
+/* per object conversion times, slowest first */
+static void print_convert_stats(ObjectRen **obrs, int totobr, double posttime)
+{
+	int a;
+
+	qsort(obrs, totobr, sizeof(ObjectRen *), convtime_cmp);
+
+	printf("Render conversion: %d objects, %.3f s post-processing\n", totobr, posttime);
+	for (a=0; a<totobr && a<CONVERT_STATS_MAX; a++) {
+		ObjectRen *obr= obrs[a];
+
+		if (obr->psysindex)
+			printf("  %-32s psys %-3d %8.3f s  (Ve:%d Fa:%d St:%d)\n", obr->ob->id.name+2, obr->psysindex,
+			       obr->convtime, obr->totvert, obr->totvlak, obr->totstrand);
+		else
+			printf("  %-32s          %8.3f s  (Ve:%d Fa:%d Ha:%d)\n", obr->ob->id.name+2,
+			       obr->convtime, obr->totvert, obr->totvlak, obr->tothalo);
+	}
+}
+
+/* runs the deferred post-processing of all newly converted objects in
+ * threads, then finalizes them in database order */
+static void convert_render_objects_post(Render *re, int timeoffset)
+{
+	ObjectRen *obr, **obrs;
+	double start= PIL_check_seconds_timer();
+	int a, totobr= 0, totpost= 0, totthread, totvert= 0;
+
+	for (obr=re->objecttable.first; obr; obr=obr->next) {
+		if (obr->flag & R_NEED_FINALIZE) {
+			totobr++;
+			totvert += obr->totvert;
+			if (obr->postflag)
+				totpost++;
+		}
+	}
+
+	if (totobr == 0)
+		return;
+
+	obrs= MEM_mallocN(sizeof(ObjectRen *)*totobr, "convert objects");
+	for (a=0, obr=re->objecttable.first; obr; obr=obr->next)
+		if (obr->flag & R_NEED_FINALIZE)
+			obrs[a++]= obr;
+
+	totthread= min_ii(re->r.threads, totpost);
+
+	if (totthread > 1) {
+		ListBase threads;
+		ConvertPostThread thread[BLENDER_MAX_THREADS];
+		ThreadQueue *workqueue= BLI_thread_queue_init();
+		ObjectRen **postobrs= MEM_mallocN(sizeof(ObjectRen *)*totpost, "convert post objects");
+
+		/* biggest objects first, so the last ones to finish are small */
+		for (a=0, totpost=0; a<totobr; a++)
+			if (obrs[a]->postflag)
+				postobrs[totpost++]= obrs[a];
+		qsort(postobrs, totpost, sizeof(ObjectRen *), postprocess_size_cmp);
+
+		for (a=0; a<totpost; a++)
+			BLI_thread_queue_push(workqueue, postobrs[a]);
+		BLI_thread_queue_nowait(workqueue);
+
+		BLI_init_threads(&threads, do_convert_post_thread, totthread);
+		for (a=0; a<totthread; a++) {
+			thread[a].re= re;
+			thread[a].workqueue= workqueue;
+			thread[a].thread= a;
+			BLI_insert_thread(&threads, &thread[a]);
+		}
+		BLI_end_threads(&threads);
+
+		BLI_thread_queue_free(workqueue);
+		MEM_freeN(postobrs);
+	}
+	else if (totpost) {
+		for (a=0; a<totobr; a++) {
+			if (obrs[a]->postflag) {
+				double time= PIL_check_seconds_timer();
+				postprocess_render_object(re, obrs[a], 0);
+				obrs[a]->convtime += PIL_check_seconds_timer() - time;
+			}
+		}
+	}
+
+	for (a=0; a<totobr; a++) {
+		int totvlak;
+
+		obr= obrs[a];
+		totvlak= obr->totvlak;
+
+		finalize_render_object(re, obr, timeoffset);
+		obr->flag &= ~R_NEED_FINALIZE;
+
+		/* quads may have been split */
+		re->totvlak += obr->totvlak - totvlak;
+	}
+
+	/* autosmooth splits vertices */
+	for (a=0; a<totobr; a++)
+		totvert -= obrs[a]->totvert;
+	re->totvert -= totvert;
+
+	if (!timeoffset) {
+		ObjectRen *slowest= obrs[0];
+
+		for (a=1; a<totobr; a++)
+			if (obrs[a]->convtime > slowest->convtime)
+				slowest= obrs[a];
+
+		re->i.convert_time= (float)(PIL_check_seconds_timer() - start);
+		re->i.convert_slowest_time= (float)slowest->convtime;
+		BLI_strncpy(re->i.convert_slowest, slowest->ob->id.name+2, sizeof(re->i.convert_slowest));
+
+		if (G.debug & G_DEBUG)
+			print_convert_stats(obrs, totobr, re->i.convert_time);
+	}
+
+	MEM_freeN(obrs);
+}
+
+static int get_vector_renderlayers(Scene *sce)
+{
+	SceneRenderLayer *srl;
+	unsigned int lay= 0;
+
+	for (srl= sce->r.layers.first; srl; srl= srl->next)
+		if (srl->passflag & SCE_PASS_VECTOR)
+			lay |= srl->lay;
+
+	return lay;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Persistent Objects														 */
+/* ------------------------------------------------------------------------- */
+
+/* Between motion blur samples, and with persistent data enabled also between
+ * animation frames, mesh objects with static geometry are kept in
+ * re->persistenttable together with their raytree. Their render data stays in
+ * the view space of the sample it was converted in, an instance matrix maps it
+ * to the current view like for dupli instances, so moving objects and camera
+ * are handled and only geometry changes need a new conversion. */
+
+static int use_persistent_objects(Render *re)
+{
+	if (!(re->flag & R_MBLUR_PASS) && !((re->flag & R_ANIMATION) && (re->r.mode & R_PERSISTENT_DATA)))
+		return 0;
+	if ((re->flag & R_BAKING) || (re->r.scemode & (R_BUTS_PREVIEW|R_VIEWPORT_PREVIEW)))
+		return 0;
+	/* speed vectors are computed from vertex positions in each frame */
+	if (get_vector_renderlayers(re->scene))
+		return 0;
+
+	return 1;
+}
+
+/* animating transform is fine, it only changes the instance matrix */
+static int anim_is_transform_only(AnimData *adt)
+{
+	static const char *paths[]= {"location", "rotation_", "scale", "delta_", "constraints", NULL};
+	ListBase *curves[2];
+	FCurve *fcu;
+	int a, b;
+
+	if (adt == NULL)
+		return 1;
+	/* strips can animate anything */
+	if (adt->nla_tracks.first)
+		return 0;
+
+	curves[0]= (adt->action)? &adt->action->curves: NULL;
+	curves[1]= &adt->drivers;
+
+	for (a=0; a<2; a++) {
+		if (curves[a] == NULL)
+			continue;
+
+		for (fcu=curves[a]->first; fcu; fcu=fcu->next) {
+			if (fcu->rna_path == NULL)
+				return 0;
+
+			for (b=0; paths[b]; b++)
+				if (STRPREFIX(fcu->rna_path, paths[b]))
+					break;
+
+			if (paths[b] == NULL)
+				return 0;
+		}
+	}
+
+	return 1;
+}
+
+static void render_object_dependency_walk(void *userData, Object *UNUSED(ob), ID **idpoin)
+{
+	int *depends= userData;
+
+	if (*idpoin)
+		*depends= 1;
+}
+
+static int render_object_is_static(Render *re, Object *ob)
+{
+	Mesh *me;
+	int depends= 0;
+
+	if (ob->type != OB_MESH || ob->particlesystem.first || (ob->transflag & OB_DUPLI))
+		return 0;
+	/* armature, lattice and curve parent deform */
+	if (ob->parent && ob->partype == PARSKEL)
+		return 0;
+	if (!anim_is_transform_only(ob->adt))
+		return 0;
+
+	me= ob->data;
+	if (me->adt || (me->key && me->key->adt))
+		return 0;
+
+	/* simulations and other time dependent modifiers */
+	if (BKE_object_is_animated(re->scene, ob))
+		return 0;
+
+	/* modifiers using other objects or textures change along with them */
+	modifiers_foreachIDLink(ob, render_object_dependency_walk, &depends);
+	if (depends)
+		return 0;
+
+	/* displacement textures may be animated */
+	if (test_for_displace(re, ob))
+		return 0;
+
+	return 1;
+}
+
+static int use_persistent_render_object(Render *re, Object *ob, Object *par, DupliObject *dob, int timeoffset)
+{
+	if (par || dob || timeoffset || (ob->transflag & OB_RENDER_DUPLI))
+		return 0;
+
+	return use_persistent_objects(re) && render_object_is_static(re, ob);
+}
+
+/* FNV-1a, over words instead of bytes */
+static unsigned int checksum_words(unsigned int hash, const void *data, size_t size)
+{
+	const unsigned int *word= data;
+	size_t a, len= size/sizeof(unsigned int);
+
+	for (a=0; a<len; a++)
+		hash= (hash ^ word[a]) * 16777619u;
+
+	return hash;
+}
+
+/* geometry can still be changed without animation, by scripts in frame
+ * change handlers for example, so the mesh itself gets compared too */
+static unsigned int render_object_checksum(Object *ob)
+{
+	Mesh *me= ob->data;
+	ModifierData *md;
+	int tot[6], a;
+	unsigned int hash= 2166136261u;
+
+	tot[0]= me->totvert;
+	tot[1]= me->totedge;
+	tot[2]= me->totpoly;
+	tot[3]= me->totloop;
+	tot[4]= ob->totcol;
+	tot[5]= (me->flag & ME_AUTOSMOOTH)? me->smoothresh: -1;
+	hash= checksum_words(hash, tot, sizeof(tot));
+
+	if (me->mvert) hash= checksum_words(hash, me->mvert, sizeof(MVert)*me->totvert);
+	if (me->medge) hash= checksum_words(hash, me->medge, sizeof(MEdge)*me->totedge);
+	if (me->mpoly) hash= checksum_words(hash, me->mpoly, sizeof(MPoly)*me->totpoly);
+	if (me->mloop) hash= checksum_words(hash, me->mloop, sizeof(MLoop)*me->totloop);
+
+	for (a=1; a<=ob->totcol; a++) {
+		Material *ma= give_current_material(ob, a);
+		hash= checksum_words(hash, &ma, sizeof(ma));
+	}
+
+	for (md=ob->modifiers.first; md; md=md->next) {
+		tot[0]= md->type;
+		tot[1]= md->mode;
+		hash= checksum_words(hash, tot, sizeof(int)*2);
+	}
+
+	return hash;
+}
+
+/* from the view space the object was converted in to the current one */
+static void add_persistent_render_instance(Render *re, ObjectRen *obr)
+{
+	Object *ob= obr->ob;
+	float obmat[4][4], mat[4][4];
+
+	mul_m4_m4m4(obmat, re->viewmat, ob->obmat);
+	mul_m4_m4m4(mat, obmat, obr->persistmat);
+
+	RE_addRenderInstance(re, obr, ob, NULL, obr->index, 0, mat, ob->lay);
+}
+
+static void init_persistent_render_object(Render *re, ObjectRen *obr)
+{
+	Object *ob= obr->ob;
+	float obmat[4][4];
+
+	obr->flag |= R_PERSISTENT;
+	obr->checksum= render_object_checksum(ob);
+
+	mul_m4_m4m4(obmat, re->viewmat, ob->obmat);
+	invert_m4_m4(obr->persistmat, obmat);
+}
+
+/* reuse the object converted in an earlier frame, returns 0 when it has
+ * to be converted again */
+static int add_persistent_render_object(Render *re, Object *ob, Object *par, DupliObject *dob, int timeoffset)
+{
+	ObjectRen *obr;
+	int i;
+
+	if (re->persistenttable.first == NULL)
+		return 0;
+	if (!use_persistent_render_object(re, ob, par, dob, timeoffset))
+		return 0;
+
+	for (obr=re->persistenttable.first; obr; obr=obr->next)
+		if (obr->ob == ob)
+			break;
+
+	if (obr == NULL)
+		return 0;
+
+	BLI_remlink(&re->persistenttable, obr);
+
+	if (obr->lay != ob->lay || obr->checksum != render_object_checksum(ob)) {
+		free_renderdata_object(obr);
+		MEM_freeN(obr);
+		return 0;
+	}
+
+	BLI_addtail(&re->objecttable, obr);
+	add_persistent_render_instance(re, obr);
+
+	/* material flags and volumes are set up each frame */
+	for (i=1; i<=max_ii(ob->totcol, 1); i++) {
+		Material *ma= give_render_material(re, ob, i);
+		if (ma && ma->material_type == MA_TYPE_VOLUME)
+			add_volume(re, obr, ma);
+	}
+
+	/* set by finalize_render_object */
+	ob->smoothresh= obr->smoothresh;
+
+	re->totvert += obr->totvert;
+	re->totvlak += obr->totvlak;
+	re->totstrand += obr->totstrand;
+
+	return 1;
+}
+
+/* move the static objects out of the database before it gets freed */
+static void keep_persistent_render_objects(Render *re)
+{
+	ObjectRen *obr, *next;
+
+	for (obr=re->objecttable.first; obr; obr=next) {
+		next= obr->next;
+
+		if (!(obr->flag & R_PERSISTENT) || (obr->flag & R_NEED_FINALIZE))
+			continue;
+		/* halos are projected in place */
+		if (obr->tothalo)
+			continue;
+
+		obr->smoothresh= obr->ob->smoothresh;
+
+		BLI_remlink(&re->objecttable, obr);
+		BLI_addtail(&re->persistenttable, obr);
+	}
+}
+
+void RE_Database_FreePersistent(Render *re)
+{
+	ObjectRen *obr;
+
+	for (obr=re->persistenttable.first; obr; obr=obr->next)
+		free_renderdata_object(obr);
+
+	BLI_freelistN(&re->persistenttable);
+}
+
 static void add_render_object(Render *re, Object *ob, Object *par, DupliObject *dob, int timeoffset)
 {
 	ObjectRen *obr;
@@ -4753,14 +5249,16 @@ static void add_render_object(Render *re, Object *ob, Object *par, DupliObject *
 	/* one render object for the data itself */
 	if (allow_render) {
 		obr= RE_addRenderObject(re, ob, par, index, 0, ob->lay);
-		if ((dob && !dob->animated) || (ob->transflag & OB_RENDER_DUPLI)) {
-			obr->flag |= R_INSTANCEABLE;
-			copy_m4_m4(obr->obmat, ob->obmat);
-		}
+		if ((dob && !dob->animated) || (ob->transflag & OB_RENDER_DUPLI))
+			add_instanceable_render_object(re, obr);
+		else if (use_persistent_render_object(re, ob, par, dob, timeoffset))
+			init_persistent_render_object(re, obr);
 		init_render_object_data(re, obr, timeoffset);
 
 		/* only add instance for objects that have not been used for dupli */
-		if (!(ob->transflag & OB_RENDER_DUPLI)) {
+		if (obr->flag & R_PERSISTENT)
+			add_persistent_render_instance(re, obr);
+		else if (!(ob->transflag & OB_RENDER_DUPLI)) {
 			obi= RE_addRenderInstance(re, obr, ob, par, index, 0, NULL, ob->lay);
 			if (dob) set_dupli_tex_mat(re, obi, dob);
 		}
@@ -4779,10 +5277,8 @@ static void add_render_object(Render *re, Object *ob, Object *par, DupliObject *
 		psysindex= 1;
 		for (psys=ob->particlesystem.first; psys; psys=psys->next, psysindex++) {
 			obr= RE_addRenderObject(re, ob, par, index, psysindex, ob->lay);
-			if ((dob && !dob->animated) || (ob->transflag & OB_RENDER_DUPLI)) {
-				obr->flag |= R_INSTANCEABLE;
-				copy_m4_m4(obr->obmat, ob->obmat);
-			}
+			if ((dob && !dob->animated) || (ob->transflag & OB_RENDER_DUPLI))
+				add_instanceable_render_object(re, obr);
 			if (dob)
 				psys->flag |= PSYS_USE_IMAT;
 			init_render_object_data(re, obr, timeoffset);
@@ -4811,8 +5307,10 @@ static void init_render_object(Render *re, Object *ob, Object *par, DupliObject
 
 	if (ob->type==OB_LAMP)
 		add_render_lamp(re, ob);
-	else if (render_object_type(ob->type))
-		add_render_object(re, ob, par, dob, timeoffset);
+	else if (render_object_type(ob->type)) {
+		if (!add_persistent_render_object(re, ob, par, dob, timeoffset))
+			add_render_object(re, ob, par, dob, timeoffset);
+	}
 	else {
 		mul_m4_m4m4(mat, re->viewmat, ob->obmat);
 		invert_m4_m4(ob->imat, mat);
@@ -4860,11 +5358,27 @@ void RE_Database_Free(Render *re)
 	BLI_freelistN(&re->lampren);
 	BLI_freelistN(&re->lights);
 
+	/* static objects are kept for the next frame of an animation */
+	if (re->main && re->i.convertdone && use_persistent_objects(re))
+		keep_persistent_render_objects(re);
+	else
+		RE_Database_FreePersistent(re);
+
+	if (!(re->flag & R_ANIMATION) || !(re->r.mode & R_PERSISTENT_DATA)) {
+		free_occ_persistent(re);
+		free_sss_persistent(re);
+	}
+
 	free_renderdata_tables(re);
 
 	/* free orco */
 	free_mesh_orco_hash(re);
 
+	if (re->instance_hash) {
+		BLI_ghash_free(re->instance_hash, NULL, NULL);
+		re->instance_hash = NULL;
+	}
+
 	if (re->main) {
 		end_render_materials(re->main);
 		end_render_textures(re);
@@ -4951,8 +5465,9 @@ static int allow_render_dupli_instance(Render *UNUSED(re), DupliObject *dob, Obj
 		}
 	}
 
+	/* halo particles are sorted globally too, other types can be instanced */
 	for (psys=obd->particlesystem.first; psys; psys=psys->next)
-		if (!ELEM5(psys->part->ren_as, PART_DRAW_BB, PART_DRAW_LINE, PART_DRAW_PATH, PART_DRAW_OB, PART_DRAW_GR))
+		if (!ELEM6(psys->part->ren_as, PART_DRAW_NOT, PART_DRAW_BB, PART_DRAW_LINE, PART_DRAW_PATH, PART_DRAW_OB, PART_DRAW_GR))
 			return 0;
 
 	/* don't allow lamp, animated duplis, or radio render */
@@ -5004,18 +5519,6 @@ static void dupli_render_particle_set(Render *re, Object *ob, int timeoffset, in
 		dupli_render_particle_set(re, go->ob, timeoffset, level+1, enable);
 }
 
-static int get_vector_renderlayers(Scene *sce)
-{
-	SceneRenderLayer *srl;
-	unsigned int lay= 0;
-
-	for (srl= sce->r.layers.first; srl; srl= srl->next)
-		if (srl->passflag & SCE_PASS_VECTOR)
-			lay |= srl->lay;
-
-	return lay;
-}
-
 static void add_group_render_dupli_obs(Render *re, Group *group, int nolamps, int onlyselected, Object *actob, int timeoffset, int level)
 {
 	GroupObject *go;
@@ -5214,6 +5717,12 @@ static void database_init_objects(Render *re, unsigned int renderlay, int nolamp
 	for (group= re->main->group.first; group; group=group->id.next)
 		add_group_render_dupli_obs(re, group, nolamps, onlyselected, actob, timeoffset, 0);
 
+	/* displacement, autosmooth and normals of all objects, in threads */
+	convert_render_objects_post(re, timeoffset);
+
+	/* kept objects that were not used this frame */
+	RE_Database_FreePersistent(re);
+
 	if (!re->test_break(re->tbh))
 		RE_makeRenderInstances(re);
 }
@@ -5423,6 +5932,11 @@ static void database_fromscene_vectors(Render *re, Scene *scene, unsigned int la
 	re->memArena = BLI_memarena_new(BLI_MEMARENA_STD_BUFSIZE, "vector render db arena");
 	re->totvlak=re->totvert=re->totstrand=re->totlamp=re->tothalo= 0;
 	re->i.totface=re->i.totvert=re->i.totstrand=re->i.totlamp=re->i.tothalo= 0;
+	re->i.convert_time= re->i.convert_slowest_time= 0.0f;
+	re->i.convert_slowest[0]= '\0';
+	re->i.raytree_time= 0.0f;
+	re->i.raytree_nodes= 0;
+	re->i.totray_reflect= re->i.totray_shadow= re->i.totray_ao= 0;
 	re->lights.first= re->lights.last= NULL;
 
 	slurph_opt= 0;
@@ -455,6 +455,11 @@ int RE_engine_render(Render *re, int do_all)
 	re->i.cfra = re->scene->r.cfra;
 	BLI_strncpy(re->i.scene_name, re->scene->id.name + 2, sizeof(re->i.scene_name));
 	re->i.totface = re->i.totvert = re->i.totstrand = re->i.totlamp = re->i.tothalo = 0;
+	re->i.convert_time = re->i.convert_slowest_time = 0.0f;
+	re->i.convert_slowest[0] = '\0';
+	re->i.raytree_time = 0.0f;
+	re->i.raytree_nodes = 0;
+	re->i.totray_reflect = re->i.totray_shadow = re->i.totray_ao = 0;
 
 	/* render */
 	engine = re->engine;
@@ -66,17 +66,33 @@
 #define INVPI ((float)M_1_PI)
 #define TOTCHILD 8
 #define CACHE_STEP 3
+#define CACHE_LEVELS 3	/* coarsest samples are CACHE_STEP << (CACHE_LEVELS - 1) pixels apart */
+#define CACHE_MAX_SAMPLES (1 << 18)	/* for the caches of all threads together */
+#define CACHE_ERROR 0.05f
 
 typedef struct OcclusionCacheSample {
 	float co[3], n[3], ao[3], env[3], indirect[3], intensity, dist2;
-	int x, y, filled;
+	int x, y, filled, done;
 } OcclusionCacheSample;
 
 typedef struct OcclusionCache {
-	OcclusionCacheSample *sample;
+	OcclusionCacheSample *sample;	/* grid of samples step pixels apart, including last row and column */
+	OcclusionCacheSample last;	/* last sample shaded, reused for other samples in the same pixel */
 	int x, y, w, h, step;
+	int gridw, gridh;
+	int totsample;
 } OcclusionCache;
 
+/* per face occlusion after the passes, kept between animation frames and
+ * used again while the geometry did not move in world space */
+typedef struct OcclusionPersist {
+	float (*co)[3];		/* world space face centers and normals, in build order */
+	float (*n)[3];
+	float *occlusion;
+	float error, distfac;
+	int totface, totpass;
+} OcclusionPersist;
+
 typedef struct OccFace {
 	int obi;
 	int facenr;
@@ -98,6 +114,7 @@ typedef struct OcclusionTree {
 	MemArena *arena;
 
 	float (*co)[3];     /* temporary during build */
+	int *index;         /* face order before build, for persistent results */
 
 	OccFace *face;      /* instance and face indices */
 	float *occlusion;   /* occlusion for faces */
@@ -472,6 +489,8 @@ static void occ_build_split(OcclusionTree *tree, int begin, int end, int *split)
 			SWAP(float, tree->co[a][0], tree->co[enda][0]);
 			SWAP(float, tree->co[a][1], tree->co[enda][1]);
 			SWAP(float, tree->co[a][2], tree->co[enda][2]);
+			if (tree->index)
+				SWAP(int, tree->index[a], tree->index[enda]);
 		}
 		else
 			a++;
@@ -636,7 +655,7 @@ static void occ_build_sh_normalize(OccNode *node)
 	}
 }
 
-static OcclusionTree *occ_tree_build(Render *re)
+static OcclusionTree *occ_tree_build(Render *re, int persistent)
 {
 	OcclusionTree *tree;
 	ObjectInstanceRen *obi;
@@ -682,6 +701,9 @@ static OcclusionTree *occ_tree_build(Render *re)
 	tree->co = MEM_callocN(sizeof(float) * 3 * totface, "OcclusionCo");
 	tree->occlusion = MEM_callocN(sizeof(float) * totface, "OcclusionOcclusion");
 
+	if (persistent)
+		tree->index = MEM_mallocN(sizeof(int) * totface, "OcclusionIndex");
+
 	if (tree->doindirect)
 		tree->rad = MEM_callocN(sizeof(float) * 3 * totface, "OcclusionRad");
 
@@ -698,6 +720,8 @@ static OcclusionTree *occ_tree_build(Render *re)
 				tree->face[b].obi = c;
 				tree->face[b].facenr = a;
 				tree->occlusion[b] = 1.0f;
+				if (tree->index)
+					tree->index[b] = b;
 				occ_face(&tree->face[b], tree->co[b], NULL, NULL); 
 				b++;
 			}
@@ -724,7 +748,7 @@ static OcclusionTree *occ_tree_build(Render *re)
 	occ_build_sh_normalize(tree->root);
 
 	for (a = 0; a < BLENDER_MAX_THREADS; a++)
-		tree->stack[a] = MEM_callocN(sizeof(OccNode) * TOTCHILD * (tree->maxdepth + 1), "OccStack");
+		tree->stack[a] = MEM_callocN(sizeof(OccNode *) * TOTCHILD * (tree->maxdepth + 1), "OccStack");
 
 	return tree;
 }
@@ -741,11 +765,88 @@ static void occ_free_tree(OcclusionTree *tree)
 		if (tree->occlusion) MEM_freeN(tree->occlusion);
 		if (tree->cache) MEM_freeN(tree->cache);
 		if (tree->face) MEM_freeN(tree->face);
+		if (tree->index) MEM_freeN(tree->index);
 		if (tree->rad) MEM_freeN(tree->rad);
 		MEM_freeN(tree);
 	}
 }
 
+/* ------------------------- Persistence --------------------------- */
+
+static int occ_persistent_enabled(Render *re)
+{
+	if (!(re->flag & R_ANIMATION) || !(re->r.mode & R_PERSISTENT_DATA))
+		return 0;
+	if (re->flag & R_BAKING)
+		return 0;
+
+	return 1;
+}
+
+static OcclusionPersist *occ_persistent_new(Render *re, OcclusionTree *tree)
+{
+	OcclusionPersist *persist;
+	int a, b;
+
+	persist = MEM_callocN(sizeof(OcclusionPersist), "OcclusionPersist");
+	persist->totface = tree->totface;
+	persist->totpass = re->wrld.ao_approx_passes;
+	persist->error = tree->error;
+	persist->distfac = tree->distfac;
+
+	persist->co = MEM_mallocN(sizeof(float) * 3 * tree->totface, "OcclusionPersistCo");
+	persist->n = MEM_mallocN(sizeof(float) * 3 * tree->totface, "OcclusionPersistNor");
+	persist->occlusion = MEM_mallocN(sizeof(float) * tree->totface, "OcclusionPersistOcc");
+
+	/* faces in world space, the camera may have moved since the last frame */
+	for (a = 0; a < tree->totface; a++) {
+		b = tree->index[a];
+
+		occ_face(&tree->face[a], persist->co[b], persist->n[b], NULL);
+		mul_m4_v3(re->viewinv, persist->co[b]);
+		mul_mat3_m4_v3(re->viewinv, persist->n[b]);
+
+		persist->occlusion[b] = tree->occlusion[a];
+	}
+
+	return persist;
+}
+
+static void occ_persistent_free(OcclusionPersist *persist)
+{
+	if (persist) {
+		MEM_freeN(persist->co);
+		MEM_freeN(persist->n);
+		MEM_freeN(persist->occlusion);
+		MEM_freeN(persist);
+	}
+}
+
+static int occ_persistent_match(OcclusionPersist *old, OcclusionPersist *persist)
+{
+	float limit;
+	int a;
+
+	if (!old || !persist)
+		return 0;
+	if (old->totface != persist->totface || old->totpass != persist->totpass)
+		return 0;
+	if (old->error != persist->error || old->distfac != persist->distfac)
+		return 0;
+
+	for (a = 0; a < persist->totface; a++) {
+		/* allow for rounding in the view transform */
+		limit = 1e-5f * (1.0f + len_v3(persist->co[a]));
+
+		if (!compare_v3v3(old->co[a], persist->co[a], limit))
+			return 0;
+		if (!compare_v3v3(old->n[a], persist->n[a], 1e-4f))
+			return 0;
+	}
+
+	return 1;
+}
+
 /* ------------------------- Traversal --------------------------- */
 
 static float occ_solid_angle(OccNode *node, const float v[3], float d2, float invd2, const float receivenormal[3])
@@ -1057,67 +1158,190 @@ static void sample_occ_tree(Render *re, OcclusionTree *tree, OccFace *exclude,
 
 /* ---------------------------- Caching ------------------------------- */
 
-static OcclusionCacheSample *find_occ_sample(OcclusionCache *cache, int x, int y)
+/* samples are placed on a grid CACHE_STEP pixels apart, starting with every
+ * (1 << (CACHE_LEVELS - 1))th grid point and refining cells where the corner
+ * samples can not be interpolated between, see cache_occ_samples */
+
+static int occ_cache_coord(int i, int step, int size)
 {
-	x -= cache->x;
-	y -= cache->y;
+	return min_ii(i * step, size - 1);
+}
 
-	x /= cache->step;
-	y /= cache->step;
-	x *= cache->step;
-	y *= cache->step;
+static OcclusionCacheSample *occ_cache_grid_sample(OcclusionCache *cache, int i, int j)
+{
+	return &cache->sample[j * cache->gridw + i];
+}
 
-	if (x < 0 || x >= cache->w || y < 0 || y >= cache->h)
-		return NULL;
-	else
-		return &cache->sample[y * cache->w + x];
+static void occ_cache_cell_samples(OcclusionCache *cache, int i1, int j1, int i2, int j2, OcclusionCacheSample **samples)
+{
+	samples[0] = occ_cache_grid_sample(cache, i1, j1);
+	samples[1] = occ_cache_grid_sample(cache, i2, j1);
+	samples[2] = occ_cache_grid_sample(cache, i1, j2);
+	samples[3] = occ_cache_grid_sample(cache, i2, j2);
+}
+
+/* corner samples see the same smooth surface, cellsize in pixels */
+static int occ_cache_cell_smooth(OcclusionCacheSample **samples, int cellsize)
+{
+	float mino, maxo, d[3], dist2;
+	int i;
+
+	for (i = 0; i < 4; i++)
+		if (!samples[i]->filled)
+			return 0;
+
+	/* require intensities not being too different */
+	mino = min_ffff(samples[0]->intensity, samples[1]->intensity, samples[2]->intensity, samples[3]->intensity);
+	maxo = max_ffff(samples[0]->intensity, samples[1]->intensity, samples[2]->intensity, samples[3]->intensity);
+
+	if (maxo - mino > CACHE_ERROR)
+		return 0;
+
+	for (i = 1; i < 4; i++) {
+		if (dot_v3v3(samples[0]->n, samples[i]->n) < 0.98f)
+			return 0;
+
+		/* depth discontinuity, corners further apart than their pixel footprint allows */
+		sub_v3_v3v3(d, samples[i]->co, samples[0]->co);
+		dist2 = max_ff(samples[0]->dist2, samples[i]->dist2);
+
+		if (dot_v3v3(d, d) > 4.0f * cellsize * cellsize * dist2)
+			return 0;
+	}
+
+	return 1;
+}
+
+static int occ_cache_sample_match(OcclusionCacheSample *sample, const float co[3], const float n[3])
+{
+	float d[3];
+
+	if (!sample->filled)
+		return 0;
+
+	sub_v3_v3v3(d, sample->co, co);
+
+	return (dot_v3v3(d, d) < 0.5f * sample->dist2 && dot_v3v3(sample->n, n) > 0.98f);
+}
+
+static void occ_cache_fill_sample(OcclusionCacheSample *sample, ShadeInput *shi)
+{
+	copy_v3_v3(sample->co, shi->co);
+	copy_v3_v3(sample->n, shi->vno);
+	copy_v3_v3(sample->ao, shi->ao);
+	copy_v3_v3(sample->env, shi->env);
+	copy_v3_v3(sample->indirect, shi->indirect);
+	sample->intensity = max_fff(sample->ao[0], sample->ao[1], sample->ao[2]);
+	sample->intensity = max_ff(sample->intensity, max_fff(sample->env[0], sample->env[1], sample->env[2]));
+	sample->intensity = max_ff(sample->intensity, max_fff(sample->indirect[0], sample->indirect[1], sample->indirect[2]));
+	sample->dist2 = dot_v3v3(shi->dxco, shi->dxco) + dot_v3v3(shi->dyco, shi->dyco);
+	sample->x = shi->xs;
+	sample->y = shi->ys;
+	sample->filled = 1;
+}
+
+/* cells are split in both directions where possible, midpoints rounding down */
+static int occ_cache_cell_split(int i1, int j1, int i2, int j2, int *im, int *jm)
+{
+	int split = 0;
+
+	*im = i1;
+	*jm = j1;
+
+	if (i2 - i1 > 1) {
+		*im = (i1 + i2) / 2;
+		split |= 1;
+	}
+	if (j2 - j1 > 1) {
+		*jm = (j1 + j2) / 2;
+		split |= 2;
+	}
+
+	return split;
 }
 
 static int sample_occ_cache(OcclusionTree *tree, float *co, float *n, int x, int y, int thread, float *ao, float *env, float *indirect)
 {
 	OcclusionCache *cache;
 	OcclusionCacheSample *samples[4], *sample;
-	float wn[4], wz[4], wb[4], tx, ty, w, totw, mino, maxo;
-	float d[3], dist2;
-	int i, x1, y1, x2, y2;
+	float wn[4], wz[4], wb[4], d[3], tx, ty, w, totw;
+	int i, i1, j1, i2, j2, im, jm, gx, gy, x1, y1, x2, y2, split, cstep, cellsize;
 
 	if (!tree->cache)
 		return 0;
 	
-	/* first try to find a sample in the same pixel */
 	cache = &tree->cache[thread];
 
-	if (cache->sample && cache->step) {
-		sample = &cache->sample[(y - cache->y) * cache->w + (x - cache->x)];
-		if (sample->filled) {
-			sub_v3_v3v3(d, sample->co, co);
-			dist2 = dot_v3v3(d, d);
-			if (dist2 < 0.5f * sample->dist2 && dot_v3v3(sample->n, n) > 0.98f) {
-				copy_v3_v3(ao, sample->ao);
-				copy_v3_v3(env, sample->env);
-				copy_v3_v3(indirect, sample->indirect);
-				return 1;
-			}
-		}
+	if (!(cache->sample && cache->step))
+		return 0;
+
+	/* first try the sample shaded last, for other samples in the same pixel */
+	if (cache->last.x == x && cache->last.y == y && occ_cache_sample_match(&cache->last, co, n)) {
+		copy_v3_v3(ao, cache->last.ao);
+		copy_v3_v3(env, cache->last.env);
+		copy_v3_v3(indirect, cache->last.indirect);
+		return 1;
 	}
-	else
+
+	x -= cache->x;
+	y -= cache->y;
+
+	if (x < 0 || x >= cache->w || y < 0 || y >= cache->h)
+		return 0;
+	if (cache->gridw < 2 || cache->gridh < 2)
 		return 0;
 
-	/* try to interpolate between 4 neighboring pixels */
-	samples[0] = find_occ_sample(cache, x, y);
-	samples[1] = find_occ_sample(cache, x + cache->step, y);
-	samples[2] = find_occ_sample(cache, x, y + cache->step);
-	samples[3] = find_occ_sample(cache, x + cache->step, y + cache->step);
+	/* find coarsest cell containing the pixel */
+	cstep = 1 << (CACHE_LEVELS - 1);
+	gx = min_ii(x / cache->step, cache->gridw - 2);
+	gy = min_ii(y / cache->step, cache->gridh - 2);
 
-	for (i = 0; i < 4; i++)
-		if (!samples[i] || !samples[i]->filled)
-			return 0;
+	i1 = (gx / cstep) * cstep;
+	j1 = (gy / cstep) * cstep;
+	i2 = min_ii(i1 + cstep, cache->gridw - 1);
+	j2 = min_ii(j1 + cstep, cache->gridh - 1);
 
-	/* require intensities not being too different */
-	mino = min_ffff(samples[0]->intensity, samples[1]->intensity, samples[2]->intensity, samples[3]->intensity);
-	maxo = max_ffff(samples[0]->intensity, samples[1]->intensity, samples[2]->intensity, samples[3]->intensity);
+	/* descend into the cells that were refined */
+	while ((split = occ_cache_cell_split(i1, j1, i2, j2, &im, &jm))) {
+		if (!occ_cache_grid_sample(cache, im, jm)->done)
+			break;
+		if ((split & 1) && !(occ_cache_grid_sample(cache, im, j1)->done && occ_cache_grid_sample(cache, im, j2)->done))
+			break;
+		if ((split & 2) && !(occ_cache_grid_sample(cache, i1, jm)->done && occ_cache_grid_sample(cache, i2, jm)->done))
+			break;
 
-	if (maxo - mino > 0.05f)
+		if (split & 1) {
+			if (x < occ_cache_coord(im, cache->step, cache->w)) i2 = im;
+			else i1 = im;
+		}
+		if (split & 2) {
+			if (y < occ_cache_coord(jm, cache->step, cache->h)) j2 = jm;
+			else j1 = jm;
+		}
+	}
+
+	occ_cache_cell_samples(cache, i1, j1, i2, j2, samples);
+
+	/* pixel on the grid */
+	for (i = 0; i < 4; i++) {
+		sample = samples[i];
+
+		if (sample->x - cache->x == x && sample->y - cache->y == y && occ_cache_sample_match(sample, co, n)) {
+			copy_v3_v3(ao, sample->ao);
+			copy_v3_v3(env, sample->env);
+			copy_v3_v3(indirect, sample->indirect);
+			return 1;
+		}
+	}
+
+	x1 = occ_cache_coord(i1, cache->step, cache->w);
+	y1 = occ_cache_coord(j1, cache->step, cache->h);
+	x2 = occ_cache_coord(i2, cache->step, cache->w);
+	y2 = occ_cache_coord(j2, cache->step, cache->h);
+
+	cellsize = max_ii(x2 - x1, y2 - y1);
+
+	if (!occ_cache_cell_smooth(samples, cellsize))
 		return 0;
 
 	/* compute weighted interpolation between samples */
@@ -1126,11 +1350,6 @@ static int sample_occ_cache(OcclusionTree *tree, float *co, float *n, int x, int
 	zero_v3(indirect);
 	totw = 0.0f;
 
-	x1 = samples[0]->x;
-	y1 = samples[0]->y;
-	x2 = samples[3]->x;
-	y2 = samples[3]->y;
-
 	tx = (float)(x2 - x) / (float)(x2 - x1);
 	ty = (float)(y2 - y) / (float)(y2 - y1);
 
@@ -1140,10 +1359,13 @@ static int sample_occ_cache(OcclusionTree *tree, float *co, float *n, int x, int
 	wb[0] = tx * ty;
 
 	for (i = 0; i < 4; i++) {
+		/* the shaded point may lie on another surface than the corners, e.g. an
+		 * object in front that fits inside the cell, then shade it exactly */
 		sub_v3_v3v3(d, samples[i]->co, co);
-		//dist2 = dot_v3v3(d, d);
+		if (dot_v3v3(d, d) > 4.0f * cellsize * cellsize * samples[i]->dist2)
+			return 0;
 
-		wz[i] = 1.0f; //(samples[i]->dist2/(1e-4f + dist2));
+		wz[i] = 1.0f;
 		wn[i] = pow(dot_v3v3(samples[i]->n, n), 32.0f);
 
 		w = wb[i] * wn[i] * wz[i];
@@ -1251,10 +1473,11 @@ void make_occ_tree(Render *re)
 {
 	OcclusionThread othreads[BLENDER_MAX_THREADS];
 	OcclusionTree *tree;
+	OcclusionPersist *persist = NULL;
 	StrandSurface *mesh;
 	ListBase threads;
 	float ao[3], env[3], indirect[3], (*faceao)[3], (*faceenv)[3], (*faceindirect)[3];
-	int a, totface, totthread, *face, *count;
+	int a, totface, totthread, *face, *count, persistent, reused = FALSE;
 
 	/* ugly, needed for occ_face */
 	R = *re;
@@ -1262,11 +1485,46 @@ void make_occ_tree(Render *re)
 	re->i.infostr = IFACE_("Occlusion preprocessing");
 	re->stats_draw(re->sdh, &re->i);
 	
-	re->occlusiontree = tree = occ_tree_build(re);
+	persistent = occ_persistent_enabled(re);
+	re->occlusiontree = tree = occ_tree_build(re, persistent);
 	
 	if (tree) {
-		if (re->wrld.ao_approx_passes > 0)
+		/* when only the camera moved, the occlusion passes give the same result */
+		if (persistent) {
+			persist = occ_persistent_new(re, tree);
+
+			if (occ_persistent_match(re->occlusionpersist, persist)) {
+				OcclusionPersist *old = re->occlusionpersist;
+
+				memcpy(persist->occlusion, old->occlusion, sizeof(float) * persist->totface);
+				for (a = 0; a < tree->totface; a++)
+					tree->occlusion[a] = persist->occlusion[tree->index[a]];
+
+				occ_sum_occlusion(tree, tree->root);
+				reused = TRUE;
+			}
+		}
+
+		free_occ_persistent(re);
+
+		if (re->wrld.ao_approx_passes > 0 && !reused) {
 			occ_compute_passes(re, tree, re->wrld.ao_approx_passes);
+
+			if (persist && !re->test_break(re->tbh)) {
+				for (a = 0; a < tree->totface; a++)
+					persist->occlusion[tree->index[a]] = tree->occlusion[a];
+			}
+		}
+
+		/* incomplete passes are not kept */
+		if (persist && !re->test_break(re->tbh))
+			re->occlusionpersist = persist;
+		else
+			occ_persistent_free(persist);
+
+		if (G.debug & G_DEBUG)
+			printf("occlusion tree: %d faces%s\n", tree->totface, (reused) ? ", passes kept from previous frame" : "");
+
 		if (tree->doindirect && (re->wrld.mode & WO_INDIRECT_LIGHT))
 			occ_compute_bounces(re, tree, re->wrld.ao_indirect_bounces);
 
@@ -1350,17 +1608,34 @@ void make_occ_tree(Render *re)
 
 void free_occ(Render *re)
 {
-	if (re->occlusiontree) {
+	OcclusionTree *tree = re->occlusiontree;
+	int a, totsample = 0;
+
+	if (tree) {
+		if ((G.debug & G_DEBUG) && tree->cache) {
+			for (a = 0; a < BLENDER_MAX_THREADS; a++)
+				totsample += tree->cache[a].totsample;
+
+			printf("occlusion cache: %d samples\n", totsample);
+		}
+
 		occ_free_tree(re->occlusiontree);
 		re->occlusiontree = NULL;
 	}
 }
 
+void free_occ_persistent(Render *re)
+{
+	if (re->occlusionpersist) {
+		occ_persistent_free(re->occlusionpersist);
+		re->occlusionpersist = NULL;
+	}
+}
+
 void sample_occ(Render *re, ShadeInput *shi)
 {
 	OcclusionTree *tree = re->occlusiontree;
 	OcclusionCache *cache;
-	OcclusionCacheSample *sample;
 	OccFace exclude;
 	int onlyshadow;
 
@@ -1376,23 +1651,12 @@ void sample_occ(Render *re, ShadeInput *shi)
 			onlyshadow = (shi->mat->mode & MA_ONLYSHADOW);
 			sample_occ_tree(re, tree, &exclude, shi->co, shi->vno, shi->thread, onlyshadow, shi->ao, shi->env, shi->indirect);
 
-			/* fill result into sample, each time */
-			if (tree->cache) {
+			/* keep result for the other samples in this pixel */
+			if (tree->cache && shi->depth == 0) {
 				cache = &tree->cache[shi->thread];
 
-				if (cache->sample && cache->step) {
-					sample = &cache->sample[(shi->ys - cache->y) * cache->w + (shi->xs - cache->x)];
-					copy_v3_v3(sample->co, shi->co);
-					copy_v3_v3(sample->n, shi->vno);
-					copy_v3_v3(sample->ao, shi->ao);
-					copy_v3_v3(sample->env, shi->env);
-					copy_v3_v3(sample->indirect, shi->indirect);
-					sample->intensity = max_fff(sample->ao[0], sample->ao[1], sample->ao[2]);
-					sample->intensity = max_ff(sample->intensity, max_fff(sample->env[0], sample->env[1], sample->env[2]));
-					sample->intensity = max_ff(sample->intensity, max_fff(sample->indirect[0], sample->indirect[1], sample->indirect[2]));
-					sample->dist2 = dot_v3v3(shi->dxco, shi->dxco) + dot_v3v3(shi->dyco, shi->dyco);
-					sample->filled = 1;
-				}
+				if (cache->sample && cache->step)
+					occ_cache_fill_sample(&cache->last, shi);
 			}
 		}
 	}
@@ -1411,89 +1675,153 @@ void sample_occ(Render *re, ShadeInput *shi)
 	}
 }
 
-void cache_occ_samples(Render *re, RenderPart *pa, ShadeSample *ssamp)
+static void occ_cache_compute_sample(Render *re, RenderPart *pa, ShadeSample *ssamp, OcclusionCache *cache, int i, int j)
 {
 	OcclusionTree *tree = re->occlusiontree;
+	OcclusionCacheSample *sample = occ_cache_grid_sample(cache, i, j);
+	ShadeInput *shi;
 	PixStr ps;
-	OcclusionCache *cache;
-	OcclusionCacheSample *sample;
 	OccFace exclude;
-	ShadeInput *shi;
-	intptr_t *rd = NULL;
-	int *ro = NULL, *rp = NULL, *rz = NULL, onlyshadow;
-	int x, y, step = CACHE_STEP;
+	int x, y, offs, onlyshadow;
 
-	if (!tree->cache)
+	if (sample->done)
 		return;
 
-	cache = &tree->cache[pa->thread];
-	cache->w = pa->rectx;
-	cache->h = pa->recty;
-	cache->x = pa->disprect.xmin;
-	cache->y = pa->disprect.ymin;
-	cache->step = step;
-	cache->sample = MEM_callocN(sizeof(OcclusionCacheSample) * cache->w * cache->h, "OcclusionCacheSample");
-	sample = cache->sample;
+	sample->done = 1;
+
+	x = occ_cache_coord(i, cache->step, cache->w);
+	y = occ_cache_coord(j, cache->step, cache->h);
+	offs = y * pa->rectx + x;
 
 	if (re->osa) {
-		rd = pa->rectdaps;
+		if (!pa->rectdaps[offs])
+			return;
+
+		shade_samples_fill_with_ps(ssamp, (PixStr *)pa->rectdaps[offs], cache->x + x, cache->y + y);
 	}
 	else {
+		if (!pa->rectp[offs])
+			return;
+
 		/* fake pixel struct for non-osa */
 		ps.next = NULL;
 		ps.mask = 0xFFFF;
+		ps.obi = pa->recto[offs];
+		ps.facenr = pa->rectp[offs];
+		ps.z = pa->rectz[offs];
+		shade_samples_fill_with_ps(ssamp, &ps, cache->x + x, cache->y + y);
+	}
+
+	shi = ssamp->shi;
+	if (shi->vlr) {
+		onlyshadow = (shi->mat->mode & MA_ONLYSHADOW);
+		exclude.obi = shi->obi - re->objectinstance;
+		exclude.facenr = shi->vlr->index;
+		sample_occ_tree(re, tree, &exclude, shi->co, shi->vno, shi->thread, onlyshadow, shi->ao, shi->env, shi->indirect);
 
-		ro = pa->recto;
-		rp = pa->rectp;
-		rz = pa->rectz;
+		occ_cache_fill_sample(sample, shi);
+		cache->totsample++;
 	}
+}
 
-	/* compute a sample at every step pixels */
-	for (y = pa->disprect.ymin; y < pa->disprect.ymax; y++) {
-		for (x = pa->disprect.xmin; x < pa->disprect.xmax; x++, sample++, rd++, ro++, rp++, rz++) {
-			if (!(((x - pa->disprect.xmin + step) % step) == 0 || x == pa->disprect.xmax - 1))
-				continue;
-			if (!(((y - pa->disprect.ymin + step) % step) == 0 || y == pa->disprect.ymax - 1))
-				continue;
+/* add samples in cells where the error of interpolating between the corners is too big */
+static void occ_cache_refine(Render *re, RenderPart *pa, ShadeSample *ssamp, OcclusionCache *cache, int i1, int j1, int i2, int j2)
+{
+	OcclusionCacheSample *samples[4];
+	int im, jm, split, cellsize;
 
-			if (re->osa) {
-				if (!*rd) continue;
+	split = occ_cache_cell_split(i1, j1, i2, j2, &im, &jm);
+	if (!split)
+		return;
 
-				shade_samples_fill_with_ps(ssamp, (PixStr *)(*rd), x, y);
-			}
-			else {
-				if (!*rp) continue;
+	occ_cache_cell_samples(cache, i1, j1, i2, j2, samples);
+	cellsize = max_ii(occ_cache_coord(i2, cache->step, cache->w) - occ_cache_coord(i1, cache->step, cache->w),
+	                  occ_cache_coord(j2, cache->step, cache->h) - occ_cache_coord(j1, cache->step, cache->h));
 
-				ps.obi = *ro;
-				ps.facenr = *rp;
-				ps.z = *rz;
-				shade_samples_fill_with_ps(ssamp, &ps, x, y);
-			}
+	if (occ_cache_cell_smooth(samples, cellsize))
+		return;
 
-			shi = ssamp->shi;
-			if (shi->vlr) {
-				onlyshadow = (shi->mat->mode & MA_ONLYSHADOW);
-				exclude.obi = shi->obi - re->objectinstance;
-				exclude.facenr = shi->vlr->index;
-				sample_occ_tree(re, tree, &exclude, shi->co, shi->vno, shi->thread, onlyshadow, shi->ao, shi->env, shi->indirect);
-
-				copy_v3_v3(sample->co, shi->co);
-				copy_v3_v3(sample->n, shi->vno);
-				copy_v3_v3(sample->ao, shi->ao);
-				copy_v3_v3(sample->env, shi->env);
-				copy_v3_v3(sample->indirect, shi->indirect);
-				sample->intensity = max_fff(sample->ao[0], sample->ao[1], sample->ao[2]);
-				sample->intensity = max_ff(sample->intensity, max_fff(sample->env[0], sample->env[1], sample->env[2]));
-				sample->intensity = max_ff(sample->intensity, max_fff(sample->indirect[0], sample->indirect[1], sample->indirect[2]));
-				sample->dist2 = dot_v3v3(shi->dxco, shi->dxco) + dot_v3v3(shi->dyco, shi->dyco);
-				sample->x = shi->xs;
-				sample->y = shi->ys;
-				sample->filled = 1;
-			}
+	/* no surface at any of the corners */
+	if (!(samples[0]->filled || samples[1]->filled || samples[2]->filled || samples[3]->filled))
+		if (cellsize <= cache->step * 2)
+			return;
 
-			if (re->test_break(re->tbh))
-				break;
-		}
+	if (re->test_break(re->tbh))
+		return;
+
+	if (split & 1) {
+		occ_cache_compute_sample(re, pa, ssamp, cache, im, j1);
+		occ_cache_compute_sample(re, pa, ssamp, cache, im, j2);
+	}
+	if (split & 2) {
+		occ_cache_compute_sample(re, pa, ssamp, cache, i1, jm);
+		occ_cache_compute_sample(re, pa, ssamp, cache, i2, jm);
+	}
+	occ_cache_compute_sample(re, pa, ssamp, cache, im, jm);
+
+	if (split == 3) {
+		occ_cache_refine(re, pa, ssamp, cache, i1, j1, im, jm);
+		occ_cache_refine(re, pa, ssamp, cache, im, j1, i2, jm);
+		occ_cache_refine(re, pa, ssamp, cache, i1, jm, im, j2);
+		occ_cache_refine(re, pa, ssamp, cache, im, jm, i2, j2);
+	}
+	else if (split == 1) {
+		occ_cache_refine(re, pa, ssamp, cache, i1, j1, im, j2);
+		occ_cache_refine(re, pa, ssamp, cache, im, j1, i2, j2);
+	}
+	else {
+		occ_cache_refine(re, pa, ssamp, cache, i1, j1, i2, jm);
+		occ_cache_refine(re, pa, ssamp, cache, i1, jm, i2, j2);
+	}
+}
+
+void cache_occ_samples(Render *re, RenderPart *pa, ShadeSample *ssamp)
+{
+	OcclusionTree *tree = re->occlusiontree;
+	OcclusionCache *cache;
+	int i, j, step, cstep, maxsample;
+
+	if (!tree->cache)
+		return;
+
+	cache = &tree->cache[pa->thread];
+	cache->w = pa->rectx;
+	cache->h = pa->recty;
+	cache->x = pa->disprect.xmin;
+	cache->y = pa->disprect.ymin;
+	cache->last.filled = 0;
+
+	/* grid spacing, coarser for big parts to keep memory bounded */
+	maxsample = CACHE_MAX_SAMPLES / max_ii(re->r.threads, 1);
+
+	for (step = CACHE_STEP; ; step++) {
+		cache->gridw = (cache->w + step - 2) / step + 1;
+		cache->gridh = (cache->h + step - 2) / step + 1;
+
+		if (cache->gridw * cache->gridh <= maxsample)
+			break;
+	}
+
+	cache->step = step;
+	cache->sample = MEM_callocN(sizeof(OcclusionCacheSample) * cache->gridw * cache->gridh, "OcclusionCacheSample");
+
+	/* compute coarse samples first, then refine where needed */
+	cstep = 1 << (CACHE_LEVELS - 1);
+
+	for (j = 0; j < cache->gridh; j = (j == cache->gridh - 1) ? cache->gridh : min_ii(j + cstep, cache->gridh - 1)) {
+		for (i = 0; i < cache->gridw; i = (i == cache->gridw - 1) ? cache->gridw : min_ii(i + cstep, cache->gridw - 1))
+			occ_cache_compute_sample(re, pa, ssamp, cache, i, j);
+
+		if (re->test_break(re->tbh))
+			return;
+	}
+
+	for (j = 0; j < cache->gridh - 1; j += cstep) {
+		for (i = 0; i < cache->gridw - 1; i += cstep)
+			occ_cache_refine(re, pa, ssamp, cache, i, j, min_ii(i + cstep, cache->gridw - 1), min_ii(j + cstep, cache->gridh - 1));
+
+		if (re->test_break(re->tbh))
+			return;
 	}
 }
 
@@ -1508,8 +1836,11 @@ void free_occ_samples(Render *re, RenderPart *pa)
 		if (cache->sample)
 			MEM_freeN(cache->sample);
 
+		cache->sample = NULL;
 		cache->w = 0;
 		cache->h = 0;
+		cache->gridw = 0;
+		cache->gridh = 0;
 		cache->step = 0;
 	}
 }
@@ -89,6 +89,8 @@
 #include "renderdatabase.h"
 #include "rendercore.h"
 #include "initrender.h"
+#include "occlusion.h"
+#include "sss.h"
 #include "shadbuf.h"
 #include "pixelblending.h"
 #include "zbuf.h"
@@ -178,6 +180,18 @@ static void stats_background(void *UNUSED(arg), RenderStats *rs)
 			fprintf(stdout, IFACE_("Sce: %s Ve:%d Fa:%d La:%d"), rs->scene_name, rs->totvert, rs->totface, rs->totlamp);
 	}
 
+	if (rs->convert_time != 0.0f) {
+		fprintf(stdout, IFACE_(" | Conv:%.2fs"), rs->convert_time);
+		if (rs->convert_slowest[0])
+			fprintf(stdout, IFACE_(" (%s %.2fs)"), rs->convert_slowest, rs->convert_slowest_time);
+	}
+	if (rs->raytree_nodes)
+		fprintf(stdout, IFACE_(" | Tree:%d nodes %.2fs"), rs->raytree_nodes, rs->raytree_time);
+	if (rs->totray_reflect || rs->totray_shadow || rs->totray_ao)
+		fprintf(stdout, IFACE_(" Rays:%.2fM (Re:%.2fM Sh:%.2fM AO:%.2fM)"),
+		        (rs->totray_reflect + rs->totray_shadow + rs->totray_ao) * 1e-6,
+		        rs->totray_reflect * 1e-6, rs->totray_shadow * 1e-6, rs->totray_ao * 1e-6);
+
 	BLI_callback_exec(G.main, NULL, BLI_CB_EVT_RENDER_STATS);
 
 	fputc('\n', stdout);
@@ -201,7 +215,8 @@ float *RE_RenderLayerGetPass(RenderLayer *rl, int passtype)
 
 RenderLayer *RE_GetRenderLayer(RenderResult *rr, const char *name)
 {
-	if (rr == NULL) {
+	/* layers of a streamed result have no buffers */
+	if (rr == NULL || rr->exr_stream) {
 		return NULL;
 	}
 	else {
@@ -303,7 +318,15 @@ void RE_AcquireResultImage(Render *re, RenderResult *rr)
 	if (re) {
 		BLI_rw_mutex_lock(&re->resultmutex, THREAD_LOCK_READ);
 
-		if (re->result) {
+		if (re->result && re->result->exr_stream) {
+			/* buffers are only in the tile files, show an empty result */
+			rr->rectx = re->result->rectx;
+			rr->recty = re->result->recty;
+
+			rr->xof = re->disprect.xmin;
+			rr->yof = re->disprect.ymin;
+		}
+		else if (re->result) {
 			RenderLayer *rl;
 			
 			rr->rectx = re->result->rectx;
@@ -906,6 +929,7 @@ static void print_part_stats(Render *re, RenderPart *pa)
 	
 	BLI_snprintf(str, sizeof(str), IFACE_("%s, Part %d-%d"), re->scene->id.name + 2, pa->nr, re->i.totpart);
 	re->i.infostr = str;
+	update_ray_stats(re);
 	re->stats_draw(re->sdh, &re->i);
 	re->i.infostr = NULL;
 }
@@ -1257,6 +1281,9 @@ static void do_render_blur_3d(Render *re)
 	/* create accumulation render result */
 	rres = render_result_new(re, &re->disprect, 0, RR_USE_MEM, RR_ALL_LAYERS);
 	
+	/* objects with static geometry are converted once and shared by all samples */
+	re->flag |= R_MBLUR_PASS;
+	
 	/* do the blur steps */
 	while (blur--) {
 		re->mblur_offs = re->r.blurfac * ((float)(re->r.mblur_samples - blur)) / (float)re->r.mblur_samples;
@@ -1271,6 +1298,15 @@ static void do_render_blur_3d(Render *re)
 		if (re->test_break(re->tbh)) break;
 	}
 	
+	re->flag &= ~R_MBLUR_PASS;
+	
+	/* keep them for the next frame only when asked for */
+	if (!(re->flag & R_ANIMATION) || !(re->r.mode & R_PERSISTENT_DATA)) {
+		RE_Database_FreePersistent(re);
+		free_occ_persistent(re);
+		free_sss_persistent(re);
+	}
+	
 	/* swap results */
 	BLI_rw_mutex_lock(&re->resultmutex, THREAD_LOCK_WRITE);
 	render_result_free(re->result);
@@ -2523,7 +2559,14 @@ static int do_write_image_or_movie(Render *re, Main *bmain, Scene *scene, bMovie
 			BKE_makepicstring(name, scene->r.pic, bmain->name, scene->r.cfra, &scene->r.im_format, scene->r.scemode & R_EXTENSION, TRUE);
 		
 		if (re->r.im_format.imtype == R_IMF_IMTYPE_MULTILAYER) {
-			if (re->result) {
+			if (re->result && re->result->exr_stream) {
+				ok = render_result_exr_file_write(re, re->reports, name, scene->r.im_format.exr_codec);
+				if (ok == 0)
+					printf("Render error: cannot save %s\n", name);
+				else
+					printf("Saved: %s", name);
+			}
+			else if (re->result) {
 				RE_WriteRenderResult(re->reports, re->result, name, scene->r.im_format.exr_codec);
 				printf("Saved: %s", name);
 			}
@@ -2717,6 +2760,11 @@ void RE_BlenderAnim(Render *re, Main *bmain, Scene *scene, Object *camera_overri
 
 	re->flag &= ~R_ANIMATION;
 
+	/* static objects, occlusion and sss points kept between frames */
+	RE_Database_FreePersistent(re);
+	free_occ_persistent(re);
+	free_sss_persistent(re);
+
 	BLI_callback_exec(re->main, (ID *)scene, G.is_break ? BLI_CB_EVT_RENDER_CANCEL : BLI_CB_EVT_RENDER_COMPLETE);
 
 	/* UGLY WARNING */
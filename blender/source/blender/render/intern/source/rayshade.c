@@ -76,6 +76,9 @@
 
 #define DEPTH_SHADOW_TRA  10
 
+/* number of primitives above which the automatic raytree structure is QBVH */
+#define RAYSTRUCTURE_AUTO_QBVH_SIZE		(1 << 20)
+
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 /* defined in pipeline.c, is hardcopy of active dynamic allocated Render */
 /* only to be used here in this file, it's for speed */
@@ -101,10 +104,14 @@ RayObject *RE_rayobject_create(int type, int size, int octree_resolution)
 	RayObject * res = NULL;
 
 	if (type == R_RAYSTRUCTURE_AUTO) {
-		/* TODO */
-		//if (detect_simd())
 #ifdef __SSE__
-		type = BLI_cpu_support_sse2()? R_RAYSTRUCTURE_SIMD_SVBVH: R_RAYSTRUCTURE_VBVH;
+		/* SVBVH searches an optimal packing of the tree, which pays off in traversal but
+		 * gets slow and memory hungry to build for very large trees. QBVH packs greedily
+		 * and uses the same 4-wide SIMD traversal, including the shadow ray early exit */
+		if (BLI_cpu_support_sse2())
+			type = (size > RAYSTRUCTURE_AUTO_QBVH_SIZE)? R_RAYSTRUCTURE_SIMD_QBVH: R_RAYSTRUCTURE_SIMD_SVBVH;
+		else
+			type = R_RAYSTRUCTURE_VBVH;
 #else
 		type = R_RAYSTRUCTURE_VBVH;
 #endif
@@ -150,11 +157,137 @@ static RayObject* rayobject_create(Render *re, int type, int size)
 RayCounter re_rc_counter[BLENDER_MAX_THREADS];
 #endif
 
+/* rays cast per type, counted per thread so no locking is needed,
+ * summed into the render stats as parts finish */
+enum {
+	RAY_STATS_REFLECT = 0,
+	RAY_STATS_SHADOW,
+	RAY_STATS_AO,
+	RAY_STATS_TOT
+};
+
+typedef struct RayTypeStats {
+	unsigned long long rays[RAY_STATS_TOT];
+	char pad[64 - RAY_STATS_TOT * sizeof(unsigned long long)];	/* one cache line per thread */
+} RayTypeStats;
+
+static int raycast_stats(Isect *isec, int thread, int type)
+{
+	R.raystats[thread].rays[type]++;
+	return RE_rayobject_raycast(R.raytree, isec);
+}
+
+/* returns a bit mask of the rays that hit */
+static int raycast_packet_stats(Isect *isec, int tot, int thread, int type)
+{
+	R.raystats[thread].rays[type] += tot;
+
+	if (G.debug_value == RT_DEBUG_VALUE_NO_PACKETS) {
+		int a, hit = 0;
+
+		for (a = 0; a < tot; a++)
+			if (RE_rayobject_raycast(R.raytree, &isec[a]))
+				hit |= (1 << a);
+
+		return hit;
+	}
+
+	return RE_rayobject_raycast_packet(R.raytree, isec, tot);
+}
+
+static void reset_ray_stats(Render *re)
+{
+	if (re->raystats == NULL)
+		re->raystats = MEM_mallocN(sizeof(RayTypeStats) * BLENDER_MAX_THREADS, "ray type stats");
+
+	memset(re->raystats, 0, sizeof(RayTypeStats) * BLENDER_MAX_THREADS);
+	re->raystats_start = PIL_check_seconds_timer();
+
+	re->i.totray_reflect = re->i.totray_shadow = re->i.totray_ao = 0;
+}
+
+void update_ray_stats(Render *re)
+{
+	unsigned long long tot[RAY_STATS_TOT] = {0};
+	int a, type;
+
+	if (re->raystats == NULL)
+		return;
+
+	for (a = 0; a < BLENDER_MAX_THREADS; a++)
+		for (type = 0; type < RAY_STATS_TOT; type++)
+			tot[type] += re->raystats[a].rays[type];
+
+	re->i.totray_reflect = tot[RAY_STATS_REFLECT];
+	re->i.totray_shadow = tot[RAY_STATS_SHADOW];
+	re->i.totray_ao = tot[RAY_STATS_AO];
+}
+
+static void print_ray_stats(Render *re)
+{
+	static const char *names[RAY_STATS_TOT] = {"reflection/refraction", "shadow", "AO/environment"};
+	double time = PIL_check_seconds_timer() - re->raystats_start;
+	unsigned long long tot;
+	int a, type;
+
+	printf("Raytrace: %.3f s since raytree build, %s\n", time,
+	       (G.debug_value == RT_DEBUG_VALUE_NO_PACKETS)? "single rays": "ray packets");
+
+	for (type = 0; type < RAY_STATS_TOT; type++) {
+		tot = 0;
+		for (a = 0; a < BLENDER_MAX_THREADS; a++)
+			tot += re->raystats[a].rays[type];
+
+		if (tot)
+			printf("  %-22s %12llu rays  %8.3f Mrays/s\n", names[type], tot, (time > 0.0)? (double)tot / time * 1e-6: 0.0);
+	}
+}
+
+static void raytree_stats(Render *re, double buildtime)
+{
+	ObjectRen *obr;
+	RayObjectStats stats, obstats, tmp;
+	int totobtree = 0;
+
+	memset(&obstats, 0, sizeof(obstats));
+
+	for (obr=re->objecttable.first; obr; obr=obr->next) {
+		if (obr->raytree) {
+			RE_rayobject_stats(obr->raytree, &tmp);
+			obstats.totnode += tmp.totnode;
+			obstats.totleaf += tmp.totleaf;
+			obstats.sah_cost += tmp.sah_cost;
+			totobtree++;
+		}
+	}
+
+	RE_rayobject_stats(re->raytree, &stats);
+
+	re->i.raytree_time = (float)buildtime;
+	re->i.raytree_nodes = stats.totnode + obstats.totnode;
+
+	if (G.debug & G_DEBUG) {
+		printf("Raytree: built in %.3f s\n", buildtime);
+		printf("  main tree: %d nodes, %d leaves, SAH cost %.2f\n", stats.totnode, stats.totleaf, stats.sah_cost);
+		if (totobtree)
+			printf("  %d object trees: %d nodes, %d leaves, average SAH cost %.2f\n", totobtree,
+			       obstats.totnode, obstats.totleaf, obstats.sah_cost / totobtree);
+	}
+}
+
 
 void freeraytree(Render *re)
 {
 	ObjectInstanceRen *obi;
 	
+	if (re->raystats) {
+		update_ray_stats(re);
+		if (G.debug & G_DEBUG)
+			print_ray_stats(re);
+
+		MEM_freeN(re->raystats);
+		re->raystats = NULL;
+	}
 	if (re->raytree) {
 		RE_rayobject_free(re->raytree);
 		re->raytree = NULL;
@@ -170,6 +303,16 @@ void freeraytree(Render *re)
 
 	for (obi=re->instancetable.first; obi; obi=obi->next) {
 		ObjectRen *obr = obi->obr;
+
+		/* kept for the next frame, freed with the object */
+		if (obr->flag & R_PERSISTENT) {
+			if (obi->raytree) {
+				RE_rayobject_free(obi->raytree);
+				obi->raytree = NULL;
+			}
+			continue;
+		}
+
 		if (obr->raytree) {
 			RE_rayobject_free(obr->raytree);
 			obr->raytree = NULL;
@@ -207,20 +350,30 @@ static int is_raytraceable_vlr(Render *re, VlakRen *vlr)
 
 static int is_raytraceable(Render *re, ObjectInstanceRen *obi)
 {
-	int v;
 	ObjectRen *obr = obi->obr;
 
 	if (re->excludeob && obr->ob == re->excludeob)
 		return 0;
 
-	for (v=0;v<obr->totvlak;v++) {
-		VlakRen *vlr = obr->vlaknodes[v>>8].vlak + (v&255);
+	return (obr->totrayface > 0);
+}
 
-		if (is_raytraceable_vlr(re, vlr))
-			return 1;
-	}
+/* count per object rather than per instance, with many instances of
+ * the same object walking all faces for each of them adds up */
+static void count_raytraceable_faces(Render *re)
+{
+	ObjectRen *obr;
+	int v;
 
-	return 0;
+	for (obr=re->objecttable.first; obr; obr=obr->next) {
+		obr->totrayface = 0;
+
+		for (v=0;v<obr->totvlak;v++) {
+			VlakRen *vlr = obr->vlaknodes[v>>8].vlak + (v&255);
+			if (is_raytraceable_vlr(re, vlr))
+				obr->totrayface++;
+		}
+	}
 }
 
 
@@ -256,17 +409,27 @@ RayObject* makeraytree_object(Render *re, ObjectInstanceRen *obi)
 		else
 			face = obr->rayfaces = (RayFace *)MEM_callocN(faces * sizeof(RayFace), "ObjectRen faces");
 
-		obr->rayobi = obi;
+		if (obr->flag & R_PERSISTENT) {
+			/* the raytree outlives the instance table, so the primitives
+			 * point to a copy of the instance owned by the object */
+			obr->rayobi = MEM_mallocN(sizeof(ObjectInstanceRen), "persistent rayobi");
+			*obr->rayobi = *obi;
+			obr->rayobi->next = obr->rayobi->prev = NULL;
+			obr->rayobi->raytree = NULL;
+			obr->rayobi->transform_primitives = 0;
+		}
+		else
+			obr->rayobi = obi;
 		
 		for (v=0;v<obr->totvlak;v++) {
 			VlakRen *vlr = obr->vlaknodes[v>>8].vlak + (v&255);
 			if (is_raytraceable_vlr(re, vlr)) {
 				if ((re->r.raytrace_options & R_RAYTRACE_USE_LOCAL_COORDS)) {
-					RE_rayobject_add(raytree, RE_vlakprimitive_from_vlak(vlakprimitive, obi, vlr));
+					RE_rayobject_add(raytree, RE_vlakprimitive_from_vlak(vlakprimitive, obr->rayobi, vlr));
 					vlakprimitive++;
 				}
 				else {
-					RE_rayface_from_vlak(face, obi, vlr);
+					RE_rayface_from_vlak(face, obr->rayobi, vlr);
 					RE_rayobject_add(raytree, RE_rayobject_unalignRayFace(face));
 					face++;
 				}
@@ -275,8 +438,24 @@ RayObject* makeraytree_object(Render *re, ObjectInstanceRen *obi)
 		RE_rayobject_done(raytree);
 
 		/* in case of cancel during build, raytree is not usable */
-		if (test_break(re))
+		if (test_break(re)) {
 			RE_rayobject_free(raytree);
+
+			/* not freed by freeraytree() */
+			if (obr->flag & R_PERSISTENT) {
+				MEM_freeN(obr->rayobi);
+				obr->rayobi = NULL;
+
+				if (obr->rayfaces) {
+					MEM_freeN(obr->rayfaces);
+					obr->rayfaces = NULL;
+				}
+				if (obr->rayprimitives) {
+					MEM_freeN(obr->rayprimitives);
+					obr->rayprimitives = NULL;
+				}
+			}
+		}
 		else
 			obr->raytree= raytree;
 	}
@@ -294,18 +473,13 @@ RayObject* makeraytree_object(Render *re, ObjectInstanceRen *obi)
 
 static int has_special_rayobject(Render *re, ObjectInstanceRen *obi)
 {
-	if ( (obi->flag & R_TRANSFORMED) && (re->r.raytrace_options & R_RAYTRACE_USE_INSTANCES) ) {
-		ObjectRen *obr = obi->obr;
-		int v, faces = 0;
-		
-		for (v=0;v<obr->totvlak;v++) {
-			VlakRen *vlr = obr->vlaknodes[v>>8].vlak + (v&255);
-			if (is_raytraceable_vlr(re, vlr)) {
-				faces++;
-				if (faces > 4)
-					return 1;
-			}
-		}
+	/* persistent objects always get their own raytree, so it can be reused
+	 * in the next frame, except for octree which can't have instances */
+	int persistent = (obi->obr->flag & R_PERSISTENT) && (re->r.raytrace_structure != R_RAYSTRUCTURE_OCTREE);
+
+	if ( (obi->flag & R_TRANSFORMED) && ((re->r.raytrace_options & R_RAYTRACE_USE_INSTANCES) || persistent) ) {
+		if (obi->obr->totrayface > 4)
+			return 1;
 	}
 	return 0;
 }
@@ -320,22 +494,16 @@ static void makeraytree_single(Render *re)
 	VlakPrimitive *vlakprimitive = NULL;
 	int faces = 0, obs = 0, special = 0;
 
+	count_raytraceable_faces(re);
+
 	for (obi=re->instancetable.first; obi; obi=obi->next)
 	if (is_raytraceable(re, obi)) {
-		ObjectRen *obr = obi->obr;
 		obs++;
 		
-		if (has_special_rayobject(re, obi)) {
+		if (has_special_rayobject(re, obi))
 			special++;
-		}
-		else {
-			int v;
-			for (v=0;v<obr->totvlak;v++) {
-				VlakRen *vlr = obr->vlaknodes[v>>8].vlak + (v&255);
-				if (is_raytraceable_vlr(re, vlr))
-					faces++;
-			}
-		}
+		else
+			faces += obi->obr->totrayface;
 	}
 	
 	if (faces + special == 0) {
@@ -412,6 +580,7 @@ static void makeraytree_single(Render *re)
 void makeraytree(Render *re)
 {
 	float min[3], max[3], sub[3];
+	double start = PIL_check_seconds_timer();
 	int i;
 	
 	re->i.infostr = IFACE_("Raytree.. preparing");
@@ -448,10 +617,14 @@ void makeraytree(Render *re)
 
 		re->maxdist = len_v3(sub);
 
+		raytree_stats(re, PIL_check_seconds_timer() - start);
+
 		re->i.infostr = IFACE_("Raytree finished");
 		re->stats_draw(re->sdh, &re->i);
 	}
 
+	reset_ray_stats(re);
+
 #ifdef RE_RAYCOUNTER
 	memset(re_rc_counter, 0, sizeof(re_rc_counter));
 #endif
@@ -751,7 +924,7 @@ static void traceray(ShadeInput *origshi, ShadeResult *origshr, short depth, con
 	if (origshi->obi->flag & R_ENV_TRANSFORMED)
 		ray_env_rotate(&isec, origshi->obi->imat);
 
-	if (RE_rayobject_raycast(R.raytree, &isec)) {
+	if (raycast_stats(&isec, origshi->thread, RAY_STATS_REFLECT)) {
 		ShadeResult shr= {{0}};
 		float d= 1.0f;
 
@@ -1635,7 +1808,7 @@ static void ray_trace_shadow_tra(Isect *is, ShadeInput *origshi, int depth, int
 	 * if it has col[3]>0.0f  continue. so exit when alpha is full */
 	const float initial_dist = is->dist;
 
-	if (RE_rayobject_raycast(R.raytree, is)) {
+	if (raycast_stats(is, origshi->thread, RAY_STATS_SHADOW)) {
 		/* Warning regarding initializing to zero's, This is not that nice,
 		 * and possibly a bit slow for every ray, however some variables were
 		 * not initialized properly in, unless using
@@ -1855,7 +2028,7 @@ static void ray_ao_qmc(ShadeInput *shi, float ao[3], float env[3])
 	float adapt_thresh = R.wrld.ao_adapt_thresh;
 	float adapt_speed_fac = R.wrld.ao_adapt_speed_fac;
 	
-	int samples=0;
+	int samples=0, done=FALSE;
 	int max_samples = R.wrld.aosamp*R.wrld.aosamp;
 	
 	float dxyview[3], skyadded=0;
@@ -1923,64 +2096,78 @@ static void ray_ao_qmc(ShadeInput *shi, float ao[3], float env[3])
 
 	QMC_initPixel(qsa, shi->thread);
 	
-	while (samples < max_samples) {
+	while (samples < max_samples && !done) {
+		Isect packet[RE_RAY_PACKET_SIZE];
+		float packetdir[RE_RAY_PACKET_SIZE][3];
+		int a, hit, totpacket = min_ii(max_samples - samples, RE_RAY_PACKET_SIZE);
 
-		/* sampling, returns quasi-random vector in unit hemisphere */
-		QMC_sampleHemi(samp3d, qsa, shi->thread, samples);
+		/* the next samples are traced together, the results are still
+		 * accumulated one by one so adaptive sampling stops at the same sample */
+		for (a = 0; a < totpacket; a++) {
+			/* sampling, returns quasi-random vector in unit hemisphere */
+			QMC_sampleHemi(samp3d, qsa, shi->thread, samples + a);
 
-		dir[0] = (samp3d[0]*up[0] + samp3d[1]*side[0] + samp3d[2]*nrm[0]);
-		dir[1] = (samp3d[0]*up[1] + samp3d[1]*side[1] + samp3d[2]*nrm[1]);
-		dir[2] = (samp3d[0]*up[2] + samp3d[1]*side[2] + samp3d[2]*nrm[2]);
-		
-		normalize_v3(dir);
-		
-		isec.dir[0] = -dir[0];
-		isec.dir[1] = -dir[1];
-		isec.dir[2] = -dir[2];
-		isec.dist = maxdist;
-		
-		if (shi->obi->flag & R_ENV_TRANSFORMED)
-			ray_env_rotate_dir(&isec, shi->obi->imat);
-		
-		prev = fac;
-		
-		if (RE_rayobject_raycast(R.raytree, &isec)) {
-			if (R.wrld.aomode & WO_AODIST) fac+= expf(-isec.dist*R.wrld.aodistfac);
-			else fac+= 1.0f;
-		}
-		else if (envcolor!=WO_AOPLAIN) {
-			float skycol[4];
-			float view[3];
+			dir[0] = (samp3d[0]*up[0] + samp3d[1]*side[0] + samp3d[2]*nrm[0]);
+			dir[1] = (samp3d[0]*up[1] + samp3d[1]*side[1] + samp3d[2]*nrm[1]);
+			dir[2] = (samp3d[0]*up[2] + samp3d[1]*side[2] + samp3d[2]*nrm[2]);
 			
-			view[0]= -dir[0];
-			view[1]= -dir[1];
-			view[2]= -dir[2];
-			normalize_v3(view);
+			normalize_v3(dir);
+			copy_v3_v3(packetdir[a], dir);
 			
-			if (envcolor==WO_AOSKYCOL) {
-				const float skyfac= 0.5f * (1.0f + dot_v3v3(view, R.grvec));
-				env[0]+= (1.0f-skyfac)*R.wrld.horr + skyfac*R.wrld.zenr;
-				env[1]+= (1.0f-skyfac)*R.wrld.horg + skyfac*R.wrld.zeng;
-				env[2]+= (1.0f-skyfac)*R.wrld.horb + skyfac*R.wrld.zenb;
-			}
-			else {	/* WO_AOSKYTEX */
-				shadeSkyView(skycol, isec.start, view, dxyview, shi->thread);
-				shadeSunView(skycol, shi->view);
-				env[0]+= skycol[0];
-				env[1]+= skycol[1];
-				env[2]+= skycol[2];
-			}
-			skyadded++;
+			packet[a] = isec;
+			packet[a].dir[0] = -dir[0];
+			packet[a].dir[1] = -dir[1];
+			packet[a].dir[2] = -dir[2];
+			packet[a].dist = maxdist;
+			
+			if (shi->obi->flag & R_ENV_TRANSFORMED)
+				ray_env_rotate_dir(&packet[a], shi->obi->imat);
 		}
-		
-		samples++;
-		
-		if (qsa && qsa->type == SAMP_TYPE_HALTON) {
-			/* adaptive sampling - consider samples below threshold as in shadow (or vice versa) and exit early */
-			if (adapt_thresh > 0.0f && (samples > max_samples/2) ) {
+
+		hit = raycast_packet_stats(packet, totpacket, shi->thread, RAY_STATS_AO);
+
+		for (a = 0; a < totpacket; a++) {
+			prev = fac;
+			
+			if (hit & (1 << a)) {
+				if (R.wrld.aomode & WO_AODIST) fac+= expf(-packet[a].dist*R.wrld.aodistfac);
+				else fac+= 1.0f;
+			}
+			else if (envcolor!=WO_AOPLAIN) {
+				float skycol[4];
+				float view[3];
 				
-				if (adaptive_sample_contrast_val(samples, prev, fac, adapt_thresh)) {
-					break;
+				view[0]= -packetdir[a][0];
+				view[1]= -packetdir[a][1];
+				view[2]= -packetdir[a][2];
+				normalize_v3(view);
+				
+				if (envcolor==WO_AOSKYCOL) {
+					const float skyfac= 0.5f * (1.0f + dot_v3v3(view, R.grvec));
+					env[0]+= (1.0f-skyfac)*R.wrld.horr + skyfac*R.wrld.zenr;
+					env[1]+= (1.0f-skyfac)*R.wrld.horg + skyfac*R.wrld.zeng;
+					env[2]+= (1.0f-skyfac)*R.wrld.horb + skyfac*R.wrld.zenb;
+				}
+				else {	/* WO_AOSKYTEX */
+					shadeSkyView(skycol, isec.start, view, dxyview, shi->thread);
+					shadeSunView(skycol, shi->view);
+					env[0]+= skycol[0];
+					env[1]+= skycol[1];
+					env[2]+= skycol[2];
+				}
+				skyadded++;
+			}
+			
+			samples++;
+			
+			if (qsa && qsa->type == SAMP_TYPE_HALTON) {
+				/* adaptive sampling - consider samples below threshold as in shadow (or vice versa) and exit early */
+				if (adapt_thresh > 0.0f && (samples > max_samples/2) ) {
+					
+					if (adaptive_sample_contrast_val(samples, prev, fac, adapt_thresh)) {
+						done = TRUE;
+						break;
+					}
 				}
 			}
 		}
@@ -2001,12 +2188,12 @@ static void ray_ao_qmc(ShadeInput *shi, float ao[3], float env[3])
 /* extern call from shade_lamp_loop, ambient occlusion calculus */
 static void ray_ao_spheresamp(ShadeInput *shi, float ao[3], float env[3])
 {
-	Isect isec;
+	Isect isec, packet[RE_RAY_PACKET_SIZE];
 	RayHint point_hint;
-	float *vec, *nrm, bias, sh=0.0f;
+	float *vec, *nrm, *packetvec[RE_RAY_PACKET_SIZE], bias, sh=0.0f;
 	float maxdist = R.wrld.aodist;
 	float dxyview[3];
-	int j= -1, tot, actual=0, skyadded=0, envcolor, resol= R.wrld.aosamp;
+	int j= -1, tot, totpacket=0, actual=0, skyadded=0, envcolor, resol= R.wrld.aosamp;
 	
 	RE_RC_INIT(isec, *shi);
 	isec.orig.ob   = shi->obi;
@@ -2064,61 +2251,71 @@ static void ray_ao_spheresamp(ShadeInput *shi, float ao[3], float env[3])
 	}
 	
 	while (tot--) {
+		int trace = (dot_v3v3(vec, nrm) > bias);
 		
-		if (dot_v3v3(vec, nrm) > bias) {
+		if (trace && (R.r.mode & R_OSA)) {
 			/* only ao samples for mask */
-			if (R.r.mode & R_OSA) {
-				j++;
-				if (j==R.osa) j= 0;
-				if (!(shi->mask & (1<<j))) {
-					vec+=3;
-					continue;
-				}
-			}
-			
+			j++;
+			if (j==R.osa) j= 0;
+			if (!(shi->mask & (1<<j)))
+				trace = FALSE;
+		}
+		
+		if (trace) {
 			actual++;
 			
 			/* always set start/vec/dist */
-			isec.dir[0] = -vec[0];
-			isec.dir[1] = -vec[1];
-			isec.dir[2] = -vec[2];
-			isec.dist = maxdist;
+			packet[totpacket] = isec;
+			packet[totpacket].dir[0] = -vec[0];
+			packet[totpacket].dir[1] = -vec[1];
+			packet[totpacket].dir[2] = -vec[2];
+			packet[totpacket].dist = maxdist;
 			
 			if (shi->obi->flag & R_ENV_TRANSFORMED)
-				ray_env_rotate_dir(&isec, shi->obi->imat);
+				ray_env_rotate_dir(&packet[totpacket], shi->obi->imat);
 
-			/* do the trace */
-			if (RE_rayobject_raycast(R.raytree, &isec)) {
-				if (R.wrld.aomode & WO_AODIST) sh+= expf(-isec.dist*R.wrld.aodistfac);
-				else sh+= 1.0f;
-			}
-			else if (envcolor!=WO_AOPLAIN) {
-				float skycol[4];
-				float view[3];
-				
-				view[0]= -vec[0];
-				view[1]= -vec[1];
-				view[2]= -vec[2];
-				normalize_v3(view);
-				
-				if (envcolor==WO_AOSKYCOL) {
-					const float fac = 0.5f * (1.0f + dot_v3v3(view, R.grvec));
-					env[0]+= (1.0f-fac)*R.wrld.horr + fac*R.wrld.zenr;
-					env[1]+= (1.0f-fac)*R.wrld.horg + fac*R.wrld.zeng;
-					env[2]+= (1.0f-fac)*R.wrld.horb + fac*R.wrld.zenb;
+			packetvec[totpacket++] = vec;
+		}
+		/* samples */
+		vec+= 3;
+		
+		/* do the trace, when the packet is full or after the last sample */
+		if (totpacket == RE_RAY_PACKET_SIZE || (tot == 0 && totpacket > 0)) {
+			int a, hit = raycast_packet_stats(packet, totpacket, shi->thread, RAY_STATS_AO);
+			
+			for (a = 0; a < totpacket; a++) {
+				if (hit & (1 << a)) {
+					if (R.wrld.aomode & WO_AODIST) sh+= expf(-packet[a].dist*R.wrld.aodistfac);
+					else sh+= 1.0f;
 				}
-				else {	/* WO_AOSKYTEX */
-					shadeSkyView(skycol, isec.start, view, dxyview, shi->thread);
-					shadeSunView(skycol, shi->view);
-					env[0]+= skycol[0];
-					env[1]+= skycol[1];
-					env[2]+= skycol[2];
+				else if (envcolor!=WO_AOPLAIN) {
+					float skycol[4];
+					float view[3];
+					
+					view[0]= -packetvec[a][0];
+					view[1]= -packetvec[a][1];
+					view[2]= -packetvec[a][2];
+					normalize_v3(view);
+					
+					if (envcolor==WO_AOSKYCOL) {
+						const float fac = 0.5f * (1.0f + dot_v3v3(view, R.grvec));
+						env[0]+= (1.0f-fac)*R.wrld.horr + fac*R.wrld.zenr;
+						env[1]+= (1.0f-fac)*R.wrld.horg + fac*R.wrld.zeng;
+						env[2]+= (1.0f-fac)*R.wrld.horb + fac*R.wrld.zenb;
+					}
+					else {	/* WO_AOSKYTEX */
+						shadeSkyView(skycol, isec.start, view, dxyview, shi->thread);
+						shadeSunView(skycol, shi->view);
+						env[0]+= skycol[0];
+						env[1]+= skycol[1];
+						env[2]+= skycol[2];
+					}
+					skyadded++;
 				}
-				skyadded++;
 			}
+			
+			totpacket = 0;
 		}
-		/* samples */
-		vec+= 3;
 	}
 	
 	if (actual==0) sh= 1.0f;
@@ -2185,18 +2382,89 @@ static void ray_shadow_jittered_coords(ShadeInput *shi, int max, float jitco[RE_
 	}
 }
 
+/* sets start and direction of a shadow ray for the given QMC sample */
+static void ray_shadow_qmc_sample(ShadeInput *shi, LampRen *lar, QMCSampler *qsa, const float lampco[3],
+                                  float jitco[RE_MAX_OSA][3], int totjitco, int do_soft, int sample, Isect *isec)
+{
+	float samp3d[3], start[3], end[3];
+
+	isec->orig.ob   = shi->obi;
+	isec->orig.face = shi->vlr;
+
+	/* manually jitter the start shading co-ord per sample
+	 * based on the pre-generated OSA texture sampling offsets, 
+	 * for anti-aliasing sharp shadow edges. */
+	copy_v3_v3(start, jitco[sample % totjitco]);
+
+	if (do_soft) {
+		/* sphere shadow source */
+		if (lar->type == LA_LOCAL) {
+			float ru[3], rv[3], v[3], s[3];
+			
+			/* calc tangent plane vectors */
+			sub_v3_v3v3(v, start, lampco);
+			normalize_v3(v);
+			ortho_basis_v3v3_v3(ru, rv, v);
+			
+			/* sampling, returns quasi-random vector in area_size disc */
+			QMC_sampleDisc(samp3d, qsa, shi->thread, sample, lar->area_size);
+
+			/* distribute disc samples across the tangent plane */
+			s[0] = samp3d[0]*ru[0] + samp3d[1]*rv[0];
+			s[1] = samp3d[0]*ru[1] + samp3d[1]*rv[1];
+			s[2] = samp3d[0]*ru[2] + samp3d[1]*rv[2];
+			
+			copy_v3_v3(samp3d, s);
+		}
+		else {
+			/* sampling, returns quasi-random vector in [sizex,sizey]^2 plane */
+			QMC_sampleRect(samp3d, qsa, shi->thread, sample, lar->area_size, lar->area_sizey);
+							
+			/* align samples to lamp vector */
+			mul_m3_v3(lar->mat, samp3d);
+		}
+		end[0] = lampco[0]+samp3d[0];
+		end[1] = lampco[1]+samp3d[1];
+		end[2] = lampco[2]+samp3d[2];
+	}
+	else {
+		copy_v3_v3(end, lampco);
+	}
+
+	if (shi->strand) {
+		/* bias away somewhat to avoid self intersection */
+		float jitbias= 0.5f*(len_v3(shi->dxco) + len_v3(shi->dyco));
+		float v[3];
+
+		sub_v3_v3v3(v, start, end);
+		normalize_v3(v);
+
+		start[0] -= jitbias*v[0];
+		start[1] -= jitbias*v[1];
+		start[2] -= jitbias*v[2];
+	}
+	
+	copy_v3_v3(isec->start, start);
+	isec->dir[0] = end[0]-isec->start[0];
+	isec->dir[1] = end[1]-isec->start[1];
+	isec->dir[2] = end[2]-isec->start[2];
+	isec->dist = normalize_v3(isec->dir);
+	
+	if (shi->obi->flag & R_ENV_TRANSFORMED)
+		ray_env_rotate(isec, shi->obi->imat);
+}
+
 static void ray_shadow_qmc(ShadeInput *shi, LampRen *lar, const float lampco[3], float shadfac[4], Isect *isec)
 {
 	QMCSampler *qsa=NULL;
 	int samples=0;
-	float samp3d[3];
 
-	float fac=0.0f, vec[3], end[3];
+	float fac=0.0f;
 	float colsq[4];
 	float adapt_thresh = lar->adapt_thresh;
 	int min_adapt_samples=4, max_samples = lar->ray_totsamp;
-	float start[3];
-	int do_soft = TRUE, full_osa = FALSE, i;
+	int do_soft = TRUE, full_osa = FALSE, done = FALSE, i;
+	int adaptive;
 
 	float min[3], max[3];
 	RayHint bb_hint;
@@ -2247,79 +2515,17 @@ static void ray_shadow_qmc(ShadeInput *shi, LampRen *lar, const float lampco[3],
 	isec->hint = &bb_hint;
 	isec->check = RE_CHECK_VLR_RENDER;
 	isec->skip = RE_SKIP_VLR_NEIGHBOUR;
-	copy_v3_v3(vec, lampco);
-	
-	while (samples < max_samples) {
-
-		isec->orig.ob   = shi->obi;
-		isec->orig.face = shi->vlr;
-
-		/* manually jitter the start shading co-ord per sample
-		 * based on the pre-generated OSA texture sampling offsets, 
-		 * for anti-aliasing sharp shadow edges. */
-		copy_v3_v3(start, jitco[samples % totjitco]);
 
-		if (do_soft) {
-			/* sphere shadow source */
-			if (lar->type == LA_LOCAL) {
-				float ru[3], rv[3], v[3], s[3];
-				
-				/* calc tangent plane vectors */
-				sub_v3_v3v3(v, start, lampco);
-				normalize_v3(v);
-				ortho_basis_v3v3_v3(ru, rv, v);
-				
-				/* sampling, returns quasi-random vector in area_size disc */
-				QMC_sampleDisc(samp3d, qsa, shi->thread, samples, lar->area_size);
-
-				/* distribute disc samples across the tangent plane */
-				s[0] = samp3d[0]*ru[0] + samp3d[1]*rv[0];
-				s[1] = samp3d[0]*ru[1] + samp3d[1]*rv[1];
-				s[2] = samp3d[0]*ru[2] + samp3d[1]*rv[2];
-				
-				copy_v3_v3(samp3d, s);
-			}
-			else {
-				/* sampling, returns quasi-random vector in [sizex,sizey]^2 plane */
-				QMC_sampleRect(samp3d, qsa, shi->thread, samples, lar->area_size, lar->area_sizey);
-								
-				/* align samples to lamp vector */
-				mul_m3_v3(lar->mat, samp3d);
-			}
-			end[0] = vec[0]+samp3d[0];
-			end[1] = vec[1]+samp3d[1];
-			end[2] = vec[2]+samp3d[2];
-		}
-		else {
-			copy_v3_v3(end, vec);
-		}
-
-		if (shi->strand) {
-			/* bias away somewhat to avoid self intersection */
-			float jitbias= 0.5f*(len_v3(shi->dxco) + len_v3(shi->dyco));
-			float v[3];
-
-			sub_v3_v3v3(v, start, end);
-			normalize_v3(v);
+	/* adaptive sampling - consider samples below threshold as in shadow (or vice versa) and exit early */
+	adaptive = (lar->ray_samp_method == LA_SAMP_HALTON) && (max_samples > min_adapt_samples) && (adapt_thresh > 0.0f);
+	
+	if (isec->mode==RE_RAY_SHADOW_TRA) {
+		while (samples < max_samples) {
+			float col[4] = {1.0f, 1.0f, 1.0f, 1.0f};
 
-			start[0] -= jitbias*v[0];
-			start[1] -= jitbias*v[1];
-			start[2] -= jitbias*v[2];
-		}
-		
-		copy_v3_v3(isec->start, start);
-		isec->dir[0] = end[0]-isec->start[0];
-		isec->dir[1] = end[1]-isec->start[1];
-		isec->dir[2] = end[2]-isec->start[2];
-		isec->dist = normalize_v3(isec->dir);
-		
-		if (shi->obi->flag & R_ENV_TRANSFORMED)
-			ray_env_rotate(isec, shi->obi->imat);
+			ray_shadow_qmc_sample(shi, lar, qsa, lampco, jitco, totjitco, do_soft, samples, isec);
 
-		/* trace the ray */
-		if (isec->mode==RE_RAY_SHADOW_TRA) {
-			float col[4] = {1.0f, 1.0f, 1.0f, 1.0f};
-			
+			/* trace the ray */
 			ray_trace_shadow_tra(isec, shi, DEPTH_SHADOW_TRA, 0, col);
 			shadfac[0] += col[0];
 			shadfac[1] += col[1];
@@ -2330,26 +2536,44 @@ static void ray_shadow_qmc(ShadeInput *shi, LampRen *lar, const float lampco[3],
 			colsq[0] += col[0]*col[0];
 			colsq[1] += col[1]*col[1];
 			colsq[2] += col[2]*col[2];
+			
+			samples++;
+			
+			if (adaptive && (samples > max_samples / 3)) {
+				if ((shadfac[3] / samples > (1.0f-adapt_thresh)) || (shadfac[3] / samples < adapt_thresh))
+					break;
+				else if (adaptive_sample_variance(samples, shadfac, colsq, adapt_thresh))
+					break;
+			}
 		}
-		else {
-			if ( RE_rayobject_raycast(R.raytree, isec) ) fac+= 1.0f;
-		}
-		
-		samples++;
-		
-		if (lar->ray_samp_method == LA_SAMP_HALTON) {
-		
-			/* adaptive sampling - consider samples below threshold as in shadow (or vice versa) and exit early */
-			if ((max_samples > min_adapt_samples) && (adapt_thresh > 0.0f) && (samples > max_samples / 3)) {
-				if (isec->mode==RE_RAY_SHADOW_TRA) {
-					if ((shadfac[3] / samples > (1.0f-adapt_thresh)) || (shadfac[3] / samples < adapt_thresh))
-						break;
-					else if (adaptive_sample_variance(samples, shadfac, colsq, adapt_thresh))
-						break;
+	}
+	else {
+		while (samples < max_samples && !done) {
+			Isect packet[RE_RAY_PACKET_SIZE];
+			int a, hit, totpacket = min_ii(max_samples - samples, RE_RAY_PACKET_SIZE);
+
+			/* the next samples are traced together, the results are still
+			 * accumulated one by one so adaptive sampling stops at the same sample */
+			for (a = 0; a < totpacket; a++) {
+				packet[a] = *isec;
+				ray_shadow_qmc_sample(shi, lar, qsa, lampco, jitco, totjitco, do_soft, samples + a, &packet[a]);
+			}
+
+			hit = raycast_packet_stats(packet, totpacket, shi->thread, RAY_STATS_SHADOW);
+
+			for (a = 0; a < totpacket; a++) {
+				if (hit & (1 << a)) {
+					fac += 1.0f;
+					isec->last_hit = packet[a].last_hit;
 				}
-				else {
-					if ((fac / samples > (1.0f-adapt_thresh)) || (fac / samples < adapt_thresh))
+				
+				samples++;
+				
+				if (adaptive && (samples > max_samples / 3)) {
+					if ((fac / samples > (1.0f-adapt_thresh)) || (fac / samples < adapt_thresh)) {
+						done = TRUE;
 						break;
+					}
 				}
 			}
 		}
@@ -2438,7 +2662,7 @@ static void ray_shadow_jitter(ShadeInput *shi, LampRen *lar, const float lampco[
 			shadfac[2] += col[2];
 			shadfac[3] += col[3];
 		}
-		else if ( RE_rayobject_raycast(R.raytree, isec) ) fac+= 1.0f;
+		else if ( raycast_stats(isec, shi->thread, RAY_STATS_SHADOW) ) fac+= 1.0f;
 		
 		div+= 1.0f;
 		jitlamp+= 2;
@@ -2533,7 +2757,7 @@ void ray_shadow(ShadeInput *shi, LampRen *lar, float shadfac[4])
 				ray_trace_shadow_tra(&isec, shi, DEPTH_SHADOW_TRA, 0, col);
 				copy_v4_v4(shadfac, col);
 			}
-			else if (RE_rayobject_raycast(R.raytree, &isec))
+			else if (raycast_stats(&isec, shi->thread, RAY_STATS_SHADOW))
 				shadfac[3]= 0.0f;
 		}
 		else {
@@ -38,6 +38,7 @@
 #include "BLI_utildefines.h"
 #include "BLI_fileops.h"
 #include "BLI_listbase.h"
+#include "BLI_math_base.h"
 #include "BLI_path_util.h"
 #include "BLI_rect.h"
 #include "BLI_string.h"
@@ -956,6 +957,7 @@ void render_result_exr_file_end(Render *re)
 {
 	RenderResult *rr;
 	RenderLayer *rl;
+	int stream = render_result_exr_file_stream(re);
 
 	save_empty_result_tiles(re);
 	
@@ -968,12 +970,157 @@ void render_result_exr_file_end(Render *re)
 		rr->do_exr_tile = FALSE;
 	}
 	
+	if (stream) {
+		/* keep layers and passes without buffers, the file is written from the tile files */
+		re->result->exr_stream = TRUE;
+		return;
+	}
+
 	render_result_free_list(&re->fullresult, re->result);
 	re->result = NULL;
 
 	render_result_exr_file_read(re, 0);
 }
 
+/* background renders to a multilayer exr don't need the result in memory when
+ * nothing else works on the full buffers, it gets written from the tile files */
+int render_result_exr_file_stream(Render *re)
+{
+	Scene *scene = re->scene;
+
+	if (!G.background || re->result == NULL || re->result->next)
+		return FALSE;
+	if (!(re->r.scemode & R_EXR_TILE_FILE) || re->r.im_format.imtype != R_IMF_IMTYPE_MULTILAYER)
+		return FALSE;
+	if (re->r.scemode & (R_FULL_SAMPLE | R_SINGLE_LAYER | R_BUTS_PREVIEW | R_VIEWPORT_PREVIEW))
+		return FALSE;
+
+	/* fields, blur, border, flares, freestyle and stamp all work on the full buffers */
+	if (re->r.mode & (R_FIELDS | R_MBLUR | R_EDGE_FRS))
+		return FALSE;
+	if ((re->r.mode & R_BORDER) && !(re->r.mode & R_CROP))
+		return FALSE;
+	if ((re->flag & R_HALO) || (re->r.stamp & R_STAMP_DRAW))
+		return FALSE;
+
+	/* compositing and sequencer */
+	if (scene->nodetree && scene->use_nodes && (re->r.scemode & R_DOCOMP))
+		return FALSE;
+	if (RE_seq_render_active(scene, &re->r))
+		return FALSE;
+
+	return TRUE;
+}
+
+static void exr_stream_set_channels(void *exrhandle, RenderLayer *rl, int rectx, int ymin)
+{
+	RenderPass *rpass;
+	int a;
+
+	/* rects point to where the full image would start */
+	for (a = 0; a < 4; a++)
+		IMB_exr_set_channel(exrhandle, rl->name, get_pass_name(SCE_PASS_COMBINED, a),
+		                    4, 4 * rectx, rl->rectf + a - 4 * rectx * ymin);
+
+	for (rpass = rl->passes.first; rpass; rpass = rpass->next) {
+		int xstride = rpass->channels;
+		for (a = 0; a < xstride; a++)
+			IMB_exr_set_channel(exrhandle, rl->name, get_pass_name(rpass->passtype, a),
+			                    xstride, xstride * rectx, rpass->rect + a - xstride * rectx * ymin);
+	}
+}
+
+/* write multilayer exr from the tile files of a streamed result, in bands of
+ * part rows. layers and passes only hold one band at a time. a write that
+ * is canceled halfway fails, and the incomplete file is removed */
+int render_result_exr_file_write(Render *re, ReportList *reports, const char *filename, int compress)
+{
+	RenderResult *rr = re->result;
+	RenderLayer *rl;
+	RenderPass *rpass;
+	void *exrhandle, **readhandle;
+	char str[FILE_MAX];
+	int a, nr, totlayer, rectx, recty, bandy, ymin, ymax, success = TRUE;
+
+	totlayer = BLI_countlist(&rr->layers);
+	if (totlayer == 0)
+		return FALSE;
+
+	bandy = (re->party > 0) ? min_ii(re->party, rr->recty) : rr->recty;
+	readhandle = MEM_callocN(sizeof(void *) * totlayer, "exr stream handles");
+	exrhandle = IMB_exr_get_handle();
+
+	for (nr = 0, rl = rr->layers.first; rl; rl = rl->next, nr++) {
+		readhandle[nr] = IMB_exr_get_handle();
+
+		render_result_exr_file_path(re->scene, rl->name, 0, str);
+		if (!IMB_exr_begin_read(readhandle[nr], str, &rectx, &recty) || rectx != rr->rectx || recty != rr->recty) {
+			printf("cannot read: %s\n", str);
+			success = FALSE;
+		}
+
+		rl->rectf = MEM_mapallocN(sizeof(float) * 4 * rr->rectx * bandy, "exr stream combined");
+		for (a = 0; a < 4; a++)
+			IMB_exr_add_channel(exrhandle, rl->name, get_pass_name(SCE_PASS_COMBINED, a), 0, 0, NULL);
+
+		for (rpass = rl->passes.first; rpass; rpass = rpass->next) {
+			rpass->rect = MEM_mapallocN(sizeof(float) * rpass->channels * rr->rectx * bandy, "exr stream pass");
+			for (a = 0; a < rpass->channels; a++)
+				IMB_exr_add_channel(exrhandle, rl->name, get_pass_name(rpass->passtype, a), 0, 0, NULL);
+		}
+	}
+
+	BLI_make_existing_file(filename);
+
+	if (success && IMB_exr_begin_write(exrhandle, filename, rr->rectx, rr->recty, compress)) {
+		/* scanlines are written top to bottom, bands stay aligned with the part rows */
+		for (ymin = ((rr->recty - 1) / bandy) * bandy; ymin >= 0; ymin -= bandy) {
+			ymax = min_ii(ymin + bandy, rr->recty) - 1;
+
+			for (nr = 0, rl = rr->layers.first; rl; rl = rl->next, nr++) {
+				exr_stream_set_channels(readhandle[nr], rl, rr->rectx, ymin);
+				IMB_exr_read_channels_rows(readhandle[nr], ymin, ymax);
+				exr_stream_set_channels(exrhandle, rl, rr->rectx, ymin);
+			}
+
+			IMB_exr_write_channels_rows(exrhandle, ymax - ymin + 1);
+
+			if (ymin > 0 && re->test_break(re->tbh)) {
+				BKE_report(reports, RPT_WARNING, "Writing render result canceled");
+				success = FALSE;
+				break;
+			}
+		}
+
+		IMB_exr_close(exrhandle);
+
+		if (!success)
+			BLI_delete(filename, false, false);
+	}
+	else {
+		BKE_report(reports, RPT_ERROR, "Error writing render result (see console)");
+		success = FALSE;
+
+		IMB_exr_close(exrhandle);
+	}
+
+	for (nr = 0, rl = rr->layers.first; rl; rl = rl->next, nr++) {
+		IMB_exr_close(readhandle[nr]);
+
+		MEM_freeN(rl->rectf);
+		rl->rectf = NULL;
+
+		for (rpass = rl->passes.first; rpass; rpass = rpass->next) {
+			MEM_freeN(rpass->rect);
+			rpass->rect = NULL;
+		}
+	}
+
+	MEM_freeN(readhandle);
+
+	return success;
+}
+
 /* save part into exr file */
 void render_result_exr_file_merge(RenderResult *rr, RenderResult *rrpart)
 {
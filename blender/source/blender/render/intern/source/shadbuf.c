@@ -86,7 +86,8 @@ extern struct Render R;
 
 /* ------------------------------------------------------------------------- */
 
-static void copy_to_ztile(int *rectz, int size, int x1, int y1, int tile, char *r1)
+/* rectz holds the rows of the shadow buffer starting at ystart */
+static void copy_to_ztile(int *rectz, int size, int x1, int y1, int ystart, int tile, char *r1)
 {
 	int len4, *rz;
 	int x2, y2;
@@ -99,7 +100,7 @@ static void copy_to_ztile(int *rectz, int size, int x1, int y1, int tile, char *
 	if (x1>=x2 || y1>=y2) return;
 
 	len4= 4*(x2- x1);
-	rz= rectz + size*y1 + x1;
+	rz= rectz + size*(y1 - ystart) + x1;
 	for (; y1<y2; y1++) {
 		memcpy(r1, rz, len4);
 		rz+= size;
@@ -305,9 +306,10 @@ static float deep_alpha(Render *re, int obinr, int facenr, int strand)
 	return ma->shad_alpha;
 }
 
-static void compress_deepshadowbuf(Render *re, ShadBuf *shb, APixstr *apixbuf, APixstrand *apixbufstrand)
+/* compress the A-buffer of the rows ystart to yend into the deep samples of shsample */
+static void compress_deepshadowbuf(Render *re, ShadBuf *shb, ShadSampleBuf *shsample,
+                                   APixstr *apixbuf, APixstrand *apixbufstrand, int ystart, int yend)
 {
-	ShadSampleBuf *shsample;
 	DeepSample *ds[RE_MAX_OSA], *sampleds[RE_MAX_OSA], *dsb, *newbuf;
 	APixstr *ap, *apn;
 	APixstrand *aps, *apns;
@@ -320,16 +322,10 @@ static void compress_deepshadowbuf(Render *re, ShadBuf *shb, APixstr *apixbuf, A
 
 	int a, b, c, tot, minz, found, prevtot, newtot;
 	int sampletot[RE_MAX_OSA], totsample = 0, totsamplec = 0;
-	
-	shsample= MEM_callocN(sizeof(ShadSampleBuf), "shad sample buf");
-	BLI_addtail(&shb->buffers, shsample);
-
-	shsample->totbuf = MEM_callocN(sizeof(int) * size * size, "deeptotbuf");
-	shsample->deepbuf = MEM_callocN(sizeof(DeepSample *) * size * size, "deepbuf");
 
 	ap= apixbuf;
 	aps= apixbufstrand;
-	for (a=0; a<size*size; a++, ap++, aps++) {
+	for (a=ystart*size; a<yend*size; a++, ap++, aps++) {
 		/* count number of samples */
 		for (c=0; c<totbuf; c++)
 			sampletot[c]= 0;
@@ -503,29 +499,23 @@ static void compress_deepshadowbuf(Render *re, ShadBuf *shb, APixstr *apixbuf, A
 	//printf("%d -> %d, ratio %f\n", totsample, totsamplec, (float)totsamplec/(float)totsample);
 }
 
-/* create Z tiles (for compression): this system is 24 bits!!! */
-static void compress_shadowbuf(ShadBuf *shb, int *rectz, int square)
+/* create Z tiles (for compression): this system is 24 bits!!!
+ * rectz holds the rows ystart to yend, which are multiples of the tile size */
+static void compress_shadowbuf(ShadBuf *shb, ShadSampleBuf *shsample, int *rectz, int ystart, int yend, int square)
 {
-	ShadSampleBuf *shsample;
 	float dist;
 	uintptr_t *ztile;
 	int *rz, *rz1, verg, verg1, size= shb->size;
 	int a, x, y, minx, miny, byt1, byt2;
 	char *rc, *rcline, *ctile, *zt;
 	
-	shsample= MEM_callocN(sizeof(ShadSampleBuf), "shad sample buf");
-	BLI_addtail(&shb->buffers, shsample);
-	
-	shsample->zbuf= MEM_mallocN(sizeof(uintptr_t)*(size*size)/256, "initshadbuf2");
-	shsample->cbuf= MEM_callocN((size*size)/256, "initshadbuf3");
-	
-	ztile= (uintptr_t *)shsample->zbuf;
-	ctile= shsample->cbuf;
+	ztile= (uintptr_t *)shsample->zbuf + (ystart/16)*(size/16);
+	ctile= shsample->cbuf + (ystart/16)*(size/16);
 	
 	/* help buffer */
 	rcline= MEM_mallocN(256*4+sizeof(int), "makeshadbuf2");
 	
-	for (y=0; y<size; y+=16) {
+	for (y=ystart; y<yend; y+=16) {
 		if (y< size/2) miny= y+15-size/2;
 		else miny= y-size/2;
 		
@@ -543,7 +533,7 @@ static void compress_shadowbuf(ShadBuf *shb, int *rectz, int square)
 				rz1= (&verg)+1;
 			}
 			else {
-				copy_to_ztile(rectz, size, x, y, 16, rcline);
+				copy_to_ztile(rectz, size, x, y, ystart, 16, rcline);
 				rz1= (int *)rcline;
 				
 				verg= (*rz1 & 0xFFFFFF00);
@@ -717,43 +707,80 @@ static void shadowbuf_autoclip(Render *re, LampRen *lar)
 	}
 }
 
-static void makeflatshadowbuf(Render *re, LampRen *lar, float *jitbuf)
+static ShadSampleBuf *add_shadow_samplebuf(ShadBuf *shb, int deep)
 {
+	ShadSampleBuf *shsample;
+	int size= shb->size;
+
+	shsample= MEM_callocN(sizeof(ShadSampleBuf), "shad sample buf");
+	BLI_addtail(&shb->buffers, shsample);
+
+	if (deep) {
+		shsample->totbuf = MEM_callocN(sizeof(int) * size * size, "deeptotbuf");
+		shsample->deepbuf = MEM_callocN(sizeof(DeepSample *) * size * size, "deepbuf");
+	}
+	else {
+		shsample->zbuf= MEM_mallocN(sizeof(uintptr_t)*(size*size)/256, "initshadbuf2");
+		shsample->cbuf= MEM_callocN((size*size)/256, "initshadbuf3");
+	}
+
+	return shsample;
+}
+
+/* Shadow buffers are zbuffered and compressed in bands of rows. Each band only
+ * needs a z or A-buffer of its own size, and with more than one thread assigned
+ * to a buffer the bands are divided over the threads. */
+
+/* upper limit of pixels in the z or A-buffer of a band */
+#define SHADBUF_BAND_PIXELS			(1 << 22)
+#define SHADBUF_DEEP_BAND_PIXELS	(1 << 20)
+
+typedef struct ShadBufBands {
+	Render *re;
+	LampRen *lar;
+	float *jitbuf;
+	ShadSampleBuf *shsample[RE_MAX_OSA];
+	int bandsize, totband, nextband, totdone;
+} ShadBufBands;
+
+static void makeflatshadowband(ShadBufBands *bands, int *rectz, int ystart, int yend)
+{
+	Render *re= bands->re;
+	LampRen *lar= bands->lar;
 	ShadBuf *shb= lar->shb;
-	int *rectz, samples;
+	float *jitbuf= bands->jitbuf;
+	int samples;
 
-	/* zbuffering */
-	rectz= MEM_mapallocN(sizeof(int)*shb->size*shb->size, "makeshadbuf");
-	
 	for (samples=0; samples<shb->totbuf; samples++) {
-		zbuffer_shadow(re, shb->persmat, lar, rectz, shb->size, jitbuf[2*samples], jitbuf[2*samples+1]);
+		zbuffer_shadow(re, shb->persmat, lar, rectz, shb->size, ystart, yend, jitbuf[2*samples], jitbuf[2*samples+1]);
 		/* create Z tiles (for compression): this system is 24 bits!!! */
-		compress_shadowbuf(shb, rectz, lar->mode & LA_SQUARE);
+		compress_shadowbuf(shb, bands->shsample[samples], rectz, ystart, yend, lar->mode & LA_SQUARE);
 
 		if (re->test_break(re->tbh))
 			break;
 	}
-	
-	MEM_freeN(rectz);
 }
 
-static void makedeepshadowbuf(Render *re, LampRen *lar, float *jitbuf)
+static void makedeepshadowband(ShadBufBands *bands, int ystart, int yend)
 {
+	Render *re= bands->re;
+	LampRen *lar= bands->lar;
 	ShadBuf *shb= lar->shb;
 	APixstr *apixbuf;
 	APixstrand *apixbufstrand= NULL;
 	ListBase apsmbase= {NULL, NULL};
+	int totpixel= shb->size*(yend - ystart);
 
 	/* zbuffering */
-	apixbuf= MEM_callocN(sizeof(APixstr)*shb->size*shb->size, "APixbuf");
+	apixbuf= MEM_callocN(sizeof(APixstr)*totpixel, "APixbuf");
 	if (re->totstrand)
-		apixbufstrand= MEM_callocN(sizeof(APixstrand)*shb->size*shb->size, "APixbufstrand");
+		apixbufstrand= MEM_callocN(sizeof(APixstrand)*totpixel, "APixbufstrand");
 
 	zbuffer_abuf_shadow(re, lar, shb->persmat, apixbuf, apixbufstrand, &apsmbase, shb->size,
-		shb->totbuf, (float(*)[2])jitbuf);
+		ystart, yend, shb->totbuf, (float(*)[2])bands->jitbuf);
 
 	/* create Z tiles (for compression): this system is 24 bits!!! */
-	compress_deepshadowbuf(re, shb, apixbuf, apixbufstrand);
+	compress_deepshadowbuf(re, shb, bands->shsample[0], apixbuf, apixbufstrand, ystart, yend);
 	
 	MEM_freeN(apixbuf);
 	if (apixbufstrand)
@@ -761,6 +788,119 @@ static void makedeepshadowbuf(Render *re, LampRen *lar, float *jitbuf)
 	freepsA(&apsmbase);
 }
 
+static int shadowband_next(ShadBufBands *bands)
+{
+	int band= -1;
+
+	BLI_lock_thread(LOCK_CUSTOM1);
+	if (bands->nextband < bands->totband)
+		band= bands->nextband++;
+	BLI_unlock_thread(LOCK_CUSTOM1);
+
+	return band;
+}
+
+static void *do_shadow_band_thread(void *bands_v)
+{
+	ShadBufBands *bands= (ShadBufBands *)bands_v;
+	Render *re= bands->re;
+	ShadBuf *shb= bands->lar->shb;
+	int *rectz= NULL;
+	int band, ystart, yend;
+
+	if (bands->lar->buftype != LA_SHADBUF_DEEP)
+		rectz= MEM_mapallocN(sizeof(int)*shb->size*bands->bandsize, "makeshadbuf");
+
+	while (!re->test_break(re->tbh) && (band= shadowband_next(bands)) != -1) {
+		ystart= band*bands->bandsize;
+		yend= min_ii(ystart + bands->bandsize, shb->size);
+
+		if (rectz)
+			makeflatshadowband(bands, rectz, ystart, yend);
+		else
+			makedeepshadowband(bands, ystart, yend);
+	}
+
+	if (rectz)
+		MEM_freeN(rectz);
+
+	BLI_lock_thread(LOCK_CUSTOM1);
+	bands->totdone++;
+	BLI_unlock_thread(LOCK_CUSTOM1);
+
+	return NULL;
+}
+
+static volatile int g_break= 0;
+static int thread_break(void *UNUSED(arg))
+{
+	return g_break;
+}
+
+static void makeshadowbands(Render *re, LampRen *lar, float *jitbuf)
+{
+	ShadBuf *shb= lar->shb;
+	ShadBufBands bands;
+	ListBase threads;
+	int a, maxpixels, totthread= max_ii(shb->totthread, 1);
+
+	memset(&bands, 0, sizeof(ShadBufBands));
+	bands.re= re;
+	bands.lar= lar;
+	bands.jitbuf= jitbuf;
+
+	if (lar->buftype == LA_SHADBUF_DEEP) {
+		bands.shsample[0]= add_shadow_samplebuf(shb, 1);
+		maxpixels= SHADBUF_DEEP_BAND_PIXELS;
+	}
+	else {
+		for (a=0; a<shb->totbuf; a++)
+			bands.shsample[a]= add_shadow_samplebuf(shb, 0);
+		maxpixels= SHADBUF_BAND_PIXELS;
+	}
+
+	/* a few bands per thread to balance the load, in multiples of the 16 pixel tiles */
+	bands.bandsize= (totthread > 1)? shb->size/(2*totthread): shb->size;
+	bands.bandsize= min_ii(bands.bandsize, maxpixels/shb->size);
+	bands.bandsize= max_ii((bands.bandsize + 15) & ~15, 16);
+	bands.totband= (shb->size + bands.bandsize - 1)/bands.bandsize;
+
+	totthread= min_ii(totthread, bands.totband);
+
+	if (totthread <= 1) {
+		do_shadow_band_thread(&bands);
+	}
+	else {
+		int (*test_break)(void *)= re->test_break;
+		int done;
+
+		/* swap test break function, it's polled here while the bands are made */
+		re->test_break= thread_break;
+
+		BLI_init_threads(&threads, do_shadow_band_thread, totthread);
+
+		for (a=0; a<totthread; a++)
+			BLI_insert_thread(&threads, &bands);
+
+		do {
+			if ((g_break=test_break(re->tbh)))
+				break;
+
+			PIL_sleep_ms(10);
+
+			BLI_lock_thread(LOCK_CUSTOM1);
+			done= (bands.totdone == totthread);
+			BLI_unlock_thread(LOCK_CUSTOM1);
+		} while (!done);
+
+		BLI_end_threads(&threads);
+
+		/* unset threadsafety */
+		re->test_break= test_break;
+		g_break= 0;
+	}
+}
+
 void makeshadowbuf(Render *re, LampRen *lar)
 {
 	ShadBuf *shb= lar->shb;
@@ -798,12 +938,10 @@ void makeshadowbuf(Render *re, LampRen *lar)
 		else jitbuf= twozero;
 		
 		/* zbuffering */
-		if (lar->buftype == LA_SHADBUF_DEEP) {
-			makedeepshadowbuf(re, lar, jitbuf);
+		makeshadowbands(re, lar, jitbuf);
+
+		if (lar->buftype == LA_SHADBUF_DEEP)
 			shb->totbuf= 1;
-		}
-		else
-			makeflatshadowbuf(re, lar, jitbuf);
 
 		/* printf("lampbuf %d\n", sizeoflampbuf(shb)); */
 	}
@@ -836,34 +974,64 @@ static void *do_shadow_thread(void *re_v)
 	return NULL;
 }
 
-static volatile int g_break= 0;
-static int thread_break(void *UNUSED(arg))
+/* relative cost of building a shadow buffer */
+static double shadowbuf_cost(LampRen *lar)
 {
-	return g_break;
+	/* irregular buffers only get their matrices set here */
+	if (lar->buftype == LA_SHADBUF_IRREGULAR)
+		return 0.0;
+
+	return (double)lar->shb->size * (double)lar->shb->size * (double)lar->buffers;
 }
 
 void threaded_makeshadowbufs(Render *re)
 {
 	ListBase threads;
 	LampRen *lar;
-	int a, totthread= 0;
+	double totcost= 0.0;
+	int a, totlamp= 0, totthread= 1;
 	int (*test_break)(void *);
 
 	/* count number of threads to use */
 	if (G.is_rendering) {
 		for (lar=re->lampren.first; lar; lar= lar->next)
 			if (lar->shb)
-				totthread++;
+				totcost += shadowbuf_cost(lar);
 		
-		totthread = min_ii(totthread, re->r.threads);
+		totthread = re->r.threads;
+	}
+	/* else preview render */
+
+	/* a buffer that would keep one thread busy longer than all the other buffers
+	 * together is built first, with all threads working on its bands */
+	for (lar=re->lampren.first; lar; lar= lar->next) {
+		if (lar->shb) {
+			lar->thread_assigned= 0;
+			lar->thread_ready= 0;
+			lar->shb->totthread= (totthread > 1 && shadowbuf_cost(lar) * totthread > totcost)? totthread: 1;
+		}
 	}
-	else
-		totthread = 1; /* preview render */
+
+	for (lar=re->lampren.first; lar; lar= lar->next) {
+		if (lar->shb && lar->shb->totthread > 1) {
+			if (re->test_break(re->tbh)) break;
+			makeshadowbuf(re, lar);
+			lar->thread_assigned= 1;
+			lar->thread_ready= 1;
+		}
+	}
+
+	/* the remaining buffers are spread over threads */
+	for (lar=re->lampren.first; lar; lar= lar->next)
+		if (lar->shb && !lar->thread_assigned)
+			totlamp++;
+
+	totthread = min_ii(totlamp, totthread);
 
 	if (totthread <= 1) {
 		for (lar=re->lampren.first; lar; lar= lar->next) {
 			if (re->test_break(re->tbh)) break;
-			if (lar->shb) {
+			if (lar->shb && !lar->thread_assigned) {
 				/* if type is irregular, this only sets the perspective matrix and autoclips */
 				makeshadowbuf(re, lar);
 			}
@@ -874,11 +1042,6 @@ void threaded_makeshadowbufs(Render *re)
 		test_break= re->test_break;
 		re->test_break= thread_break;
 
-		for (lar=re->lampren.first; lar; lar= lar->next) {
-			lar->thread_assigned= 0;
-			lar->thread_ready= 0;
-		}
-
 		BLI_init_threads(&threads, do_shadow_thread, totthread);
 		
 		for (a=0; a<totthread; a++)
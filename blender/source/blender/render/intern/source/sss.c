@@ -54,15 +54,20 @@
 #include "BLI_utildefines.h"
 #include "BLI_ghash.h"
 #include "BLI_memarena.h"
+#include "BLI_threads.h"
 
 #include "BLF_translation.h"
 
 #include "PIL_time.h"
 
+#include "DNA_group_types.h"
+#include "DNA_image_types.h"
 #include "DNA_material_types.h"
+#include "DNA_texture_types.h"
 
 #include "BKE_colortools.h"
 #include "BKE_global.h"
+#include "BKE_image.h"
 #include "BKE_main.h"
 #include "BKE_material.h"
 #include "BKE_node.h"
@@ -152,8 +157,19 @@ struct ScatterTree {
 	ScatterPoint **tmppoints;
 	int totpoint;
 	float min[3], max[3];
+
+	int dothreadedbuild;
+	int totbuildthread;
 };
 
+typedef struct ScatterBuildThread {
+	ScatterTree *tree;
+	ScatterNode *node;
+	ScatterPoint **refpoints;
+	float mid[3], size[3];
+	int depth;
+} ScatterBuildThread;
+
 typedef struct ScatterResult {
 	float rad[3];
 	float backrad[3];
@@ -652,13 +668,31 @@ static void subnode_middle(int i, float *mid, float *subsize, float *submid)
 	submid[2]= mid[2] + ((z)? subsize[2]: -subsize[2]);
 }
 
+static void create_octree_node(ScatterTree *tree, ScatterNode *node, float *mid, float *size, ScatterPoint **refpoints, int depth);
+
+static void *exec_octree_build(void *data)
+{
+	ScatterBuildThread *sthread= (ScatterBuildThread *)data;
+
+	create_octree_node(sthread->tree, sthread->node, sthread->mid, sthread->size,
+		sthread->refpoints, sthread->depth);
+
+	return 0;
+}
+
 static void create_octree_node(ScatterTree *tree, ScatterNode *node, float *mid, float *size, ScatterPoint **refpoints, int depth)
 {
+	ListBase threads;
+	ScatterBuildThread sthreads[8];
 	ScatterNode *subnode;
-	ScatterPoint **subrefpoints, **tmppoints= tree->tmppoints;
-	int index, nsize[8], noffset[8], i, subco, used_nodes, usedi;
+	ScatterPoint **subrefpoints, **tmppoints;
+	int index, nsize[8], noffset[8], i, subco, used_nodes, usedi, dothreads, totthread= 0;
 	float submid[3], subsize[3];
 
+	/* each node only touches the slice of tmppoints matching its refpoints,
+	 * so subtrees can be built in parallel */
+	tmppoints= tree->tmppoints + (refpoints - tree->refpoints);
+
 	/* stopping condition */
 	if (node->totpoint <= MAX_OCTREE_NODE_POINTS || depth == MAX_OCTREE_DEPTH) {
 		for (i=0; i<node->totpoint; i++)
@@ -710,10 +744,24 @@ static void create_octree_node(ScatterTree *tree, ScatterNode *node, float *mid,
 		noffset[index]++;
 	}
 
+	/* the subtrees of the root are built in threads, the remaining ones when all
+	 * threads are busy are built by the calling thread */
+	dothreads= (tree->dothreadedbuild && node == tree->root);
+
+	if (dothreads)
+		BLI_init_threads(&threads, exec_octree_build, tree->totbuildthread);
+
 	/* create subnodes */
 	for (subco=0, i=0; i<8; subco+=nsize[i], i++) {
 		if (nsize[i] > 0) {
+			if (tree->dothreadedbuild)
+				BLI_lock_thread(LOCK_CUSTOM1);
+
 			subnode= BLI_memarena_alloc(tree->arena, sizeof(ScatterNode));
+
+			if (tree->dothreadedbuild)
+				BLI_unlock_thread(LOCK_CUSTOM1);
+
 			node->child[i]= subnode;
 			subnode->points= node->points + subco;
 			subnode->totpoint= nsize[i];
@@ -721,13 +769,27 @@ static void create_octree_node(ScatterTree *tree, ScatterNode *node, float *mid,
 
 			subnode_middle(i, mid, subsize, submid);
 
-			create_octree_node(tree, subnode, submid, subsize, subrefpoints,
-				depth+1);
+			if (dothreads && BLI_available_threads(&threads)) {
+				sthreads[totthread].tree= tree;
+				sthreads[totthread].node= subnode;
+				sthreads[totthread].refpoints= subrefpoints;
+				sthreads[totthread].depth= depth+1;
+				copy_v3_v3(sthreads[totthread].mid, submid);
+				copy_v3_v3(sthreads[totthread].size, subsize);
+				BLI_insert_thread(&threads, &sthreads[totthread]);
+				totthread++;
+			}
+			else
+				create_octree_node(tree, subnode, submid, subsize, subrefpoints,
+					depth+1);
 		}
 		else
 			node->child[i]= NULL;
 	}
 
+	if (dothreads)
+		BLI_end_threads(&threads);
+
 	node->points= NULL;
 	node->totpoint= 0;
 }
@@ -775,7 +837,7 @@ ScatterTree *scatter_tree_new(ScatterSettings *ss[3], float scale, float error,
 	return tree;
 }
 
-void scatter_tree_build(ScatterTree *tree)
+void scatter_tree_build(ScatterTree *tree, int totthread)
 {
 	ScatterPoint *newpoints, **tmppoints;
 	float mid[3], size[3];
@@ -788,6 +850,10 @@ void scatter_tree_build(ScatterTree *tree)
 	tree->arena= BLI_memarena_new(0x8000 * sizeof(ScatterNode), "sss tree arena");
 	BLI_memarena_use_calloc(tree->arena);
 
+	/* threads */
+	tree->totbuildthread= (totpoint > 10000) ? min_ii(totthread, BLENDER_MAX_THREADS) : 1;
+	tree->dothreadedbuild= (tree->totbuildthread > 1);
+
 	/* build tree */
 	tree->root= BLI_memarena_alloc(tree->arena, sizeof(ScatterNode));
 	tree->root->points= newpoints;
@@ -851,16 +917,206 @@ typedef struct SSSPoints {
 	int totpoint;
 } SSSPoints;
 
-static void sss_create_tree_mat(Render *re, Material *mat)
+/* irradiance points of a material, kept between animation frames as long as
+ * the scene checksum stays the same. points are in camera space, so this also
+ * requires a static camera */
+typedef struct SSSPersist {
+	struct SSSPersist *next, *prev;
+
+	Material *mat;
+	unsigned int hash;
+
+	float (*co)[3];
+	float (*color)[3];
+	float *area;
+	int totpoint;
+} SSSPersist;
+
+static unsigned int sss_checksum(unsigned int hash, const void *data, size_t size)
+{
+	const unsigned int *word= data;
+	size_t a, len= size/sizeof(unsigned int);
+
+	for (a=0; a<len; a++)
+		hash= (hash ^ word[a]) * 16777619u;
+
+	return hash;
+}
+
+#define SSS_CHECKSUM_RANGE(hash, ptr, first, last) \
+	sss_checksum(hash, &(ptr)->first, (size_t)((char *)&(ptr)->last - (char *)&(ptr)->first))
+
+static int sss_persistent_enabled(Render *re)
+{
+	if (!(re->flag & R_ANIMATION) || !(re->r.mode & R_PERSISTENT_DATA))
+		return 0;
+	if (re->flag & (R_BAKING|R_MBLUR_PASS))
+		return 0;
+
+	return 1;
+}
+
+static int sss_texture_static(MTex **mtex)
+{
+	Tex *tex;
+	int a;
+
+	for (a=0; a<MAX_MTEX; a++) {
+		if (mtex[a] && (tex= mtex[a]->tex)) {
+			if (tex->adt || (tex->use_nodes && tex->nodetree))
+				return 0;
+			if (tex->type == TEX_IMAGE && tex->ima && ELEM(tex->ima->source, IMA_SRC_SEQUENCE, IMA_SRC_MOVIE))
+				return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* texture slot and texture settings, textures are tested static already */
+static unsigned int sss_mtex_checksum(unsigned int hash, MTex **mtex)
+{
+	Tex *tex;
+	int a;
+
+	for (a=0; a<MAX_MTEX; a++) {
+		if (mtex[a] && (tex= mtex[a]->tex)) {
+			hash= sss_checksum(hash, &a, sizeof(a));
+			hash= SSS_CHECKSUM_RANGE(hash, mtex[a], texco, object);
+			hash= SSS_CHECKSUM_RANGE(hash, mtex[a], projx, zenupfac);
+			hash= SSS_CHECKSUM_RANGE(hash, tex, noisesize, iuser);
+			hash= sss_checksum(hash, &tex->ima, sizeof(tex->ima));
+		}
+	}
+
+	return hash;
+}
+
+/* animated materials and textures are not covered by the checksum */
+static int sss_material_static(Material *mat)
+{
+	if (mat->adt || (mat->use_nodes && mat->nodetree))
+		return 0;
+
+	return sss_texture_static(mat->mtex);
+}
+
+/* checksum of everything in the database that the irradiance points depend on,
+ * shared by all materials. zero means the points can't be kept */
+static unsigned int sss_scene_checksum(Render *re)
+{
+	ObjectInstanceRen *obi;
+	ObjectRen *obr;
+	VertRen *ver;
+	GroupObject *go;
+	LampRen *lar;
+	unsigned int hash= 2166136261u;
+	int a, tot[2];
+
+	tot[0]= re->winx;
+	tot[1]= re->winy;
+	hash= sss_checksum(hash, tot, sizeof(tot));
+	hash= sss_checksum(hash, &re->r.mode, sizeof(re->r.mode));
+	hash= sss_checksum(hash, re->winmat, sizeof(re->winmat));
+	hash= SSS_CHECKSUM_RANGE(hash, &re->wrld, colormodel, aosphere);
+
+	for (obi=re->instancetable.first; obi; obi=obi->next) {
+		obr= obi->obr;
+
+		tot[0]= obr->totvert;
+		tot[1]= obr->totvlak;
+		hash= sss_checksum(hash, tot, sizeof(tot));
+
+		if (obi->flag & R_TRANSFORMED)
+			hash= sss_checksum(hash, obi->mat, sizeof(obi->mat));
+
+		for (a=0; a<obr->totvert; a++) {
+			ver= RE_findOrAddVert(obr, a);
+			hash= sss_checksum(hash, ver->co, sizeof(ver->co));
+			hash= sss_checksum(hash, ver->n, sizeof(ver->n));
+		}
+	}
+
+	for (go=re->lights.first; go; go=go->next) {
+		lar= go->lampren;
+		if (lar == NULL) continue;
+
+		if (!sss_texture_static(lar->mtex))
+			return 0;
+
+		hash= SSS_CHECKSUM_RANGE(hash, lar, xs, curfalloff);
+		hash= SSS_CHECKSUM_RANGE(hash, lar, bufsize, xold);
+		hash= SSS_CHECKSUM_RANGE(hash, lar, area_size, sunsky);
+		hash= sss_checksum(hash, lar->mat, sizeof(lar->mat));
+		hash= sss_mtex_checksum(hash, lar->mtex);
+	}
+
+	return hash;
+}
+
+static unsigned int sss_material_checksum(Material *mat, unsigned int hash)
+{
+	hash= SSS_CHECKSUM_RANGE(hash, mat, material_type, ramp_col);
+	hash= SSS_CHECKSUM_RANGE(hash, mat, sss_radius, mapto_textured);
+	hash= sss_mtex_checksum(hash, mat->mtex);
+
+	return hash;
+}
+
+static SSSPersist *sss_persistent_find(Render *re, Material *mat)
+{
+	SSSPersist *persist;
+
+	for (persist=re->ssspersist.first; persist; persist=persist->next)
+		if (persist->mat == mat)
+			return persist;
+
+	return NULL;
+}
+
+static void sss_persistent_free(SSSPersist *persist)
+{
+	MEM_freeN(persist->co);
+	MEM_freeN(persist->color);
+	MEM_freeN(persist->area);
+}
+
+static void sss_create_tree_mat(Render *re, Material *mat, unsigned int scenehash)
 {
 	SSSPoints *p;
+	SSSPersist *persist= NULL;
 	RenderResult *rr;
 	ListBase points;
 	float (*co)[3] = NULL, (*color)[3] = NULL, *area = NULL;
-	int totpoint = 0, osa, osaflag, partsdone;
+	unsigned int hash= 0;
+	int totpoint = 0, osa, osaflag, partsdone, keep= FALSE;
 
 	if (re->test_break(re->tbh))
 		return;
+
+	if (scenehash && sss_material_static(mat)) {
+		hash= sss_material_checksum(mat, scenehash);
+		persist= sss_persistent_find(re, mat);
+
+		/* same scene as previous frame, skip the preprocessing render */
+		if (persist && persist->hash == hash) {
+			co= persist->co;
+			color= persist->color;
+			area= persist->area;
+			totpoint= persist->totpoint;
+			keep= TRUE;
+
+			if (G.debug & G_DEBUG)
+				printf("sss tree %s: %d points kept from previous frame\n", mat->id.name+2, totpoint);
+
+			goto build;
+		}
+	}
+	else if ((persist= sss_persistent_find(re, mat))) {
+		sss_persistent_free(persist);
+		BLI_freelinkN(&re->ssspersist, persist);
+		persist= NULL;
+	}
 	
 	points.first= points.last= NULL;
 
@@ -928,6 +1184,25 @@ static void sss_create_tree_mat(Render *re, Material *mat)
 	}
 	BLI_freelistN(&points);
 
+	/* keep points for the next frame, incomplete ones are not kept */
+	if (hash && totpoint && !re->test_break(re->tbh)) {
+		if (persist)
+			sss_persistent_free(persist);
+		else {
+			persist= MEM_callocN(sizeof(SSSPersist), "SSSPersist");
+			persist->mat= mat;
+			BLI_addtail(&re->ssspersist, persist);
+		}
+
+		persist->hash= hash;
+		persist->co= co;
+		persist->color= color;
+		persist->area= area;
+		persist->totpoint= totpoint;
+		keep= TRUE;
+	}
+
+build:
 	/* build tree */
 	if (!re->test_break(re->tbh)) {
 		SSSData *sss= MEM_callocN(sizeof(*sss), "SSSData");
@@ -946,15 +1221,17 @@ static void sss_create_tree_mat(Render *re, Material *mat)
 		sss->tree= scatter_tree_new(sss->ss, mat->sss_scale, error,
 			co, color, area, totpoint);
 
-		MEM_freeN(co);
-		MEM_freeN(color);
-		MEM_freeN(area);
+		if (!keep) {
+			MEM_freeN(co);
+			MEM_freeN(color);
+			MEM_freeN(area);
+		}
 
-		scatter_tree_build(sss->tree);
+		scatter_tree_build(sss->tree, re->r.threads);
 
 		BLI_ghash_insert(re->sss_hash, mat, sss);
 	}
-	else {
+	else if (!keep) {
 		if (co) MEM_freeN(co);
 		if (color) MEM_freeN(color);
 		if (area) MEM_freeN(area);
@@ -995,11 +1272,17 @@ void make_sss_tree(Render *re)
 	Material *mat;
 	bool infostr_set = false;
 	const char *prevstr = NULL;
+	unsigned int scenehash = 0;
 
 	free_sss(re);
 	
 	re->sss_hash= BLI_ghash_ptr_new("make_sss_tree gh");
 
+	if (sss_persistent_enabled(re))
+		scenehash= sss_scene_checksum(re);
+	else
+		free_sss_persistent(re);
+
 	re->stats_draw(re->sdh, &re->i);
 	
 	for (mat= re->main->mat.first; mat; mat= mat->id.next) {
@@ -1010,7 +1293,7 @@ void make_sss_tree(Render *re)
 				infostr_set = true;
 			}
 
-			sss_create_tree_mat(re, mat);
+			sss_create_tree_mat(re, mat, scenehash);
 		}
 	}
 	
@@ -1025,7 +1308,7 @@ void make_sss_tree(Render *re)
 					infostr_set = true;
 				}
 
-				sss_create_tree_mat(re, mat);
+				sss_create_tree_mat(re, mat, 0);
 			}
 		}
 	}
@@ -1050,6 +1333,16 @@ void free_sss(Render *re)
 	}
 }
 
+void free_sss_persistent(Render *re)
+{
+	SSSPersist *persist;
+
+	for (persist=re->ssspersist.first; persist; persist=persist->next)
+		sss_persistent_free(persist);
+
+	BLI_freelistN(&re->ssspersist);
+}
+
 int sample_sss(Render *re, Material *mat, const float co[3], float color[3])
 {
 	if (re->sss_hash) {
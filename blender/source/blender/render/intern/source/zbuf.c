@@ -2296,7 +2296,17 @@ void zbuffer_solid(RenderPart *pa, RenderLayer *rl, void(*fillfunc)(RenderPart *
 	}
 }
 
-void zbuffer_shadow(Render *re, float winmat[4][4], LampRen *lar, int *rectz, int size, float jitx, float jity)
+/* clip flags against the band of rows being filled, same bits as zbuf_part_project() */
+static int zbuf_shadow_band_clip(const float bounds[4], const float ho[4])
+{
+	if (ho[1] > bounds[3]*ho[3]) return 4;
+	else if (ho[1] < bounds[2]*ho[3]) return 8;
+	return 0;
+}
+
+/* rectz holds the rows ystart to yend of the shadow buffer, so large buffers can
+ * be filled in horizontal bands, each by its own thread */
+void zbuffer_shadow(Render *re, float winmat[4][4], LampRen *lar, int *rectz, int size, int ystart, int yend, float jitx, float jity)
 {
 	ZbufProjectCache cache[ZBUF_PROJECT_CACHE_SIZE];
 	ZSpan zspan;
@@ -2308,25 +2318,31 @@ void zbuffer_shadow(Render *re, float winmat[4][4], LampRen *lar, int *rectz, in
 	StrandRen *strand= NULL;
 	StrandVert *svert;
 	StrandBound *sbound;
-	float obwinmat[4][4], ho1[4], ho2[4], ho3[4], ho4[4];
-	int a, b, c, i, c1, c2, c3, c4, ok=1, lay= -1;
+	float obwinmat[4][4], bounds[4], ho1[4], ho2[4], ho3[4], ho4[4];
+	int a, b, c, i, c1, c2, c3, c4= 0, bandclip, ok=1, lay= -1, bandy= yend - ystart;
 
 	if (lar->mode & (LA_LAYER|LA_LAYER_SHADOW)) lay= lar->lay;
 
+	/* same as zbuffer_part_bounds(), for the full width of the band */
+	bounds[0]= (float)(-size-1)/(float)size;
+	bounds[1]= (float)(size+1)/(float)size;
+	bounds[2]= (float)(2*ystart - size-1)/(float)size;
+	bounds[3]= (float)(2*yend - size+1)/(float)size;
+
 	/* 1.0f for clipping in clippyra()... bad stuff actually */
-	zbuf_alloc_span(&zspan, size, size, 1.0f);
+	zbuf_alloc_span(&zspan, size, bandy, 1.0f);
 	zspan.zmulx=  ((float)size)/2.0f;
 	zspan.zmuly=  ((float)size)/2.0f;
 	/* -0.5f to center the sample position */
 	zspan.zofsx= jitx - 0.5f;
-	zspan.zofsy= jity - 0.5f;
+	zspan.zofsy= jity - ystart - 0.5f;
 	
 	/* the buffers */
 	zspan.rectz= rectz;
-	fillrect(rectz, size, size, 0x7FFFFFFE);
+	fillrect(rectz, size, bandy, 0x7FFFFFFE);
 	if (lar->buftype==LA_SHADBUF_HALFWAY) {
-		zspan.rectz1= MEM_mallocN(size*size*sizeof(int), "seconday z buffer");
-		fillrect(zspan.rectz1, size, size, 0x7FFFFFFE);
+		zspan.rectz1= MEM_mallocN(size*bandy*sizeof(int), "seconday z buffer");
+		fillrect(zspan.rectz1, size, bandy, 0x7FFFFFFE);
 	}
 	
 	/* filling methods */
@@ -2346,7 +2362,7 @@ void zbuffer_shadow(Render *re, float winmat[4][4], LampRen *lar, int *rectz, in
 		else
 			copy_m4_m4(obwinmat, winmat);
 
-		if (clip_render_object(obi->obr->boundbox, NULL, obwinmat))
+		if (clip_render_object(obi->obr->boundbox, bounds, obwinmat))
 			continue;
 
 		zbuf_project_cache_clear(cache, obr->totvert);
@@ -2368,22 +2384,28 @@ void zbuffer_shadow(Render *re, float winmat[4][4], LampRen *lar, int *rectz, in
 				c1= zbuf_shadow_project(cache, vlr->v1->index, obwinmat, vlr->v1->co, ho1);
 				c2= zbuf_shadow_project(cache, vlr->v2->index, obwinmat, vlr->v2->co, ho2);
 				c3= zbuf_shadow_project(cache, vlr->v3->index, obwinmat, vlr->v3->co, ho3);
-
-				if ((ma->material_type == MA_TYPE_WIRE) || (vlr->flag & R_STRAND)) {
-					if (vlr->v4) {
-						c4= zbuf_shadow_project(cache, vlr->v4->index, obwinmat, vlr->v4->co, ho4);
-						zbufclipwire(&zspan, 0, a+1, vlr->ec, ho1, ho2, ho3, ho4, c1, c2, c3, c4);
+				if (vlr->v4)
+					c4= zbuf_shadow_project(cache, vlr->v4->index, obwinmat, vlr->v4->co, ho4);
+
+				/* faces entirely above or below this band are skipped */
+				bandclip= zbuf_shadow_band_clip(bounds, ho1) & zbuf_shadow_band_clip(bounds, ho2) &
+				          zbuf_shadow_band_clip(bounds, ho3);
+				if (vlr->v4)
+					bandclip &= zbuf_shadow_band_clip(bounds, ho4);
+
+				if (bandclip == 0) {
+					if ((ma->material_type == MA_TYPE_WIRE) || (vlr->flag & R_STRAND)) {
+						if (vlr->v4)
+							zbufclipwire(&zspan, 0, a+1, vlr->ec, ho1, ho2, ho3, ho4, c1, c2, c3, c4);
+						else
+							zbufclipwire(&zspan, 0, a+1, vlr->ec, ho1, ho2, ho3, 0, c1, c2, c3, 0);
 					}
-					else
-						zbufclipwire(&zspan, 0, a+1, vlr->ec, ho1, ho2, ho3, 0, c1, c2, c3, 0);
-				}
-				else {
-					if (vlr->v4) {
-						c4= zbuf_shadow_project(cache, vlr->v4->index, obwinmat, vlr->v4->co, ho4);
-						zbufclip4(&zspan, 0, 0, ho1, ho2, ho3, ho4, c1, c2, c3, c4);
+					else {
+						if (vlr->v4)
+							zbufclip4(&zspan, 0, 0, ho1, ho2, ho3, ho4, c1, c2, c3, c4);
+						else
+							zbufclip(&zspan, 0, 0, ho1, ho2, ho3, c1, c2, c3);
 					}
-					else
-						zbufclip(&zspan, 0, 0, ho1, ho2, ho3, c1, c2, c3);
 				}
 			}
 
@@ -2396,7 +2418,7 @@ void zbuffer_shadow(Render *re, float winmat[4][4], LampRen *lar, int *rectz, in
 			/* for each bounding box containing a number of strands */
 			sbound= obr->strandbuf->bound;
 			for (c=0; c<obr->strandbuf->totbound; c++, sbound++) {
-				if (clip_render_object(sbound->boundbox, NULL, obwinmat))
+				if (clip_render_object(sbound->boundbox, bounds, obwinmat))
 					continue;
 
 				/* for each strand in this bounding box */
@@ -2448,7 +2470,7 @@ void zbuffer_shadow(Render *re, float winmat[4][4], LampRen *lar, int *rectz, in
 	
 	/* merge buffers */
 	if (lar->buftype==LA_SHADBUF_HALFWAY) {
-		for (a=size*size -1; a>=0; a--)
+		for (a=size*bandy -1; a>=0; a--)
 			rectz[a]= (rectz[a]>>1) + (zspan.rectz1[a]>>1);
 		
 		MEM_freeN(zspan.rectz1);
@@ -3459,7 +3481,8 @@ static int zbuffer_abuf_render(RenderPart *pa, APixstr *APixbuf, APixstrand *APi
 	return doztra;
 }
 
-void zbuffer_abuf_shadow(Render *re, LampRen *lar, float winmat[4][4], APixstr *APixbuf, APixstrand *APixbufstrand, ListBase *apsmbase, int size, int samples, float (*jit)[2])
+/* like zbuffer_shadow(), the buffers only hold the rows ystart to yend */
+void zbuffer_abuf_shadow(Render *re, LampRen *lar, float winmat[4][4], APixstr *APixbuf, APixstrand *APixbufstrand, ListBase *apsmbase, int size, int ystart, int yend, int samples, float (*jit)[2])
 {
 	RenderPart pa;
 	int lay= -1;
@@ -3468,11 +3491,11 @@ void zbuffer_abuf_shadow(Render *re, LampRen *lar, float winmat[4][4], APixstr *
 
 	memset(&pa, 0, sizeof(RenderPart));
 	pa.rectx= size;
-	pa.recty= size;
+	pa.recty= yend - ystart;
 	pa.disprect.xmin = 0;
-	pa.disprect.ymin = 0;
+	pa.disprect.ymin = ystart;
 	pa.disprect.xmax = size;
-	pa.disprect.ymax = size;
+	pa.disprect.ymax = yend;
 
 	zbuffer_abuf(re, &pa, APixbuf, apsmbase, lay, 0, winmat, size, size, samples, jit, 1.0f, 1);
 	if (APixbufstrand)